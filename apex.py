@@ -34,6 +34,8 @@ parser.add_argument("code", type=str, help="C source code compiled into LLVM byt
 parser.add_argument("file", type=str, help="Target file name (NOT FULL PATH).")
 parser.add_argument("line", type=int, help="Target line number.")
 parser.add_argument("--export", type=str, help="true/false for exporting call graphs.")
+parser.add_argument("--slicer", type=str, help="true/false for using dg slicer instead of dependency blocks.")
+parser.add_argument("--newpm", type=str, help="true/false for running APEX via the new pass manager.")
 
 # Parse cmd line args.
 args = parser.parse_args()
@@ -41,6 +43,8 @@ code = args.code
 target_file = args.file
 line = args.line
 export = args.export
+slicer = args.slicer
+newpm = args.newpm
 
 execute("rm -rf build extracted; mkdir build")
 
@@ -58,8 +62,14 @@ execute("llvm-as build/linked.ll -o build/linked.bc")
 if not os.path.isfile("src/build/apex/libAPEXPass.so"):
     print("ERROR: Please first build APEX with: make build")
     sys.exit(1)
-opt = """opt -o build/apex.bc -load src/build/apex/libAPEXPass.so -apex -file={FILE} -line={LINE} < build/linked.bc 2> build/apex.log
-      """.format(FILE=target_file, LINE=line)
+# The new pass manager loads the pass via -load-pass-plugin, -load is still
+# needed so that opt knows APEX command line options.
+if newpm and newpm == "true":
+    passes = "-load-pass-plugin src/build/apex/libAPEXPass.so -passes=apex"
+else:
+    passes = "-apex"
+opt = """opt -o build/apex.bc -load src/build/apex/libAPEXPass.so {PASSES} -file={FILE} -line={LINE} -slicer={SLICER} < build/linked.bc 2> build/apex.log
+      """.format(PASSES=passes, FILE=target_file, LINE=line, SLICER=("true" if slicer == "true" else "false"))
 execute(opt)
 
 # Compile apex.bc into executable called "extracted"
@@ -16,7 +16,12 @@
 #include "apex.h"
 
 /// Running on each module.
-bool APEXPass::runOnModule(Module &M) {
+bool APEXPass::runOnModule(Module &M) { return runAPEX(M, nullptr); }
+
+/// Runs APEX on the module @M. When @MAM is given, points-to analysis, dg and
+/// dependency blocks are taken from the cached analyses instead of being
+/// computed here.
+bool APEXPass::runAPEX(Module &M, ModuleAnalysisManager *MAM) {
   logPrintUnderline("APEXPass START.");
 
 
@@ -36,30 +41,61 @@ bool APEXPass::runOnModule(Module &M) {
 
   logPrintUnderline(
       "Initializing dg. Calculating control and data dependencies.");
-  dgInit(M);
+  if (MAM && ARG_SLICER) {
+    // Slicer removes nodes from the dg, so it must not work on the cached
+    // dg. dg can not be copied and it keeps constructed functions in a global
+    // map, so there can be only one dg at a time: drop the cached dg and build
+    // our copy from the cached points-to analysis (slicer does not change it).
+    PreservedAnalyses PA = PreservedAnalyses::all();
+    PA.abandon<APEXDgAnalysis>();
+    PA.abandon<APEXDependencyBlocksAnalysis>();
+    MAM->invalidate(M, PA);
+    pta_ = MAM->getResult<APEXPTAAnalysis>(M).pta.get();
+    dgInit(M);
+  } else if (MAM) {
+    dg_ = MAM->getResult<APEXDgAnalysis>(M).dg.get();
+    logPrint("- done (cached)");
+  } else {
+    dgInit(M);
+  }
 
-  logPrintUnderline("Extracting data from dg. Building apex dependency graph.");
-  apexDgInit();
+  if (ARG_SLICER) {
+    logPrintUnderline("Marking target instructions as slicing criteria.");
+    dgMarkTargetInstructions();
 
-  if (VERBOSE_DEBUG) {
-    logPrintUnderline("Printing data dependencies from apex_dg.");
-    apexDgPrintDependenciesCompact();
+    logPrintUnderline("Marking call path from @" + source_function_id_ +
+                      " to @" + target_function_id_ + ".");
+    dgMarkCallPath(M);
+
+    logPrintUnderline("Slicing away everything that is not marked.");
+    dgSlice(M);
+  } else {
+    runDependencyBlocks(M, MAM);
   }
 
-  logPrintUnderline("Constructing function dependency blocks.");
-  apexDgComputeFunctionDependencyBlocks(M);
+  logPrintUnderline("Injecting exit and extract calls.");
+  moduleInjectExitExtract(M);
+
+  logPrintUnderline("Stripping debug symbols from every function in module.");
+  stripAllDebugSymbols(M);
 
   if (VERBOSE_DEBUG) {
-    logPrintUnderline("Printing calculated function dependency blocks.");
-    apexDgPrintFunctionDependencyBlocks();
+    logPrintUnderline("Final module dump.");
+    logDumpModule(M);
   }
 
-  logPrintUnderline("Constructing dependency blocks to functions call graph.");
-  apexDgConstructBlocksFunctionsCallgraph();
+  logPrintUnderline("APEXPass END.");
+  return true;
+}
 
-  if (VERBOSE_DEBUG) {
-    logPrintUnderline("Printing dependency block to functions call graph.");
-    apexDgPrintBlocksFunctionsCallgraph();
+/// Computes what to keep using dependency blocks and removes the rest.
+void APEXPass::runDependencyBlocks(Module &M, ModuleAnalysisManager *MAM) {
+  if (MAM) {
+    logPrintUnderline("Loading cached dependency blocks.");
+    blocks_ = &MAM->getResult<APEXDependencyBlocksAnalysis>(M);
+    logPrint("- done");
+  } else {
+    blocks_result_ = apexComputeDependencyBlocks(M, dg_, protected_functions_);
   }
 
   logPrintUnderline("Finding path from @" + source_function_id_ + " to @" +
@@ -75,39 +111,25 @@ bool APEXPass::runOnModule(Module &M) {
   logPrintUnderline("Removing functions and dependency blocks that do not "
                     "affect calculated path.");
   removeUnneededStuff(M);
-
-  logPrintUnderline("Injecting exit and extract calls.");
-  moduleInjectExitExtract(M);
-
-  logPrintUnderline("Stripping debug symbols from every function in module.");
-  stripAllDebugSymbols(M);
-
-  if (VERBOSE_DEBUG) {
-    logPrintUnderline("Final module dump.");
-    logDumpModule(M);
-  }
-
-  logPrintUnderline("APEXPass END.");
-  return true;
 }
 
 // Logging utilities
 // ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
 /// Simple logging print with newline.
-void APEXPass::logPrint(const std::string &message) {
+void logPrint(const std::string &message) {
   errs() << message + "\n";
 }
 
 /// Simple logging print with newline.
-void APEXPass::logPrintDbg(const std::string &message) {
+void logPrintDbg(const std::string &message) {
   if (VERBOSE_DEBUG) {
     errs() << message + "\n";
   }
 }
 
 /// Simple logging print with newline.
-void APEXPass::logPrintUnderline(const std::string &message) {
+void logPrintUnderline(const std::string &message) {
   std::string underline = "";
   for (int i = 0; i < message.size() + 4; ++i) {
     underline.append("=");
@@ -119,10 +141,10 @@ void APEXPass::logPrintUnderline(const std::string &message) {
 }
 
 /// Simple logging print WITHOUT newline.
-void APEXPass::logPrintFlat(const std::string &message) { errs() << message; }
+void logPrintFlat(const std::string &message) { errs() << message; }
 
 /// Dumps whole module M.
-void APEXPass::logDumpModule(const Module &M) {
+void logDumpModule(const Module &M) {
   M.dump();
   logPrint("");
 }
@@ -130,10 +152,10 @@ void APEXPass::logDumpModule(const Module &M) {
 // Function utilities
 // ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
-/// Returns true if function @F is protected,
-/// Protected functions will not be removed at the end of the APEXPass.
-bool APEXPass::functionIsProtected(const Function *F) {
-  for (std::string fcn_id : protected_functions_) {
+/// Returns true if function @F is in the @protected_functions.
+bool apexFunctionIsProtected(const Function *F,
+                             const std::vector<std::string> &protected_functions) {
+  for (std::string fcn_id : protected_functions) {
     if (F->getGlobalIdentifier() == fcn_id) {
       return true;
     }
@@ -141,6 +163,12 @@ bool APEXPass::functionIsProtected(const Function *F) {
   return false;
 }
 
+/// Returns true if function @F is protected,
+/// Protected functions will not be removed at the end of the APEXPass.
+bool APEXPass::functionIsProtected(const Function *F) {
+  return apexFunctionIsProtected(F, protected_functions_);
+}
+
 // Callgraph utilities
 // ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
@@ -152,14 +180,13 @@ bool APEXPass::functionIsProtected(const Function *F) {
 /// blocks that are on the execution flow.
 void APEXPass::findPath(const Module &M) {
   // @block_path is used to store path from @source_function to each node.
-  std::map<DependencyBlock *, std::vector<DependencyBlock>> block_path;
+  std::map<const DependencyBlock *, std::vector<DependencyBlock>> block_path;
   {
-    std::vector<DependencyBlock *> queue;
-    std::vector<DependencyBlock *> visited;
+    std::vector<const DependencyBlock *> queue;
+    std::vector<const DependencyBlock *> visited;
 
     // Initially push blocks from source function into the @queue.
-    for (auto &block :
-         function_dependency_blocks_[M.getFunction(source_function_id_)]) {
+    for (auto &block : functionBlocks(M.getFunction(source_function_id_))) {
       queue.push_back(&block);
     }
 
@@ -170,11 +197,9 @@ void APEXPass::findPath(const Module &M) {
 
       // Find if there are calls to other functions that come from the current
       // block.
-      for (const auto &called_function :
-           blocks_functions_callgraph_[*current_ptr]) {
+      for (const auto &called_function : blockCalledFunctions(*current_ptr)) {
         // Get blocks for those functions that are called.
-        for (auto &neighbour_block :
-             function_dependency_blocks_[called_function]) {
+        for (auto &neighbour_block : functionBlocks(called_function)) {
           // What we do here is that we copy the path from the current
           // block, append current node to it and assign this path to
           // each neighbour of current.
@@ -201,9 +226,8 @@ void APEXPass::findPath(const Module &M) {
   // We use heuristic and take last instruction from the @target_instructions_.
   // The reason is that inside @target_instructions_ may be more instructions
   // than present in target block (especially at the beginning), so
-  DependencyBlock *target_block = nullptr;
-  for (auto &block :
-       function_dependency_blocks_[M.getFunction(target_function_id_)]) {
+  const DependencyBlock *target_block = nullptr;
+  for (auto &block : functionBlocks(M.getFunction(target_function_id_))) {
     for (const auto &node_ptr : block) {
       if (target_instructions_.back() == node_ptr->getValue()) {
         // Check the target line, just in case.
@@ -246,36 +270,205 @@ void APEXPass::printPath() {
 // dg utilities
 // ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
-/// Initializes dg and calculates control & data dependencies.
-void APEXPass::dgInit(Module &M) {
+/// Calculates pointer analysis for @M.
+APEXPTAResult APEXPass::ptaCompute(Module &M) {
+  APEXPTAResult result;
+  result.pta.reset(new LLVMPointerAnalysis(&M));
+  result.pta->run<analysis::pta::PointsToFlowInsensitive>();
+  return result;
+}
+
+/// Calculates dg and control & data dependencies for @M from the points-to
+/// analysis @pta.
+APEXDgResult APEXPass::dgCompute(Module &M, LLVMPointerAnalysis *pta) {
   // The reasoning why everything below needs to be here:
   //
   // In order to get data dependencies, I've replicated
   // what llvm-dg-dump tool is doing, so for details, check:
   // dg/tools/llvm-dg-dump.cpp
-  LLVMPointerAnalysis *pta = new LLVMPointerAnalysis(&M);
-  pta->run<analysis::pta::PointsToFlowInsensitive>();
-  dg_.build(&M, pta);
+  APEXDgResult result;
+  result.dg.reset(new LLVMDependenceGraph());
+  result.dg->build(&M, pta);
   analysis::rd::LLVMReachingDefinitions rda(&M, pta);
   rda.run<analysis::rd::ReachingDefinitionsAnalysis>();
   // rda.run<analysis::rd::SemisparseRda>(); // This is alternative to above
   // ^^
-  LLVMDefUseAnalysis dua(&dg_, &rda, pta);
+  LLVMDefUseAnalysis dua(result.dg.get(), &rda, pta);
   dua.run();
-  dg_.computeControlDependencies(CD_ALG::CLASSIC);
+  result.dg->computeControlDependencies(CD_ALG::CLASSIC);
+  return result;
+}
+
+/// Initializes dg and calculates control & data dependencies. Points-to
+/// analysis is computed too, unless @pta_ is already set.
+void APEXPass::dgInit(Module &M) {
+  if (nullptr == pta_) {
+    pta_result_ = ptaCompute(M);
+    pta_ = pta_result_.pta.get();
+  }
+  dg_result_ = dgCompute(M, pta_);
+  dg_ = dg_result_.dg.get();
 
   logPrint("- done");
 }
 
+/// Marks target instructions (and everything they depend on) in the @dg_
+/// as slicing criteria.
+///
+/// Caution: @dgInit() has to be called before this.
+void APEXPass::dgMarkTargetInstructions() {
+  const std::map<llvm::Value *, LLVMDependenceGraph *> &CF =
+      dg::getConstructedFunctions();
+
+  for (const Instruction *I : target_instructions_) {
+    auto fcn_dg = CF.find(const_cast<Function *>(I->getFunction()));
+    if (fcn_dg == CF.end()) {
+      logPrint("ERROR: Target function is not in the dg! Make sure target "
+               "instructions are not dead code.");
+      exit(FATAL_ERROR);
+    }
+
+    LLVMNode *node = fcn_dg->second->getNode(const_cast<Instruction *>(I));
+    if (nullptr == node) {
+      logPrintFlat("ERROR: Could not find target instruction in the dg: ");
+      I->dump();
+      exit(FATAL_ERROR);
+    }
+    slice_id_ = slicer_.mark(node, slice_id_);
+  }
+  logPrint("- done");
+}
+
+/// Finds call sites that lead from source function to the target function
+/// and marks them (with their dependencies) with @slice_id_.
+///
+/// We walk backwards from the target function over callers, so every
+/// dependence graph is visited at most once.
+void APEXPass::dgMarkCallPath(const Module &M) {
+  const std::map<llvm::Value *, LLVMDependenceGraph *> &CF =
+      dg::getConstructedFunctions();
+
+  auto source_dg =
+      CF.find(const_cast<Function *>(M.getFunction(source_function_id_)));
+  auto target_dg =
+      CF.find(const_cast<Function *>(M.getFunction(target_function_id_)));
+  if (source_dg == CF.end() || target_dg == CF.end()) {
+    logPrint("ERROR: Source or target function is not in the dg!");
+    exit(FATAL_ERROR);
+  }
+
+  // @call_to maps dependence graph to the call site that we used to get there
+  // and to the called dependence graph (the one that is closer to the target).
+  std::map<LLVMDependenceGraph *, std::pair<LLVMNode *, LLVMDependenceGraph *>>
+      call_to;
+  std::set<LLVMDependenceGraph *> visited = {target_dg->second};
+  std::vector<LLVMDependenceGraph *> queue = {target_dg->second};
+  bool found_source = (source_dg->second == target_dg->second);
+
+  for (size_t i = 0; i < queue.size() && false == found_source; ++i) {
+    for (LLVMNode *caller : queue[i]->getCallers()) {
+      LLVMDependenceGraph *caller_dg = caller->getDG();
+      if (false == visited.insert(caller_dg).second) {
+        continue;
+      }
+      call_to[caller_dg] = std::make_pair(caller, queue[i]);
+      queue.push_back(caller_dg);
+
+      if (caller_dg == source_dg->second) {
+        found_source = true;
+        break;
+      }
+    }
+  }
+
+  if (false == found_source) {
+    logPrint("ERROR: There is no call path from @" + source_function_id_ +
+             " to @" + target_function_id_ + "!");
+    exit(FATAL_ERROR);
+  }
+
+  // Reconstruct the path from the source and mark every call site on it.
+  for (LLVMDependenceGraph *current = source_dg->second;
+       current != target_dg->second;) {
+    auto step = call_to.find(current);
+    assert(step != call_to.end() && "Broken call path");
+    LLVMNode *call_site = step->second.first;
+    if (VERBOSE_DEBUG) {
+      logPrintFlat("- call site: ");
+      call_site->getValue()->dump();
+    }
+    slice_id_ = slicer_.mark(call_site, slice_id_);
+
+    // Descend into the called graph that we came from. A call via
+    // function pointer can have more subgraphs, so we can not pick
+    // the graph from the subgraphs of the call site.
+    current = step->second.second;
+  }
+  logPrint("- done");
+}
+
+/// Slices away everything that was not marked with @slice_id_ and removes
+/// functions that did not get into the slice at all.
+void APEXPass::dgSlice(Module &M) {
+  for (const std::string &fcn_id : protected_functions_) {
+    slicer_.keepFunctionUntouched(fcn_id.c_str());
+  }
+  slicer_.slice(dg_, nullptr, slice_id_);
+
+  analysis::SlicerStatistics &st = slicer_.getStatistics();
+  logPrint("- sliced away " + std::to_string(st.nodesRemoved) + " from " +
+           std::to_string(st.nodesTotal) + " nodes");
+
+  const std::map<llvm::Value *, LLVMDependenceGraph *> &CF =
+      dg::getConstructedFunctions();
+  std::set<const Function *> functions_to_remove;
+  for (const auto &F : M) {
+    if (functionIsProtected(&F) ||
+        F.getGlobalIdentifier() == source_function_id_) {
+      continue;
+    }
+    auto fcn_dg = CF.find(const_cast<Function *>(&F));
+    if (fcn_dg == CF.end() || fcn_dg->second->getSlice() != slice_id_) {
+      functions_to_remove.insert(&F);
+    }
+  }
+  removeFunctions(M, functions_to_remove);
+}
+
 // apex dg utilities
 // ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
-/// Extracts data from @dg_ and stores them into @apex_dg_ structures.
+/// Stores control/reverse_control/data/reverse_data dependencies of the @node
+/// to the @apex_node.
+static void apexDgGetBlockNodeInfo(APEXDependencyNode &apex_node,
+                                   LLVMNode *node) {
+  for (auto i = node->control_begin(), e = node->control_end(); i != e; ++i) {
+    LLVMNode *cd_node = *i;
+    apex_node.control_depenencies.push_back(cd_node);
+  }
+
+  for (auto i = node->rev_control_begin(), e = node->rev_control_end(); i != e;
+       ++i) {
+    LLVMNode *rev_cd_node = *i;
+    apex_node.rev_control_depenencies.push_back(rev_cd_node);
+  }
+
+  for (auto i = node->data_begin(), e = node->data_end(); i != e; ++i) {
+    LLVMNode *dd_node = *i;
+    apex_node.data_dependencies.push_back(dd_node);
+  }
+
+  for (auto i = node->rev_data_begin(), e = node->rev_data_end(); i != e; ++i) {
+    LLVMNode *rev_dd_node = *i;
+    apex_node.rev_data_dependencies.push_back(rev_dd_node);
+  }
+}
+
+/// Extracts data from dg and stores them into @apex_dg structures.
 ///
-/// Caution: @dgInit() has to be called before @apexDgInit(), dg needs to be
-///          initialized in for this to properly work, otherwise
-///          CF map will be empty.
-void APEXPass::apexDgInit() {
+/// Caution: dg needs to be computed before @apexDgInit() for this to properly
+///          work, otherwise CF map will be empty.
+static void apexDgInit(APEXDependencyGraph &apex_dg) {
   const std::map<llvm::Value *, LLVMDependenceGraph *> &CF =
       dg::getConstructedFunctions(); // Need to call this (dg reasons).
 
@@ -300,60 +493,34 @@ void APEXPass::apexDgInit() {
         apex_function.nodes.push_back(apex_node);
       }
     }
-    apex_dg_.functions.push_back(apex_function);
+    apex_dg.functions.push_back(apex_function);
   }
   logPrint("- done");
 
   logPrint("\nStoring data and control dependencies into @apex_dg structures:");
-  for (auto &apex_dg_function : apex_dg_.functions) {
+  for (auto &apex_dg_function : apex_dg.functions) {
     for (auto &node : apex_dg_function.nodes) {
       // Data & reverse data dependencies.
-      apex_dg_.node_data_dependencies_map[node.node] = node.data_dependencies;
-      apex_dg_.node_rev_data_dependencies_map[node.node] =
+      apex_dg.node_data_dependencies_map[node.node] = node.data_dependencies;
+      apex_dg.node_rev_data_dependencies_map[node.node] =
           node.rev_data_dependencies;
 
       // Control & reverse control dependencies.
-      apex_dg_.node_control_dependencies_map[node.node] =
+      apex_dg.node_control_dependencies_map[node.node] =
           node.control_depenencies;
-      apex_dg_.node_rev_control_dependencies_map[node.node] =
+      apex_dg.node_rev_control_dependencies_map[node.node] =
           node.rev_control_depenencies;
 
       // Map function to node.
-      apex_dg_.node_function_map[node.node] = &apex_dg_function;
+      apex_dg.node_function_map[node.node] = &apex_dg_function;
     }
   }
   logPrint("- done");
 }
 
-/// Stores control/reverse_control/data/reverse_data dependencies of the @node
-/// to the @apex_node.
-void APEXPass::apexDgGetBlockNodeInfo(APEXDependencyNode &apex_node,
-                                      LLVMNode *node) {
-  for (auto i = node->control_begin(), e = node->control_end(); i != e; ++i) {
-    LLVMNode *cd_node = *i;
-    apex_node.control_depenencies.push_back(cd_node);
-  }
-
-  for (auto i = node->rev_control_begin(), e = node->rev_control_end(); i != e;
-       ++i) {
-    LLVMNode *rev_cd_node = *i;
-    apex_node.rev_control_depenencies.push_back(rev_cd_node);
-  }
-
-  for (auto i = node->data_begin(), e = node->data_end(); i != e; ++i) {
-    LLVMNode *dd_node = *i;
-    apex_node.data_dependencies.push_back(dd_node);
-  }
-
-  for (auto i = node->rev_data_begin(), e = node->rev_data_end(); i != e; ++i) {
-    LLVMNode *rev_dd_node = *i;
-    apex_node.rev_data_dependencies.push_back(rev_dd_node);
-  }
-}
-
-/// Pretty prints @apex_dg_, but only with data dependencies.
-void APEXPass::apexDgPrintDependenciesCompact() {
-  for (APEXDependencyFunction &function : apex_dg_.functions) {
+/// Pretty prints @apex_dg, but only with data dependencies.
+static void apexDgPrintDependenciesCompact(APEXDependencyGraph &apex_dg) {
+  for (APEXDependencyFunction &function : apex_dg.functions) {
     std::string fcn_name = function.value->getName();
 
     logPrint("\n===> " + fcn_name);
@@ -374,8 +541,9 @@ void APEXPass::apexDgPrintDependenciesCompact() {
 /// Take @node and find all data dependencies that form the chain.
 /// Store these dependencies in the @dependencies vector.
 // TODO: Refactor this function. It is copy-paste code!
-void APEXPass::apexDgFindDataDependencies(
-    LLVMNode &node, std::vector<LLVMNode *> &data_dependencies,
+static void apexDgFindDataDependencies(
+    APEXDependencyGraph &apex_dg, LLVMNode &node,
+    std::vector<LLVMNode *> &data_dependencies,
     std::vector<LLVMNode *> &rev_data_dependencies) {
   {
     std::vector<LLVMNode *> visited;
@@ -410,7 +578,7 @@ void APEXPass::apexDgFindDataDependencies(
       }
 
       // Add neighbours to the queue.
-      for (LLVMNode *neighbor : apex_dg_.node_data_dependencies_map[curr]) {
+      for (LLVMNode *neighbor : apex_dg.node_data_dependencies_map[curr]) {
         queue.push_back(neighbor);
       }
     }
@@ -448,7 +616,7 @@ void APEXPass::apexDgFindDataDependencies(
       }
 
       // Add neighbours to the queue.
-      for (LLVMNode *neighbor : apex_dg_.node_rev_data_dependencies_map[curr]) {
+      for (LLVMNode *neighbor : apex_dg.node_rev_data_dependencies_map[curr]) {
         queue.push_back(neighbor);
       }
     }
@@ -460,9 +628,9 @@ void APEXPass::apexDgFindDataDependencies(
 /// Returns @APEXDependencyNode, that is @I equivalent in the @apex_dg.
 ///
 /// Dies if unable to find @I in the @apex_dg.
-void APEXPass::apexDgGetNodeOrDie(const APEXDependencyGraph &apex_dg,
-                                  const Instruction *const I,
-                                  APEXDependencyNode &node) {
+static void apexDgGetNodeOrDie(const APEXDependencyGraph &apex_dg,
+                               const Instruction *const I,
+                               APEXDependencyNode &node) {
   for (APEXDependencyFunction apex_fcn : apex_dg.functions) {
     for (APEXDependencyNode &apex_node : apex_fcn.nodes) {
       if (apex_node.value == I) {
@@ -479,23 +647,28 @@ void APEXPass::apexDgGetNodeOrDie(const APEXDependencyGraph &apex_dg,
   exit(FATAL_ERROR);
 }
 
-/// We go over functions that are in @apex_dg_ and compute for each function
+/// We go over functions that are in @apex_dg and compute for each function
 /// dependencies between instructions. Instructions that are linked via data
-/// dependencies are stored in the @functions_blocks map.
-void APEXPass::apexDgComputeFunctionDependencyBlocks(const Module &M) {
+/// dependencies are stored in the @function_dependency_blocks map.
+static void apexDgComputeFunctionDependencyBlocks(
+    const Module &M, APEXDependencyBlocksResult &result,
+    const std::vector<std::string> &protected_functions) {
+  APEXDependencyGraph &apex_dg = result.apex_dg;
+  auto &function_dependency_blocks = result.function_dependency_blocks;
+
   logPrint("Constructing dependency blocks:");
 
   for (auto &F : M) {
     logPrintDbg("Constructing dependency blocks for: " +
                 F.getGlobalIdentifier());
 
-    if (functionIsProtected(&F)) {
+    if (apexFunctionIsProtected(&F, protected_functions)) {
       logPrintDbg("- function is protected");
       continue;
     }
 
     bool function_in_apex_dg = false;
-    for (APEXDependencyFunction &apex_fcn : apex_dg_.functions) {
+    for (APEXDependencyFunction &apex_fcn : apex_dg.functions) {
       if (&F == apex_fcn.value) {
         function_in_apex_dg = true;
       }
@@ -516,7 +689,7 @@ void APEXPass::apexDgComputeFunctionDependencyBlocks(const Module &M) {
 
         std::vector<LLVMNode *> new_block;
         APEXDependencyNode apex_node;
-        apexDgGetNodeOrDie(apex_dg_, &I, apex_node);
+        apexDgGetNodeOrDie(apex_dg, &I, apex_node);
 
         bool go_to_next_instruction = false;
 
@@ -557,8 +730,8 @@ void APEXPass::apexDgComputeFunctionDependencyBlocks(const Module &M) {
           // Get dependency chain for @current;
           std::vector<LLVMNode *> data_dependencies;
           std::vector<LLVMNode *> rev_data_dependencies;
-          apexDgFindDataDependencies(*apex_node.node, data_dependencies,
-                                     rev_data_dependencies);
+          apexDgFindDataDependencies(apex_dg, *apex_node.node,
+                                     data_dependencies, rev_data_dependencies);
           // I think it is enough to consider only data dependencies and
           // do not care about reverse data dependencies.
           // Reverse data dependencies contain instructions that are outside
@@ -617,7 +790,7 @@ void APEXPass::apexDgComputeFunctionDependencyBlocks(const Module &M) {
                 " instructions in blocks");
 
     // Everything should be OK, store computed blocks into storage.
-    function_dependency_blocks_[&F] = function_blocks;
+    function_dependency_blocks[&F] = function_blocks;
   }
   logPrint("- done");
 
@@ -628,7 +801,7 @@ void APEXPass::apexDgComputeFunctionDependencyBlocks(const Module &M) {
   logPrint("\nSorting function dependency blocks:");
   std::map<const Function *, std::vector<std::vector<LLVMNode *>>>
       function_dependency_blocks_sorted;
-  for (const auto &function_blocks : function_dependency_blocks_) {
+  for (const auto &function_blocks : function_dependency_blocks) {
     for (const auto &block : function_blocks.second) {
       std::vector<LLVMNode *> new_block_sorted;
       for (const auto &BB : *(function_blocks.first)) {
@@ -647,13 +820,14 @@ void APEXPass::apexDgComputeFunctionDependencyBlocks(const Module &M) {
           new_block_sorted);
     }
   }
-  function_dependency_blocks_ = function_dependency_blocks_sorted;
+  function_dependency_blocks = function_dependency_blocks_sorted;
   logPrint("- done");
 }
 
-/// Pretty prints @functions_blocks map.
-void APEXPass::apexDgPrintFunctionDependencyBlocks() {
-  for (auto &function_blocks : function_dependency_blocks_) {
+/// Pretty prints @function_dependency_blocks map.
+static void
+apexDgPrintFunctionDependencyBlocks(const APEXDependencyBlocksResult &result) {
+  for (auto &function_blocks : result.function_dependency_blocks) {
     std::string fcn_id = function_blocks.first->getGlobalIdentifier();
     logPrint("FUNCTION: " + fcn_id);
     for (auto &block : function_blocks.second) {
@@ -670,8 +844,10 @@ void APEXPass::apexDgPrintFunctionDependencyBlocks() {
 /// Takes @function_dependency_blocks that were computed by
 /// @apexDgComputeFunctionDependencyBlocks() and constructs callgraph where
 /// key is some block and value is vector of functions that this block may call.
-void APEXPass::apexDgConstructBlocksFunctionsCallgraph() {
-  for (auto &function_blocks : function_dependency_blocks_) {
+static void
+apexDgConstructBlocksFunctionsCallgraph(APEXDependencyBlocksResult &result) {
+  auto &blocks_functions_callgraph = result.blocks_functions_callgraph;
+  for (auto &function_blocks : result.function_dependency_blocks) {
     for (auto &block : function_blocks.second) {
       for (LLVMNode *node : block) {
 
@@ -680,9 +856,9 @@ void APEXPass::apexDgConstructBlocksFunctionsCallgraph() {
           const Function *called_fcn = call_inst->getCalledFunction();
 
           // Store call edge from block to function.
-          auto &functions = blocks_functions_callgraph_[block];
+          auto &functions = blocks_functions_callgraph[block];
           functions.push_back(called_fcn);
-          blocks_functions_callgraph_[block] = functions;
+          blocks_functions_callgraph[block] = functions;
         }
       }
     }
@@ -690,9 +866,28 @@ void APEXPass::apexDgConstructBlocksFunctionsCallgraph() {
   logPrint("- done");
 }
 
+/// Returns dependency blocks of the function @F (no blocks if @F has none).
+const std::vector<DependencyBlock> &
+APEXPass::functionBlocks(const Function *F) {
+  static const std::vector<DependencyBlock> no_blocks;
+  auto it = blocks_->function_dependency_blocks.find(F);
+  return it == blocks_->function_dependency_blocks.end() ? no_blocks
+                                                         : it->second;
+}
+
+/// Returns functions that may be called from the @block.
+const std::vector<const Function *> &
+APEXPass::blockCalledFunctions(const DependencyBlock &block) {
+  static const std::vector<const Function *> no_functions;
+  auto it = blocks_->blocks_functions_callgraph.find(block);
+  return it == blocks_->blocks_functions_callgraph.end() ? no_functions
+                                                         : it->second;
+}
+
 /// Pretty prints dependency blocks to functions callgraph.
-void APEXPass::apexDgPrintBlocksFunctionsCallgraph() {
-  for (const auto &block_functions : blocks_functions_callgraph_) {
+static void
+apexDgPrintBlocksFunctionsCallgraph(const APEXDependencyBlocksResult &result) {
+  for (const auto &block_functions : result.blocks_functions_callgraph) {
     const Instruction *node_inst =
         cast<Instruction>(block_functions.first.front()->getValue());
     logPrint("COMPONENT: in " +
@@ -708,6 +903,47 @@ void APEXPass::apexDgPrintBlocksFunctionsCallgraph() {
   }
 }
 
+/// Computes apex dependency graph, dependency blocks and dependency blocks to
+/// functions call graph from the @dg of the module @M. Functions from the
+/// @protected_functions get no dependency blocks.
+///
+/// Caution: dg keeps constructed functions in a global map, so @dg has to be
+///          the live dg of the @M.
+APEXDependencyBlocksResult
+apexComputeDependencyBlocks(const Module &M, const LLVMDependenceGraph *dg,
+                            const std::vector<std::string> &protected_functions) {
+  assert(nullptr != dg && "dg has to be computed before dependency blocks");
+  APEXDependencyBlocksResult result;
+
+  logPrintUnderline("Extracting data from dg. Building apex dependency graph.");
+  apexDgInit(result.apex_dg);
+
+  if (VERBOSE_DEBUG) {
+    logPrintUnderline("Printing data dependencies from apex_dg.");
+    apexDgPrintDependenciesCompact(result.apex_dg);
+  }
+
+  logPrintUnderline("Constructing function dependency blocks.");
+  apexDgComputeFunctionDependencyBlocks(M, result, protected_functions);
+
+  if (VERBOSE_DEBUG) {
+    logPrintUnderline("Printing calculated function dependency blocks.");
+    apexDgPrintFunctionDependencyBlocks(result);
+  }
+
+  logPrintUnderline("Constructing dependency blocks to functions call graph.");
+  apexDgConstructBlocksFunctionsCallgraph(result);
+
+  if (VERBOSE_DEBUG) {
+    logPrintUnderline("Printing dependency block to functions call graph.");
+    apexDgPrintBlocksFunctionsCallgraph(result);
+  }
+
+  // Moving the result keeps elements of @apex_dg.functions in place, so
+  // pointers stored in the @node_function_map stay valid.
+  return result;
+}
+
 // Module utilities
 // ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
@@ -991,7 +1227,7 @@ void APEXPass::removeUnneededStuff(Module &M) {
 
                   // Find wich block contains our branch instruction.
                   for (const auto &fcn_block :
-                       function_dependency_blocks_[block_function]) {
+                       functionBlocks(block_function)) {
                     for (const auto &node : fcn_block) {
                       Instruction *node_inst =
                           cast<Instruction>(node->getValue());
@@ -1035,8 +1271,7 @@ void APEXPass::removeUnneededStuff(Module &M) {
     // Go over @path and figure out if there are any calls outside the @path.
     // If there are, put those called blocks for investigation into the @queue.
     for (const auto &path_block : path_) {
-      for (const auto &called_function :
-           blocks_functions_callgraph_[path_block]) {
+      for (const auto &called_function : blockCalledFunctions(path_block)) {
 
         // Is @called_function part of the path?
         bool called_function_part_of_path = false;
@@ -1051,7 +1286,7 @@ void APEXPass::removeUnneededStuff(Module &M) {
 
         if (false == called_function_part_of_path) {
           for (auto const &called_function_block :
-               function_dependency_blocks_[called_function]) {
+               functionBlocks(called_function)) {
             queue.push_back(called_function_block);
           }
         }
@@ -1074,8 +1309,8 @@ void APEXPass::removeUnneededStuff(Module &M) {
 
       // Go over functions that are being called from the @current block.
       // Add them to the queue if they were not visited already.
-      for (const auto &called_function : blocks_functions_callgraph_[current]) {
-        for (const auto &block : function_dependency_blocks_[called_function]) {
+      for (const auto &called_function : blockCalledFunctions(current)) {
+        for (const auto &block : functionBlocks(called_function)) {
 
           // Check if we already visited @block.
           bool block_already_visited = false;
@@ -1114,8 +1349,7 @@ void APEXPass::removeUnneededStuff(Module &M) {
                     module_function.getGlobalIdentifier());
 
         // Go over all blocks in the @module_function.
-        for (auto const &block :
-             function_dependency_blocks_[&module_function]) {
+        for (auto const &block : functionBlocks(&module_function)) {
           // Check if @block has entry in the
           // @function_blocks_to_keep[&module_function]
           if (function_blocks_to_keep[&module_function].count(block) > 0) {
@@ -1197,6 +1431,12 @@ void APEXPass::removeUnneededStuff(Module &M) {
   }
 
   logPrint("\nRemoving unwanted functions:");
+  removeFunctions(M, functions_to_remove);
+}
+
+/// Removes @functions_to_remove from the module @M.
+void APEXPass::removeFunctions(
+    Module &M, const std::set<const Function *> &functions_to_remove) {
   {
     for (auto const &function : functions_to_remove) {
       // Need to get non-const Function ptr.
@@ -1240,18 +1480,114 @@ void APEXPass::stripAllDebugSymbols(Module &M) {
 }
 
 
-/// Goes over all functions in the module and adds functions
-/// that are only declarations to the @protected_functions_.
+/// Returns IDs of functions that APEX must not remove: apexlib and LLVM
+/// functions and functions that are only declarations in the module @M.
 /// We do not want to remove declarations.
-void APEXPass::collectProtectedFunctions(Module &M) {
+std::vector<std::string> apexProtectedFunctions(const Module &M) {
+  std::vector<std::string> protected_functions = {
+      // apexlib functions
+      "_apex_exit",
+      "_apex_extract_int",
+
+      // LLVM stuff
+      "llvm.stackrestore",
+      "llvm.stacksave",
+  };
+
   for (const auto &F: M) {
     if (VERBOSE_DEBUG) {
       logPrint(F.getGlobalIdentifier());
     }
     if (F.isDeclaration()) {
       logPrintDbg("- is declaration");
-      protected_functions_.push_back(F.getGlobalIdentifier());
+      protected_functions.push_back(F.getGlobalIdentifier());
     }
   }
   logPrint("- done");
-}
\ No newline at end of file
+  return protected_functions;
+}
+
+/// Collects functions that will not be removed by APEXPass into the
+/// @protected_functions_.
+void APEXPass::collectProtectedFunctions(Module &M) {
+  protected_functions_ = apexProtectedFunctions(M);
+}
+
+// New pass manager
+// ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+/// Points-to analysis result is valid as long as the module is not changed.
+bool APEXPTAResult::invalidate(Module &M, const PreservedAnalyses &PA,
+                               ModuleAnalysisManager::Invalidator &Inv) {
+  auto PAC = PA.getChecker<APEXPTAAnalysis>();
+  return !(PAC.preserved() || PAC.preservedSet<AllAnalysesOn<Module>>());
+}
+
+/// dg points into the points-to analysis, so it needs to go together with it.
+bool APEXDgResult::invalidate(Module &M, const PreservedAnalyses &PA,
+                              ModuleAnalysisManager::Invalidator &Inv) {
+  auto PAC = PA.getChecker<APEXDgAnalysis>();
+  return !(PAC.preserved() || PAC.preservedSet<AllAnalysesOn<Module>>()) ||
+         Inv.invalidate<APEXPTAAnalysis>(M, PA);
+}
+
+/// Dependency blocks point into the dg, so they need to go together with it.
+bool APEXDependencyBlocksResult::invalidate(
+    Module &M, const PreservedAnalyses &PA,
+    ModuleAnalysisManager::Invalidator &Inv) {
+  auto PAC = PA.getChecker<APEXDependencyBlocksAnalysis>();
+  return !(PAC.preserved() || PAC.preservedSet<AllAnalysesOn<Module>>()) ||
+         Inv.invalidate<APEXDgAnalysis>(M, PA);
+}
+
+APEXPTAResult APEXPTAAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
+  return APEXPass::ptaCompute(M);
+}
+
+APEXDgResult APEXDgAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
+  return APEXPass::dgCompute(M, MAM.getResult<APEXPTAAnalysis>(M).pta.get());
+}
+
+APEXDependencyBlocksResult
+APEXDependencyBlocksAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
+  return apexComputeDependencyBlocks(
+      M, MAM.getResult<APEXDgAnalysis>(M).dg.get(), apexProtectedFunctions(M));
+}
+
+/// Runs APEX with analyses from the @MAM. Whenever APEX changes the module,
+/// nothing is preserved: even when it removes nothing, it injects calls to
+/// apexlib that the cached points-to analysis and dg have no nodes for, so
+/// the next APEX in the pipeline computes them again.
+PreservedAnalyses APEXNewPass::run(Module &M, ModuleAnalysisManager &MAM) {
+  APEXPass apex;
+  if (apex.runAPEX(M, &MAM)) {
+    return PreservedAnalyses::none();
+  }
+  return PreservedAnalyses::all();
+}
+
+void registerAPEXAnalyses(ModuleAnalysisManager &MAM) {
+  MAM.registerPass([] { return APEXPTAAnalysis(); });
+  MAM.registerPass([] { return APEXDgAnalysis(); });
+  MAM.registerPass([] { return APEXDependencyBlocksAnalysis(); });
+}
+
+/// Registering APEX for the new pass manager, so it can be ran via
+/// opt -load-pass-plugin ... -passes=apex.
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "APEXPass", LLVM_VERSION_STRING,
+          [](PassBuilder &PB) {
+            PB.registerAnalysisRegistrationCallback(
+                [](ModuleAnalysisManager &MAM) { registerAPEXAnalyses(MAM); });
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, ModulePassManager &MPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  if (Name == "apex") {
+                    MPM.addPass(APEXNewPass());
+                    return true;
+                  }
+                  return false;
+                });
+          }};
+}
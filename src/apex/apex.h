@@ -24,6 +24,9 @@
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Passes/PassPlugin.h>
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 #include <llvm/Transforms/Utils/ValueMapper.h>
@@ -31,6 +34,7 @@
 // We need this for dg integration.
 #include "analysis/PointsTo/PointsToFlowInsensitive.h"
 #include "llvm/LLVMDependenceGraph.h"
+#include "llvm/Slicer.h"
 #include "llvm/analysis/DefUse.h"
 
 using namespace llvm;
@@ -57,6 +61,12 @@ cl::opt<std::string> ARG_LINE("line",
                               cl::desc("Number representing line in the file."),
                               cl::value_desc("Source code line number."));
 
+cl::opt<bool> ARG_SLICER(
+    "slicer",
+    cl::desc("Use dg slicer (instead of dependency blocks) to decide what "
+             "to keep."),
+    cl::init(false));
+
 /// Node is usually line instruction of IR. Sometimes whole function.
 struct APEXDependencyNode {
   LLVMNode *node;
@@ -85,8 +95,108 @@ struct APEXDependencyGraph {
   std::map<LLVMNode *, APEXDependencyFunction *> node_function_map;
 };
 
+/// Pointer analysis computed by dg.
+struct APEXPTAResult {
+  std::unique_ptr<LLVMPointerAnalysis> pta;
+
+  bool invalidate(Module &M, const PreservedAnalyses &PA,
+                  ModuleAnalysisManager::Invalidator &Inv);
+};
+
+/// Dependence graph computed by dg on top of the @APEXPTAResult.
+struct APEXDgResult {
+  std::unique_ptr<LLVMDependenceGraph> dg;
+
+  bool invalidate(Module &M, const PreservedAnalyses &PA,
+                  ModuleAnalysisManager::Invalidator &Inv);
+};
+
+/// Dependency blocks computed on top of the @APEXDgResult.
+struct APEXDependencyBlocksResult {
+  APEXDependencyGraph apex_dg;
+  std::map<const Function *, std::vector<DependencyBlock>>
+      function_dependency_blocks;
+  std::map<DependencyBlock, std::vector<const Function *>>
+      blocks_functions_callgraph;
+
+  bool invalidate(Module &M, const PreservedAnalyses &PA,
+                  ModuleAnalysisManager::Invalidator &Inv);
+};
+
+// Logging utilities.
+void logPrint(const std::string &message);
+void logPrintDbg(const std::string &message);
+void logPrintUnderline(const std::string &message);
+void logPrintFlat(const std::string &message);
+void logDumpModule(const Module &M);
+
+// Function utilities.
+bool apexFunctionIsProtected(const Function *F,
+                             const std::vector<std::string> &protected_functions);
+std::vector<std::string> apexProtectedFunctions(const Module &M);
+
+// Dependency blocks, shared by the APEXPass and the
+// APEXDependencyBlocksAnalysis.
+APEXDependencyBlocksResult
+apexComputeDependencyBlocks(const Module &M, const LLVMDependenceGraph *dg,
+                            const std::vector<std::string> &protected_functions);
+
+/// New pass manager module analysis that computes points-to analysis for the
+/// module.
+class APEXPTAAnalysis : public AnalysisInfoMixin<APEXPTAAnalysis> {
+  friend AnalysisInfoMixin<APEXPTAAnalysis>;
+  static AnalysisKey Key;
+
+public:
+  using Result = APEXPTAResult;
+  Result run(Module &M, ModuleAnalysisManager &MAM);
+};
+
+/// New pass manager module analysis that computes dg for the module from
+/// the @APEXPTAAnalysis result.
+///
+/// Caution: dg keeps constructed functions in a global map, so there should be
+///          only one live result at a time.
+class APEXDgAnalysis : public AnalysisInfoMixin<APEXDgAnalysis> {
+  friend AnalysisInfoMixin<APEXDgAnalysis>;
+  static AnalysisKey Key;
+
+public:
+  using Result = APEXDgResult;
+  Result run(Module &M, ModuleAnalysisManager &MAM);
+};
+
+/// New pass manager module analysis that computes dependency blocks.
+class APEXDependencyBlocksAnalysis
+    : public AnalysisInfoMixin<APEXDependencyBlocksAnalysis> {
+  friend AnalysisInfoMixin<APEXDependencyBlocksAnalysis>;
+  static AnalysisKey Key;
+
+public:
+  using Result = APEXDependencyBlocksResult;
+  Result run(Module &M, ModuleAnalysisManager &MAM);
+};
+
+/// APEX for the new pass manager. Analyses are taken from the
+/// @ModuleAnalysisManager, so they are shared with other passes in the
+/// pipeline and computed only once while the module does not change.
+///
+/// Registered as "apex" by the plugin, run via:
+/// opt -load libAPEXPass.so -load-pass-plugin libAPEXPass.so -passes=apex
+class APEXNewPass : public PassInfoMixin<APEXNewPass> {
+public:
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM);
+};
+
+/// Registers APEX analyses, so APEXNewPass can be used in the pipeline.
+void registerAPEXAnalyses(ModuleAnalysisManager &MAM);
+
 /// Actual APEX pass.
 class APEXPass : public ModulePass {
+  friend class APEXPTAAnalysis;
+  friend class APEXDgAnalysis;
+  friend class APEXNewPass;
+
 public:
   static char ID;
   APEXPass() : ModulePass(ID) {}
@@ -102,43 +212,43 @@ private:
   /// Target instructions that correspond to the user input.
   std::vector<const Instruction *> target_instructions_;
 
-  /// Dependence graph: https://github.com/mchalupa/dg
-  LLVMDependenceGraph dg_;
-
-  /// Holds all the necessary info about dependencies.
-  APEXDependencyGraph apex_dg_;
+  /// Points-to analysis and dependence graph: https://github.com/mchalupa/dg
+  /// Point either to @pta_result_ and @dg_result_ or to the cached analyses
+  /// results.
+  ///
+  /// @dg_ holds pointer to @pta_, so @pta_result_ has to be declared first.
+  /// Members are destroyed in reverse order of declaration, so @dg_result_ is
+  /// destroyed before @pta_result_.
+  LLVMPointerAnalysis *pta_ = nullptr;
+  APEXPTAResult pta_result_;
+  LLVMDependenceGraph *dg_ = nullptr;
+  APEXDgResult dg_result_;
+
+  /// dg slicer, used instead of dependency blocks when -slicer is set.
+  LLVMSlicer slicer_;
+  uint32_t slice_id_ = 0;
 
   /// @path_ is the representation of computed execution path.
   /// It holds pair of function and dependency block from function through which
   /// is the execution "flowing".
   std::vector<DependencyBlock> path_;
 
-  std::map<const Function *, std::vector<DependencyBlock>>
-      function_dependency_blocks_;
+  /// Dependency blocks computed by @apexComputeDependencyBlocks() when APEX
+  /// does not run in the new pass manager.
+  APEXDependencyBlocksResult blocks_result_;
 
-  std::map<DependencyBlock, std::vector<const Function *>>
-      blocks_functions_callgraph_;
+  /// Dependency blocks used for finding the path. Points either to
+  /// @blocks_result_ or to the cached analysis result.
+  const APEXDependencyBlocksResult *blocks_ = &blocks_result_;
 
     /// Protected functions IDs. These will not be removed by APEXPass.
-    std::vector<std::string> protected_functions_ = {
-            // apexlib functions
-            "_apex_exit",
-            "_apex_extract_int",
-
-            // LLVM stuff
-            "llvm.stackrestore",
-            "llvm.stacksave",
-    };
+    /// Initialized by @collectProtectedFunctions().
+    std::vector<std::string> protected_functions_;
 
   // Methods
   // ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
-  // Logging utilities.
-  void logPrint(const std::string &message);
-  void logPrintDbg(const std::string &message);
-  void logPrintUnderline(const std::string &message);
-  void logPrintFlat(const std::string &message);
-  void logDumpModule(const Module &M);
+  bool runAPEX(Module &M, ModuleAnalysisManager *MAM);
 
   // Function utilities.
   bool functionIsProtected(const Function *F);
@@ -148,29 +258,27 @@ private:
   void printPath();
 
   // dg utilities.
+  static APEXPTAResult ptaCompute(Module &M);
+  static APEXDgResult dgCompute(Module &M, LLVMPointerAnalysis *pta);
   void dgInit(Module &M);
+  void dgMarkTargetInstructions();
+  void dgMarkCallPath(const Module &M);
+  void dgSlice(Module &M);
 
   // apex dg utilities.
-  void apexDgInit();
-  void apexDgGetBlockNodeInfo(APEXDependencyNode &apex_node, LLVMNode *node);
-  void apexDgPrintDependenciesCompact();
-  void
-  apexDgFindDataDependencies(LLVMNode &node,
-                             std::vector<LLVMNode *> &dependencies,
-                             std::vector<LLVMNode *> &rev_data_dependencies);
-  void apexDgGetNodeOrDie(const APEXDependencyGraph &apex_dg,
-                          const Instruction *const I, APEXDependencyNode &node);
-  void apexDgComputeFunctionDependencyBlocks(const Module &M);
-  void apexDgPrintFunctionDependencyBlocks();
-  void apexDgConstructBlocksFunctionsCallgraph();
-  void apexDgPrintBlocksFunctionsCallgraph();
+  const std::vector<DependencyBlock> &functionBlocks(const Function *F);
+  const std::vector<const Function *> &
+  blockCalledFunctions(const DependencyBlock &block);
 
   // Module utilities.
   void moduleParseCmdLineArgsOrDie();
   void moduleFindTargetInstructionsOrDie(Module &M, const std::string &file,
                                          const std::string &line);
   void moduleInjectExitExtract(Module &M);
+  void runDependencyBlocks(Module &M, ModuleAnalysisManager *MAM);
   void removeUnneededStuff(Module &M);
+  void removeFunctions(Module &M,
+                       const std::set<const Function *> &functions_to_remove);
   void stripAllDebugSymbols(Module &M);
     void collectProtectedFunctions(Module &M);
 };
@@ -179,4 +287,9 @@ private:
 char APEXPass::ID = 0;
 static RegisterPass<APEXPass> X("apex", "Active code Path EXtractor.",
                                 false /* Only looks at CFG */,
-                                false /* Analysis Pass */);
\ No newline at end of file
+                                false /* Analysis Pass */);
+
+/// Keys identifying APEX analyses in the new pass manager.
+AnalysisKey APEXPTAAnalysis::Key;
+AnalysisKey APEXDgAnalysis::Key;
+AnalysisKey APEXDependencyBlocksAnalysis::Key;
\ No newline at end of file
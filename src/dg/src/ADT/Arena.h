@@ -0,0 +1,186 @@
+#ifndef _DG_ARENA_H_
+#define _DG_ARENA_H_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace dg {
+namespace ADT {
+
+// Bump-pointer allocator. The memory is taken from big slabs
+// and it is released all at once when the arena is destroyed
+// (or cleared), there is no way to free a single allocation.
+// The arena does not call destructors of the objects that
+// were created in its memory, that is up to the user.
+class Arena {
+    std::vector<std::unique_ptr<char[]>> _slabs;
+    char *_cur{nullptr};
+    char *_end{nullptr};
+    // size of the next slab
+    size_t _slabSize;
+    size_t _allocated{0};
+
+    static const size_t MAX_SLAB_SIZE = 1 << 20;
+
+    void _newSlab(size_t minSize) {
+        size_t size = _slabSize;
+        while (size < minSize)
+            size *= 2;
+
+        _slabs.emplace_back(new char[size]);
+        _cur = _slabs.back().get();
+        _end = _cur + size;
+
+        // grow the slabs, so that the number of slabs
+        // is logarithmic in the allocated memory
+        if (_slabSize < MAX_SLAB_SIZE)
+            _slabSize *= 2;
+    }
+
+    static char *_align(char *ptr, size_t align) {
+        uintptr_t p = reinterpret_cast<uintptr_t>(ptr);
+        return reinterpret_cast<char *>((p + align - 1) & ~(align - 1));
+    }
+
+public:
+    explicit Arena(size_t slabSize = 4096) : _slabSize(slabSize) {
+        assert(slabSize > 0);
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    Arena(Arena&& rhs)
+    : _slabs(std::move(rhs._slabs)), _cur(rhs._cur), _end(rhs._end),
+      _slabSize(rhs._slabSize), _allocated(rhs._allocated) {
+        rhs.clear();
+    }
+
+    Arena& operator=(Arena&& rhs) {
+        if (this != &rhs) {
+            _slabs = std::move(rhs._slabs);
+            _cur = rhs._cur;
+            _end = rhs._end;
+            _slabSize = rhs._slabSize;
+            _allocated = rhs._allocated;
+            rhs.clear();
+        }
+
+        return *this;
+    }
+
+    void *allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        assert(align > 0 && (align & (align - 1)) == 0
+               && "Alignment must be a power of two");
+
+        char *ptr = _align(_cur, align);
+        if (!_cur || ptr + size > _end) {
+            _newSlab(size + align);
+            ptr = _align(_cur, align);
+        }
+
+        assert(ptr + size <= _end);
+        _cur = ptr + size;
+        _allocated += size;
+        return ptr;
+    }
+
+    // release all the memory
+    void clear() {
+        _slabs.clear();
+        _cur = _end = nullptr;
+        _allocated = 0;
+    }
+
+    // the number of bytes allocated by the user
+    size_t allocated() const { return _allocated; }
+    size_t slabsNum() const { return _slabs.size(); }
+};
+
+// Arena of objects of one type. The objects are created in chunks
+// of CHUNK objects, so they are close to each other in memory and their
+// addresses never change. Unlike Arena, TypedArena calls the destructors
+// of the objects when it is destroyed.
+template <typename T, size_t CHUNK = 256>
+class TypedArena {
+    using StorageT = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+    std::vector<std::unique_ptr<StorageT[]>> _chunks;
+    // number of objects in the last chunk
+    size_t _lastSize{CHUNK};
+    size_t _size{0};
+
+    T *_at(size_t i) const {
+        return reinterpret_cast<T *>(&_chunks[i / CHUNK][i % CHUNK]);
+    }
+
+public:
+    TypedArena() = default;
+    TypedArena(const TypedArena&) = delete;
+    TypedArena& operator=(const TypedArena&) = delete;
+
+    TypedArena(TypedArena&& rhs)
+    : _chunks(std::move(rhs._chunks)), _lastSize(rhs._lastSize), _size(rhs._size) {
+        rhs._chunks.clear();
+        rhs._lastSize = CHUNK;
+        rhs._size = 0;
+    }
+
+    TypedArena& operator=(TypedArena&& rhs) {
+        if (this != &rhs) {
+            clear();
+            _chunks = std::move(rhs._chunks);
+            _lastSize = rhs._lastSize;
+            _size = rhs._size;
+            rhs._chunks.clear();
+            rhs._lastSize = CHUNK;
+            rhs._size = 0;
+        }
+
+        return *this;
+    }
+
+    ~TypedArena() { clear(); }
+
+    template <typename... Args>
+    T *create(Args&&... args) {
+        if (_lastSize == CHUNK) {
+            _chunks.emplace_back(new StorageT[CHUNK]);
+            _lastSize = 0;
+        }
+
+        T *obj = new (&_chunks.back()[_lastSize]) T(std::forward<Args>(args)...);
+        ++_lastSize;
+        ++_size;
+        return obj;
+    }
+
+    // destroy all the objects and release the memory
+    void clear() {
+        for (size_t i = 0; i < _size; ++i)
+            _at(i)->~T();
+
+        _chunks.clear();
+        _lastSize = CHUNK;
+        _size = 0;
+    }
+
+    T *operator[](size_t i) const {
+        assert(i < _size);
+        return _at(i);
+    }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+};
+
+} // namespace ADT
+} // namespace dg
+
+#endif // _DG_ARENA_H_
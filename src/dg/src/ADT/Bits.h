@@ -2,10 +2,50 @@
 #define _DG_SPARSE_BITS_H_
 
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 
 namespace dg {
 namespace ADT {
 
+// number of bits set in the word
+template <typename T>
+inline size_t popCount(T bits) {
+    static_assert(sizeof(T) <= sizeof(unsigned long long),
+                  "Word is too big");
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(static_cast<unsigned long long>(bits));
+#else
+    size_t num = 0;
+    while (bits) {
+        // clear the lowest set bit
+        bits &= bits - 1;
+        ++num;
+    }
+
+    return num;
+#endif
+}
+
+// index of the lowest bit set in the word. The word must not be 0
+template <typename T>
+inline size_t countTrailingZeros(T bits) {
+    static_assert(sizeof(T) <= sizeof(unsigned long long),
+                  "Word is too big");
+    assert(bits != 0 && "Undefined for zero");
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(static_cast<unsigned long long>(bits));
+#else
+    size_t num = 0;
+    while (!(bits & 0x1)) {
+        bits = bits >> 1;
+        ++num;
+    }
+
+    return num;
+#endif
+}
+
 // an element that holds a sequence of bits (up to 64 bits usually)
 // along with offset. So this class can represent a sequence
 // of [S, S(+sizeof(InnerT)*8)] bits. (E.g. 100th, 101th, ..., 163th bit)
@@ -26,14 +66,7 @@ public:
         return i >= _shift && i - _shift < bitsNum();
     }
 
-    size_t size() const {
-        size_t num = 0;
-        for (size_t i = 0; i < bitsNum(); ++i)
-            if (_bits & (static_cast<InnerT>(1) << i))
-                ++num;
-
-        return num;
-    }
+    size_t size() const { return popCount(_bits); }
 
     bool empty() const { return _bits == 0; }
 
@@ -61,22 +94,22 @@ public:
             return pos == ShiftedBits::bitsNum();
         }
 
+        // move to the first set bit on position >= pos
         void _findNext() {
             assert(pos < ShiftedBits::bitsNum());
-            while (!(bits->_bits & (static_cast<InnerT>(1) << pos))) {
-                ++pos;
-
-                if (isEnd())
-                    return;
-            }
+            InnerT rest = bits->_bits >> pos;
+            if (rest == 0)
+                pos = ShiftedBits::bitsNum();
+            else
+                pos += countTrailingZeros(rest);
         }
 
         const_iterator(const ShiftedBits *bits, size_t pos = 0)
         :bits(bits), pos(pos) {
             assert(bits && "No bits given");
             // start at the first element
-            if (!isEnd() && !(bits->_bits & 1))
-                operator++();
+            if (!isEnd())
+                _findNext();
         }
 
     public:
@@ -134,14 +167,7 @@ public:
     bool empty() const { return _bits == 0; }
     bool mayContain(size_t i) const { return i < bitsNum(); }
 
-    size_t size() const {
-        size_t num = 0;
-        for (size_t i = 0; i < bitsNum(); ++i)
-            if (_bits & (static_cast<InnerT>(1) << i))
-                ++num;
-
-        return num;
-    }
+    size_t size() const { return popCount(_bits); }
 
     bool get(size_t i) const {
         if (!mayContain(i))
@@ -159,6 +185,14 @@ public:
         return ret;
     }
 
+    // return the previous value
+    bool unset(size_t i) {
+        assert(mayContain(i));
+        bool ret = get(i);
+        _bits &= ~(static_cast<InnerT>(1) << i);
+        return ret;
+    }
+
     class const_iterator {
         const Bits *bits{nullptr};
         size_t pos{0};
@@ -167,22 +201,22 @@ public:
             return pos == Bits::bitsNum();
         }
 
+        // move to the first set bit on position >= pos
         void _findNext() {
             assert(pos < Bits::bitsNum());
-            while (!(bits->_bits & (static_cast<InnerT>(1) << pos))) {
-                ++pos;
-
-                if (isEnd())
-                    return;
-            }
+            InnerT rest = bits->_bits >> pos;
+            if (rest == 0)
+                pos = Bits::bitsNum();
+            else
+                pos += countTrailingZeros(rest);
         }
 
         const_iterator(const Bits *bits, size_t pos = 0)
         :bits(bits), pos(pos) {
             assert(bits && "No bits given");
             // start at the first element
-            if (!isEnd() && !(bits->_bits & 1))
-                operator++();
+            if (!isEnd())
+                _findNext();
         }
 
     public:
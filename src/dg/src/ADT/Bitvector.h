@@ -1,39 +1,130 @@
 #ifndef _DG_SPARSE_BITVECTOR_H_
 #define _DG_SPARSE_BITVECTOR_H_
 
-#include <map>
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Bits.h"
 
 namespace dg {
 namespace ADT {
 
+// Sparse bitvector stored as a sorted vector of chunks.
+// Every chunk holds SCALE words of bits along with the shift
+// of its first bit, so it represents the bits
+// [shift, shift + SCALE*sizeof(BitsT)*8). Chunks are sorted by the shift
+// and we never keep a chunk with no bit set, so the set operations
+// can be done as linear merge-joins over the chunks.
+// The number of set bits is cached, so size() is O(1).
+// The loops over words of a chunk are simple enough to be vectorized
+// by the compiler when SCALE > 1.
+// Unlike with chunks in std::map, setting, unsetting or merging bits
+// can insert or remove a chunk, so it invalidates iterators
+// into the bitvector.
 template <typename BitsT = uint64_t, typename ShiftT = uint64_t, size_t SCALE = 1>
 class SparseBitvectorImpl {
-    // mapping from shift to bits
-    using BitsContainerT = std::map<ShiftT, BitsT>;
-    BitsContainerT _bits{};
+    static_assert(SCALE > 0, "Chunk must have at least one word");
 
-    static size_t _bitsNum() { return sizeof(BitsT) * 8; }
-    static ShiftT _shift(size_t i) { return i - (i % _bitsNum()); }
+    struct Chunk {
+        ShiftT shift;
+        BitsT words[SCALE];
 
-    static size_t _countBits(BitsT bits) {
-        size_t num = 0;
-        while (bits) {
-            if (bits & 0x1)
-                ++num;
+        Chunk(ShiftT s) : shift(s), words() {}
+
+        bool empty() const {
+            BitsT any = 0;
+            for (size_t i = 0; i < SCALE; ++i)
+                any |= words[i];
+            return any == 0;
+        }
 
-            bits = bits >> 1;
+        size_t count() const {
+            size_t num = 0;
+            for (size_t i = 0; i < SCALE; ++i)
+                num += popCount(words[i]);
+            return num;
         }
 
-        return num;
+        // returns the number of bits that were newly set
+        size_t unite(const Chunk& rhs) {
+            assert(shift == rhs.shift);
+            size_t added = 0;
+            for (size_t i = 0; i < SCALE; ++i) {
+                added += popCount(rhs.words[i] & ~words[i]);
+                words[i] |= rhs.words[i];
+            }
+            return added;
+        }
+
+        // returns the number of bits that were unset
+        size_t intersect(const Chunk& rhs) {
+            assert(shift == rhs.shift);
+            size_t removed = 0;
+            for (size_t i = 0; i < SCALE; ++i) {
+                removed += popCount(words[i] & ~rhs.words[i]);
+                words[i] &= rhs.words[i];
+            }
+            return removed;
+        }
+
+        // returns the number of bits that were unset
+        size_t subtract(const Chunk& rhs) {
+            assert(shift == rhs.shift);
+            size_t removed = 0;
+            for (size_t i = 0; i < SCALE; ++i) {
+                removed += popCount(words[i] & rhs.words[i]);
+                words[i] &= ~rhs.words[i];
+            }
+            return removed;
+        }
+
+        bool operator==(const Chunk& rhs) const {
+            if (shift != rhs.shift)
+                return false;
+            for (size_t i = 0; i < SCALE; ++i)
+                if (words[i] != rhs.words[i])
+                    return false;
+            return true;
+        }
+    };
+
+    using BitsContainerT = std::vector<Chunk>;
+    BitsContainerT _bits{};
+    // the number of set bits
+    size_t _size{0};
+
+    static size_t _wordBitsNum() { return sizeof(BitsT) * 8; }
+    static size_t _bitsNum() { return _wordBitsNum() * SCALE; }
+    static ShiftT _shift(size_t i) { return i - (i % _bitsNum()); }
+    static BitsT _mask(size_t pos) {
+        return static_cast<BitsT>(1) << (pos % _wordBitsNum());
     }
 
-    void _addBits(size_t i) {
-        // for now we just push it back,
-        // but we would rather do it somehow
-        // more smartly (probably not using the vector)
-        auto sft = _shift(i);
-        _bits.emplace(sft, (1UL << (i - sft)));
+    // find the first chunk with shift not less than sft
+    typename BitsContainerT::iterator _lowerBound(ShiftT sft) {
+        // sets are often filled in increasing order,
+        // so check the last chunk first
+        if (_bits.empty() || _bits.back().shift < sft)
+            return _bits.end();
+        if (_bits.back().shift == sft)
+            return _bits.end() - 1;
+
+        return std::lower_bound(_bits.begin(), _bits.end(), sft,
+                                [](const Chunk& c, ShiftT s) { return c.shift < s; });
+    }
+
+    typename BitsContainerT::const_iterator _lowerBound(ShiftT sft) const {
+        return const_cast<SparseBitvectorImpl *>(this)->_lowerBound(sft);
+    }
+
+    // remove chunks that have no bit set
+    void _removeEmpty() {
+        _bits.erase(std::remove_if(_bits.begin(), _bits.end(),
+                                   [](const Chunk& c) { return c.empty(); }),
+                    _bits.end());
     }
 
 public:
@@ -42,59 +133,186 @@ public:
 
     SparseBitvectorImpl(const SparseBitvectorImpl&) = default;
     SparseBitvectorImpl(SparseBitvectorImpl&&) = default;
+    SparseBitvectorImpl& operator=(const SparseBitvectorImpl&) = default;
+    SparseBitvectorImpl& operator=(SparseBitvectorImpl&&) = default;
 
-    void reset() { _bits.clear(); }
+    void reset() { _bits.clear(); _size = 0; }
     bool empty() const { return _bits.empty(); }
-    void swap(SparseBitvectorImpl& oth) { _bits.swap(oth._bits); }
+    void swap(SparseBitvectorImpl& oth) {
+        _bits.swap(oth._bits);
+        std::swap(_size, oth._size);
+    }
 
     bool get(size_t i) const {
         auto sft = _shift(i);
         assert(sft % _bitsNum() == 0);
 
-        auto it = _bits.find(sft);
-        if (it == _bits.end()) {
+        auto it = _lowerBound(sft);
+        if (it == _bits.end() || it->shift != sft) {
             return false;
         }
 
-        return (it->second & (1UL << (i - sft)));
+        return (it->words[(i - sft) / _wordBitsNum()] & _mask(i - sft));
     }
 
     // returns the previous value of the i-th bit
     bool set(size_t i) {
         auto sft = _shift(i);
-        auto it = _bits.find(sft);
-        if (it == _bits.end()) {
-            _addBits(i);
-            return false;
+        auto it = _lowerBound(sft);
+        if (it == _bits.end() || it->shift != sft) {
+            it = _bits.emplace(it, sft);
         }
 
-        bool prev = (it->second & (1UL << (i - sft)));
-        it->second |= (1UL << (i - sft));
+        BitsT& word = it->words[(i - sft) / _wordBitsNum()];
+        bool prev = (word & _mask(i - sft));
+        word |= _mask(i - sft);
+        if (!prev)
+            ++_size;
 
         return prev;
     }
 
+    // returns the previous value of the i-th bit
+    bool unset(size_t i) {
+        auto sft = _shift(i);
+        auto it = _lowerBound(sft);
+        if (it == _bits.end() || it->shift != sft)
+            return false;
+
+        BitsT& word = it->words[(i - sft) / _wordBitsNum()];
+        bool prev = (word & _mask(i - sft));
+        if (!prev)
+            return false;
+
+        word &= ~_mask(i - sft);
+        --_size;
+        if (it->empty())
+            _bits.erase(it);
+
+        return true;
+    }
+
     // this is the union operation
     bool merge(const SparseBitvectorImpl& rhs) {
-        bool changed = false;
-        // FIXME: this is inefficient
-        for (size_t i : rhs) {
-            // if we changed a bit from false to true,
-            // we changed the bitvector
-            changed |= (set(i) == false);
+        if (this == &rhs)
+            return false;
+
+        // first unite the chunks that we already have
+        // and count the chunks that we are missing
+        size_t added = 0;
+        size_t missing = 0;
+        auto it = _bits.begin();
+        auto et = _bits.end();
+        for (const Chunk& r : rhs._bits) {
+            while (it != et && it->shift < r.shift)
+                ++it;
+
+            if (it != et && it->shift == r.shift)
+                added += it->unite(r);
+            else
+                ++missing;
+        }
+
+        _size += added;
+        if (missing == 0)
+            return added != 0;
+
+        // now put the missing chunks to their places.
+        // Merge from the back, so that every chunk is moved only once.
+        size_t i = _bits.size();
+        size_t j = rhs._bits.size();
+        _bits.resize(i + missing, Chunk(0));
+        size_t k = _bits.size();
+        while (j > 0) {
+            const Chunk& r = rhs._bits[j - 1];
+            if (i > 0 && _bits[i - 1].shift >= r.shift) {
+                // equal chunks were already united above
+                if (_bits[i - 1].shift == r.shift)
+                    --j;
+                _bits[--k] = _bits[--i];
+            } else {
+                _bits[--k] = r;
+                _size += r.count();
+                --j;
+            }
+        }
+        assert(k == i && "Did not fill all the missing chunks");
+
+        return true;
+    }
+
+    // keep only the bits that are also in rhs,
+    // return true if the bitvector changed
+    bool intersect(const SparseBitvectorImpl& rhs) {
+        if (this == &rhs)
+            return false;
+
+        size_t removed = 0;
+        auto rit = rhs._bits.begin();
+        auto ret = rhs._bits.end();
+        for (Chunk& c : _bits) {
+            while (rit != ret && rit->shift < c.shift)
+                ++rit;
+
+            if (rit != ret && rit->shift == c.shift) {
+                removed += c.intersect(*rit);
+            } else {
+                // the whole chunk goes away
+                removed += c.count();
+                c = Chunk(c.shift);
+            }
+        }
+
+        if (removed == 0)
+            return false;
+
+        _size -= removed;
+        _removeEmpty();
+        return true;
+    }
+
+    // remove the bits that are in rhs,
+    // return true if the bitvector changed
+    bool subtract(const SparseBitvectorImpl& rhs) {
+        if (this == &rhs) {
+            bool changed = !empty();
+            reset();
+            return changed;
+        }
+
+        size_t removed = 0;
+        auto rit = rhs._bits.begin();
+        auto ret = rhs._bits.end();
+        for (Chunk& c : _bits) {
+            while (rit != ret && rit->shift < c.shift)
+                ++rit;
+
+            if (rit == ret)
+                break;
+
+            if (rit->shift == c.shift)
+                removed += c.subtract(*rit);
         }
 
-        return changed;
+        if (removed == 0)
+            return false;
+
+        _size -= removed;
+        _removeEmpty();
+        return true;
     }
 
-    size_t size() const {
-        size_t num = 0;
-        for (auto& it : _bits)
-            num += _countBits(it.second);
+    bool operator==(const SparseBitvectorImpl& rhs) const {
+        return _size == rhs._size && _bits.size() == rhs._bits.size() &&
+                std::equal(_bits.begin(), _bits.end(), rhs._bits.begin());
+    }
 
-        return num;
+    bool operator!=(const SparseBitvectorImpl& rhs) const {
+        return !operator==(rhs);
     }
 
+    size_t size() const { return _size; }
+
     class const_iterator {
         typename BitsContainerT::const_iterator container_it;
         typename BitsContainerT::const_iterator container_end;
@@ -108,23 +326,34 @@ public:
                 _findClosestBit();
         }
 
+        // move to the first set bit on position >= pos in the current
+        // chunk or to _bitsNum() if there is no such bit
         void _findClosestBit() {
-            assert(pos < (sizeof(BitsT)*8));
-            while (!(container_it->second & (1UL << pos))) {
-                if (++pos == sizeof(BitsT)*8)
+            assert(pos < _bitsNum());
+            size_t w = pos / _wordBitsNum();
+            BitsT word = container_it->words[w] >> (pos % _wordBitsNum());
+            while (word == 0) {
+                if (++w == SCALE) {
+                    pos = _bitsNum();
                     return;
+                }
+
+                pos = w * _wordBitsNum();
+                word = container_it->words[w];
             }
+
+            pos += countTrailingZeros(word);
         }
 
     public:
         const_iterator() = default;
         const_iterator& operator++() {
             // shift to the next bit in the current bits
-            assert(pos < (sizeof(BitsT)*8));
-            if (++pos != 64)
+            assert(pos < _bitsNum());
+            if (++pos != _bitsNum())
                 _findClosestBit();
 
-            if (pos == 64) {
+            if (pos == _bitsNum()) {
                 ++container_it;
                 pos = 0;
                 if (container_it != container_end) {
@@ -141,7 +370,7 @@ public:
         }
 
         size_t operator*() const {
-            return container_it->first + pos;
+            return container_it->shift + pos;
         }
 
         bool operator==(const const_iterator& rhs) const {
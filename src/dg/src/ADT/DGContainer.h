@@ -4,6 +4,11 @@
 #include <set>
 #include <cassert>
 #include <algorithm>
+#include <iterator>
+
+#ifdef ENABLE_FLAT_CONTAINERS
+#include "FlatSet.h"
+#endif
 
 namespace dg {
 
@@ -12,14 +17,20 @@ namespace dg {
 //
 //   This is basically just a wrapper for real container, so that
 //   we have the container defined on one place for all edges.
-//   It may have more implementations depending on available features
+//   It may have more implementations depending on available features.
+//   When ENABLE_FLAT_CONTAINERS is defined, the elements are kept
+//   in a sorted array with EXPECTED_ELEMENTS_NUM elements stored inline.
+//   Note that then inserting or erasing invalidates iterators.
 /// ------------------------------------------------------------------
 template <typename ValueT, unsigned int EXPECTED_ELEMENTS_NUM = 8>
 class DGContainer
 {
 public:
-    // XXX use llvm ADTs when available, or BDDs?
+#ifdef ENABLE_FLAT_CONTAINERS
+    using ContainerT = ADT::FlatSet<ValueT, EXPECTED_ELEMENTS_NUM>;
+#else
     using ContainerT = typename std::set<ValueT>;
+#endif
     using iterator = typename ContainerT::iterator;
     using const_iterator = typename ContainerT::const_iterator;
     using size_type = typename ContainerT::size_type;
@@ -54,7 +65,7 @@ public:
         container.clear();
     }
 
-    bool empty()
+    bool empty() const
     {
         return container.empty();
     }
@@ -72,7 +83,7 @@ public:
                               oth.container.begin(),
                               oth.container.end(),
                               std::inserter(tmp.container,
-                                            tmp.container.begin()));
+                                            tmp.container.end()));
 
         // swap containers
         container.swap(tmp.container);
@@ -84,8 +95,8 @@ public:
             return false;
 
         // the sets are ordered, so this will work
-        iterator snd = oth.container.begin();
-        for (iterator fst = container.begin(), efst = container.end();
+        const_iterator snd = oth.container.begin();
+        for (const_iterator fst = container.begin(), efst = container.end();
              fst != efst; ++fst, ++snd)
             if (*fst != *snd)
                 return false;
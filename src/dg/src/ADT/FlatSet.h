@@ -0,0 +1,182 @@
+#ifndef _DG_FLAT_SET_H_
+#define _DG_FLAT_SET_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace dg {
+namespace ADT {
+
+// A set kept as a sorted array. Up to INLINE_NUM elements are stored
+// in the object itself, so small sets do not allocate at all.
+// When the set grows bigger, the elements are spilled to a sorted array
+// on the heap that takes the place of the inline elements (the object
+// is not bigger than the inline elements and the size).
+// Unlike std::set, inserting or erasing an element invalidates iterators.
+// ValueT must be default constructible and trivially copyable.
+template <typename ValueT, unsigned int INLINE_NUM = 8>
+class FlatSet {
+    static_assert(INLINE_NUM > 0, "Need at least one inline element");
+    static_assert(std::is_trivially_copyable<ValueT>::value,
+                  "The elements are moved around by copying");
+
+    struct HeapT {
+        ValueT *data;
+        size_t capacity;
+    };
+
+    // the inline elements or the spilled elements, never both
+    // (ValueT is trivially copyable, so the union is too)
+    union StorageT {
+        ValueT inl[INLINE_NUM];
+        HeapT heap;
+
+        StorageT() : inl() {}
+    } _storage;
+
+    uint32_t _size{0};
+    bool _isSpilled{false};
+
+    ValueT *_data() { return _isSpilled ? _storage.heap.data : _storage.inl; }
+    const ValueT *_data() const {
+        return _isSpilled ? _storage.heap.data : _storage.inl;
+    }
+
+    size_t _capacity() const {
+        return _isSpilled ? _storage.heap.capacity : INLINE_NUM;
+    }
+
+    void _reserve(size_t capacity) {
+        assert(capacity >= _size);
+        ValueT *data = new ValueT[capacity];
+        std::copy(_data(), _data() + _size, data);
+        _release();
+        _storage.heap = HeapT{data, capacity};
+        _isSpilled = true;
+    }
+
+    void _release() {
+        if (_isSpilled)
+            delete[] _storage.heap.data;
+    }
+
+    // make this set an empty inline set
+    // (the storage must be released or taken by another set)
+    void _reset() {
+        new (&_storage) StorageT();
+        _size = 0;
+        _isSpilled = false;
+    }
+
+public:
+    using value_type = ValueT;
+    using iterator = const ValueT *;
+    using const_iterator = const ValueT *;
+    using size_type = size_t;
+
+    FlatSet() = default;
+
+    FlatSet(const FlatSet& oth) {
+        if (oth._isSpilled)
+            _reserve(std::max<size_t>(oth._size, 2 * INLINE_NUM));
+        std::copy(oth.begin(), oth.end(), _data());
+        _size = oth._size;
+    }
+
+    FlatSet(FlatSet&& oth)
+    : _storage(oth._storage), _size(oth._size), _isSpilled(oth._isSpilled) {
+        oth._reset();
+    }
+
+    FlatSet& operator=(const FlatSet& oth) {
+        FlatSet tmp(oth);
+        swap(tmp);
+        return *this;
+    }
+
+    FlatSet& operator=(FlatSet&& oth) {
+        FlatSet tmp(std::move(oth));
+        swap(tmp);
+        return *this;
+    }
+
+    ~FlatSet() { _release(); }
+
+    const_iterator begin() const { return _data(); }
+    const_iterator end() const { return _data() + size(); }
+
+    size_type size() const { return _size; }
+
+    bool empty() const { return size() == 0; }
+
+    const_iterator find(const ValueT& v) const {
+        auto it = std::lower_bound(begin(), end(), v);
+        if (it != end() && !(v < *it))
+            return it;
+        return end();
+    }
+
+    size_type count(const ValueT& v) const { return find(v) != end(); }
+
+    std::pair<iterator, bool> insert(const ValueT& v) {
+        size_t pos = std::lower_bound(begin(), end(), v) - begin();
+        if (pos < size() && !(v < _data()[pos]))
+            return {begin() + pos, false};
+
+        if (_size == _capacity())
+            _reserve(2 * _capacity());
+
+        ValueT *data = _data();
+        std::copy_backward(data + pos, data + _size, data + _size + 1);
+        data[pos] = v;
+        ++_size;
+
+        return {begin() + pos, true};
+    }
+
+    // insert with a hint. We use only the common case when elements
+    // are inserted in increasing order (e.g. by std::inserter)
+    iterator insert(const_iterator, const ValueT& v) {
+        return insert(v).first;
+    }
+
+    size_type erase(const ValueT& v) {
+        auto it = find(v);
+        if (it == end())
+            return 0;
+
+        size_t pos = it - begin();
+        ValueT *data = _data();
+        std::copy(data + pos + 1, data + _size, data + pos);
+        --_size;
+
+        return 1;
+    }
+
+    void clear() {
+        _release();
+        _reset();
+    }
+
+    void swap(FlatSet& oth) {
+        std::swap(_storage, oth._storage);
+        std::swap(_size, oth._size);
+        std::swap(_isSpilled, oth._isSpilled);
+    }
+
+    bool operator==(const FlatSet& oth) const {
+        return size() == oth.size() && std::equal(begin(), end(), oth.begin());
+    }
+
+    bool operator!=(const FlatSet& oth) const { return !operator==(oth); }
+};
+
+} // namespace ADT
+} // namespace dg
+
+#endif // _DG_FLAT_SET_H_
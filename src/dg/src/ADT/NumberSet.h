@@ -1,6 +1,13 @@
 #ifndef _DG_NUMBER_SET_H_
 #define _DG_NUMBER_SET_H_
 
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iterator>
+#include <utility>
+#include <vector>
+
 #include "Bits.h"
 #include "Bitvector.h"
 
@@ -9,7 +16,6 @@ namespace ADT {
 
 // this is just a wrapper around sparse bitvector
 // that translates the bitvector methods to a new methods.
-// There is no possibility to remove elements from the set.
 class BitvectorNumberSet {
     using NumT = uint64_t;
     using ContainerT = SparseBitvectorImpl<uint64_t, NumT>;
@@ -23,6 +29,7 @@ public:
     BitvectorNumberSet(BitvectorNumberSet&&) = default;
 
     bool add(NumT n) { return !_bitvector.set(n); }
+    bool remove(NumT n) { return _bitvector.unset(n); }
     bool has(NumT n) const { return _bitvector.get(n); }
     bool empty() const { return _bitvector.empty(); }
     size_t size() const { return _bitvector.size(); }
@@ -37,8 +44,7 @@ public:
 // that is optimized for holding small values
 // (values less than sizeof(NumT)*8*SmallElemNum)).
 // If a greater value is inserted, the whole container
-// is lifted to a normal set.
-// There is no possibility to remove elements from the set.
+// is lifted to a normal set (and it is never shrinked back).
 class SmallNumberSet {
     using NumT = uint64_t;
     // NOTE: if we change this to something that
@@ -90,6 +96,13 @@ public:
             return _set.big.add(n);
     }
 
+    // return true if the element was in the set
+    bool remove(NumT n) {
+        if (is_small)
+            return _set.small.mayContain(n) && _set.small.unset(n);
+        return _set.big.remove(n);
+    }
+
     bool has(NumT n) const {
         return is_small ? _set.small.get(n) : _set.big.has(n);
     }
@@ -174,6 +187,709 @@ public:
     friend class const_iterator;
 };
 
+// A set of numbers in the style of roaring bitmaps.
+// The numbers are split by their upper bits into chunks of 2^16 numbers
+// and every chunk is kept in the container that suits it best:
+// a sorted array of the lower 16 bits (sparse chunks), a bitmap
+// (dense chunks) or a sorted list of runs (intervals of numbers).
+// Adding and removing elements keeps the chunks in arrays and bitmaps,
+// runs are created by optimize() and by the bulk operations.
+// The number of elements is cached, so size() is O(1).
+class RoaringNumberSet {
+    using NumT = uint64_t;
+    using LowT = uint16_t;
+
+    static const unsigned CHUNK_BITS = 16;
+    static const uint32_t CHUNK_MASK = (1 << CHUNK_BITS) - 1;
+    static const uint32_t WORDS_NUM = (1 << CHUNK_BITS) / 64;
+    // from this size, the bitmap takes less memory than the array
+    static const uint32_t ARRAY_MAX = 4096;
+
+    class Container {
+    public:
+        enum class Kind : uint8_t { ARRAY, BITMAP, RUNS };
+
+    private:
+        Kind _kind{Kind::ARRAY};
+        uint32_t _card{0};
+        // the key of the chunk that the container belongs to
+        NumT _key{0};
+        // sorted elements (ARRAY) or pairs first, last (RUNS)
+        std::vector<LowT> _data;
+        // WORDS_NUM words for BITMAP
+        std::vector<uint64_t> _words;
+
+        bool _getBit(uint32_t x) const {
+            return (_words[x / 64] >> (x % 64)) & 0x1;
+        }
+
+        void _setBit(uint32_t x) {
+            _words[x / 64] |= static_cast<uint64_t>(1) << (x % 64);
+        }
+
+        void _unsetBit(uint32_t x) {
+            _words[x / 64] &= ~(static_cast<uint64_t>(1) << (x % 64));
+        }
+
+        // unset the bits from..to (including 'to') word by word
+        void _unsetBits(uint32_t from, uint32_t to) {
+            uint32_t fw = from / 64, tw = to / 64;
+            uint64_t fmask = ~static_cast<uint64_t>(0) << (from % 64);
+            uint64_t tmask = ~static_cast<uint64_t>(0) >> (63 - to % 64);
+            if (fw == tw) {
+                _words[fw] &= ~(fmask & tmask);
+                return;
+            }
+
+            _words[fw] &= ~fmask;
+            for (uint32_t w = fw + 1; w < tw; ++w)
+                _words[w] = 0;
+            _words[tw] &= ~tmask;
+        }
+
+        // find the first bit set on position >= from
+        bool _findBit(uint32_t from, uint32_t& val) const {
+            uint32_t w = from / 64;
+            if (w >= WORDS_NUM)
+                return false;
+
+            uint64_t bits = _words[w] >> (from % 64);
+            if (bits) {
+                val = from + countTrailingZeros(bits);
+                return true;
+            }
+
+            for (++w; w < WORDS_NUM; ++w) {
+                if (_words[w]) {
+                    val = w * 64 + countTrailingZeros(_words[w]);
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        size_t _runsNum() const { return _data.size() / 2; }
+
+        // index of the first run that ends at x or after it
+        size_t _findRun(uint32_t x) const {
+            size_t lo = 0, hi = _runsNum();
+            while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+                if (_data[2 * mid + 1] < x)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            return lo;
+        }
+
+        void _recount() {
+            _card = 0;
+            for (auto w : _words)
+                _card += popCount(w);
+        }
+
+        // turn a bitmap back to an array if it is small enough
+        void _shrink() {
+            if (_kind == Kind::BITMAP && _card <= ARRAY_MAX)
+                toArray();
+        }
+
+        // the container that we use when we need to modify runs
+        void _unpackRuns() {
+            if (_kind != Kind::RUNS)
+                return;
+
+            if (_card < ARRAY_MAX)
+                toArray();
+            else
+                toBitmap();
+        }
+
+    public:
+        explicit Container(NumT key = 0) : _key(key) {}
+
+        NumT key() const { return _key; }
+        Kind kind() const { return _kind; }
+        uint32_t size() const { return _card; }
+        bool empty() const { return _card == 0; }
+
+        // iteration: idx is the position in the container
+        // and val is the current element
+        bool first(uint32_t& idx, uint32_t& val) const {
+            if (_card == 0)
+                return false;
+
+            idx = 0;
+            if (_kind == Kind::BITMAP)
+                return _findBit(0, val);
+
+            val = _data[0];
+            return true;
+        }
+
+        bool next(uint32_t& idx, uint32_t& val) const {
+            switch (_kind) {
+            case Kind::ARRAY:
+                if (++idx == _card)
+                    return false;
+                val = _data[idx];
+                return true;
+            case Kind::BITMAP:
+                return _findBit(val + 1, val);
+            case Kind::RUNS:
+                if (val < _data[2 * idx + 1]) {
+                    ++val;
+                    return true;
+                }
+                if (++idx == _runsNum())
+                    return false;
+                val = _data[2 * idx];
+                return true;
+            }
+
+            abort();
+        }
+
+        template <typename F>
+        void forEach(F f) const {
+            uint32_t idx, val;
+            bool ok = first(idx, val);
+            while (ok) {
+                f(val);
+                ok = next(idx, val);
+            }
+        }
+
+        bool contains(uint32_t x) const {
+            switch (_kind) {
+            case Kind::ARRAY:
+                return std::binary_search(_data.begin(), _data.end(), x);
+            case Kind::BITMAP:
+                return _getBit(x);
+            case Kind::RUNS: {
+                size_t r = _findRun(x);
+                return r < _runsNum() && _data[2 * r] <= x;
+            }
+            }
+
+            abort();
+        }
+
+        // return true if the element was not in the container
+        bool add(uint32_t x) {
+            if (contains(x))
+                return false;
+
+            _unpackRuns();
+            if (_kind == Kind::ARRAY && _card == ARRAY_MAX)
+                toBitmap();
+
+            if (_kind == Kind::ARRAY)
+                _data.insert(std::lower_bound(_data.begin(), _data.end(), x), x);
+            else
+                _setBit(x);
+
+            ++_card;
+            return true;
+        }
+
+        // return true if the element was in the container
+        bool remove(uint32_t x) {
+            if (!contains(x))
+                return false;
+
+            _unpackRuns();
+            if (_kind == Kind::ARRAY)
+                _data.erase(std::lower_bound(_data.begin(), _data.end(), x));
+            else
+                _unsetBit(x);
+
+            --_card;
+            _shrink();
+            return true;
+        }
+
+        void toArray() {
+            if (_kind == Kind::ARRAY)
+                return;
+
+            std::vector<LowT> data;
+            data.reserve(_card);
+            forEach([&data](uint32_t x) { data.push_back(x); });
+
+            _data.swap(data);
+            std::vector<uint64_t>().swap(_words);
+            _kind = Kind::ARRAY;
+        }
+
+        void toBitmap() {
+            if (_kind == Kind::BITMAP)
+                return;
+
+            _words.assign(WORDS_NUM, 0);
+            forEach([this](uint32_t x) { _setBit(x); });
+
+            std::vector<LowT>().swap(_data);
+            _kind = Kind::BITMAP;
+        }
+
+        void toRuns() {
+            if (_kind == Kind::RUNS)
+                return;
+
+            std::vector<LowT> data;
+            data.reserve(2 * runsNum());
+            forEach([&data](uint32_t x) {
+                if (!data.empty() && data.back() + 1u == x)
+                    data.back() = x;
+                else {
+                    data.push_back(x);
+                    data.push_back(x);
+                }
+            });
+
+            _data.swap(data);
+            std::vector<uint64_t>().swap(_words);
+            _kind = Kind::RUNS;
+        }
+
+        // the number of runs that the elements form
+        size_t runsNum() const {
+            size_t num = 0;
+            switch (_kind) {
+            case Kind::ARRAY:
+                for (uint32_t i = 0; i < _card; ++i) {
+                    if (i == 0 || _data[i - 1] + 1u != _data[i])
+                        ++num;
+                }
+                return num;
+            case Kind::BITMAP: {
+                uint64_t carry = 0;
+                for (auto w : _words) {
+                    // count the bits that start a run
+                    num += popCount(w & ~((w << 1) | carry));
+                    carry = w >> 63;
+                }
+                return num;
+            }
+            case Kind::RUNS:
+                return _runsNum();
+            }
+
+            abort();
+        }
+
+        // pick the container that takes the least memory
+        void optimize() {
+            // the sizes in the number of LowT elements
+            size_t arraySize = _card;
+            size_t bitmapSize = WORDS_NUM * 4;
+            size_t runsSize = 2 * runsNum();
+
+            if (runsSize < std::min(arraySize, bitmapSize))
+                toRuns();
+            else if (_card <= ARRAY_MAX)
+                toArray();
+            else
+                toBitmap();
+        }
+
+        void unite(const Container& rhs) {
+            if (_kind == Kind::ARRAY && rhs._kind == Kind::ARRAY &&
+                _card + rhs._card <= ARRAY_MAX) {
+                std::vector<LowT> data;
+                data.reserve(_card + rhs._card);
+                std::set_union(_data.begin(), _data.end(),
+                               rhs._data.begin(), rhs._data.end(),
+                               std::back_inserter(data));
+                _data.swap(data);
+                _card = _data.size();
+                return;
+            }
+
+            bool hadRuns = _kind == Kind::RUNS || rhs._kind == Kind::RUNS;
+
+            toBitmap();
+            if (rhs._kind == Kind::BITMAP) {
+                for (uint32_t i = 0; i < WORDS_NUM; ++i)
+                    _words[i] |= rhs._words[i];
+            } else {
+                rhs.forEach([this](uint32_t x) { _setBit(x); });
+            }
+            _recount();
+
+            // keep runs as runs if it pays off
+            if (hadRuns)
+                optimize();
+            else
+                _shrink();
+        }
+
+        void intersect(const Container& rhs) {
+            if (_kind != Kind::ARRAY && rhs._kind == Kind::ARRAY) {
+                // filter the smaller container
+                Container tmp(rhs);
+                tmp.intersect(*this);
+                *this = std::move(tmp);
+                return;
+            }
+
+            if (_kind == Kind::ARRAY) {
+                auto end = std::remove_if(_data.begin(), _data.end(),
+                            [&rhs](LowT x) { return !rhs.contains(x); });
+                _data.erase(end, _data.end());
+                _card = _data.size();
+                return;
+            }
+
+            toBitmap();
+            if (rhs._kind == Kind::BITMAP) {
+                for (uint32_t i = 0; i < WORDS_NUM; ++i)
+                    _words[i] &= rhs._words[i];
+            } else {
+                assert(rhs._kind == Kind::RUNS);
+                // unset the gaps between the runs
+                uint32_t from = 0;
+                for (size_t r = 0; r < rhs._runsNum(); ++r) {
+                    uint32_t start = rhs._data[2 * r];
+                    if (start > from)
+                        _unsetBits(from, start - 1);
+                    from = rhs._data[2 * r + 1] + 1u;
+                }
+                if (from <= CHUNK_MASK)
+                    _unsetBits(from, CHUNK_MASK);
+            }
+            _recount();
+            _shrink();
+        }
+
+        void subtract(const Container& rhs) {
+            if (_kind == Kind::ARRAY) {
+                auto end = std::remove_if(_data.begin(), _data.end(),
+                            [&rhs](LowT x) { return rhs.contains(x); });
+                _data.erase(end, _data.end());
+                _card = _data.size();
+                return;
+            }
+
+            toBitmap();
+            if (rhs._kind == Kind::BITMAP) {
+                for (uint32_t i = 0; i < WORDS_NUM; ++i)
+                    _words[i] &= ~rhs._words[i];
+            } else if (rhs._kind == Kind::RUNS) {
+                for (size_t r = 0; r < rhs._runsNum(); ++r)
+                    _unsetBits(rhs._data[2 * r], rhs._data[2 * r + 1]);
+            } else {
+                rhs.forEach([this](uint32_t x) { _unsetBit(x); });
+            }
+            _recount();
+            _shrink();
+        }
+
+        bool operator==(const Container& rhs) const {
+            if (_card != rhs._card)
+                return false;
+            if (_kind == rhs._kind)
+                return _data == rhs._data && _words == rhs._words;
+
+            uint32_t idx1, val1, idx2, val2;
+            bool ok1 = first(idx1, val1), ok2 = rhs.first(idx2, val2);
+            while (ok1 && ok2) {
+                if (val1 != val2)
+                    return false;
+                ok1 = next(idx1, val1);
+                ok2 = rhs.next(idx2, val2);
+            }
+            return ok1 == ok2;
+        }
+    };
+
+    // the containers of the chunks (in no particular order)
+    std::vector<Container> _containers;
+    // the keys of the chunks (the upper bits of numbers) with
+    // the index of their container, sorted by the key. The entries
+    // are plain numbers, so inserting a new chunk or removing one
+    // only moves memory and does not move any container
+    struct ChunkT {
+        NumT key;
+        uint32_t idx;
+    };
+    std::vector<ChunkT> _chunks;
+    size_t _size{0};
+
+    static NumT _key(NumT n) { return n >> CHUNK_BITS; }
+    static uint32_t _low(NumT n) { return n & CHUNK_MASK; }
+
+    Container& _container(const ChunkT& c) { return _containers[c.idx]; }
+    const Container& _container(const ChunkT& c) const { return _containers[c.idx]; }
+
+    std::vector<ChunkT>::iterator _lowerBound(NumT key) {
+        // sets are often filled in increasing order,
+        // so check the last chunk first
+        if (_chunks.empty() || _chunks.back().key < key)
+            return _chunks.end();
+        if (_chunks.back().key == key)
+            return _chunks.end() - 1;
+
+        return std::lower_bound(_chunks.begin(), _chunks.end(), key,
+                                [](const ChunkT& c, NumT k) { return c.key < k; });
+    }
+
+    std::vector<ChunkT>::const_iterator _lowerBound(NumT key) const {
+        return const_cast<RoaringNumberSet *>(this)->_lowerBound(key);
+    }
+
+    // add a chunk with an empty container before 'it'
+    std::vector<ChunkT>::iterator _insertChunk(std::vector<ChunkT>::iterator it,
+                                               NumT key) {
+        uint32_t idx = static_cast<uint32_t>(_containers.size());
+        _containers.emplace_back(key);
+        return _chunks.insert(it, ChunkT{key, idx});
+    }
+
+    void _eraseChunk(std::vector<ChunkT>::iterator it) {
+        // move the last container to the place of the erased one
+        uint32_t idx = it->idx;
+        uint32_t last = static_cast<uint32_t>(_containers.size()) - 1;
+        _chunks.erase(it);
+        if (idx != last) {
+            _containers[idx] = std::move(_containers[last]);
+            auto moved = _lowerBound(_containers[idx].key());
+            assert(moved != _chunks.end() && moved->idx == last);
+            moved->idx = idx;
+        }
+        _containers.pop_back();
+    }
+
+    // remove chunks that are empty and store the containers
+    // in the order of the chunks
+    void _removeEmpty() {
+        std::vector<Container> containers;
+        containers.reserve(_containers.size());
+        auto end = std::remove_if(_chunks.begin(), _chunks.end(),
+                                  [this](const ChunkT& c) {
+                                      return _container(c).empty();
+                                  });
+        _chunks.erase(end, _chunks.end());
+        for (auto& c : _chunks) {
+            containers.push_back(std::move(_container(c)));
+            c.idx = static_cast<uint32_t>(containers.size() - 1);
+        }
+        _containers.swap(containers);
+    }
+
+    void _recount() {
+        _size = 0;
+        for (auto& c : _containers)
+            _size += c.size();
+    }
+
+public:
+    bool add(NumT n) {
+        auto it = _lowerBound(_key(n));
+        if (it == _chunks.end() || it->key != _key(n))
+            it = _insertChunk(it, _key(n));
+
+        if (_container(*it).add(_low(n))) {
+            ++_size;
+            return true;
+        }
+
+        return false;
+    }
+
+    // return true if the element was in the set
+    bool remove(NumT n) {
+        auto it = _lowerBound(_key(n));
+        if (it == _chunks.end() || it->key != _key(n))
+            return false;
+
+        if (!_container(*it).remove(_low(n)))
+            return false;
+
+        --_size;
+        if (_container(*it).empty())
+            _eraseChunk(it);
+        return true;
+    }
+
+    bool has(NumT n) const {
+        auto it = _lowerBound(_key(n));
+        return it != _chunks.end() && it->key == _key(n) &&
+                _container(*it).contains(_low(n));
+    }
+
+    bool empty() const { return _size == 0; }
+    size_t size() const { return _size; }
+
+    void reset() { _chunks.clear(); _containers.clear(); _size = 0; }
+
+    void swap(RoaringNumberSet& oth) {
+        _chunks.swap(oth._chunks);
+        _containers.swap(oth._containers);
+        std::swap(_size, oth._size);
+    }
+
+    // make union of the two sets and store it into this set,
+    // return true if this set changed
+    bool merge(const RoaringNumberSet& rhs) {
+        if (this == &rhs)
+            return false;
+
+        std::vector<ChunkT> result;
+        result.reserve(_chunks.size() + rhs._chunks.size());
+
+        auto it = _chunks.begin();
+        auto rit = rhs._chunks.begin();
+        while (it != _chunks.end() || rit != rhs._chunks.end()) {
+            if (rit == rhs._chunks.end() ||
+                (it != _chunks.end() && it->key < rit->key)) {
+                result.push_back(*it++);
+            } else if (it == _chunks.end() || rit->key < it->key) {
+                // the chunks of rhs are copied to the end
+                // of our containers
+                _containers.push_back(rhs._container(*rit));
+                result.push_back(ChunkT{rit->key,
+                                 static_cast<uint32_t>(_containers.size() - 1)});
+                ++rit;
+            } else {
+                _container(*it).unite(rhs._container(*rit));
+                result.push_back(*it++);
+                ++rit;
+            }
+        }
+
+        auto old = _size;
+        _chunks.swap(result);
+        _recount();
+        return old != _size;
+    }
+
+    // keep only the elements that are also in rhs,
+    // return true if this set changed
+    bool intersect(const RoaringNumberSet& rhs) {
+        auto rit = rhs._chunks.begin();
+        for (auto& c : _chunks) {
+            while (rit != rhs._chunks.end() && rit->key < c.key)
+                ++rit;
+
+            if (rit != rhs._chunks.end() && rit->key == c.key)
+                _container(c).intersect(rhs._container(*rit));
+            else
+                _container(c) = Container(c.key);
+        }
+
+        auto old = _size;
+        _removeEmpty();
+        _recount();
+        return old != _size;
+    }
+
+    // remove the elements that are in rhs,
+    // return true if this set changed
+    bool subtract(const RoaringNumberSet& rhs) {
+        auto rit = rhs._chunks.begin();
+        for (auto& c : _chunks) {
+            while (rit != rhs._chunks.end() && rit->key < c.key)
+                ++rit;
+
+            if (rit != rhs._chunks.end() && rit->key == c.key)
+                _container(c).subtract(rhs._container(*rit));
+        }
+
+        auto old = _size;
+        _removeEmpty();
+        _recount();
+        return old != _size;
+    }
+
+    // switch every chunk to the container that takes the least memory
+    // (e.g. use runs for intervals of numbers)
+    void optimize() {
+        for (auto& c : _containers)
+            c.optimize();
+    }
+
+    bool operator==(const RoaringNumberSet& rhs) const {
+        if (_size != rhs._size || _chunks.size() != rhs._chunks.size())
+            return false;
+
+        for (size_t i = 0; i < _chunks.size(); ++i) {
+            if (_chunks[i].key != rhs._chunks[i].key ||
+                !(_container(_chunks[i]) == rhs._container(rhs._chunks[i])))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool operator!=(const RoaringNumberSet& rhs) const {
+        return !operator==(rhs);
+    }
+
+    class const_iterator {
+        const RoaringNumberSet *set{nullptr};
+        size_t pos{0};
+        uint32_t idx{0};
+        uint32_t val{0};
+
+        const Container& container() const {
+            return set->_container(set->_chunks[pos]);
+        }
+
+        const_iterator(const RoaringNumberSet& S, bool end = false)
+        : set(&S), pos(end ? S._chunks.size() : 0) {
+            if (pos < set->_chunks.size()) {
+                bool ok = container().first(idx, val);
+                assert(ok && "Empty chunk");
+                (void) ok;
+            }
+        }
+
+    public:
+        const_iterator() = default;
+        const_iterator(const const_iterator&) = default;
+        const_iterator& operator=(const const_iterator&) = default;
+
+        const_iterator& operator++() {
+            assert(pos < set->_chunks.size() && "Incrementing end iterator");
+            if (!container().next(idx, val)) {
+                idx = val = 0;
+                if (++pos < set->_chunks.size())
+                    container().first(idx, val);
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            auto tmp = *this;
+            operator++();
+            return tmp;
+        }
+
+        NumT operator*() const {
+            assert(pos < set->_chunks.size() && "Dereferencing end iterator");
+            return (set->_chunks[pos].key << CHUNK_BITS) | val;
+        }
+
+        bool operator==(const const_iterator& rhs) const {
+            return pos == rhs.pos && idx == rhs.idx && val == rhs.val &&
+                   set == rhs.set;
+        }
+
+        bool operator!=(const const_iterator& rhs) const {
+            return !operator==(rhs);
+        }
+
+        friend class RoaringNumberSet;
+    };
+
+    const_iterator begin() const { return const_iterator(*this); }
+    const_iterator end() const { return const_iterator(*this, true /* end */); }
+};
+
 #if 0
 // This class is a container for a set of numbers
 // that is optimized for holding small values
@@ -0,0 +1,405 @@
+#ifndef _DG_PERSISTENT_MAP_H_
+#define _DG_PERSISTENT_MAP_H_
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Bits.h"
+
+namespace dg {
+namespace ADT {
+
+// Persistent map (a hash array mapped trie). IndexF maps the keys
+// to 32-bit indices (different keys must have different indices)
+// and every level of the trie is indexed by 5 bits of the index.
+// Copying the map is O(1), the copies share the nodes of the trie.
+// A change of the map copies only the nodes on the path to the changed
+// value that are shared with other maps. The shape of the trie depends
+// only on the keys, so merging two maps that were derived one from
+// the other skips the subtrees that they still share.
+// ValueT must be default constructible and cheap to copy
+// (e.g. a shared_ptr to the real value).
+template <typename KeyT, typename ValueT, typename IndexF>
+class PersistentMap {
+public:
+    using value_type = std::pair<KeyT, ValueT>;
+
+private:
+    static const unsigned BITS = 5;
+    static const uint32_t MASK = (1u << BITS) - 1;
+    static const unsigned LEVELS = (32 + BITS - 1) / BITS;
+
+    struct Node;
+    using NodePtr = std::shared_ptr<Node>;
+
+    // an item of a node - a key-value pair or a subtree
+    struct Entry {
+        NodePtr child;
+        value_type item;
+
+        bool isLeaf() const { return !child; }
+    };
+
+    struct Node {
+        // the slots of the node that are used
+        uint32_t bitmap{0};
+        // the entries of the used slots, ordered by the slots
+        std::vector<Entry> entries;
+
+        bool has(unsigned slot) const { return bitmap & (1u << slot); }
+        unsigned position(unsigned slot) const {
+            return popCount(bitmap & ((1u << slot) - 1));
+        }
+    };
+
+    NodePtr _root;
+
+    static uint32_t _index(const KeyT& key) { return IndexF()(key); }
+    static unsigned _slot(uint32_t idx, unsigned level) {
+        return (idx >> (level * BITS)) & MASK;
+    }
+
+    static NodePtr _singleton(const value_type& item, unsigned level) {
+        assert(level < LEVELS && "Different keys with the same index");
+        NodePtr n = std::make_shared<Node>();
+        n->bitmap = 1u << _slot(_index(item.first), level);
+        n->entries.push_back(Entry{nullptr, item});
+        return n;
+    }
+
+    // take the subtree of other map, the values of the subtree
+    // are copied only if the merge function changes them
+    template <typename F>
+    static NodePtr _adopt(const NodePtr& b, F& f) {
+        NodePtr res;
+        for (size_t pos = 0; pos < b->entries.size(); ++pos) {
+            const Entry& eb = b->entries[pos];
+            Entry e;
+            if (eb.isLeaf()) {
+                ValueT v = f(nullptr, eb.item.second, false);
+                if (v == eb.item.second)
+                    continue;
+                e.item = value_type(eb.item.first, std::move(v));
+            } else {
+                NodePtr c = _adopt(eb.child, f);
+                if (c == eb.child)
+                    continue;
+                e.child = std::move(c);
+            }
+
+            if (!res)
+                res = std::make_shared<Node>(*b);
+            res->entries[pos] = std::move(e);
+        }
+
+        return res ? res : b;
+    }
+
+    // merge the subtree 'b' to the subtree 'a' and return the result.
+    // 'a' is changed in place if it is not shared (exclusive),
+    // otherwise it is copied when something changes
+    template <typename F>
+    static NodePtr _merge(const NodePtr& a, const NodePtr& b,
+                          unsigned level, bool exclusive, F& f) {
+        if (!b || a == b)
+            return a;
+        if (!a)
+            return _adopt(b, f);
+
+        assert(level < LEVELS && "Different keys with the same index");
+
+        NodePtr res;
+        Node *target = (exclusive && a.use_count() == 1) ? a.get() : nullptr;
+        auto writable = [&]() -> Node * {
+            if (!target) {
+                res = std::make_shared<Node>(*a);
+                target = res.get();
+            }
+            return target;
+        };
+
+        for (uint32_t bits = b->bitmap; bits; bits &= bits - 1) {
+            unsigned slot = countTrailingZeros(bits);
+            const Entry& eb = b->entries[b->position(slot)];
+            const Node *cur = target ? target : a.get();
+            unsigned pos = cur->position(slot);
+
+            if (!cur->has(slot)) {
+                Entry e;
+                if (eb.isLeaf())
+                    e.item = value_type(eb.item.first,
+                                        f(nullptr, eb.item.second, false));
+                else
+                    e.child = _adopt(eb.child, f);
+
+                Node *n = writable();
+                n->bitmap |= 1u << slot;
+                n->entries.insert(n->entries.begin() + pos, std::move(e));
+                continue;
+            }
+
+            const Entry& ea = cur->entries[pos];
+            if (ea.isLeaf() && eb.isLeaf() && ea.item.first == eb.item.first) {
+                if (ea.item.second == eb.item.second)
+                    continue;
+
+                ValueT v = f(&ea.item.second, eb.item.second, target != nullptr);
+                if (!(v == ea.item.second))
+                    writable()->entries[pos].item.second = std::move(v);
+                continue;
+            }
+
+            // the entries have different keys or one of them
+            // is a subtree, merge them on the next level
+            NodePtr tmpa, tmpb;
+            if (ea.isLeaf())
+                tmpa = _singleton(ea.item, level + 1);
+            if (eb.isLeaf())
+                tmpb = _singleton(eb.item, level + 1);
+            // (references, so that we do not raise the use count)
+            const NodePtr& ca = ea.isLeaf() ? tmpa : ea.child;
+            const NodePtr& cb = eb.isLeaf() ? tmpb : eb.child;
+
+            NodePtr c = _merge(ca, cb, level + 1, target != nullptr, f);
+            if (ea.isLeaf() || c != ea.child) {
+                Entry& e = writable()->entries[pos];
+                e.item = value_type();
+                e.child = std::move(c);
+            }
+        }
+
+        return res ? res : a;
+    }
+
+    template <typename F>
+    static void _forEach(const NodePtr& a, F& f) {
+        for (const Entry& e : a->entries) {
+            if (e.isLeaf())
+                f(e.item);
+            else
+                _forEach(e.child, f);
+        }
+    }
+
+    // call f for the items of the subtree 'a' that are not in 'b'
+    template <typename F>
+    static void _diff(const NodePtr& a, const NodePtr& b,
+                      unsigned level, F& f) {
+        if (!a || a == b)
+            return;
+        if (!b) {
+            _forEach(a, f);
+            return;
+        }
+
+        assert(level < LEVELS && "Different keys with the same index");
+
+        for (uint32_t bits = a->bitmap; bits; bits &= bits - 1) {
+            unsigned slot = countTrailingZeros(bits);
+            const Entry& ea = a->entries[a->position(slot)];
+            if (!b->has(slot)) {
+                if (ea.isLeaf())
+                    f(ea.item);
+                else
+                    _forEach(ea.child, f);
+                continue;
+            }
+
+            const Entry& eb = b->entries[b->position(slot)];
+            if (ea.isLeaf() && eb.isLeaf() && ea.item.first == eb.item.first) {
+                if (!(ea.item.second == eb.item.second))
+                    f(ea.item);
+                continue;
+            }
+
+            NodePtr tmpa, tmpb;
+            if (ea.isLeaf())
+                tmpa = _singleton(ea.item, level + 1);
+            if (eb.isLeaf())
+                tmpb = _singleton(eb.item, level + 1);
+
+            _diff(ea.isLeaf() ? tmpa : ea.child,
+                  eb.isLeaf() ? tmpb : eb.child, level + 1, f);
+        }
+    }
+
+public:
+    class const_iterator {
+        // the path to the current leaf: (node, position in the node)
+        std::vector<std::pair<const Node *, size_t>> _stack;
+
+        // move to the nearest leaf
+        void _settle() {
+            while (!_stack.empty()) {
+                auto& top = _stack.back();
+                if (top.second == top.first->entries.size()) {
+                    _stack.pop_back();
+                    if (!_stack.empty())
+                        ++_stack.back().second;
+                    continue;
+                }
+
+                const Entry& e = top.first->entries[top.second];
+                if (e.isLeaf())
+                    return;
+                _stack.emplace_back(e.child.get(), 0);
+            }
+        }
+
+    public:
+        const_iterator() = default;
+        explicit const_iterator(const Node *root) {
+            if (root) {
+                _stack.emplace_back(root, 0);
+                _settle();
+            }
+        }
+
+        const value_type& operator*() const {
+            const auto& top = _stack.back();
+            return top.first->entries[top.second].item;
+        }
+        const value_type *operator->() const { return &operator*(); }
+
+        const_iterator& operator++() {
+            ++_stack.back().second;
+            _settle();
+            return *this;
+        }
+
+        bool operator==(const const_iterator& rhs) const {
+            if (_stack.empty() || rhs._stack.empty())
+                return _stack.empty() && rhs._stack.empty();
+            return _stack.back() == rhs._stack.back();
+        }
+
+        bool operator!=(const const_iterator& rhs) const {
+            return !operator==(rhs);
+        }
+    };
+
+    const_iterator begin() const { return const_iterator(_root.get()); }
+    const_iterator end() const { return const_iterator(); }
+
+    bool empty() const { return !_root; }
+
+    // do the maps share all the values?
+    bool sameAs(const PersistentMap& rhs) const { return _root == rhs._root; }
+
+    const ValueT *get(const KeyT& key) const {
+        uint32_t idx = _index(key);
+        const Node *n = _root.get();
+        for (unsigned level = 0; n; ++level) {
+            unsigned slot = _slot(idx, level);
+            if (!n->has(slot))
+                return nullptr;
+
+            const Entry& e = n->entries[n->position(slot)];
+            if (e.isLeaf())
+                return e.item.first == key ? &e.item.second : nullptr;
+            n = e.child.get();
+        }
+
+        return nullptr;
+    }
+
+    // get the value for the key, insert a default constructed value
+    // if the key is not in the map. The nodes on the path to the value
+    // that are shared with other maps are copied, so the value
+    // can be changed without changing other maps
+    ValueT& operator[](const KeyT& key) {
+        uint32_t idx = _index(key);
+        NodePtr *n = &_root;
+        for (unsigned level = 0; ; ++level) {
+            assert(level < LEVELS && "Different keys with the same index");
+            if (!*n)
+                *n = std::make_shared<Node>();
+            else if (n->use_count() > 1)
+                *n = std::make_shared<Node>(**n);
+
+            Node *node = n->get();
+            unsigned slot = _slot(idx, level);
+            unsigned pos = node->position(slot);
+            if (!node->has(slot)) {
+                node->bitmap |= 1u << slot;
+                auto it = node->entries.insert(node->entries.begin() + pos,
+                                               Entry{nullptr, value_type(key, ValueT())});
+                return it->item.second;
+            }
+
+            Entry& e = node->entries[pos];
+            if (e.isLeaf()) {
+                if (e.item.first == key)
+                    return e.item.second;
+
+                // move the leaf one level down
+                NodePtr child = _singleton(e.item, level + 1);
+                e.item = value_type();
+                e.child = std::move(child);
+            }
+
+            n = &e.child;
+        }
+    }
+
+    // Set the value of the key to f(mine, exclusive), where 'mine' is
+    // the current value of the key (or nullptr) and 'exclusive' says
+    // whether the value is not shared with other maps. The map is changed
+    // (and its shared nodes copied) only if the value changes.
+    template <typename F>
+    void update(const KeyT& key, F f) {
+        uint32_t idx = _index(key);
+        const ValueT *mine = nullptr;
+        bool exclusive = true;
+        const NodePtr *n = &_root;
+        for (unsigned level = 0; *n; ++level) {
+            exclusive &= n->use_count() == 1;
+            unsigned slot = _slot(idx, level);
+            if (!(*n)->has(slot))
+                break;
+
+            const Entry& e = (*n)->entries[(*n)->position(slot)];
+            if (e.isLeaf()) {
+                if (e.item.first == key)
+                    mine = &e.item.second;
+                break;
+            }
+            n = &e.child;
+        }
+
+        ValueT v = f(mine, exclusive && mine != nullptr);
+        if (mine && v == *mine)
+            return;
+
+        (*this)[key] = std::move(v);
+    }
+
+    // call f(item) for every item of this map that is not in 'old'
+    // (the key is not in 'old' or it has a different value there).
+    // The subtrees shared with 'old' are skipped, so this is cheap
+    // for maps derived one from the other.
+    template <typename F>
+    void forEachDifferent(const PersistentMap& old, F f) const {
+        _diff(_root, old._root, 0, f);
+    }
+
+    // Merge 'other' into this map. For every key of 'other' whose value
+    // differs from the value in this map, the function
+    //   ValueT f(const ValueT *mine, const ValueT& theirs, bool exclusive)
+    // is called. 'mine' is the value of the key in this map (or nullptr)
+    // and 'exclusive' says whether the value is not shared with other
+    // maps. The returned value becomes the value of the key
+    // (returning 'theirs' for a missing key shares the value).
+    template <typename F>
+    void merge(const PersistentMap& other, F f) {
+        _root = _merge(_root, other._root, 0, true, f);
+    }
+};
+
+} // namespace ADT
+} // namespace dg
+
+#endif // _DG_PERSISTENT_MAP_H_
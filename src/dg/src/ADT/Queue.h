@@ -1,35 +1,42 @@
 #ifndef _DG_ADT_QUEUE_H_
 #define _DG_ADT_QUEUE_H_
 
-#include <stack>
-#include <queue>
+#include <cassert>
+#include <cstddef>
+#include <functional>
 #include <set>
+#include <utility>
+#include <vector>
 
 namespace dg {
 namespace ADT {
 
+// stack backed by a vector, so pushing an element
+// allocates only when the vector grows
 template <typename ValueT>
 class QueueLIFO
 {
-    using ContainerT = std::stack<ValueT>;
+    using ContainerT = std::vector<ValueT>;
 
 public:
     ValueT pop()
     {
-        ValueT ret = Container.top();
-        Container.pop();
+        assert(!Container.empty() && "Pop from empty queue");
+        ValueT ret = std::move(Container.back());
+        Container.pop_back();
 
         return ret;
     }
 
     ValueT& top()
     {
-        return Container.top();
+        assert(!Container.empty() && "Top of empty queue");
+        return Container.back();
     }
 
     void push(const ValueT& what)
     {
-        Container.push(what);
+        Container.push_back(what);
     }
 
     bool empty() const
@@ -42,6 +49,16 @@ public:
         return Container.size();
     }
 
+    void reserve(size_t n)
+    {
+        Container.reserve(n);
+    }
+
+    void clear()
+    {
+        Container.clear();
+    }
+
     void swap(QueueLIFO<ValueT>& oth)
     {
         Container.swap(oth.Container);
@@ -51,47 +68,93 @@ private:
     ContainerT Container;
 };
 
+// queue in a growable ring buffer. The capacity is always a power of two,
+// so the position in the buffer is computed by masking.
+// ValueT must be default constructible.
 template <typename ValueT>
 class QueueFIFO
 {
-    using ContainerT = std::queue<ValueT>;
+    using ContainerT = std::vector<ValueT>;
+
+    ContainerT Container;
+    // index of the first element
+    size_t head{0};
+    size_t num{0};
+
+    size_t mask() const { return Container.size() - 1; }
+
+    void grow(size_t n)
+    {
+        size_t cap = Container.empty() ? 16 : Container.size();
+        while (cap < n)
+            cap *= 2;
+
+        if (cap == Container.size())
+            return;
+
+        // unwrap the elements into the new buffer
+        ContainerT tmp(cap);
+        for (size_t i = 0; i < num; ++i)
+            tmp[i] = std::move(Container[(head + i) & mask()]);
+
+        Container.swap(tmp);
+        head = 0;
+    }
+
 public:
+    using size_type = size_t;
 
     ValueT pop()
     {
-        ValueT ret = Container.front();
-        Container.pop();
+        assert(num > 0 && "Pop from empty queue");
+        ValueT ret = std::move(Container[head]);
+        head = (head + 1) & mask();
+        --num;
 
         return ret;
     }
 
     ValueT& top()
     {
-        return Container.top();
+        assert(num > 0 && "Top of empty queue");
+        return Container[head];
     }
 
     void push(const ValueT& what)
     {
-        Container.push(what);
+        if (num == Container.size())
+            grow(num + 1);
+
+        Container[(head + num) & mask()] = what;
+        ++num;
     }
 
     bool empty() const
     {
-        return Container.empty();
+        return num == 0;
     }
 
-    typename ContainerT::size_type size() const
+    size_type size() const
     {
-        return Container.size();
+        return num;
+    }
+
+    void reserve(size_t n)
+    {
+        grow(n);
+    }
+
+    void clear()
+    {
+        head = num = 0;
     }
 
     void swap(QueueFIFO<ValueT>& oth)
     {
         Container.swap(oth.Container);
+        std::swap(head, oth.head);
+        std::swap(num, oth.num);
     }
-
-private:
-    ContainerT Container;
 };
 
 template <typename ValueT, typename Comp>
@@ -126,6 +189,192 @@ private:
     ContainerT Container;
 };
 
+// get the index of a node into the heap - the ID of the node
+template <typename ValueT>
+struct GetNodeID
+{
+    unsigned operator()(const ValueT& v) const
+    {
+        return v->getID();
+    }
+};
+
+// Binary heap of elements with priorities. The elements are identified
+// by an index (the ID of a node by default) and every element is
+// in the heap at most once: pushing an element that is already
+// in the heap only updates its priority if the new one is better.
+// The element with the best (the smallest w.r.t. Comp) priority
+// is popped first. The heap keeps a table indexed by the IDs of elements,
+// so the IDs should be dense.
+template <typename ValueT, typename PriorityT = unsigned,
+          typename Comp = std::less<PriorityT>,
+          typename GetIndex = GetNodeID<ValueT>>
+class IndexedHeap
+{
+    struct Item {
+        ValueT value;
+        PriorityT priority;
+
+        Item(const ValueT& v, const PriorityT& p) : value(v), priority(p) {}
+    };
+
+    static const size_t NOT_IN_HEAP = ~static_cast<size_t>(0);
+
+    std::vector<Item> heap;
+    // index of element -> position in the heap
+    std::vector<size_t> positions;
+    Comp comp;
+    GetIndex getIndex;
+
+    size_t& position(const ValueT& v)
+    {
+        unsigned idx = getIndex(v);
+        if (idx >= positions.size())
+            positions.resize(idx + 1, NOT_IN_HEAP);
+
+        return positions[idx];
+    }
+
+    void place(size_t pos, Item&& item)
+    {
+        position(item.value) = pos;
+        heap[pos] = std::move(item);
+    }
+
+    void siftUp(size_t pos)
+    {
+        Item item = std::move(heap[pos]);
+        while (pos > 0) {
+            size_t parent = (pos - 1) / 2;
+            if (!comp(item.priority, heap[parent].priority))
+                break;
+
+            place(pos, std::move(heap[parent]));
+            pos = parent;
+        }
+
+        place(pos, std::move(item));
+    }
+
+    void siftDown(size_t pos)
+    {
+        Item item = std::move(heap[pos]);
+        size_t n = heap.size();
+        while (2 * pos + 1 < n) {
+            size_t child = 2 * pos + 1;
+            if (child + 1 < n && comp(heap[child + 1].priority, heap[child].priority))
+                ++child;
+
+            if (!comp(heap[child].priority, item.priority))
+                break;
+
+            place(pos, std::move(heap[child]));
+            pos = child;
+        }
+
+        place(pos, std::move(item));
+    }
+
+public:
+    IndexedHeap(const Comp& c = Comp(), const GetIndex& gi = GetIndex())
+    : comp(c), getIndex(gi) {}
+
+    // push the element or improve its priority if it is already
+    // in the heap. Return true if the element was not in the heap
+    bool push(const ValueT& what, const PriorityT& prio)
+    {
+        size_t pos = position(what);
+        if (pos == NOT_IN_HEAP) {
+            heap.emplace_back(what, prio);
+            siftUp(heap.size() - 1);
+            return true;
+        }
+
+        if (comp(prio, heap[pos].priority)) {
+            heap[pos].priority = prio;
+            siftUp(pos);
+        }
+
+        return false;
+    }
+
+    // set the priority of an element that is in the heap
+    // (can make the priority both better and worse)
+    void update(const ValueT& what, const PriorityT& prio)
+    {
+        size_t pos = position(what);
+        assert(pos != NOT_IN_HEAP && "The element is not in the heap");
+
+        bool better = comp(prio, heap[pos].priority);
+        heap[pos].priority = prio;
+        if (better)
+            siftUp(pos);
+        else
+            siftDown(pos);
+    }
+
+    ValueT pop()
+    {
+        assert(!heap.empty() && "Pop from empty heap");
+        ValueT ret = std::move(heap[0].value);
+        position(ret) = NOT_IN_HEAP;
+
+        if (heap.size() > 1) {
+            heap[0] = std::move(heap.back());
+            heap.pop_back();
+            siftDown(0);
+        } else {
+            heap.pop_back();
+        }
+
+        return ret;
+    }
+
+    const ValueT& top() const
+    {
+        assert(!heap.empty() && "Top of empty heap");
+        return heap[0].value;
+    }
+
+    const PriorityT& topPriority() const
+    {
+        assert(!heap.empty() && "Top of empty heap");
+        return heap[0].priority;
+    }
+
+    bool contains(const ValueT& what) const
+    {
+        unsigned idx = getIndex(what);
+        return idx < positions.size() && positions[idx] != NOT_IN_HEAP;
+    }
+
+    const PriorityT& getPriority(const ValueT& what) const
+    {
+        assert(contains(what) && "The element is not in the heap");
+        return heap[positions[getIndex(what)]].priority;
+    }
+
+    bool empty() const
+    {
+        return heap.empty();
+    }
+
+    size_t size() const
+    {
+        return heap.size();
+    }
+
+    void clear()
+    {
+        for (auto& item : heap)
+            position(item.value) = NOT_IN_HEAP;
+        heap.clear();
+    }
+};
+
+template <typename ValueT, typename PriorityT, typename Comp, typename GetIndex>
+const size_t IndexedHeap<ValueT, PriorityT, Comp, GetIndex>::NOT_IN_HEAP;
+
 } // namespace ADT
 } // namespace dg
 
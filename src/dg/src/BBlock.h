@@ -6,6 +6,7 @@
 
 #include <cassert>
 #include <list>
+#include <vector>
 
 #include "ADT/DGContainer.h"
 #include "analysis/Analysis.h"
@@ -28,7 +29,7 @@ public:
     using DependenceGraphT = typename NodeT::DependenceGraphType;
 
     struct BBlockEdge {
-        BBlockEdge(BBlock<NodeT>* t, uint8_t label = 0)
+        BBlockEdge(BBlock<NodeT>* t = nullptr, uint8_t label = 0)
             : target(t), label(label) {}
 
         BBlock<NodeT> *target;
@@ -153,22 +154,27 @@ public:
             // and create new edges to all successors. The new edges
             // will have the same label as the found one
             DGContainer<BBlockEdge> new_edges;
-            for (auto I = pred->nextBBs.begin(),E = pred->nextBBs.end(); I != E;) {
-                auto cur = I++;
-                if (cur->target == this) {
-                    // create edges that will go from the predecessor
-                    // to every successor of this node
-                    for (const BBlockEdge& succ : nextBBs) {
-                        // we cannot create an edge to this bblock (we're isolating _this_ bblock),
-                        // that would be incorrect. It can occur when we're isolatin a bblock
-                        // with self-loop
-                        if (succ.target != this)
-                            new_edges.insert(BBlockEdge(succ.target, cur->label));
-                    }
-
-                    // remove the edge from predecessor
-                    pred->nextBBs.erase(*cur);
+            // gather the edges first, erasing may invalidate
+            // the iterators of the container
+            std::vector<BBlockEdge> edges_to_this;
+            for (const BBlockEdge& edge : pred->nextBBs) {
+                if (edge.target == this)
+                    edges_to_this.push_back(edge);
+            }
+
+            for (const BBlockEdge& cur : edges_to_this) {
+                // create edges that will go from the predecessor
+                // to every successor of this node
+                for (const BBlockEdge& succ : nextBBs) {
+                    // we cannot create an edge to this bblock (we're isolating _this_ bblock),
+                    // that would be incorrect. It can occur when we're isolatin a bblock
+                    // with self-loop
+                    if (succ.target != this)
+                        new_edges.insert(BBlockEdge(succ.target, cur.label));
                 }
+
+                // remove the edge from predecessor
+                pred->nextBBs.erase(cur);
             }
 
             // add newly created edges to predecessor
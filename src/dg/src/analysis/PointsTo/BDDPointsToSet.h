@@ -0,0 +1,673 @@
+#ifndef _DG_BDD_POINTS_TO_SET_H_
+#define _DG_BDD_POINTS_TO_SET_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Pointer.h"
+
+namespace dg {
+namespace analysis {
+namespace pta {
+
+// Table of nodes of reduced ordered binary decision diagrams
+// that represent sets of pointers. A pointer (target, offset) is encoded
+// as TARGET_BITS bits of a dense index of the target followed by
+// OFFSET_BITS bits of the offset (the most significant bits first),
+// so the elements of a set are enumerated sorted by (index, offset).
+// The indices of targets are given in the order in which
+// the targets are seen for the first time.
+//
+// Nodes are hash-consed (every node is stored only once), so equal
+// sets have the same root. Results of the operations are kept in
+// a fixed-size (lossy) cache, so the memory used by the cache is bounded.
+//
+// The sets hold references to their roots. When the table has grown
+// enough, the nodes that are not reachable from any referenced root
+// are freed (mark & sweep) and reused. This may happen only in collect(),
+// so the nodes that are not referenced yet stay valid in the middle
+// of an operation. When the last reference is released, the whole table
+// is emptied (including the indices of targets).
+// NOTE: the table is not thread-safe.
+class BDDTable {
+public:
+    using NodeIDT = uint32_t;
+
+    static const unsigned TARGET_BITS = 32;
+    static const unsigned OFFSET_BITS = 64;
+    static const unsigned VARS_NUM = TARGET_BITS + OFFSET_BITS;
+
+    // terminal nodes
+    static const NodeIDT ZERO = 0;
+    static const NodeIDT ONE = 1;
+
+private:
+    // the variable of free nodes
+    static const uint32_t FREE = ~static_cast<uint32_t>(0);
+    // do not collect garbage in tables smaller than this
+    static const size_t MIN_NODES = 1 << 16;
+
+    struct Node {
+        uint32_t var;
+        NodeIDT low;
+        NodeIDT high;
+        // the next node in the bucket of the unique table
+        // or the next free node (0 terminates both the lists)
+        NodeIDT next;
+        // the number of references to this node as to a root of a set
+        uint32_t refs;
+    };
+
+    enum class Op : uint32_t { OR = 1, ANDNOT, COUNT };
+
+    struct CacheEntry {
+        Op op;
+        NodeIDT a, b;
+        // entries from before the last garbage collection are invalid
+        uint32_t epoch;
+        uint64_t result;
+    };
+
+    static const size_t CACHE_SIZE = 1 << 16;
+
+    std::vector<Node> nodes;
+    // heads of the buckets of the unique table (the size is a power of 2)
+    std::vector<NodeIDT> buckets;
+    NodeIDT freeNodes{0};
+    size_t liveNodes{0};
+    size_t collectAt{MIN_NODES};
+    // the number of references to all roots
+    size_t refsNum{0};
+
+    std::vector<CacheEntry> cache;
+    uint32_t epoch{1};
+
+    std::unordered_map<PSNode *, uint32_t> targetIndex;
+    std::vector<PSNode *> targets;
+
+    BDDTable() : cache(CACHE_SIZE, CacheEntry{Op::OR, 0, 0, 0, 0}) {
+        init();
+    }
+
+    void init() {
+        // terminals are below all the variables
+        nodes.clear();
+        nodes.push_back(Node{VARS_NUM, ZERO, ZERO, 0, 0});
+        nodes.push_back(Node{VARS_NUM, ONE, ONE, 0, 0});
+        buckets.assign(1024, 0);
+        freeNodes = 0;
+        liveNodes = 2;
+        collectAt = MIN_NODES;
+        ++epoch;
+    }
+
+    size_t hash(uint32_t var, NodeIDT low, NodeIDT high) const {
+        uint64_t h = (static_cast<uint64_t>(low) << 32) | high;
+        h = (h ^ (static_cast<uint64_t>(var) << 48)) * 0x9e3779b97f4a7c15ULL;
+        return static_cast<size_t>(h >> 32) & (buckets.size() - 1);
+    }
+
+    void link(NodeIDT n) {
+        auto& head = buckets[hash(nodes[n].var, nodes[n].low, nodes[n].high)];
+        nodes[n].next = head;
+        head = n;
+    }
+
+    void rehash(size_t size) {
+        buckets.assign(size, 0);
+        for (NodeIDT n = 2; n < nodes.size(); ++n) {
+            if (nodes[n].var != FREE)
+                link(n);
+        }
+    }
+
+    CacheEntry& cacheEntry(Op op, NodeIDT a, NodeIDT b) {
+        uint64_t h = ((static_cast<uint64_t>(a) << 32) | b) * 0x9e3779b97f4a7c15ULL;
+        h ^= static_cast<uint64_t>(op);
+        return cache[(h >> 32) % CACHE_SIZE];
+    }
+
+    bool cached(Op op, NodeIDT a, NodeIDT b, uint64_t& result) {
+        const CacheEntry& e = cacheEntry(op, a, b);
+        if (e.op == op && e.a == a && e.b == b && e.epoch == epoch) {
+            result = e.result;
+            return true;
+        }
+
+        return false;
+    }
+
+    void store(Op op, NodeIDT a, NodeIDT b, uint64_t result) {
+        cacheEntry(op, a, b) = CacheEntry{op, a, b, epoch, result};
+    }
+
+    // get the node (var, low, high), keep the diagram reduced
+    NodeIDT mk(uint32_t var, NodeIDT low, NodeIDT high) {
+        if (low == high)
+            return low;
+
+        for (NodeIDT n = buckets[hash(var, low, high)]; n != 0; n = nodes[n].next) {
+            const Node& node = nodes[n];
+            if (node.var == var && node.low == low && node.high == high)
+                return n;
+        }
+
+        NodeIDT id;
+        if (freeNodes != 0) {
+            id = freeNodes;
+            freeNodes = nodes[id].next;
+            nodes[id] = Node{var, low, high, 0, 0};
+        } else {
+            id = static_cast<NodeIDT>(nodes.size());
+            nodes.push_back(Node{var, low, high, 0, 0});
+        }
+
+        ++liveNodes;
+        if (liveNodes > buckets.size())
+            rehash(2 * buckets.size());
+        else
+            link(id);
+
+        return id;
+    }
+
+    static bool bit(uint64_t idx, uint64_t off, unsigned var) {
+        if (var < TARGET_BITS)
+            return (idx >> (TARGET_BITS - 1 - var)) & 0x1;
+        return (off >> (VARS_NUM - 1 - var)) & 0x1;
+    }
+
+    // the set n with the element (idx, off) added,
+    // n must be at the level 'var' or below
+    NodeIDT insert(NodeIDT n, uint64_t idx, uint64_t off, unsigned var) {
+        if (var == VARS_NUM)
+            return ONE;
+
+        NodeIDT low = getChild(n, var, false);
+        NodeIDT high = getChild(n, var, true);
+        if (bit(idx, off, var))
+            high = insert(high, idx, off, var + 1);
+        else
+            low = insert(low, idx, off, var + 1);
+
+        return mk(var, low, high);
+    }
+
+    // free the nodes that are not reachable from any referenced root
+    void sweep() {
+        std::vector<bool> marked(nodes.size(), false);
+        std::vector<NodeIDT> stack;
+        for (NodeIDT n = 2; n < nodes.size(); ++n) {
+            if (nodes[n].var != FREE && nodes[n].refs > 0)
+                stack.push_back(n);
+        }
+
+        while (!stack.empty()) {
+            NodeIDT n = stack.back();
+            stack.pop_back();
+            if (n <= ONE || marked[n])
+                continue;
+
+            marked[n] = true;
+            stack.push_back(nodes[n].low);
+            stack.push_back(nodes[n].high);
+        }
+
+        // drop the unreachable nodes at the end of the table
+        // and put the rest of them to the list of free nodes
+        // (from the end, so that the small IDs are reused first)
+        NodeIDT last = static_cast<NodeIDT>(nodes.size()) - 1;
+        while (last > ONE && !marked[last])
+            --last;
+        nodes.resize(last + 1);
+
+        freeNodes = 0;
+        liveNodes = 2;
+        for (NodeIDT n = last; n > ONE; --n) {
+            if (marked[n]) {
+                ++liveNodes;
+                continue;
+            }
+
+            nodes[n].var = FREE;
+            nodes[n].next = freeNodes;
+            freeNodes = n;
+        }
+
+        rehash(buckets.size());
+        // the cache may refer to the freed nodes
+        ++epoch;
+    }
+
+public:
+    BDDTable(const BDDTable&) = delete;
+    BDDTable& operator=(const BDDTable&) = delete;
+
+    static BDDTable& get() {
+        // never destroyed, the sets in static objects
+        // may release their references at exit
+        static BDDTable *table = new BDDTable();
+        return *table;
+    }
+
+    void acquire(NodeIDT n) {
+        if (n <= ONE)
+            return;
+        ++nodes[n].refs;
+        ++refsNum;
+    }
+
+    void release(NodeIDT n) {
+        if (n <= ONE)
+            return;
+
+        assert(nodes[n].refs > 0);
+        --nodes[n].refs;
+        if (--refsNum > 0)
+            return;
+
+        // no set is alive, start from scratch
+        if (nodes.size() > MIN_NODES) {
+            std::vector<Node>().swap(nodes);
+            std::vector<NodeIDT>().swap(buckets);
+            std::unordered_map<PSNode *, uint32_t>().swap(targetIndex);
+            std::vector<PSNode *>().swap(targets);
+        } else {
+            targetIndex.clear();
+            targets.clear();
+        }
+        init();
+    }
+
+    // free the unreferenced nodes if there are too many nodes.
+    // All nodes that are not reachable from a referenced root
+    // are invalid after calling this method.
+    void collect() {
+        if (liveNodes < collectAt)
+            return;
+
+        sweep();
+        collectAt = 2 * liveNodes;
+        if (collectAt < MIN_NODES)
+            collectAt = MIN_NODES;
+    }
+
+    uint32_t getVar(NodeIDT n) const { return nodes[n].var; }
+    NodeIDT getLow(NodeIDT n) const { return nodes[n].low; }
+    NodeIDT getHigh(NodeIDT n) const { return nodes[n].high; }
+
+    // the successor of the node for the given value of the variable
+    // (nodes that are below the variable do not depend on it)
+    NodeIDT getChild(NodeIDT n, unsigned var, bool value) const {
+        if (nodes[n].var != var)
+            return n;
+        return value ? nodes[n].high : nodes[n].low;
+    }
+
+    uint32_t getTargetIndex(PSNode *target) {
+        auto it = targetIndex.find(target);
+        if (it != targetIndex.end())
+            return it->second;
+
+        uint32_t idx = static_cast<uint32_t>(targets.size());
+        targets.push_back(target);
+        targetIndex.emplace(target, idx);
+        return idx;
+    }
+
+    PSNode *getTarget(uint32_t idx) const {
+        assert(idx < targets.size());
+        return targets[idx];
+    }
+
+    // the set n with the pointer (target, offset) added
+    NodeIDT insert(NodeIDT n, PSNode *target, Offset off) {
+        return insert(n, getTargetIndex(target), *off, 0);
+    }
+
+    // the set {(target, offset)}
+    NodeIDT singleton(PSNode *target, Offset off) {
+        return insert(ZERO, target, off);
+    }
+
+    // the set {(target, x) | x is any offset}
+    NodeIDT allOffsets(PSNode *target) {
+        uint64_t idx = getTargetIndex(target);
+        NodeIDT n = ONE;
+        for (unsigned var = TARGET_BITS; var > 0; --var) {
+            if (bit(idx, 0, var - 1))
+                n = mk(var - 1, ZERO, n);
+            else
+                n = mk(var - 1, n, ZERO);
+        }
+
+        return n;
+    }
+
+    bool contains(NodeIDT n, PSNode *target, Offset off) {
+        auto it = targetIndex.find(target);
+        if (it == targetIndex.end())
+            return false;
+
+        uint64_t idx = it->second;
+        while (n > ONE) {
+            unsigned var = nodes[n].var;
+            n = bit(idx, *off, var) ? nodes[n].high : nodes[n].low;
+        }
+
+        return n == ONE;
+    }
+
+    NodeIDT unite(NodeIDT a, NodeIDT b) {
+        if (a == b || b == ZERO)
+            return a;
+        if (a == ZERO)
+            return b;
+        if (a == ONE || b == ONE)
+            return ONE;
+
+        // union is commutative
+        if (a > b)
+            std::swap(a, b);
+
+        uint64_t result;
+        if (cached(Op::OR, a, b, result))
+            return static_cast<NodeIDT>(result);
+
+        unsigned var = std::min(nodes[a].var, nodes[b].var);
+        NodeIDT low = unite(getChild(a, var, false), getChild(b, var, false));
+        NodeIDT high = unite(getChild(a, var, true), getChild(b, var, true));
+        NodeIDT n = mk(var, low, high);
+
+        store(Op::OR, a, b, n);
+        return n;
+    }
+
+    // a \ b
+    NodeIDT subtract(NodeIDT a, NodeIDT b) {
+        if (a == ZERO || b == ONE || a == b)
+            return ZERO;
+        if (b == ZERO)
+            return a;
+
+        uint64_t result;
+        if (cached(Op::ANDNOT, a, b, result))
+            return static_cast<NodeIDT>(result);
+
+        // a may be ONE here, that is the node below all variables
+        unsigned var = std::min(nodes[a].var, nodes[b].var);
+        NodeIDT low = subtract(getChild(a, var, false), getChild(b, var, false));
+        NodeIDT high = subtract(getChild(a, var, true), getChild(b, var, true));
+        NodeIDT n = mk(var, low, high);
+
+        store(Op::ANDNOT, a, b, n);
+        return n;
+    }
+
+    // c * 2^bits, saturated to UINT64_MAX (the shift of 64 or more
+    // bits is undefined and ZERO is below all the variables)
+    static uint64_t shift(uint64_t c, unsigned bits) {
+        if (c == 0)
+            return 0;
+        if (bits >= 64 || c > (UINT64_MAX >> bits))
+            return UINT64_MAX;
+        return c << bits;
+    }
+
+    static uint64_t saturatedAdd(uint64_t a, uint64_t b) {
+        return a > UINT64_MAX - b ? UINT64_MAX : a + b;
+    }
+
+    // the number of elements of the set represented by
+    // the node n (counted from the level of the node)
+    uint64_t count(NodeIDT n) {
+        if (n <= ONE)
+            return n;
+
+        uint64_t result;
+        if (cached(Op::COUNT, n, 0, result))
+            return result;
+
+        unsigned var = nodes[n].var;
+        NodeIDT low = nodes[n].low;
+        NodeIDT high = nodes[n].high;
+        // skipped variables can have any value
+        result = saturatedAdd(shift(count(low), nodes[low].var - var - 1),
+                              shift(count(high), nodes[high].var - var - 1));
+
+        store(Op::COUNT, n, 0, result);
+        return result;
+    }
+
+    // the number of elements of the set with the root n
+    // (UINT64_MAX if the number does not fit into 64 bits)
+    uint64_t size(NodeIDT n) {
+        return shift(count(n), nodes[n].var);
+    }
+
+    // the number of (live) nodes in the table
+    size_t nodesNum() const { return liveNodes; }
+};
+
+// Points-to set represented by a binary decision diagram.
+// The set is just a reference to the root node in the BDDTable,
+// so copying and comparing sets is cheap and equal sets share
+// all their nodes. This keeps the memory bounded even for huge
+// sets of pointers that differ only a bit.
+class BDDPointsToSet {
+    using TableT = BDDTable;
+    TableT::NodeIDT root{TableT::ZERO};
+
+    // replace the root by the node 'newRoot'
+    bool reset(TableT::NodeIDT newRoot) {
+        if (newRoot == root)
+            return false;
+
+        TableT& T = TableT::get();
+        T.acquire(newRoot);
+        T.release(root);
+        root = newRoot;
+        return true;
+    }
+
+    bool addWithUnknownOffset(PSNode *target) {
+        TableT& T = TableT::get();
+        if (T.contains(root, target, Offset::UNKNOWN))
+            return false;
+
+        T.collect();
+        // get rid of other offsets and keep
+        // only the unknown offset
+        auto n = T.subtract(root, T.allOffsets(target));
+        return reset(T.insert(n, target, Offset::UNKNOWN));
+    }
+
+public:
+    BDDPointsToSet() = default;
+    BDDPointsToSet(const BDDPointsToSet& rhs) : root(rhs.root) {
+        TableT::get().acquire(root);
+    }
+    BDDPointsToSet(BDDPointsToSet&& rhs) : root(rhs.root) {
+        rhs.root = TableT::ZERO;
+    }
+    ~BDDPointsToSet() { TableT::get().release(root); }
+
+    BDDPointsToSet& operator=(const BDDPointsToSet& rhs) {
+        reset(rhs.root);
+        return *this;
+    }
+
+    BDDPointsToSet& operator=(BDDPointsToSet&& rhs) {
+        swap(rhs);
+        return *this;
+    }
+
+    bool add(PSNode *target, Offset off) {
+        if (off.isUnknown())
+            return addWithUnknownOffset(target);
+
+        TableT& T = TableT::get();
+        // if we have the same pointer but with unknown offset,
+        // do nothing
+        if (T.contains(root, target, Offset::UNKNOWN))
+            return false;
+
+        T.collect();
+        // inserting a pointer that is already in the set
+        // gives the same root
+        return reset(T.insert(root, target, off));
+    }
+
+    bool add(const Pointer& ptr) {
+        return add(ptr.target, ptr.offset);
+    }
+
+    // make union of the two sets and store it
+    // into 'this' set (i.e. merge rhs to this set)
+    bool merge(const BDDPointsToSet& rhs) {
+        TableT& T = TableT::get();
+        T.collect();
+        return reset(T.unite(root, rhs.root));
+    }
+
+    bool empty() const { return root == TableT::ZERO; }
+
+    size_t count(const Pointer& ptr) const {
+        return TableT::get().contains(root, ptr.target, ptr.offset);
+    }
+
+    bool has(const Pointer& ptr) const {
+        return count(ptr) > 0;
+    }
+
+    size_t size() const { return TableT::get().size(root); }
+
+    void swap(BDDPointsToSet& rhs) { std::swap(root, rhs.root); }
+
+    bool operator==(const BDDPointsToSet& rhs) const { return root == rhs.root; }
+    bool operator!=(const BDDPointsToSet& rhs) const { return root != rhs.root; }
+
+    // Enumerates the paths to the ONE terminal. The nodes are immutable
+    // and the iterator holds a reference to the root, so adding to the set
+    // while iterating over it is safe (the iteration goes over the old
+    // version of the set).
+    class const_iterator {
+        // the node and the value of the variable on every level
+        struct Frame {
+            TableT::NodeIDT node;
+            uint8_t value;
+        };
+
+        TableT::NodeIDT root{TableT::ZERO};
+        std::vector<Frame> frames;
+        unsigned depth{0};
+
+        const_iterator(TableT::NodeIDT root) : root(root) {
+            if (root == TableT::ZERO)
+                return;
+
+            TableT::get().acquire(root);
+
+            frames.resize(TableT::VARS_NUM + 1);
+            frames[0] = Frame{root, 0};
+            _findNext();
+        }
+
+        // descend to the next path to the ONE terminal
+        // starting from the current frame
+        void _findNext() {
+            const TableT& T = TableT::get();
+            while (depth < TableT::VARS_NUM) {
+                Frame& f = frames[depth];
+                if (f.value > 1) {
+                    // both values of this variable were explored
+                    if (depth == 0) {
+                        frames.clear();
+                        return;
+                    }
+
+                    ++frames[--depth].value;
+                    continue;
+                }
+
+                auto child = T.getChild(f.node, depth, f.value);
+                if (child == TableT::ZERO) {
+                    ++f.value;
+                    continue;
+                }
+
+                frames[++depth] = Frame{child, 0};
+            }
+
+            assert(frames[depth].node == TableT::ONE);
+        }
+
+    public:
+        const_iterator() = default;
+        const_iterator(const const_iterator& rhs)
+        : root(rhs.root), frames(rhs.frames), depth(rhs.depth) {
+            TableT::get().acquire(root);
+        }
+        ~const_iterator() { TableT::get().release(root); }
+
+        const_iterator& operator=(const const_iterator& rhs) {
+            TableT::get().acquire(rhs.root);
+            TableT::get().release(root);
+            root = rhs.root;
+            frames = rhs.frames;
+            depth = rhs.depth;
+            return *this;
+        }
+
+        const_iterator& operator++() {
+            assert(!frames.empty() && "Incrementing end iterator");
+            ++frames[--depth].value;
+            _findNext();
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            auto tmp = *this;
+            operator++();
+            return tmp;
+        }
+
+        Pointer operator*() const {
+            uint64_t idx = 0, off = 0;
+            for (unsigned var = 0; var < TableT::TARGET_BITS; ++var)
+                idx = (idx << 1) | frames[var].value;
+            for (unsigned var = TableT::TARGET_BITS; var < TableT::VARS_NUM; ++var)
+                off = (off << 1) | frames[var].value;
+
+            return Pointer(TableT::get().getTarget(idx), off);
+        }
+
+        bool operator==(const const_iterator& rhs) const {
+            if (frames.empty() || rhs.frames.empty())
+                return frames.empty() == rhs.frames.empty();
+
+            for (unsigned var = 0; var < TableT::VARS_NUM; ++var)
+                if (frames[var].value != rhs.frames[var].value)
+                    return false;
+            return true;
+        }
+
+        bool operator!=(const const_iterator& rhs) const {
+            return !operator==(rhs);
+        }
+
+        friend class BDDPointsToSet;
+    };
+
+    const_iterator begin() const { return const_iterator(root); }
+    const_iterator end() const { return const_iterator(); }
+};
+
+} // namespace pta
+} // namespace analysis
+} // namespace dg
+
+#endif // _DG_BDD_POINTS_TO_SET_H_
@@ -0,0 +1,228 @@
+#ifndef _DG_ID_POINTS_TO_SET_H_
+#define _DG_ID_POINTS_TO_SET_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "Pointer.h"
+#include "ADT/Bitvector.h"
+
+namespace dg {
+namespace analysis {
+namespace pta {
+
+// Points-to set that identifies the targets by their dense global IDs
+// (NodeT::getGlobalID()) instead of by their addresses.
+// PSNode has the global IDs only with ENABLE_ID_POINTS_TO_SETS.
+// A pointer (target, offset) is encoded into a single number
+// (ID << 32) | offset, so the whole set is just sparse bitvectors
+// and the sets are merged word by word. Pointers with offset 0
+// and Offset::UNKNOWN are the most common ones, so these are kept
+// in separate bitvectors indexed by the ID.
+// The pointers are iterated sorted by the ID of the target and the offset,
+// so the iteration order does not depend on the addresses of nodes.
+//
+// Offsets that do not fit into 32 bits are treated as Offset::UNKNOWN
+// (the analysis makes such offsets unknown anyway, they are beyond
+// the size of any object).
+// It is a template only to postpone the use of PSNode until it is defined.
+template <typename NodeT>
+class IDPointsToSetImpl {
+    using BitvectorT = ADT::SparseBitvector;
+
+    static const uint64_t OFFSET_BITS = 32;
+    static const uint64_t UNKNOWN_SLOT = (static_cast<uint64_t>(1) << OFFSET_BITS) - 1;
+
+    // IDs of targets that are pointed to with offset 0
+    BitvectorT zeros;
+    // IDs of targets that are pointed to with unknown offset
+    BitvectorT unknowns;
+    // encoded pointers with other offsets
+    BitvectorT pointers;
+
+    static uint64_t encode(unsigned id, uint64_t off) {
+        assert(off != 0 && off < UNKNOWN_SLOT);
+        return (static_cast<uint64_t>(id) << OFFSET_BITS) | off;
+    }
+
+    // unlike the other sets, this one rejects a nullptr target
+    // (there is no global ID for it)
+    static unsigned getID(NodeT *target) {
+        assert(target && "Cannot have a pointer with nullptr as target");
+        return target->getGlobalID();
+    }
+
+    static bool isUnknown(Offset off) {
+        return *off >= UNKNOWN_SLOT;
+    }
+
+    bool addWithUnknownOffset(unsigned id) {
+        if (unknowns.get(id))
+            return false;
+
+        // get rid of other offsets and keep
+        // only the unknown offset
+        zeros.unset(id);
+
+        BitvectorT other;
+        for (auto x : pointers) {
+            if ((x >> OFFSET_BITS) == id)
+                other.set(x);
+        }
+        pointers.subtract(other);
+
+        unknowns.set(id);
+        return true;
+    }
+
+public:
+    bool add(NodeT *target, Offset off) {
+        unsigned id = getID(target);
+        if (isUnknown(off))
+            return addWithUnknownOffset(id);
+
+        if (unknowns.get(id))
+            return false;
+
+        if (off.isZero())
+            return !zeros.set(id);
+
+        return !pointers.set(encode(id, *off));
+    }
+
+    bool add(const Pointer& ptr) {
+        return add(ptr.target, ptr.offset);
+    }
+
+    // make union of the two sets and store it
+    // into 'this' set (i.e. merge rhs to this set)
+    bool merge(const IDPointsToSetImpl& rhs) {
+        bool changed = zeros.merge(rhs.zeros);
+        changed |= unknowns.merge(rhs.unknowns);
+        changed |= pointers.merge(rhs.pointers);
+        return changed;
+    }
+
+    bool empty() const {
+        return zeros.empty() && unknowns.empty() && pointers.empty();
+    }
+
+    size_t count(const Pointer& ptr) const {
+        unsigned id = getID(ptr.target);
+        if (isUnknown(ptr.offset))
+            return unknowns.get(id);
+        if (ptr.offset.isZero())
+            return zeros.get(id);
+
+        return pointers.get(encode(id, *ptr.offset));
+    }
+
+    bool has(const Pointer& ptr) const {
+        return count(ptr) > 0;
+    }
+
+    size_t size() const {
+        return zeros.size() + unknowns.size() + pointers.size();
+    }
+
+    void swap(IDPointsToSetImpl& rhs) {
+        zeros.swap(rhs.zeros);
+        unknowns.swap(rhs.unknowns);
+        pointers.swap(rhs.pointers);
+    }
+
+    bool operator==(const IDPointsToSetImpl& rhs) const {
+        return zeros == rhs.zeros && unknowns == rhs.unknowns &&
+               pointers == rhs.pointers;
+    }
+
+    bool operator!=(const IDPointsToSetImpl& rhs) const {
+        return !operator==(rhs);
+    }
+
+    // merges the three bitvectors in the order of encoded pointers
+    class const_iterator {
+        BitvectorT::const_iterator zerosIt, zerosEnd;
+        BitvectorT::const_iterator pointersIt, pointersEnd;
+        BitvectorT::const_iterator unknownsIt, unknownsEnd;
+
+        static const uint64_t END = ~static_cast<uint64_t>(0);
+
+        const_iterator(const IDPointsToSetImpl& S, bool end = false)
+        : zerosIt(end ? S.zeros.end() : S.zeros.begin()), zerosEnd(S.zeros.end()),
+          pointersIt(end ? S.pointers.end() : S.pointers.begin()),
+          pointersEnd(S.pointers.end()),
+          unknownsIt(end ? S.unknowns.end() : S.unknowns.begin()),
+          unknownsEnd(S.unknowns.end()) {}
+
+        uint64_t zerosKey() const {
+            return zerosIt == zerosEnd ? END : (*zerosIt << OFFSET_BITS);
+        }
+
+        uint64_t pointersKey() const {
+            return pointersIt == pointersEnd ? END : *pointersIt;
+        }
+
+        uint64_t unknownsKey() const {
+            return unknownsIt == unknownsEnd ?
+                    END : ((*unknownsIt << OFFSET_BITS) | UNKNOWN_SLOT);
+        }
+
+        uint64_t key() const {
+            return std::min(zerosKey(), std::min(pointersKey(), unknownsKey()));
+        }
+
+    public:
+        const_iterator& operator++() {
+            uint64_t k = key();
+            assert(k != END && "Incrementing end iterator");
+            // the keys in the bitvectors are disjoint
+            if (k == zerosKey())
+                ++zerosIt;
+            else if (k == pointersKey())
+                ++pointersIt;
+            else
+                ++unknownsIt;
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            auto tmp = *this;
+            operator++();
+            return tmp;
+        }
+
+        Pointer operator*() const {
+            uint64_t k = key();
+            assert(k != END && "Dereferencing end iterator");
+            uint64_t off = k & UNKNOWN_SLOT;
+            return Pointer(NodeT::getByGlobalID(k >> OFFSET_BITS),
+                           off == UNKNOWN_SLOT ? Offset::UNKNOWN : off);
+        }
+
+        bool operator==(const const_iterator& rhs) const {
+            return zerosIt == rhs.zerosIt && pointersIt == rhs.pointersIt &&
+                   unknownsIt == rhs.unknownsIt;
+        }
+
+        bool operator!=(const const_iterator& rhs) const {
+            return !operator==(rhs);
+        }
+
+        friend class IDPointsToSetImpl;
+    };
+
+    const_iterator begin() const { return const_iterator(*this); }
+    const_iterator end() const { return const_iterator(*this, true /* end */); }
+};
+
+class PSNode;
+using IDPointsToSet = IDPointsToSetImpl<PSNode>;
+
+} // namespace pta
+} // namespace analysis
+} // namespace dg
+
+#endif // _DG_ID_POINTS_TO_SET_H_
@@ -2,8 +2,15 @@
 #define _DG_PS_NODE_H_
 
 #include <cassert>
-#include <cstdarg>
 #include <string>
+#include <vector>
+
+#ifdef ENABLE_ID_POINTS_TO_SETS
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <queue>
+#endif
 
 #include "Pointer.h"
 #include "PointsToSet.h"
@@ -122,11 +129,86 @@ class PSNode : public SubgraphNode<PSNode>
 
     unsigned int dfsid = 0;
 
+#ifdef ENABLE_ID_POINTS_TO_SETS
+    // ID of the node unique among all living PSNodes. The SubgraphNode's ID
+    // is unique only in one PointerSubgraph, but points-to sets
+    // need to distinguish nodes from all the graphs (and the special nodes).
+    // The IDs of destroyed nodes are reused, so the IDs stay dense.
+    unsigned int globalID;
+
+    // The nodes by their global IDs. The nodes are stored in chunks
+    // that are never moved, so the nodes can be created from more threads
+    // while other threads look up nodes by their IDs.
+    class GlobalNodes {
+        static const unsigned CHUNK_BITS = 12;
+        static const unsigned CHUNK_SIZE = 1u << CHUNK_BITS;
+        static const unsigned MAX_CHUNKS = 1u << 16;
+
+        std::atomic<PSNode **> chunks[MAX_CHUNKS];
+        // the smallest free ID is reused first
+        std::priority_queue<unsigned int, std::vector<unsigned int>,
+                            std::greater<unsigned int>> free_ids;
+        unsigned int next_id{0};
+        std::mutex lock;
+
+    public:
+        GlobalNodes() {
+            for (auto& chunk : chunks)
+                chunk.store(nullptr, std::memory_order_relaxed);
+        }
+
+        ~GlobalNodes() {
+            for (auto& chunk : chunks)
+                delete[] chunk.load(std::memory_order_relaxed);
+        }
+
+        unsigned int add(PSNode *n) {
+            std::lock_guard<std::mutex> guard(lock);
+
+            unsigned int id;
+            if (!free_ids.empty()) {
+                id = free_ids.top();
+                free_ids.pop();
+            } else {
+                id = next_id++;
+                assert(id < CHUNK_SIZE * MAX_CHUNKS && "Too many nodes");
+                if (id % CHUNK_SIZE == 0)
+                    chunks[id >> CHUNK_BITS].store(new PSNode *[CHUNK_SIZE](),
+                                                   std::memory_order_release);
+            }
+
+            chunks[id >> CHUNK_BITS].load(std::memory_order_relaxed)
+                [id & (CHUNK_SIZE - 1)] = n;
+            return id;
+        }
+
+        void remove(unsigned int id) {
+            std::lock_guard<std::mutex> guard(lock);
+            chunks[id >> CHUNK_BITS].load(std::memory_order_relaxed)
+                [id & (CHUNK_SIZE - 1)] = nullptr;
+            free_ids.push(id);
+        }
+
+        PSNode *get(unsigned int id) const {
+            assert(id < CHUNK_SIZE * MAX_CHUNKS);
+            PSNode **chunk = chunks[id >> CHUNK_BITS].load(std::memory_order_acquire);
+            assert(chunk && "Invalid global ID");
+            return chunk[id & (CHUNK_SIZE - 1)];
+        }
+    };
+
+    static GlobalNodes& getGlobalNodes() {
+        static GlobalNodes nodes;
+        return nodes;
+    }
+#endif // ENABLE_ID_POINTS_TO_SETS
+
 protected:
     ///
     // Construct a PSNode
     // \param t     type of the node
-    // Different types take different arguments:
+    // The nodes are created by the create* methods of PointerSubgraph.
+    // Different types take different arguments (operands):
     //
     // ALLOC:        no argument
     // DYN_ALLOC:    no argument
@@ -151,11 +233,11 @@ protected:
     // CONSTANT:     node that keeps constant points-to information
     //               the argument is the pointer it points to
     // PHI:          phi node that gathers pointers from different paths in CFG
-    //               arguments are null-terminated list of the relevant nodes
+    //               arguments are the list of the relevant nodes
     //               from predecessors
     // CALL:         represents call of subprocedure,
     //               XXX: get rid of the arguments here?
-    //               arguments are null-terminated list of nodes that can user
+    //               arguments are a list of nodes that can user
     //               use arbitrarily - they are not used by the analysis itself.
     //               The arguments can be used e. g. when mapping call arguments
     //               back to original CFG. Actually, the CALL node is not needed
@@ -175,6 +257,9 @@ protected:
 
     PSNode(unsigned id, PSNodeType t)
     : SubgraphNode<PSNode>(id), type(t) {
+#ifdef ENABLE_ID_POINTS_TO_SETS
+        globalID = getGlobalNodes().add(this);
+#endif
         switch(type) {
             case PSNodeType::ALLOC:
             case PSNodeType::DYN_ALLOC:
@@ -218,44 +303,6 @@ protected:
         pointsTo.add(Pointer(op, offset));
     }
 
-    PSNode(unsigned id, PSNodeType t, va_list args)
-    : PSNode(id, t) {
-        PSNode *op;
-
-        switch(type) {
-            case PSNodeType::NOOP:
-            case PSNodeType::ENTRY:
-            case PSNodeType::FUNCTION:
-                // no operands (and FUNCTION has been set up
-                // in the super ctor)
-                break;
-            case PSNodeType::CAST:
-            case PSNodeType::LOAD:
-            case PSNodeType::CALL_FUNCPTR:
-            case PSNodeType::INVALIDATE_LOCALS:
-            case PSNodeType::FREE:
-                addOperand(va_arg(args, PSNode *));
-                break;
-            case PSNodeType::STORE:
-                addOperand(va_arg(args, PSNode *));
-                addOperand(va_arg(args, PSNode *));
-                break;
-            case PSNodeType::CALL_RETURN:
-            case PSNodeType::PHI:
-            case PSNodeType::RETURN:
-            case PSNodeType::CALL:
-                op = va_arg(args, PSNode *);
-                // the operands are null terminated
-                while (op) {
-                    addOperand(op);
-                    op = va_arg(args, PSNode *);
-                }
-                break;
-            default:
-                assert(0 && "Unknown type");
-        }
-    }
-
 public:
 
     PSNode(PSNodeType t)
@@ -278,7 +325,19 @@ public:
         }
     }
 
+#ifdef ENABLE_ID_POINTS_TO_SETS
+    virtual ~PSNode() {
+        getGlobalNodes().remove(globalID);
+    }
+
+    // the global IDs are used only by the ID points-to sets
+    unsigned int getGlobalID() const { return globalID; }
+    static PSNode *getByGlobalID(unsigned int id) {
+        return getGlobalNodes().get(id);
+    }
+#else
     virtual ~PSNode() = default;
+#endif
 
     PSNodeType getType() const { return type; }
 
@@ -44,6 +44,15 @@ struct Pointer
     bool isInvalidated() const { return target == INVALIDATED; }
 };
 
+// The constructor of Pointer asserts that the target is not nullptr,
+// but the points-to sets take any target in add() (as PointsToSet does).
+// The sets that store whole pointers create them with this function.
+inline Pointer makePointer(PSNode *target, Offset off) {
+    Pointer ptr(UNKNOWN_MEMORY, off);
+    ptr.target = target;
+    return ptr;
+}
+
 extern const Pointer PointerUnknown;
 extern const Pointer PointerNull;
 
@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 #include "Pointer.h"
 #include "PointsToSet.h"
 #include "PointerSubgraph.h"
@@ -34,18 +38,38 @@ static inline bool canBeDereferenced(const Pointer& ptr)
     return true;
 }
 
-bool PointerAnalysis::processLoad(PSNode *node)
+bool PointerAnalysis::processLoad(PSNode *node, bool all)
 {
-    bool changed = false;
-    PSNode *operand = node->getOperand(0);
+    PSNode *operand = getOperand(node, 0);
 
     if (operand->pointsTo.empty())
-        return error(operand, "Load's operand has no points-to set");
+        return reportError(node, operand, "Load's operand has no points-to set");
+
+    bool changed = false;
+    if (unknown_memory_used)
+        changed |= loadUnknownMemory(node);
+
+    // if the memory changed, we must load from all the pointers
+    if (all && operand == node) {
+        // the load is its own operand (e.g. in unreachable code),
+        // do not iterate over the set that we add to
+        PointsToSetT pointers = node->pointsTo;
+        return processLoad(node, pointers) || changed;
+    } else if (all)
+        return processLoad(node, operand->pointsTo) || changed;
+
+    return processLoad(node, newPointers(node, 0)) || changed;
+}
 
-    for (const Pointer& ptr : operand->pointsTo) {
+template <typename PointersT>
+bool PointerAnalysis::processLoad(PSNode *node, const PointersT& pointers)
+{
+    bool changed = false;
+
+    for (const Pointer& ptr : pointers) {
         if (ptr.isUnknown()) {
             // load from unknown pointer yields unknown pointer
-            changed |= node->addPointsTo(UNKNOWN_MEMORY);
+            changed |= addPointer(node, UNKNOWN_MEMORY);
             continue;
         }
 
@@ -56,6 +80,8 @@ bool PointerAnalysis::processLoad(PSNode *node)
         // information
         std::vector<MemoryObject *> objects;
         getMemoryObjects(node, ptr, objects);
+        for (MemoryObject *o : objects)
+            registerReader(o, node);
 
         PSNodeAlloc *target = PSNodeAlloc::get(ptr.target);
         assert(target && "Target is not memory allocation");
@@ -66,9 +92,9 @@ bool PointerAnalysis::processLoad(PSNode *node)
             if (target->isZeroInitialized())
                 // if the memory is zero initialized, then everything
                 // is fine, we add nullptr
-                changed |= node->addPointsTo(NULLPTR);
+                changed |= addPointer(node, NULLPTR);
             else
-                changed |= errorEmptyPointsTo(node, target);
+                changed |= reportEmptyPointsTo(node, target);
 
             continue;
         }
@@ -83,16 +109,16 @@ bool PointerAnalysis::processLoad(PSNode *node)
                 // FIXME: don't duplicate the code
                 if (o->pointsTo.empty()) {
                     if (target->isZeroInitialized())
-                        changed |= node->addPointsTo(NULLPTR);
+                        changed |= addPointer(node, NULLPTR);
                     else if (objects.size() == 1)
-                        changed |= errorEmptyPointsTo(node, target);
+                        changed |= reportEmptyPointsTo(node, target);
                 }
 
                 // we have some pointers - copy them all,
                 // since the offset is unknown
                 for (auto& it : o->pointsTo) {
                     for (const Pointer &p : it.second) {
-                        changed |= node->addPointsTo(p);
+                        changed |= addPointer(node, p);
                     }
                 }
 
@@ -106,24 +132,26 @@ bool PointerAnalysis::processLoad(PSNode *node)
                 // if the memory is zero initialized, then everything
                 // is fine, we add nullptr
                 if (target->isZeroInitialized())
-                    changed |= node->addPointsTo(NULLPTR);
+                    changed |= addPointer(node, NULLPTR);
                 // if we don't have a definition even with unknown offset
                 // it is an error
                 // FIXME: don't triplicate the code!
                 else if (!o->pointsTo.count(Offset::UNKNOWN))
-                    changed |= errorEmptyPointsTo(node, target);
+                    changed |= reportEmptyPointsTo(node, target);
             } else {
                 // we have pointers on that memory, so we can
                 // do the work
-                for (const Pointer& memptr : o->pointsTo[ptr.offset])
-                    changed |= node->addPointsTo(memptr);
+                // (do not use operator[], the loads may run in parallel)
+                for (const Pointer& memptr : o->find(ptr.offset)->second)
+                    changed |= addPointer(node, memptr);
             }
 
             // plus always add the pointers at unknown offset,
             // since these can be what we need too
-            if (o->pointsTo.count(Offset::UNKNOWN)) {
-                for (const Pointer& memptr : o->pointsTo[Offset::UNKNOWN]) {
-                    changed |= node->addPointsTo(memptr);
+            auto unknownIt = o->find(Offset::UNKNOWN);
+            if (unknownIt != o->end()) {
+                for (const Pointer& memptr : unknownIt->second) {
+                    changed |= addPointer(node, memptr);
                 }
             }
         }
@@ -132,18 +160,21 @@ bool PointerAnalysis::processLoad(PSNode *node)
     return changed;
 }
 
-bool PointerAnalysis::processMemcpy(PSNode *node)
+template <typename SrcPointersT, typename DestPointersT>
+bool PointerAnalysis::processMemcpy(PSNode *node, const SrcPointersT& src,
+                                    const DestPointersT& dest)
 {
     bool changed = false;
     PSNodeMemcpy *memcpy = PSNodeMemcpy::get(node);
-    PSNode *srcNode = memcpy->getSource();
-    PSNode *destNode = memcpy->getDestination();
+
+    if (unknown_memory_used)
+        changed |= processUnknownMemcpy(node, src, dest);
 
     std::vector<MemoryObject *> srcObjects;
     std::vector<MemoryObject *> destObjects;
 
     // gather srcNode pointer objects
-    for (const Pointer& ptr : srcNode->pointsTo) {
+    for (const Pointer& ptr : src) {
         assert(ptr.target && "Got nullptr as target");
 
         if (!canBeDereferenced(ptr))
@@ -151,6 +182,8 @@ bool PointerAnalysis::processMemcpy(PSNode *node)
 
         srcObjects.clear();
         getMemoryObjects(node, ptr, srcObjects);
+        for (MemoryObject *o : srcObjects)
+            registerReader(o, node);
 
         if (srcObjects.empty()){
             abort();
@@ -158,7 +191,7 @@ bool PointerAnalysis::processMemcpy(PSNode *node)
         }
 
         // gather destNode objects
-        for (const Pointer& dptr : destNode->pointsTo) {
+        for (const Pointer& dptr : dest) {
             assert(dptr.target && "Got nullptr as target");
 
             if (!canBeDereferenced(dptr))
@@ -207,7 +240,13 @@ bool PointerAnalysis::processMemcpy(std::vector<MemoryObject *>& srcObjects,
         if ((sourceAlloc->getSize() != Offset::UNKNOWN) &&
             (sourceAlloc->getSize() == destAlloc->getSize()) &&
             len == sourceAlloc->getSize() && sptr.offset == 0) {
-            destAlloc->setZeroInitialized();
+            if (!destAlloc->isZeroInitialized()) {
+                destAlloc->setZeroInitialized();
+                // the loads from the destination can read null now
+                for (MemoryObject *destO : destObjects)
+                    memoryObjectChanged(destO);
+                changed = true;
+            }
         } else {
             // we could analyze in a lot of cases where
             // shoulde be stored the nullptr, but the question
@@ -218,8 +257,9 @@ bool PointerAnalysis::processMemcpy(std::vector<MemoryObject *>& srcObjects,
     }
 
     for (MemoryObject *destO : destObjects) {
+        bool objChanged = false;
         if (contains_null_somewhere)
-            changed |= destO->addPointsTo(Offset::UNKNOWN, NULLPTR);
+            objChanged |= addToMemory(destO, Offset::UNKNOWN, NULLPTR);
 
         // copy every pointer from srcObjects that is in
         // the range to destination's objects
@@ -242,35 +282,42 @@ bool PointerAnalysis::processMemcpy(std::vector<MemoryObject *>& srcObjects,
                         !destOffset.isUnknown()) {
                         // check that new offset does not overflow Offset::UNKNOWN
                         if (Offset::UNKNOWN - *destOffset <= *src.first - *srcOffset) {
-                            changed |= destO->addPointsTo(Offset::UNKNOWN, src.second);
+                            objChanged |= addToMemory(destO, Offset::UNKNOWN, src.second);
                             continue;
                         }
 
                         Offset newOff = *src.first - *srcOffset + *destOffset;
                         if (newOff >= destO->node->getSize() ||
                             newOff >= max_offset) {
-                            changed |= destO->addPointsTo(Offset::UNKNOWN, src.second);
+                            objChanged |= addToMemory(destO, Offset::UNKNOWN, src.second);
                         } else {
-                            changed |= destO->addPointsTo(newOff, src.second);
+                            objChanged |= addToMemory(destO, newOff, src.second);
                         }
                     } else {
-                        changed |= destO->addPointsTo(Offset::UNKNOWN, src.second);
+                        objChanged |= addToMemory(destO, Offset::UNKNOWN, src.second);
                     }
                 }
             }
         }
+
+        if (objChanged) {
+            checkObjectBudget(destO);
+            memoryObjectChanged(destO);
+            changed = true;
+        }
     }
 
     return changed;
 }
 
-bool PointerAnalysis::processGep(PSNode *node) {
+template <typename PointersT>
+bool PointerAnalysis::processGep(PSNode *node, const PointersT& pointers) {
     bool changed = false;
 
     PSNodeGep *gep = PSNodeGep::get(node);
     assert(gep && "Non-GEP given");
 
-    for (const Pointer& ptr : gep->getSource()->pointsTo) {
+    for (const Pointer& ptr : pointers) {
         uint64_t new_offset;
         if (ptr.offset.isUnknown() || gep->getOffset().isUnknown())
             // set it like this to avoid overflow when adding
@@ -283,41 +330,992 @@ bool PointerAnalysis::processGep(PSNode *node) {
         // to the begining of the memory - therefore make 0 exception
         if ((new_offset == 0 || new_offset < ptr.target->getSize())
             && new_offset < max_offset)
-            changed |= node->addPointsTo(ptr.target, new_offset);
+            changed |= addPointer(node, Pointer(ptr.target, new_offset));
         else
-            changed |= node->addPointsTo(ptr.target, Offset::UNKNOWN);
+            changed |= addPointer(node, Pointer(ptr.target, Offset::UNKNOWN));
     }
 
     return changed;
 }
 
-bool PointerAnalysis::processNode(PSNode *node)
+template <typename PointersT, typename ValuesT>
+bool PointerAnalysis::processStore(PSNode *node, const PointersT& pointers,
+                                   const ValuesT& values)
 {
     bool changed = false;
     std::vector<MemoryObject *> objects;
 
+    for (const Pointer& ptr : pointers) {
+        assert(ptr.target && "Got nullptr as target");
+
+        // store via a pointer that was degraded to unknown memory
+        if (ptr.isUnknown() && unknown_memory_used) {
+            bool objChanged = false;
+            for (const Pointer& to : values)
+                objChanged |= addToMemory(&unknown_memory, Offset::UNKNOWN, to);
+
+            if (objChanged) {
+                memoryObjectChanged(&unknown_memory);
+                changed = true;
+            }
+            continue;
+        }
+
+        if (!canBeDereferenced(ptr))
+            continue;
+
+        objects.clear();
+        getMemoryObjects(node, ptr, objects);
+        for (MemoryObject *o : objects) {
+            bool objChanged = false;
+            for (const Pointer& to : values) {
+                objChanged |= addToMemory(o, ptr.offset, to);
+            }
+
+            if (objChanged) {
+                checkObjectBudget(o);
+                memoryObjectChanged(o);
+                changed = true;
+            }
+        }
+    }
+
+    return changed;
+}
+
+template <typename PointersT>
+bool PointerAnalysis::processPhi(PSNode *node, const PointersT& pointers)
+{
+    bool changed = false;
+    for (const Pointer& ptr : pointers)
+        changed |= addPointer(node, ptr);
+
+    return changed;
+}
+
+template <typename PointersT>
+bool PointerAnalysis::invalidateReturned(PSNode *node, const PointersT& pointers)
+{
+    for (const Pointer& ptr : pointers) {
+        if (!canBeDereferenced(ptr))
+            continue;
+        PSNodeAlloc *target = PSNodeAlloc::get(ptr.target);
+        assert(target && "Target is not memory allocation");
+        if (!target->isHeap() && !target->isGlobal()) {
+            return addPointer(node, INVALIDATED);
+        }
+    }
+
+    return false;
+}
+
+template <typename PointersT>
+bool PointerAnalysis::processFuncptrCall(PSNode *node, const PointersT& pointers)
+{
+    bool changed = false;
+    // call via function pointer:
+    // first gather the pointers that can be used to the
+    // call and if something changes, let backend take some action
+    // (for example build relevant subgraph)
+    for (const Pointer& ptr : pointers) {
+        if (addPointer(node, ptr)) {
+            changed = true;
+
+            if (ptr.isValid() && !ptr.isInvalidated()) {
+                // the backend may change the graph
+                functionPointerCall(node, ptr.target);
+                graph_changed = true;
+            } else {
+                reportError(node, node, "Calling invalid pointer as a function!");
+                continue;
+            }
+        }
+    }
+
+    return changed;
+}
+
+const uint64_t PointerAnalysis::UNREACHABLE;
+
+void PointerAnalysis::setThreadsNum(unsigned num)
+{
+    if (num == 0)
+        num = std::max(std::thread::hardware_concurrency(), 1u);
+
+#if defined(ENABLE_SHARED_POINTS_TO_SETS) || defined(ENABLE_BDD_POINTS_TO_SETS)
+    // the tables of the shared and BDD sets are not thread-safe
+    // (even copying and iterating over a set counts references)
+    num = 1;
+#endif
+
+    threads_num = num;
+}
+
+void PointerAnalysis::solve()
+{
+    while (!worklist.empty()) {
+        PSNode *cur = worklist.pop();
+        // the node was collapsed after it was queued,
+        // its representative was queued too
+        if (getRepresentative(cur) != cur)
+            continue;
+
+        graph_changed = false;
+        bool enq = false;
+        enq |= beforeProcessed(cur);
+        enq |= processNode(cur);
+        enq |= afterProcessed(cur);
+
+        if (graph_changed)
+            enqueueReachable(cur);
+
+        if (!budget.isUnlimited()) {
+            enq |= checkNodeBudget(cur);
+            checkGlobalBudget(1);
+        }
+
+        if (enq)
+            enqueueDependents(cur);
+
+        if (collapse_cycles && isCopy(cur))
+            detectCycle(cur);
+    }
+}
+
+bool PointerAnalysis::isParallelSafe(PSNode *n)
+{
+    // the nodes that only read memory and the points-to sets
+    // of their operands and change only their own points-to set
+    switch (n->getType()) {
+        case PSNodeType::LOAD:
+        case PSNodeType::GEP:
+        case PSNodeType::CAST:
+        case PSNodeType::PHI:
+        case PSNodeType::RETURN:
+        case PSNodeType::CALL_RETURN:
+        case PSNodeType::CONSTANT:
+        case PSNodeType::ALLOC:
+        case PSNodeType::DYN_ALLOC:
+        case PSNodeType::FUNCTION:
+        case PSNodeType::CALL:
+        case PSNodeType::ENTRY:
+        case PSNodeType::NOOP:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void PointerAnalysis::processParallel(const std::vector<PSNode *>& nodes)
+{
+    // the pointers and readers of the nodes are buffered
+    // in these vectors and the logs of added pointers are only read,
+    // so they must not be resized meanwhile
+    size_t size = PS->size();
+    if (pending_pointers.size() < size) {
+        pending_pointers.resize(size);
+        pending_readers.resize(size);
+        pending_errors.resize(size);
+    }
+    if (added.size() < size)
+        added.resize(size);
+    if (seen.size() < size)
+        seen.resize(size);
+
+    prepareParallelProcessing(PS);
+
+    // the threads take the nodes by chunks, so that the threads
+    // that got cheap nodes take more of them
+    static const size_t CHUNK = 16;
+    std::atomic<size_t> next(0);
+    auto worker = [this, &nodes, &next]() {
+        size_t from;
+        while ((from = next.fetch_add(CHUNK)) < nodes.size()) {
+            size_t to = std::min(from + CHUNK, nodes.size());
+            for (size_t i = from; i < to; ++i)
+                processNode(nodes[i]);
+        }
+    };
+
+    parallel_phase = true;
+
+    // it is not worth to start the threads for a few nodes
+    if (nodes.size() < 4 * CHUNK) {
+        worker();
+    } else {
+        std::vector<std::thread> threads;
+        threads.reserve(threads_num - 1);
+        for (unsigned i = 1; i < threads_num; ++i)
+            threads.emplace_back(worker);
+        worker();
+
+        for (std::thread& t : threads)
+            t.join();
+    }
+
+    parallel_phase = false;
+}
+
+void PointerAnalysis::solveParallel()
+{
+    // The nodes are processed in rounds. Every round takes
+    // all the queued nodes, processes in parallel the nodes that
+    // change only their own points-to sets and then sequentially
+    // applies their changes and processes the rest of the nodes.
+    // The nodes in one round do not see the changes made by the other
+    // nodes of the round, but they are queued again if the changes
+    // affect them, so the fixpoint is the same as with the sequential
+    // solver (just reached in a different order).
+    std::vector<PSNode *> round;
+    std::vector<PSNode *> parallel;
+    std::vector<char> enq;
+
+    while (!worklist.empty()) {
+        round.clear();
+        parallel.clear();
+
+        while (!worklist.empty()) {
+            PSNode *cur = worklist.pop();
+            // the node was collapsed after it was queued,
+            // its representative was queued too
+            if (getRepresentative(cur) == cur)
+                round.push_back(cur);
+        }
+
+        // the hooks of the analysis may change memory
+        enq.assign(round.size(), false);
+        for (size_t i = 0; i < round.size(); ++i)
+            enq[i] = beforeProcessed(round[i]);
+
+        for (PSNode *cur : round) {
+            if (isParallelSafe(cur))
+                parallel.push_back(cur);
+        }
+
+        processParallel(parallel);
+
+        // apply the changes of the parallel nodes before processing
+        // the rest, the changes of memory must see all the readers
+        for (size_t i = 0; i < round.size(); ++i) {
+            PSNode *cur = round[i];
+            if (!isParallelSafe(cur))
+                continue;
+
+            unsigned id = cur->getID();
+            // the pending pointers are only candidates,
+            // we add them to the set only now
+            for (const Pointer& ptr : pending_pointers[id])
+                enq[i] |= addPointer(cur, ptr);
+            for (const MemoryObject *mo : pending_readers[id])
+                registerReader(mo, cur);
+            for (const PendingError& err : pending_errors[id]) {
+                if (err.to)
+                    enq[i] |= errorEmptyPointsTo(err.at, err.to);
+                else
+                    enq[i] |= error(err.at, err.msg);
+            }
+
+            pending_pointers[id].clear();
+            pending_readers[id].clear();
+            pending_errors[id].clear();
+        }
+
+        for (size_t i = 0; i < round.size(); ++i) {
+            PSNode *cur = round[i];
+            if (isParallelSafe(cur))
+                continue;
+
+            graph_changed = false;
+            enq[i] |= processNode(cur);
+
+            if (graph_changed)
+                enqueueReachable(cur);
+        }
+
+        for (size_t i = 0; i < round.size(); ++i) {
+            PSNode *cur = round[i];
+            enq[i] |= afterProcessed(cur);
+
+            if (!budget.isUnlimited())
+                enq[i] |= checkNodeBudget(cur);
+
+            if (enq[i])
+                enqueueDependents(cur);
+
+            // the node could be collapsed by a cycle found
+            // from other node of the round
+            if (collapse_cycles && isCopy(cur) && getRepresentative(cur) == cur)
+                detectCycle(cur);
+        }
+
+        if (!budget.isUnlimited())
+            checkGlobalBudget(round.size());
+    }
+
+    std::vector<std::vector<Pointer>>().swap(pending_pointers);
+    std::vector<std::vector<const MemoryObject *>>().swap(pending_readers);
+    std::vector<std::vector<PendingError>>().swap(pending_errors);
+}
+
+void PointerAnalysis::computePriorities(const SCC<PSNode>& scc_comp)
+{
+    PSNode *root = PS->getRoot();
+    priorities.assign(PS->size(), UNREACHABLE);
+
+    // reverse postorder of the nodes, so that inside
+    // of a component a node goes before its successors
+    // (except for back edges)
+    std::vector<PSNode *> postorder;
+    postorder.reserve(PS->size());
+    std::vector<bool> visited(PS->size(), false);
+    std::vector<std::pair<PSNode *, size_t>> stack;
+
+    visited[root->getID()] = true;
+    stack.emplace_back(root, 0);
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        if (top.second < top.first->successorsNum()) {
+            PSNode *succ = top.first->getSuccessors()[top.second++];
+            if (!visited[succ->getID()]) {
+                visited[succ->getID()] = true;
+                stack.emplace_back(succ, 0);
+            }
+        } else {
+            postorder.push_back(top.first);
+            stack.pop_back();
+        }
+    }
+
+    // the components are in reverse topological order,
+    // so the priority is the topological order of the component
+    // and the reverse postorder of the node inside of it
+    uint64_t comps_num = SCCs.size();
+    uint64_t rpo = 0;
+    for (auto it = postorder.rbegin(), et = postorder.rend(); it != et; ++it) {
+        uint64_t topo = comps_num - 1 - scc_comp.getSCCId(*it);
+        priorities[(*it)->getID()] = (topo << 32) | rpo++;
+    }
+
+    next_priority = comps_num << 32;
+}
+
+void PointerAnalysis::enqueueReachable(PSNode *n)
+{
+    // the graph changed, give priorities to the new nodes
+    // (after all the old ones) and process everything
+    // that is reachable from 'n'
+    if (priorities.size() < PS->size()) {
+        priorities.resize(PS->size(), UNREACHABLE);
+        process_all.resize(PS->size(), false);
+    }
+
+    for (PSNode *r : PS->getNodes(n)) {
+        if (priorities[r->getID()] == UNREACHABLE)
+            priorities[r->getID()] = next_priority++;
+        enqueue(r);
+    }
+}
+
+void PointerAnalysis::enqueueDependents(PSNode *n)
+{
+    // the nodes that use the points-to set of 'n'
+    // (of any node in the cycle that 'n' represents)
+    if (n->getID() < collapsed_members.size() &&
+        !collapsed_members[n->getID()].empty()) {
+        for (PSNode *m : collapsed_members[n->getID()]) {
+            for (PSNode *user : m->getUsers())
+                enqueueUser(user);
+        }
+    } else {
+        for (PSNode *user : n->getUsers())
+            enqueueUser(user);
+    }
+
+    // the nodes that use memory changed by 'n'
+    // (the readers of changed memory objects
+    // were already queued while processing 'n')
+    std::vector<PSNode *> deps;
+    getMemoryDependents(n, deps);
+    for (PSNode *dep : deps)
+        enqueue(dep);
+}
+
+void PointerAnalysis::resetDifferences()
+{
+    std::vector<std::vector<Pointer>>().swap(added);
+    std::vector<std::vector<size_t>>().swap(seen);
+    process_all.assign(priorities.size(), false);
+}
+
+bool PointerAnalysis::startProcessing(PSNode *node)
+{
+    unsigned id = node->getID();
+    if (id >= seen.size())
+        seen.resize(id + 1);
+
+    // new operands could have been added to the node (to call-return
+    // nodes when building subgraphs for calls via function pointers)
+    std::vector<size_t>& S = seen[id];
+    bool all = process_all[id] || S.size() != node->getOperandsNum();
+    process_all[id] = false;
+
+    if (all) {
+        S.resize(node->getOperandsNum());
+        for (unsigned i = 0; i < S.size(); ++i) {
+            unsigned opid = getOperand(node, i)->getID();
+            S[i] = opid < added.size() ? added[opid].size() : 0;
+        }
+    }
+
+    return all;
+}
+
+PointerAnalysis::NewPointers PointerAnalysis::newPointers(PSNode *node, unsigned idx)
+{
+    unsigned opid = getOperand(node, idx)->getID();
+    // the special nodes (with ID 0) never change
+    if (opid == 0 || opid >= added.size())
+        return NewPointers();
+
+    size_t& from = seen[node->getID()][idx];
+    NewPointers ret(&added, opid, from, added[opid].size());
+    from = added[opid].size();
+
+    return ret;
+}
+
+bool PointerAnalysis::addPointer(PSNode *node, const Pointer& pointer)
+{
+    const Pointer ptr = degraded ? degrade(node, pointer) : pointer;
+
+    if (parallel_phase) {
+        // only the node itself changes its points-to set,
+        // so nobody else writes to it meanwhile
+        if (node->doesPointsTo(ptr))
+            return false;
+
+        pending_pointers[node->getID()].push_back(ptr);
+        return true;
+    }
+
+    if (!node->addPointsTo(ptr))
+        return false;
+
+    unsigned id = node->getID();
+    assert(id != 0 && "Adding pointers to a special node");
+    if (id >= added.size())
+        added.resize(id + 1);
+
+    added[id].push_back(ptr);
+    ++pointers_num;
+    return true;
+}
+
+void PointerAnalysis::resetCollapsed()
+{
+    representative.clear();
+    collapsed_members.clear();
+    checked_edges.clear();
+}
+
+void PointerAnalysis::finishCollapsed()
+{
+    // the collapsed nodes have the points-to set of the representative
+    for (unsigned id = 0; id < representative.size(); ++id) {
+        PSNode *rep = representative[id];
+        if (!rep)
+            continue;
+
+        PSNode *node = PS->getNodes()[id];
+        assert(node && node != rep);
+        node->addPointsTo(rep->pointsTo);
+        collapsed.set(node, rep);
+    }
+
+    resetCollapsed();
+}
+
+void PointerAnalysis::detectCycle(PSNode *n)
+{
+    assert(getRepresentative(n) == n);
+
+    std::vector<PSNode *> single{n};
+    const std::vector<PSNode *>& members
+        = (n->getID() < collapsed_members.size() &&
+           !collapsed_members[n->getID()].empty())
+            ? collapsed_members[n->getID()] : single;
+
+    // lazy cycle detection: the points-to set of a node in a cycle
+    // is the same as the points-to set of its operand in the cycle,
+    // so we search for a cycle only when we see such an operand
+    // (and only once for every edge)
+    bool search = false;
+    for (PSNode *m : members) {
+        for (unsigned i = 0; i < m->getOperandsNum(); ++i) {
+            PSNode *op = getOperand(m, i);
+            if (op == n || !isCopy(op) ||
+                op->pointsTo.size() != n->pointsTo.size())
+                continue;
+
+            uint64_t edge = (static_cast<uint64_t>(op->getID()) << 32) | n->getID();
+            if (checked_edges.insert(edge).second)
+                search = true;
+        }
+    }
+
+    if (!search)
+        return;
+
+    auto getMembers = [this](PSNode *rep) -> std::vector<PSNode *> {
+        if (rep->getID() < collapsed_members.size() &&
+            !collapsed_members[rep->getID()].empty())
+            return collapsed_members[rep->getID()];
+        return {rep};
+    };
+
+    // the copy nodes reachable from 'n' via users...
+    std::unordered_set<PSNode *> reachable{n};
+    std::vector<PSNode *> stack{n};
+    while (!stack.empty()) {
+        PSNode *cur = stack.back();
+        stack.pop_back();
+
+        for (PSNode *m : getMembers(cur)) {
+            for (PSNode *user : m->getUsers()) {
+                PSNode *rep = getRepresentative(user);
+                if (isCopy(rep) && reachable.insert(rep).second)
+                    stack.push_back(rep);
+            }
+        }
+    }
+
+    // ...that can reach 'n' via operands form the cycle
+    std::vector<PSNode *> cycle{n};
+    std::unordered_set<PSNode *> visited{n};
+    stack.push_back(n);
+    while (!stack.empty()) {
+        PSNode *cur = stack.back();
+        stack.pop_back();
+
+        for (PSNode *m : getMembers(cur)) {
+            for (unsigned i = 0; i < m->getOperandsNum(); ++i) {
+                PSNode *op = getOperand(m, i);
+                if (reachable.count(op) > 0 && visited.insert(op).second) {
+                    cycle.push_back(op);
+                    stack.push_back(op);
+                }
+            }
+        }
+    }
+
+    if (cycle.size() > 1)
+        collapse(cycle);
+}
+
+void PointerAnalysis::collapse(const std::vector<PSNode *>& cycle)
+{
+    // the representative is the node that is processed first
+    PSNode *rep = cycle[0];
+    for (PSNode *n : cycle) {
+        if (priorities[n->getID()] < priorities[rep->getID()])
+            rep = n;
+    }
+
+    if (representative.size() < PS->size())
+        representative.resize(PS->size(), nullptr);
+    if (collapsed_members.size() < PS->size())
+        collapsed_members.resize(PS->size());
+
+    std::vector<PSNode *>& members = collapsed_members[rep->getID()];
+    if (members.empty())
+        members.push_back(rep);
+
+    for (PSNode *n : cycle) {
+        if (n == rep)
+            continue;
+
+        std::vector<PSNode *>& nmembers = collapsed_members[n->getID()];
+        if (nmembers.empty())
+            nmembers.push_back(n);
+
+        for (PSNode *m : nmembers) {
+            representative[m->getID()] = rep;
+            members.push_back(m);
+        }
+
+        std::vector<PSNode *>().swap(nmembers);
+
+        for (const Pointer& ptr : n->pointsTo)
+            addPointer(rep, ptr);
+    }
+
+    // process the whole cycle again and the users of the nodes too,
+    // since they read the points-to set of the representative now
+    for (PSNode *m : members) {
+        enqueue(m);
+        for (PSNode *user : m->getUsers())
+            enqueue(user);
+    }
+}
+
+bool PointerAnalysis::processCollapsed(PSNode *rep)
+{
+    bool changed = false;
+
+    // the representative gets the pointers
+    // from all the operands of the cycle
+    for (PSNode *m : collapsed_members[rep->getID()]) {
+        bool all = startProcessing(m);
+        for (unsigned i = 0; i < m->getOperandsNum(); ++i) {
+            PSNode *op = getOperand(m, i);
+            if (op == rep)
+                continue;
+
+            if (all)
+                changed |= processPhi(rep, op->pointsTo);
+            else
+                changed |= processPhi(rep, newPointers(m, i));
+        }
+    }
+
+    return changed;
+}
+
+Pointer PointerAnalysis::degrade(PSNode *node, const Pointer& ptr) const
+{
+    // null, unknown and invalidated pointers are kept,
+    // as well as the pointers to functions (calls via the pointers)
+    if (!ptr.isValid() || ptr.isInvalidated() ||
+        ptr.target->getType() == PSNodeType::FUNCTION)
+        return ptr;
+
+    uint8_t flags = getDegradation(node);
+    if (all_targets_unknown || (flags & DEGRADED_TARGETS))
+        return PointerUnknown;
+
+    if (all_offsets_unknown || (flags & DEGRADED_OFFSETS) ||
+        (getDegradation(ptr.target) & FIELD_INSENSITIVE))
+        return Pointer(ptr.target, Offset::UNKNOWN);
+
+    return ptr;
+}
+
+void PointerAnalysis::resetBudget()
+{
+    start_time = std::chrono::steady_clock::now();
+    iterations = 0;
+    pointers_num = 0;
+    next_time = budget.time;
+    next_iterations = budget.iterations;
+    next_memory = budget.memory;
+}
+
+void PointerAnalysis::checkGlobalBudget(uint64_t processed)
+{
+    iterations += processed;
+
+    // every exceeded limit is counted again from the degradation,
+    // so the second excess degrades the analysis more
+    if (budget.iterations != 0 && iterations >= next_iterations) {
+        degradeAll(PrecisionLoss::Reason::ITERATIONS);
+        next_iterations = iterations + budget.iterations;
+    }
+
+    if (budget.memory != 0 && pointers_num >= next_memory) {
+        degradeAll(PrecisionLoss::Reason::MEMORY);
+        next_memory = pointers_num + budget.memory;
+    }
+
+    // do not ask for the time after every node
+    if (budget.time != 0 && (processed > 1 || iterations % 64 == 0)) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::steady_clock::now() - start_time).count();
+        if (static_cast<uint64_t>(elapsed) >= next_time) {
+            degradeAll(PrecisionLoss::Reason::TIME);
+            next_time = elapsed + budget.time;
+        }
+    }
+}
+
+bool PointerAnalysis::checkNodeBudget(PSNode *node)
+{
+    bool changed = false;
+
+    // the objects with too many offsets in the points-to set
+    // become field-insensitive
+    if (budget.offsets != 0 && node->pointsTo.size() > budget.offsets) {
+        std::unordered_map<PSNode *, size_t> offsets;
+        bool rebuild = false;
+        for (const Pointer& ptr : node->pointsTo) {
+            if (!ptr.isValid() || ptr.isInvalidated() ||
+                ptr.target->getType() == PSNodeType::FUNCTION ||
+                (getDegradation(ptr.target) & FIELD_INSENSITIVE))
+                continue;
+
+            if (++offsets[ptr.target] > budget.offsets) {
+                makeFieldInsensitive(ptr.target, PrecisionLoss::Reason::OFFSETS);
+                rebuild = true;
+            }
+        }
+
+        if (rebuild)
+            changed |= rebuildPointsTo(node);
+    }
+
+    if (budget.pointsToSize != 0 && node->pointsTo.size() > budget.pointsToSize) {
+        changed |= degradeNode(node, DEGRADED_OFFSETS,
+                               PrecisionLoss::Reason::POINTS_TO_SIZE);
+        if (node->pointsTo.size() > budget.pointsToSize)
+            changed |= degradeNode(node, DEGRADED_TARGETS,
+                                   PrecisionLoss::Reason::POINTS_TO_SIZE);
+    }
+
+    return changed;
+}
+
+void PointerAnalysis::checkObjectBudget(MemoryObject *mo)
+{
+    if (budget.offsets == 0 || mo->pointsTo.size() <= budget.offsets)
+        return;
+
+    makeFieldInsensitive(mo->node, PrecisionLoss::Reason::OFFSETS);
+
+    // move all the pointers to the unknown offset,
+    // the loads read the unknown offset anyway
+    PointsToSetT& unknown = mo->pointsTo[Offset::UNKNOWN];
+    for (auto it = mo->pointsTo.begin(); it != mo->pointsTo.end();) {
+        if (it->first.isUnknown()) {
+            ++it;
+            continue;
+        }
+
+        for (const Pointer& ptr : it->second)
+            unknown.add(ptr);
+        it = mo->pointsTo.erase(it);
+    }
+}
+
+void PointerAnalysis::degradeAll(PrecisionLoss::Reason reason)
+{
+    // the nodes keep the pointers that they already have,
+    // only the new pointers are degraded
+    if (!all_offsets_unknown) {
+        all_offsets_unknown = true;
+        degraded = true;
+        losses.emplace_back(reason, PrecisionLoss::Action::UNKNOWN_OFFSETS, nullptr);
+        requeueStrongUpdates();
+    } else if (!all_targets_unknown) {
+        all_targets_unknown = true;
+        losses.emplace_back(reason, PrecisionLoss::Action::UNKNOWN_TARGETS, nullptr);
+        useUnknownMemory();
+    }
+}
+
+bool PointerAnalysis::degradeNode(PSNode *node, uint8_t flags,
+                                  PrecisionLoss::Reason reason)
+{
+    if ((getDegradation(node) & flags) == flags)
+        return false;
+
+    setDegradation(node, flags);
+    losses.emplace_back(reason, (flags & DEGRADED_TARGETS) ?
+                                    PrecisionLoss::Action::UNKNOWN_TARGETS :
+                                    PrecisionLoss::Action::UNKNOWN_OFFSETS,
+                        node);
+
+    if (flags & DEGRADED_TARGETS)
+        useUnknownMemory();
+
+    requeueStrongUpdates();
+    return rebuildPointsTo(node);
+}
+
+bool PointerAnalysis::rebuildPointsTo(PSNode *node)
+{
+    // the users that already processed the old pointers keep them,
+    // the degraded pointers are new for them
+    PointsToSetT old;
+    std::swap(old, node->pointsTo);
+
+    bool changed = false;
+    for (const Pointer& ptr : old)
+        changed |= addPointer(node, ptr);
+
+    return changed;
+}
+
+void PointerAnalysis::makeFieldInsensitive(PSNode *target,
+                                           PrecisionLoss::Reason reason)
+{
+    // the special nodes have only the unknown offset
+    if (!target || target->getID() == 0 ||
+        (getDegradation(target) & FIELD_INSENSITIVE))
+        return;
+
+    setDegradation(target, FIELD_INSENSITIVE);
+    losses.emplace_back(reason, PrecisionLoss::Action::FIELD_INSENSITIVE, target);
+    requeueStrongUpdates();
+}
+
+void PointerAnalysis::requeueStrongUpdates()
+{
+    for (PSNode *n : strong_updates) {
+        if (!hasPrecisePointers(n->getOperand(1)))
+            enqueue(n);
+    }
+}
+
+void PointerAnalysis::useUnknownMemory()
+{
+    degraded = true;
+    if (unknown_memory_used)
+        return;
+
+    unknown_memory_used = true;
+
+    // the nodes that work with memory must take the unknown memory
+    // into account (and register as its readers)
+    for (PSNode *n : PS->getNodes()) {
+        if (n && (n->getType() == PSNodeType::LOAD ||
+                  n->getType() == PSNodeType::STORE ||
+                  n->getType() == PSNodeType::MEMCPY))
+            enqueue(n);
+    }
+}
+
+bool PointerAnalysis::addToMemory(MemoryObject *mo, const Offset& off,
+                                  const Pointer& ptr)
+{
+    if (!mo->addPointsTo(degradeOffset(mo, off), ptr))
+        return false;
+
+    ++pointers_num;
+    return true;
+}
+
+bool PointerAnalysis::addToMemory(MemoryObject *mo, const Offset& off,
+                                  const PointsToSetT& pointers)
+{
+    bool changed = false;
+    for (const Pointer& ptr : pointers)
+        changed |= addToMemory(mo, off, ptr);
+
+    return changed;
+}
+
+bool PointerAnalysis::loadUnknownMemory(PSNode *node)
+{
+    registerReader(&unknown_memory, node);
+
+    bool changed = false;
+    for (auto& it : unknown_memory.pointsTo) {
+        for (const Pointer& ptr : it.second)
+            changed |= addPointer(node, ptr);
+    }
+
+    return changed;
+}
+
+template <typename SrcPointersT, typename DestPointersT>
+bool PointerAnalysis::processUnknownMemcpy(PSNode *node, const SrcPointersT& src,
+                                           const DestPointersT& dest)
+{
+    bool changed = false;
+    bool srcUnknown = false;
+    bool destUnknown = false;
+    for (const Pointer& ptr : src)
+        srcUnknown |= ptr.isUnknown();
+    for (const Pointer& ptr : dest)
+        destUnknown |= ptr.isUnknown();
+
+    std::vector<MemoryObject *> objects;
+
+    // the source memory may contain anything
+    // that was stored via pointers to unknown memory
+    registerReader(&unknown_memory, node);
+    for (const Pointer& dptr : dest) {
+        if (!canBeDereferenced(dptr))
+            continue;
+
+        objects.clear();
+        getMemoryObjects(node, dptr, objects);
+        for (MemoryObject *o : objects) {
+            bool objChanged = false;
+            for (auto& it : unknown_memory.pointsTo)
+                objChanged |= addToMemory(o, Offset::UNKNOWN, it.second);
+            if (srcUnknown)
+                objChanged |= addToMemory(o, Offset::UNKNOWN, PointerUnknown);
+
+            if (objChanged) {
+                checkObjectBudget(o);
+                memoryObjectChanged(o);
+                changed = true;
+            }
+        }
+    }
+
+    // copying to unknown memory
+    if (destUnknown) {
+        bool objChanged = false;
+        for (const Pointer& sptr : src) {
+            if (!canBeDereferenced(sptr))
+                continue;
+
+            objects.clear();
+            getMemoryObjects(node, sptr, objects);
+            for (MemoryObject *o : objects) {
+                registerReader(o, node);
+                for (auto& it : o->pointsTo)
+                    objChanged |= addToMemory(&unknown_memory, Offset::UNKNOWN,
+                                              it.second);
+            }
+        }
+
+        if (srcUnknown)
+            objChanged |= addToMemory(&unknown_memory, Offset::UNKNOWN,
+                                      PointerUnknown);
+
+        if (objChanged) {
+            memoryObjectChanged(&unknown_memory);
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+bool PointerAnalysis::processNode(PSNode *node)
+{
+    // the node represents a collapsed cycle
+    if (collapse_cycles && getRepresentative(node) == node &&
+        node->getID() < collapsed_members.size() &&
+        !collapsed_members[node->getID()].empty())
+        return processCollapsed(node);
+
+    bool changed = false;
+    bool all = startProcessing(node);
+
 #ifdef DEBUG_ENABLED
     size_t prev_size = node->pointsTo.size();
 #endif
 
     switch(node->type) {
         case PSNodeType::LOAD:
-            changed |= processLoad(node);
+            changed |= processLoad(node, all);
             break;
         case PSNodeType::STORE:
-            for (const Pointer& ptr : node->getOperand(1)->pointsTo) {
-                assert(ptr.target && "Got nullptr as target");
-
-                if (!canBeDereferenced(ptr))
-                    continue;
-
-                objects.clear();
-                getMemoryObjects(node, ptr, objects);
-                for (MemoryObject *o : objects) {
-                    for (const Pointer& to : node->getOperand(0)->pointsTo) {
-                        changed |= o->addPointsTo(ptr.offset, to);
-                    }
-                }
+            if (all) {
+                changed |= processStore(node, getOperand(node, 1)->pointsTo,
+                                        getOperand(node, 0)->pointsTo);
+            } else {
+                // store all the values to the new pointers
+                // and the new values to all the pointers
+                NewPointers values = newPointers(node, 0);
+                changed |= processStore(node, newPointers(node, 1),
+                                        getOperand(node, 0)->pointsTo);
+                if (!values.empty())
+                    changed |= processStore(node, getOperand(node, 1)->pointsTo,
+                                            values);
             }
             break;
         case PSNodeType::INVALIDATE_OBJECT:
@@ -329,12 +1327,24 @@ bool PointerAnalysis::processNode(PSNode *node)
             node->setParent(node->getOperand(0)->getSingleSuccessor()->getParent());
             break;
         case PSNodeType::GEP:
-            changed |= processGep(node);
+            // the GEP can be its own operand (in unreachable code),
+            // it has no pointers then
+            if (getOperand(node, 0) == node)
+                break;
+            if (all)
+                changed |= processGep(node, getOperand(node, 0)->pointsTo);
+            else
+                changed |= processGep(node, newPointers(node, 0));
             break;
         case PSNodeType::CAST:
-            // cast only copies the pointers
-            for (const Pointer& ptr : node->getOperand(0)->pointsTo)
-                changed |= node->addPointsTo(ptr);
+            // cast only copies the pointers (there is nothing
+            // to copy if the cast is its own operand)
+            if (getOperand(node, 0) == node)
+                break;
+            if (all)
+                changed |= processPhi(node, getOperand(node, 0)->pointsTo);
+            else
+                changed |= processPhi(node, newPointers(node, 0));
             break;
         case PSNodeType::CONSTANT:
             // maybe warn? It has no sense to insert the constants into the graph.
@@ -344,48 +1354,53 @@ bool PointerAnalysis::processNode(PSNode *node)
                    && "Constant should have exactly one pointer");
             break;
         case PSNodeType::CALL_RETURN:
-            if (invalidate_nodes) {
-                for (PSNode *op : node->operands) {
-                    for (const Pointer& ptr : op->pointsTo) {
-                        if (!canBeDereferenced(ptr))
-                            continue;
-                        PSNodeAlloc *target = PSNodeAlloc::get(ptr.target);
-                        assert(target && "Target is not memory allocation");
-                        if (!target->isHeap() && !target->isGlobal()) {
-                            changed |= node->addPointsTo(INVALIDATED);
-                        }
-                    }
-                }
-            }
-            // fall-through
         case PSNodeType::RETURN:
             // gather pointers returned from subprocedure - the same way
             // as PHI works
         case PSNodeType::PHI:
-            for (PSNode *op : node->operands)
-                changed |= node->addPointsTo(op->pointsTo);
-            break;
-        case PSNodeType::CALL_FUNCPTR:
-            // call via function pointer:
-            // first gather the pointers that can be used to the
-            // call and if something changes, let backend take some action
-            // (for example build relevant subgraph)
-            for (const Pointer& ptr : node->getOperand(0)->pointsTo) {
-                if (node->addPointsTo(ptr)) {
-                    changed = true;
-
-                    if (ptr.isValid() && !ptr.isInvalidated()) {
-                        functionPointerCall(node, ptr.target);
-                    } else {
-                        error(node, "Calling invalid pointer as a function!");
-                        continue;
-                    }
+            for (unsigned i = 0; i < node->getOperandsNum(); ++i) {
+                PSNode *op = getOperand(node, i);
+                // the node has all its own pointers
+                // (and we must not iterate over the set that we add to)
+                if (op == node)
+                    continue;
+
+                if (all) {
+                    if (invalidate_nodes && node->type == PSNodeType::CALL_RETURN)
+                        changed |= invalidateReturned(node, op->pointsTo);
+                    changed |= processPhi(node, op->pointsTo);
+                } else {
+                    NewPointers ptrs = newPointers(node, i);
+                    if (invalidate_nodes && node->type == PSNodeType::CALL_RETURN)
+                        changed |= invalidateReturned(node, ptrs);
+                    changed |= processPhi(node, ptrs);
                 }
             }
             break;
-        case PSNodeType::MEMCPY:
-            changed |= processMemcpy(node);
+        case PSNodeType::CALL_FUNCPTR:
+            if (getOperand(node, 0) == node)
+                break;
+            if (all)
+                changed |= processFuncptrCall(node, getOperand(node, 0)->pointsTo);
+            else
+                changed |= processFuncptrCall(node, newPointers(node, 0));
+            break;
+        case PSNodeType::MEMCPY: {
+            // the source and the destination
+            PSNode *src = getOperand(node, 0);
+            PSNode *dest = getOperand(node, 1);
+            if (all) {
+                changed |= processMemcpy(node, src->pointsTo, dest->pointsTo);
+            } else {
+                // copy from the new source pointers to all destinations
+                // and from all source pointers to the new destinations
+                NewPointers newDest = newPointers(node, 1);
+                changed |= processMemcpy(node, newPointers(node, 0), dest->pointsTo);
+                if (!newDest.empty())
+                    changed |= processMemcpy(node, src->pointsTo, newDest);
+            }
             break;
+        }
         case PSNodeType::ALLOC:
         case PSNodeType::DYN_ALLOC:
         case PSNodeType::FUNCTION:
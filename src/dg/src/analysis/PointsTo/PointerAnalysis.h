@@ -2,11 +2,18 @@
 #define _DG_POINTER_ANALYSIS_H_
 
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "Pointer.h"
 #include "MemoryObject.h"
 #include "PointerSubgraph.h"
+#include "PointsToMapping.h"
+#include "PointsToBudget.h"
+#include "ADT/NumberSet.h"
 #include "ADT/Queue.h"
 
 #include "analysis/SCC.h"
@@ -38,29 +45,127 @@ class PointerAnalysis
     // Invalidate flag
     bool invalidate_nodes;
 
+    // Collapse cycles of nodes that only copy pointers
+    // (PHI and CAST nodes). Such nodes have the same points-to sets,
+    // so the cycle is solved as one node (the representative).
+    // This is sound only in flow-insensitive analysis.
+    bool collapse_cycles;
+
+    // the nodes that are going to be processed, the nodes
+    // with the smaller priority (earlier in the topological order
+    // of the SCC condensation) are processed first
+    ADT::IndexedHeap<PSNode *, uint64_t> worklist;
+    // node ID -> priority, nodes that are unreachable
+    // from the root have the priority UNREACHABLE
+    std::vector<uint64_t> priorities;
+    uint64_t next_priority{0};
+    static const uint64_t UNREACHABLE = ~static_cast<uint64_t>(0);
+
+    // memory object -> IDs of nodes that read it (loads and memcpy)
+    std::unordered_map<const MemoryObject *, ADT::RoaringNumberSet> readers;
+
+    // set when the graph was changed during processing a node
+    // (by building a subgraph on a call via function pointer)
+    bool graph_changed{false};
+
+    // Difference propagation: a node that is queued only because
+    // the points-to sets of its operands changed processes only
+    // the pointers that were added to them since its last processing.
+    // node ID -> pointers added to the points-to set during the run
+    // (in the order in which they were added)
+    std::vector<std::vector<Pointer>> added;
+    // node ID -> for every operand the number of pointers
+    // from 'added' of the operand that the node already processed
+    std::vector<std::vector<size_t>> seen;
+    // node ID -> the node must process the whole points-to sets
+    // of its operands (it was queued because of a change of memory,
+    // of the graph or it was not processed yet)
+    // (not vector<bool>, the nodes may be processed concurrently)
+    std::vector<char> process_all;
+
+    // node ID -> representative of the collapsed cycle
+    // the node is in (nullptr if the node is not collapsed)
+    std::vector<PSNode *> representative;
+    // representative ID -> the nodes of the collapsed cycle
+    std::vector<std::vector<PSNode *>> collapsed_members;
+    // edges (operand ID, node ID) that already triggered
+    // the search for a cycle (we search from every edge only once)
+    std::unordered_set<uint64_t> checked_edges;
+    // collapsed node -> its representative
+    PointsToMapping<PSNode *> collapsed;
+
+    // the number of threads that process the nodes
+    // (1 means that the sequential solver is used)
+    unsigned threads_num{1};
+    // set while the nodes that change only their own points-to sets
+    // are processed in parallel. The changes of the nodes are buffered
+    // and applied when all the nodes are processed.
+    bool parallel_phase{false};
+    // node ID -> the pointers that the node added in the parallel phase
+    std::vector<std::vector<Pointer>> pending_pointers;
+    // node ID -> the memory objects that the node read in the parallel phase
+    std::vector<std::vector<const MemoryObject *>> pending_readers;
+    // the call of an error hook postponed from the parallel phase
+    struct PendingError {
+        PSNode *at;
+        // the target for errorEmptyPointsTo(), nullptr for error()
+        PSNode *to;
+        const char *msg;
+    };
+    // node ID -> the errors that the node reported in the parallel phase
+    std::vector<std::vector<PendingError>> pending_errors;
+
+    // the limits after which the analysis gives up some precision
+    PointsToBudget budget;
+    // the records about the precision that was given up
+    std::vector<PrecisionLoss> losses;
+    // set when some precision was given up, so that the pointers
+    // must be degraded when they are added
+    bool degraded{false};
+    // all the nodes were degraded
+    bool all_offsets_unknown{false};
+    bool all_targets_unknown{false};
+    // node ID -> DEGRADED_* flags of the node
+    std::vector<uint8_t> degradation;
+    // the values stored via pointers to unknown memory. It is used only
+    // when some pointers were degraded to pointers to unknown memory:
+    // the stores via such pointers write here and every load reads it
+    MemoryObject unknown_memory{UNKNOWN_MEMORY};
+    bool unknown_memory_used{false};
+    // the stores that did strong updates, they must be processed
+    // again when their pointers lose precision
+    std::unordered_set<PSNode *> strong_updates;
+    // the state of the time, iterations and memory limits
+    std::chrono::steady_clock::time_point start_time;
+    uint64_t iterations{0};
+    uint64_t pointers_num{0};
+    uint64_t next_time{0};
+    uint64_t next_iterations{0};
+    uint64_t next_memory{0};
+
+    enum : uint8_t {
+        DEGRADED_OFFSETS = 1,
+        DEGRADED_TARGETS = 2,
+        // the allocation is field-insensitive
+        FIELD_INSENSITIVE = 4
+    };
+
 protected:
-    // a set of changed nodes that are going to be
-    // processed by the analysis
-    std::vector<PSNode *> to_process;
-    std::vector<PSNode *> changed;
 
     // protected constructor for child classes
     PointerAnalysis() : PS(nullptr), max_offset(Offset::UNKNOWN),
-                         preprocess_geps(true), invalidate_nodes(false) {}
+                         preprocess_geps(true), invalidate_nodes(false),
+                         collapse_cycles(false) {}
 
 public:
     PointerAnalysis(PointerSubgraph *ps,
                     Offset::type max_off = Offset::UNKNOWN,
-                    bool prepro_geps = true, bool invalid_nodes = false)
-    : PS(ps), max_offset(max_off), preprocess_geps(prepro_geps), invalidate_nodes(invalid_nodes)
+                    bool prepro_geps = true, bool invalid_nodes = false,
+                    bool collapse = false)
+    : PS(ps), max_offset(max_off), preprocess_geps(prepro_geps), invalidate_nodes(invalid_nodes),
+      collapse_cycles(collapse)
     {
         assert(PS && "Need valid PointerSubgraph object");
-
-        // compute the strongly connected components
-        if (prepro_geps) {
-            SCC<PSNode> scc_comp;
-            SCCs = std::move(scc_comp.compute(PS->getRoot()));
-        }
     }
 
     virtual ~PointerAnalysis() {}
@@ -93,6 +198,16 @@ public:
 
     PointerSubgraph *getPS() const { return PS; }
 
+    // set the limits after which the analysis gives up some precision
+    void setBudget(const PointsToBudget& b) { budget = b; }
+    const PointsToBudget& getBudget() const { return budget; }
+
+    // where the analysis gave up the precision because of the budget
+    const std::vector<PrecisionLoss>& getPrecisionLosses() const
+    {
+        return losses;
+    }
+
     void preprocessGEPs()
     {
         // if a node is in a loop (a scc that has more than one node),
@@ -110,67 +225,73 @@ public:
         }
     }
 
+    // queue the node for (re-)processing. Nodes that are not
+    // reachable from the root are not processed at all
     virtual void enqueue(PSNode *n)
     {
-        changed.push_back(n);
+        unsigned id = n->getID();
+        if (id < priorities.size() && priorities[id] != UNREACHABLE) {
+            PSNode *rep = getRepresentative(n);
+            worklist.push(rep, priorities[rep->getID()]);
+            process_all[id] = true;
+        }
     }
 
     void run()
     {
+        // the analysis may need to look at the whole graph first
+        preprocess();
+
         PSNode *root = PS->getRoot();
         assert(root && "Do not have root of PS");
 
+        // compute the strongly connected components,
+        // they give us the order of processing the nodes
+        SCC<PSNode> scc_comp;
+        SCCs = std::move(scc_comp.compute(root));
+
         // do some optimizations
         if (preprocess_geps)
             preprocessGEPs();
 
-        // rely on C++11 move semantics
-        to_process = PS->getNodes(root);
+        computePriorities(scc_comp);
+        resetDifferences();
+        resetCollapsed();
+        resetBudget();
 
-        // do fixpoint
-        do {
-            unsigned last_processed_num = to_process.size();
-            changed.clear();
+        for (PSNode *n : PS->getNodes(root))
+            enqueue(n);
 
-            for (PSNode *cur : to_process) {
-                bool enq = false;
-                enq |= beforeProcessed(cur);
-                enq |= processNode(cur);
-                enq |= afterProcessed(cur);
+        // do fixpoint. When a node changes, we queue only
+        // the nodes that can change due to the change
+        if (threads_num > 1)
+            solveParallel();
+        else
+            solve();
 
-                if (enq)
-                    enqueue(cur);
-            }
-
-            to_process.clear();
+        // free the memory
+        resetDifferences();
+        finishCollapsed();
 
-            if (!changed.empty()) {
-                // DONT std::move - it prevents compiler from copy ellision
-                to_process = PS->getNodes(nullptr /* starting node */,
-                                          &changed /* starting set */,
-                                          last_processed_num /* expected num */);
+        postprocess();
 
-                // since changed was not empty,
-                // the to_process must not be empty too
-                assert(!to_process.empty());
-                assert(to_process.size() >= changed.size());
-            }
-        } while (!to_process.empty());
-
-        assert(to_process.empty());
-        assert(changed.empty());
+        // NOTE: We process only the nodes that are reachable
+        // from the root. In flow-insensitive analysis, the unreachable
+        // nodes could generate new information, but this information
+        // can never get to the reachable nodes in runtime, so this is OK.
+    }
 
-        // NOTE: With flow-insensitive analysis, it may happen that
-        // we have not reached the fixpoint here. This is beacuse
-        // we queue only reachable nodes from the nodes that changed
-        // something. So if in the rechable nodes something generates
-        // new information, than this information could be added to some
-        // node in a new iteration over all nodes. But this information
-        // can never get to that node in runtime, since that node is
-        // unreachable from the point where the information is
-        // generated, so this is OK.
+    // nodes that were collapsed with other nodes in a cycle
+    // (and so have the same points-to set) -> the representative
+    const PointsToMapping<PSNode *>& getCollapsedNodes() const
+    {
+        return collapsed;
     }
 
+    // The error hooks are never called concurrently, the parallel solver
+    // calls them for the nodes processed in parallel only after
+    // the parallel phase (one by one), so they need not be thread-safe.
+
     // generic error
     // @msg - message for the user
     // XXX: maybe create some enum that will represent the error
@@ -199,11 +320,308 @@ public:
         return false;
     }
 
+protected:
+    // set the number of threads that process the nodes,
+    // 0 means the number of hardware threads. The analysis that
+    // uses more threads must implement prepareParallelProcessing().
+    // The points-to sets that are not thread-safe use only one thread.
+    void setThreadsNum(unsigned num);
+
+    // called before the nodes that do not change memory are processed
+    // in parallel. After this call, getMemoryObjects() must not change
+    // anything when called for such nodes (so that it can be called
+    // from more threads at once)
+    virtual void prepareParallelProcessing(PointerSubgraph * /*ps*/) {}
+
+    // called at the beginning of run(), before the nodes
+    // are ordered for processing. The analysis may run
+    // a pre-analysis here (and even change the graph).
+    virtual void preprocess() {}
+
+    // called at the end of run(), when the points-to sets are computed
+    virtual void postprocess() {}
+
+    // add the nodes that can be affected by a change of memory
+    // at the node 'n' to 'deps'. The memory objects in
+    // flow-insensitive analysis are shared by all nodes, so the readers
+    // of changed memory objects are queued and nothing else is needed.
+    // Flow-sensitive analyses propagate the memory along the CFG.
+    virtual void getMemoryDependents(PSNode * /*n*/,
+                                     std::vector<PSNode *>& /*deps*/) {}
+
+    // the pointers that the store overwrites (strong update), or nullptr
+    // if the pointers of the store could lose precision because
+    // of the budget. When that happens after the store did strong updates,
+    // the store is queued again and strongUpdateLost() is called
+    // from here when it is processed.
+    PointsToSetT *getStrongUpdate(PSNode *n)
+    {
+        assert(n->getType() == PSNodeType::STORE);
+        if (hasPrecisePointers(n->getOperand(1))) {
+            if (!budget.isUnlimited())
+                strong_updates.insert(n);
+            return &n->getOperand(1)->pointsTo;
+        }
+
+        if (strong_updates.erase(n) > 0)
+            strongUpdateLost(n);
+
+        return nullptr;
+    }
+
+    // the store does not do strong updates anymore, so the values that
+    // it overwrote before must be merged to its memory again
+    virtual void strongUpdateLost(PSNode * /*store*/) {}
+
+    // false if the pointers of the node could lose precision
+    // because of the budget (the flow-sensitive analyses must not
+    // do strong updates via such pointers)
+    bool hasPrecisePointers(PSNode *n) const
+    {
+        if (!degraded)
+            return true;
+
+        if (all_offsets_unknown || all_targets_unknown || getDegradation(n) != 0)
+            return false;
+
+        for (const Pointer& ptr : n->pointsTo) {
+            if (getDegradation(ptr.target) & FIELD_INSENSITIVE)
+                return false;
+        }
+
+        return true;
+    }
+
 private:
+    // the pointers from the log of added pointers of a node
+    // (a range of indices, so that the logs can grow meanwhile
+    // -- the logs of all nodes can be even reallocated)
+    class NewPointers {
+        using LogsT = std::vector<std::vector<Pointer>>;
+
+        const LogsT *logs{nullptr};
+        unsigned id{0};
+        size_t from{0};
+        size_t to{0};
+
+    public:
+        NewPointers() = default;
+        NewPointers(const LogsT *l, unsigned i, size_t f, size_t t)
+        : logs(l), id(i), from(f), to(t) {}
+
+        class const_iterator {
+            const LogsT *logs;
+            unsigned id;
+            size_t pos;
+
+        public:
+            const_iterator(const LogsT *l, unsigned i, size_t p)
+            : logs(l), id(i), pos(p) {}
+
+            const_iterator& operator++() { ++pos; return *this; }
+            Pointer operator*() const { return (*logs)[id][pos]; }
+
+            bool operator==(const const_iterator& rhs) const {
+                return pos == rhs.pos;
+            }
+
+            bool operator!=(const const_iterator& rhs) const {
+                return !operator==(rhs);
+            }
+        };
+
+        const_iterator begin() const { return const_iterator(logs, id, from); }
+        const_iterator end() const { return const_iterator(logs, id, to); }
+        bool empty() const { return from == to; }
+    };
+
+    void solve();
+    // process the whole worklist in rounds, the nodes that change only
+    // their own points-to sets are processed in parallel in every round
+    void solveParallel();
+    void processParallel(const std::vector<PSNode *>& nodes);
+    // can the node be processed in parallel with other such nodes?
+    static bool isParallelSafe(PSNode *n);
+
+    void computePriorities(const SCC<PSNode>& scc_comp);
+    void enqueueReachable(PSNode *n);
+    void enqueueDependents(PSNode *n);
+
+    // queue a node because the points-to set of its operand changed
+    void enqueueUser(PSNode *n)
+    {
+        unsigned id = n->getID();
+        if (id < priorities.size() && priorities[id] != UNREACHABLE) {
+            PSNode *rep = getRepresentative(n);
+            worklist.push(rep, priorities[rep->getID()]);
+        }
+    }
+
+    PSNode *getRepresentative(PSNode *n) const
+    {
+        unsigned id = n->getID();
+        if (id < representative.size() && representative[id])
+            return representative[id];
+
+        return n;
+    }
+
+    // the operand of the node (its representative, if it was collapsed)
+    PSNode *getOperand(PSNode *node, unsigned idx) const
+    {
+        return getRepresentative(node->getOperand(idx));
+    }
+
+    // the nodes that only copy pointers from operands
+    // and that can be collapsed if they are in a cycle
+    bool isCopy(PSNode *n) const
+    {
+        unsigned id = n->getID();
+        return (n->getType() == PSNodeType::PHI ||
+                n->getType() == PSNodeType::CAST) &&
+                id < priorities.size() && priorities[id] != UNREACHABLE;
+    }
+
+    void resetCollapsed();
+    void finishCollapsed();
+    void detectCycle(PSNode *n);
+    void collapse(const std::vector<PSNode *>& cycle);
+    bool processCollapsed(PSNode *rep);
+
+    void resetDifferences();
+    // return true if the node must process the whole
+    // points-to sets of the operands
+    bool startProcessing(PSNode *node);
+    // pointers added to the operand 'idx' of 'node'
+    // since the last time the node processed them
+    NewPointers newPointers(PSNode *node, unsigned idx);
+    // add the pointer to the points-to set of the node
+    // and remember it, if it was not there
+    bool addPointer(PSNode *node, const Pointer& ptr);
+
+    // call the error hooks, in the parallel phase the calls are only
+    // recorded (with the processed node) and made after the phase
+    bool reportError(PSNode *node, PSNode *at, const char *msg)
+    {
+        if (parallel_phase) {
+            pending_errors[node->getID()].push_back({at, nullptr, msg});
+            return false;
+        }
+
+        return error(at, msg);
+    }
+
+    bool reportEmptyPointsTo(PSNode *from, PSNode *to)
+    {
+        if (parallel_phase) {
+            pending_errors[from->getID()].push_back({from, to, nullptr});
+            return false;
+        }
+
+        return errorEmptyPointsTo(from, to);
+    }
+
+    void registerReader(const MemoryObject *mo, PSNode *n)
+    {
+        if (parallel_phase) {
+            pending_readers[n->getID()].push_back(mo);
+            return;
+        }
+
+        readers[mo].add(n->getID());
+    }
+
+    // queue the nodes that read the changed memory object
+    void memoryObjectChanged(const MemoryObject *mo)
+    {
+        auto it = readers.find(mo);
+        if (it == readers.end())
+            return;
+
+        for (auto id : it->second) {
+            if (PSNode *reader = PS->getNodes()[id])
+                enqueue(reader);
+        }
+    }
+
+    uint8_t getDegradation(PSNode *n) const
+    {
+        unsigned id = n->getID();
+        return id < degradation.size() ? degradation[id] : 0;
+    }
+
+    void setDegradation(PSNode *n, uint8_t flags)
+    {
+        unsigned id = n->getID();
+        assert(id != 0 && "Degrading a special node");
+        if (id >= degradation.size())
+            degradation.resize(PS->size() > id ? PS->size() : id + 1, 0);
+        degradation[id] |= flags;
+        degraded = true;
+    }
+
+    // the pointer that is added to the points-to set of the node
+    // when the precision was given up
+    Pointer degrade(PSNode *node, const Pointer& ptr) const;
+    // the offset where the pointers are stored to the object
+    Offset degradeOffset(const MemoryObject *mo, const Offset& off) const
+    {
+        if (degraded && (all_offsets_unknown ||
+                         (getDegradation(mo->node) & FIELD_INSENSITIVE)))
+            return Offset::UNKNOWN;
+        return off;
+    }
+
+    void resetBudget();
+    // check the time, iterations and memory limits
+    void checkGlobalBudget(uint64_t processed);
+    // check the size of the points-to set of the node,
+    // return true if the points-to set changed
+    bool checkNodeBudget(PSNode *node);
+    // check the number of offsets in the memory object
+    void checkObjectBudget(MemoryObject *mo);
+    // give up precision in all nodes
+    void degradeAll(PrecisionLoss::Reason reason);
+    // give up precision in the node, return true
+    // if the points-to set of the node changed
+    bool degradeNode(PSNode *node, uint8_t flags, PrecisionLoss::Reason reason);
+    // add the pointers of the node again, so that they are degraded
+    bool rebuildPointsTo(PSNode *node);
+    void makeFieldInsensitive(PSNode *target, PrecisionLoss::Reason reason);
+    void useUnknownMemory();
+    // queue the stores that did strong updates via pointers
+    // that are not precise anymore
+    void requeueStrongUpdates();
+
+    // add the pointer(s) to the memory object
+    bool addToMemory(MemoryObject *mo, const Offset& off, const Pointer& ptr);
+    bool addToMemory(MemoryObject *mo, const Offset& off,
+                     const PointsToSetT& pointers);
+    // the loads and memcpys read also the values stored
+    // via pointers to unknown memory
+    bool loadUnknownMemory(PSNode *node);
+    template <typename SrcPointersT, typename DestPointersT>
+    bool processUnknownMemcpy(PSNode *node, const SrcPointersT& src,
+                              const DestPointersT& dest);
+
     bool processNode(PSNode *);
-    bool processLoad(PSNode *node);
-    bool processGep(PSNode *node);
-    bool processMemcpy(PSNode *node);
+    bool processLoad(PSNode *node, bool all);
+    template <typename PointersT>
+    bool processLoad(PSNode *node, const PointersT& pointers);
+    template <typename PointersT, typename ValuesT>
+    bool processStore(PSNode *node, const PointersT& pointers,
+                      const ValuesT& values);
+    template <typename PointersT>
+    bool processGep(PSNode *node, const PointersT& pointers);
+    template <typename PointersT>
+    bool processPhi(PSNode *node, const PointersT& pointers);
+    template <typename PointersT>
+    bool processFuncptrCall(PSNode *node, const PointersT& pointers);
+    template <typename PointersT>
+    bool invalidateReturned(PSNode *node, const PointersT& pointers);
+    template <typename SrcPointersT, typename DestPointersT>
+    bool processMemcpy(PSNode *node, const SrcPointersT& src,
+                       const DestPointersT& dest);
     bool processMemcpy(std::vector<MemoryObject *>& srcObjects,
                        std::vector<MemoryObject *>& destObjects,
                        const Pointer& sptr, const Pointer& dptr,
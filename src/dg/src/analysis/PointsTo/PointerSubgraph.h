@@ -2,9 +2,15 @@
 #define _DG_POINTER_SUBGRAPH_H_
 
 #include <cassert>
-#include <vector>
 #include <cstdarg>
+#include <cstdlib>
+#include <initializer_list>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "ADT/Arena.h"
 #include "ADT/Queue.h"
 #include "analysis/SubgraphNode.h"
 #include "PSNode.h"
@@ -23,15 +29,42 @@ class PointerSubgraph
     PSNode *root;
 
     unsigned int last_node_id = 0;
+    // the nodes are allocated in the arena in the order
+    // of their IDs and are all released at once with the graph
+    ADT::Arena arena;
     std::vector<PSNode *> nodes;
 
+    template <typename NodeT, typename... Args>
+    NodeT *createNode(Args&&... args) {
+        void *mem = arena.allocate(sizeof(NodeT), alignof(NodeT));
+        NodeT *node = new (mem) NodeT(++last_node_id, std::forward<Args>(args)...);
+        nodes.push_back(node);
+        return node;
+    }
+
+    template <typename NodeT = PSNode>
+    NodeT *createWithOperands(PSNodeType t, std::initializer_list<PSNode *> ops) {
+        NodeT *node = createNode<NodeT>(t);
+        for (PSNode *op : ops)
+            node->addOperand(op);
+        return node;
+    }
+
+    // the nodes must be destroyed only by the graph,
+    // their memory is owned by the arena
+    void destroy(PSNode *nd) {
+        nd->~PSNode();
+    }
+
 public:
     ~PointerSubgraph() {
-        for (PSNode *n : nodes)
-            delete n;
+        for (PSNode *n : nodes) {
+            if (n)
+                destroy(n);
+        }
     }
 
-    PointerSubgraph() : dfsnum(0), root(nullptr) {
+    PointerSubgraph() : dfsnum(0), root(nullptr), arena(16 * 1024) {
         nodes.reserve(128);
         // nodes[0] is nullptr (the node with id 0)
         nodes.push_back(nullptr);
@@ -68,51 +101,188 @@ public:
         assert(nd->getID() < size());
         assert(nodes[nd->getID()] == nd && "Inconsistency in nodes");
 
-        // clear the nodes entry
+        // clear the nodes entry, the memory
+        // is released together with the graph
         nodes[nd->getID()] = nullptr;
-        delete nd;
+        destroy(nd);
+    }
+
+    // type-safe builders of the nodes,
+    // see the PSNode constructor for the semantics of operands
+    PSNodeAlloc *createAlloc() {
+        return createNode<PSNodeAlloc>(PSNodeType::ALLOC);
+    }
+
+    PSNodeAlloc *createDynAlloc() {
+        return createNode<PSNodeAlloc>(PSNodeType::DYN_ALLOC);
+    }
+
+    PSNode *createFunction() {
+        return createNode<PSNode>(PSNodeType::FUNCTION);
+    }
+
+    PSNode *createNoop() {
+        return createNode<PSNode>(PSNodeType::NOOP);
+    }
+
+    PSNodeEntry *createEntry(const std::string& name = "not-known") {
+        return createNode<PSNodeEntry>(name);
+    }
+
+    PSNode *createLoad(PSNode *from) {
+        return createWithOperands(PSNodeType::LOAD, {from});
+    }
+
+    // store 'val' to the memory pointed by 'to'
+    PSNode *createStore(PSNode *val, PSNode *to) {
+        return createWithOperands(PSNodeType::STORE, {val, to});
+    }
+
+    PSNodeGep *createGep(PSNode *src, Offset off) {
+        return createNode<PSNodeGep>(src, off);
+    }
+
+    PSNode *createCast(PSNode *op) {
+        return createWithOperands(PSNodeType::CAST, {op});
+    }
+
+    PSNodeMemcpy *createMemcpy(PSNode *src, PSNode *dest, Offset len) {
+        return createNode<PSNodeMemcpy>(src, dest, len);
+    }
+
+    PSNode *createConstant(PSNode *target, Offset off) {
+        return createNode<PSNode>(PSNodeType::CONSTANT, target, off);
     }
 
+    PSNode *createPhi(std::initializer_list<PSNode *> ops = {}) {
+        return createWithOperands(PSNodeType::PHI, ops);
+    }
+
+    PSNodeCall *createCall(std::initializer_list<PSNode *> ops = {}) {
+        PSNodeCall *node = createNode<PSNodeCall>();
+        for (PSNode *op : ops)
+            node->addOperand(op);
+        return node;
+    }
+
+    PSNode *createCallFuncPtr(PSNode *op) {
+        return createWithOperands(PSNodeType::CALL_FUNCPTR, {op});
+    }
+
+    PSNode *createCallReturn(std::initializer_list<PSNode *> ops = {}) {
+        return createWithOperands(PSNodeType::CALL_RETURN, ops);
+    }
+
+    PSNodeRet *createReturn(std::initializer_list<PSNode *> ops = {}) {
+        PSNodeRet *node = createNode<PSNodeRet>();
+        for (PSNode *op : ops)
+            node->addOperand(op);
+        return node;
+    }
+
+    PSNode *createInvalidateLocals(PSNode *op) {
+        return createWithOperands(PSNodeType::INVALIDATE_LOCALS, {op});
+    }
+
+    PSNode *createInvalidateObject(PSNode *op) {
+        return createWithOperands(PSNodeType::INVALIDATE_OBJECT, {op});
+    }
+
+    PSNode *createFree(PSNode *op) {
+        return createWithOperands(PSNodeType::FREE, {op});
+    }
+
+    // Create a node with variable arguments (the same as the
+    // arguments of the builders above, lists of operands are
+    // null-terminated). This is kept only for backward compatibility,
+    // use the type-safe builders instead.
     PSNode *create(PSNodeType t, ...) {
         va_list args;
         PSNode *node = nullptr;
+        PSNode *op1, *op2, *op;
+        Offset::type off;
 
+        // NOTE: read every argument in its own statement,
+        // the order of evaluation of function arguments is unspecified
         va_start(args, t);
         switch (t) {
             case PSNodeType::ALLOC:
+                node = createAlloc();
+                break;
             case PSNodeType::DYN_ALLOC:
-                node = new PSNodeAlloc(++last_node_id, t);
+                node = createDynAlloc();
+                break;
+            case PSNodeType::FUNCTION:
+                node = createFunction();
+                break;
+            case PSNodeType::NOOP:
+                node = createNoop();
+                break;
+            case PSNodeType::ENTRY:
+                node = createEntry();
                 break;
             case PSNodeType::GEP:
-                node = new PSNodeGep(++last_node_id,
-                                     va_arg(args, PSNode *),
-                                     va_arg(args, Offset::type));
+                op1 = va_arg(args, PSNode *);
+                off = va_arg(args, Offset::type);
+                node = createGep(op1, off);
                 break;
             case PSNodeType::MEMCPY:
-                node = new PSNodeMemcpy(++last_node_id,
-                                        va_arg(args, PSNode *),
-                                        va_arg(args, PSNode *),
-                                        va_arg(args, Offset::type));
+                op1 = va_arg(args, PSNode *);
+                op2 = va_arg(args, PSNode *);
+                off = va_arg(args, Offset::type);
+                node = createMemcpy(op1, op2, off);
                 break;
             case PSNodeType::CONSTANT:
-                node = new PSNode(++last_node_id, PSNodeType::CONSTANT,
-                                  va_arg(args, PSNode *),
-                                  va_arg(args, Offset::type));
+                op1 = va_arg(args, PSNode *);
+                off = va_arg(args, Offset::type);
+                node = createConstant(op1, off);
                 break;
-            case PSNodeType::ENTRY:
-                node = new PSNodeEntry(++last_node_id);
+            case PSNodeType::STORE:
+                op1 = va_arg(args, PSNode *);
+                op2 = va_arg(args, PSNode *);
+                node = createStore(op1, op2);
+                break;
+            case PSNodeType::CAST:
+            case PSNodeType::LOAD:
+            case PSNodeType::CALL_FUNCPTR:
+            case PSNodeType::INVALIDATE_LOCALS:
+            case PSNodeType::INVALIDATE_OBJECT:
+            case PSNodeType::FREE:
+                node = createWithOperands(t, {va_arg(args, PSNode *)});
                 break;
             case PSNodeType::CALL:
-                node = new PSNodeCall(++last_node_id);
+                node = createCall();
+                break;
+            case PSNodeType::RETURN:
+                node = createReturn();
+                break;
+            case PSNodeType::CALL_RETURN:
+            case PSNodeType::PHI:
+                node = createWithOperands(t, {});
+                break;
+            default:
+                assert(0 && "Unknown type");
+                abort();
+        }
+
+        // CALL never took its operands from the arguments
+        switch (t) {
+            case PSNodeType::RETURN:
+            case PSNodeType::CALL_RETURN:
+            case PSNodeType::PHI:
+                // the operands are null terminated
+                op = va_arg(args, PSNode *);
+                while (op) {
+                    node->addOperand(op);
+                    op = va_arg(args, PSNode *);
+                }
                 break;
             default:
-                node = new PSNode(++last_node_id, t, args);
                 break;
         }
         va_end(args);
 
         assert(node && "Didn't created node");
-        nodes.push_back(node);
         return node;
     }
 
@@ -143,8 +313,10 @@ public:
         }
 
         std::vector<PSNode *> cont;
-        if (expected_num != 0)
+        if (expected_num != 0) {
             cont.reserve(expected_num);
+            fifo.reserve(expected_num);
+        }
 
         while (!fifo.empty()) {
             PSNode *cur = fifo.pop();
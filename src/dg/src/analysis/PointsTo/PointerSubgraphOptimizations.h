@@ -1,6 +1,11 @@
 #ifndef _DG_POINTER_SUBGRAPH_OPTIMIZATIONS_H_
 #define _DG_POINTER_SUBGRAPH_OPTIMIZATIONS_H_
 
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
 #include "PointsToMapping.h"
 
 namespace dg {
@@ -174,8 +179,14 @@ private:
     // the representant and node1 will be removed,
     // mapping will be set to  node1 -> node2)
     void merge(PSNode *node1, PSNode *node2) {
+        // merging nodes in a cycle (e.g. a phi and a cast
+        // of the phi) can leave a node that is its own operand
+        if (node1 == node2)
+            return;
+
         // remove node1
         node1->replaceAllUsesWith(node2);
+        node1->removeAllOperands();
         node1->isolate();
         PS->remove(node1);
 
@@ -192,6 +203,162 @@ private:
     unsigned merged_nodes_num;
 };
 
+// Offline variable substitution (hash-based value numbering):
+// find the nodes that must have the same points-to sets
+// before the analysis runs and merge them. These are
+//  - GEPs with the same source and offset,
+//  - constants with the same pointer,
+//  - phis with the same set of operands,
+//  - loads of the same pointer with no node that can change
+//    memory between them (on a straight path in the graph).
+// Merging a node can make other nodes equivalent (e.g. GEPs
+// of merged loads), so we iterate until nothing changes.
+// We merge only the nodes reachable from the root, because only
+// those are processed by the analysis (a representative that is not
+// reachable would never get its points-to set).
+class PSVariableSubstitution {
+public:
+    using MappingT = PointsToMapping<PSNode *>;
+
+    PSVariableSubstitution(PointerSubgraph *S) : PS(S) {}
+
+    MappingT& getMapping() { return mapping; }
+    const MappingT& getMapping() const { return mapping; }
+
+    unsigned getNumOfMergedNodes() const {
+        return merged_nodes_num;
+    }
+
+    unsigned run() {
+        computeReachable();
+
+        unsigned merged;
+        do {
+            merged = merged_nodes_num;
+            mergeValues();
+            mergeLoads();
+        } while (merged != merged_nodes_num);
+
+        // a representative may have been merged later too,
+        // make the mapping point to the final representatives
+        for (auto& it : mapping) {
+            while (PSNode *rep = mapping.get(it.second))
+                it.second = rep;
+        }
+
+        return merged_nodes_num;
+    }
+
+private:
+    void computeReachable() {
+        reachable.resize(PS->size());
+        std::vector<PSNode *> stack{PS->getRoot()};
+        reachable[PS->getRoot()->getID()] = true;
+        while (!stack.empty()) {
+            PSNode *cur = stack.back();
+            stack.pop_back();
+
+            for (PSNode *succ : cur->getSuccessors()) {
+                if (!reachable[succ->getID()]) {
+                    reachable[succ->getID()] = true;
+                    stack.push_back(succ);
+                }
+            }
+        }
+    }
+
+    // the nodes that do not change memory
+    static bool isPure(PSNode *nd) {
+        switch (nd->getType()) {
+            case PSNodeType::LOAD:
+            case PSNodeType::GEP:
+            case PSNodeType::CAST:
+            case PSNodeType::PHI:
+            case PSNodeType::CONSTANT:
+            case PSNodeType::NOOP:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void mergeValues() {
+        std::map<std::pair<PSNode *, uint64_t>, PSNode *> geps;
+        std::map<std::pair<PSNode *, uint64_t>, PSNode *> constants;
+        std::map<std::vector<PSNode *>, PSNode *> phis;
+
+        for (PSNode *node : PS->getNodes()) {
+            if (!node || !reachable[node->getID()])
+                continue;
+
+            PSNode *rep = nullptr;
+            if (PSNodeGep *GEP = PSNodeGep::get(node)) {
+                auto key = std::make_pair(GEP->getSource(), *GEP->getOffset());
+                rep = geps.emplace(key, node).first->second;
+            } else if (node->getType() == PSNodeType::CONSTANT) {
+                const Pointer& ptr = *node->pointsTo.begin();
+                auto key = std::make_pair(ptr.target, *ptr.offset);
+                rep = constants.emplace(key, node).first->second;
+            } else if (node->getType() == PSNodeType::PHI &&
+                       node->getOperandsNum() > 0) {
+                // the points-to set of a phi is the union of the sets
+                // of operands, so the order and duplicates do not matter
+                std::vector<PSNode *> key = node->getOperands();
+                std::sort(key.begin(), key.end());
+                key.erase(std::unique(key.begin(), key.end()), key.end());
+                rep = phis.emplace(std::move(key), node).first->second;
+            }
+
+            if (rep && rep != node)
+                merge(node, rep);
+        }
+    }
+
+    void mergeLoads() {
+        for (PSNode *node : PS->getNodes()) {
+            if (!node || !reachable[node->getID()] ||
+                node->getType() != PSNodeType::LOAD)
+                continue;
+
+            // go down the straight path from the load
+            // until something can change the memory
+            PSNode *cur = node;
+            while (cur->successorsNum() == 1) {
+                PSNode *succ = cur->getSingleSuccessor();
+                if (succ == node || succ->predecessorsNum() != 1 ||
+                    !isPure(succ))
+                    break;
+
+                if (succ->getType() == PSNodeType::LOAD &&
+                    succ->getOperand(0) == node->getOperand(0)) {
+                    // isolating 'succ' connects 'cur'
+                    // to the successors of 'succ'
+                    merge(succ, node);
+                } else
+                    cur = succ;
+            }
+        }
+    }
+
+    // merge node1 to node2 (the representant)
+    void merge(PSNode *node1, PSNode *node2) {
+        node1->replaceAllUsesWith(node2);
+        node1->removeAllOperands();
+        node1->isolate();
+        PS->remove(node1);
+
+        mapping.add(node1, node2);
+        ++merged_nodes_num;
+    }
+
+    PointerSubgraph *PS;
+    // map nodes to its equivalent representant
+    MappingT mapping;
+    std::vector<bool> reachable;
+
+    unsigned merged_nodes_num{0};
+};
+
 class PointerSubgraphOptimizer {
     using MappingT = PointsToMapping<PSNode *>;
 
@@ -223,9 +390,21 @@ public:
         }
     }
 
+    void substituteVariables() {
+        PSVariableSubstitution substitution(PS);
+        if (auto r = substitution.run()) {
+            // the previous mappings may point to the merged nodes
+            MappingT merged = substitution.getMapping();
+            mapping.compose(std::move(merged));
+            mapping.merge(std::move(substitution.getMapping()));
+            removed += r;
+        }
+    }
+
     unsigned run() {
         removeNoops();
         removeEquivalentNodes();
+        substituteVariables();
         removeUnknowns();
         // need to call this once more because
         // the optimizations may have created
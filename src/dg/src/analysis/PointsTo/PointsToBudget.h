@@ -0,0 +1,100 @@
+#ifndef _DG_POINTS_TO_BUDGET_H_
+#define _DG_POINTS_TO_BUDGET_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dg {
+namespace analysis {
+namespace pta {
+
+class PSNode;
+
+// The limits of the pointer analysis. When a limit is exceeded,
+// the analysis gives up some precision, so that it can finish
+// (the results stay sound). 0 means no limit.
+struct PointsToBudget {
+    // the time of the analysis in milliseconds
+    uint64_t time{0};
+    // the number of processed nodes
+    uint64_t iterations{0};
+    // the number of pointers in the points-to set of a node
+    size_t pointsToSize{0};
+    // the number of offsets of one object (in the points-to set
+    // of a node or in a memory object)
+    size_t offsets{0};
+    // the number of pointers added to the points-to sets and memory
+    // objects (an approximation of the used memory)
+    uint64_t memory{0};
+
+    bool isUnlimited() const {
+        return time == 0 && iterations == 0 && pointsToSize == 0 &&
+               offsets == 0 && memory == 0;
+    }
+};
+
+// The record about the precision that the analysis gave up.
+//
+// The time, iterations and memory limits degrade all the nodes:
+// when one of them is exceeded for the first time, all the offsets
+// become unknown. When it is exceeded again (the limit is counted
+// from the previous degradation), the pointers to all memory become
+// pointers to unknown memory. The pointsToSize limit degrades the same
+// way only the node whose points-to set is too big and the offsets limit
+// makes the object field-insensitive.
+struct PrecisionLoss {
+    enum class Reason {
+        TIME,
+        ITERATIONS,
+        POINTS_TO_SIZE,
+        OFFSETS,
+        MEMORY
+    };
+
+    enum class Action {
+        // the pointers have unknown offsets
+        UNKNOWN_OFFSETS,
+        // the pointers to memory are pointers to unknown memory
+        // (the pointers to functions, null and invalidated are kept)
+        UNKNOWN_TARGETS,
+        // all the offsets of the object are unknown
+        FIELD_INSENSITIVE
+    };
+
+    Reason reason;
+    Action action;
+    // the degraded node or the allocation that was made field-insensitive
+    // (nullptr if all the nodes were degraded)
+    PSNode *node;
+
+    PrecisionLoss(Reason r, Action a, PSNode *n)
+    : reason(r), action(a), node(n) {}
+};
+
+inline const char *toString(PrecisionLoss::Reason r) {
+    switch (r) {
+        case PrecisionLoss::Reason::TIME: return "time";
+        case PrecisionLoss::Reason::ITERATIONS: return "iterations";
+        case PrecisionLoss::Reason::POINTS_TO_SIZE: return "points-to set size";
+        case PrecisionLoss::Reason::OFFSETS: return "offsets";
+        case PrecisionLoss::Reason::MEMORY: return "memory";
+    }
+
+    return "unknown";
+}
+
+inline const char *toString(PrecisionLoss::Action a) {
+    switch (a) {
+        case PrecisionLoss::Action::UNKNOWN_OFFSETS: return "unknown offsets";
+        case PrecisionLoss::Action::UNKNOWN_TARGETS: return "unknown targets";
+        case PrecisionLoss::Action::FIELD_INSENSITIVE: return "field-insensitive";
+    }
+
+    return "unknown";
+}
+
+} // namespace pta
+} // namespace analysis
+} // namespace dg
+
+#endif // _DG_POINTS_TO_BUDGET_H_
@@ -0,0 +1,708 @@
+#ifndef _DG_ANALYSIS_POINTS_TO_CONTEXT_SENSITIVE_H_
+#define _DG_ANALYSIS_POINTS_TO_CONTEXT_SENSITIVE_H_
+
+#include <cassert>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "PointerAnalysis.h"
+#include "PointerSubgraph.h"
+#include "analysis/SCC.h"
+
+namespace dg {
+namespace analysis {
+namespace pta {
+
+// Context-sensitive version of the pointer analysis PTA
+// (PointsToFlowInsensitive, PointsToFlowSensitive, ...).
+//
+// Before solving, every call gets its own copy of the called function.
+// The calls in the copy get copies of their callees and so on, up to
+// the depth 'k', so the contexts are the call strings of length k.
+// The sizes of the copies are computed bottom-up over the strongly
+// connected components of the call graph and cached in the summaries
+// of functions, so we know in advance whether a copy fits into the budget.
+// Calls in recursion, calls of functions that can not be copied
+// (they call via function pointers) and calls whose copies would
+// exceed the budget stay context-insensitive.
+//
+// After solving, the points-to sets of the copies are merged to
+// the original nodes (pointers to copies of allocations become pointers
+// to the original allocations) and the copies are removed from the graph,
+// so the graph and the points-to sets look as if no copies were created.
+// The memory objects of the analysis are not rewritten, they may still
+// refer to the removed copies. Running the analysis again creates
+// new copies.
+//
+// A copy of a function takes only the operands of the formal arguments
+// (PHI nodes) that are the actual arguments of its call. These are
+// the operands of the CALL node if it has some. The LLVM front-end
+// creates CALL nodes without operands and adds the actual arguments
+// only to the formal arguments, so then the arguments of the call are
+// the operands of the formal arguments that belong to the calling function
+// (the calls from one function share their arguments). The operands that
+// belong to no calling function (globals, constants) or to the root
+// are taken by every copy.
+template <typename PTA>
+class PointsToContextSensitive : public PTA
+{
+public:
+    // @k      - the maximal depth of the nested copies of functions
+    // @budget - the maximal number of nodes created for the copies
+    //           (0 means the number of nodes of the graph)
+    PointsToContextSensitive(PointerSubgraph *ps, unsigned k = 2,
+                             size_t budget = 0)
+    : PTA(ps), max_depth(k), budget(budget == 0 ? ps->size() : budget) {}
+
+    // the number of nodes created for the copies of functions
+    size_t getCopiedNodesNum() const { return copied_nodes; }
+
+    // the number of calls that stayed context-insensitive,
+    // because their copies would not fit into the budget
+    size_t getFallbackCallsNum() const { return fallback_calls; }
+
+protected:
+    void preprocess() override
+    {
+        buildContexts();
+        connect();
+        PTA::preprocess();
+    }
+
+    void postprocess() override
+    {
+        PTA::postprocess();
+        mergeCopies();
+        disconnect();
+        removeCopies();
+    }
+
+private:
+    // the summary of a function
+    struct Function {
+        // the ENTRY node (or the root of the graph)
+        PSNode *entry;
+        std::vector<PSNode *> nodes;
+        std::unordered_set<PSNode *> members;
+        std::vector<PSNode *> returns;
+        // the CALL nodes that call some functions
+        std::vector<PSNode *> calls;
+        // the functions called from this function (the call graph)
+        std::vector<Function *> callees;
+        // the operands of the formal arguments that are actual
+        // arguments of some calls (the rest is taken by every copy)
+        std::unordered_set<PSNode *> actuals;
+        // depth -> the number of nodes of the copy of the function
+        // (including the nested copies of callees)
+        std::vector<size_t> sizes;
+        // the component of the call graph
+        unsigned scc{0};
+        bool copyable{true};
+        // the calls in the original function were processed
+        bool expanded{false};
+
+        Function(PSNode *e) : entry(e) {}
+
+        const std::vector<Function *>& getSuccessors() const { return callees; }
+    };
+
+    using CopiesT = std::unordered_map<PSNode *, PSNode *>;
+
+    // a copy of a function for a call
+    struct Instance {
+        Function *function;
+        // the original call
+        PSNode *call;
+        // the copies of the caller (nullptr if the caller is an original)
+        const CopiesT *caller;
+        CopiesT copies;
+
+        Instance(Function *f, PSNode *c, const CopiesT *cl)
+        : function(f), call(c), caller(cl) {}
+    };
+
+    unsigned max_depth;
+    size_t budget;
+    size_t copied_nodes{0};
+    size_t fallback_calls{0};
+
+    // ENTRY node (or root) -> the summary of the function
+    std::unordered_map<PSNode *, std::unique_ptr<Function>> functions;
+    // CALL node -> the function that contains it
+    std::unordered_map<PSNode *, Function *> callers;
+    // the original functions whose calls are to be processed
+    std::vector<Function *> to_expand;
+    // node ID -> the original node (nullptr if the node is not a copy)
+    std::vector<PSNode *> origins;
+
+    // the changes of the original nodes that connect the copies
+    // to the graph (done in connect(), undone in disconnect())
+    std::vector<std::pair<PSNode *, PSNode *>> removed_edges;
+    std::vector<std::pair<PSNode *, PSNode *>> added_edges;
+    // (node, original operand, copy of the operand)
+    std::vector<std::tuple<PSNode *, PSNode *, PSNode *>> replaced_operands;
+    std::vector<std::pair<PSNode *, PSNode *>> added_operands;
+
+    static void getCallees(PSNode *call, std::vector<PSNode *>& entries) {
+        for (PSNode *succ : call->getSuccessors()) {
+            if (succ->getType() == PSNodeType::ENTRY)
+                entries.push_back(succ);
+        }
+    }
+
+    static bool hasSuccessor(PSNode *n, PSNode *succ) {
+        for (PSNode *s : n->getSuccessors()) {
+            if (s == succ)
+                return true;
+        }
+        return false;
+    }
+
+    Function *getFunction(PSNode *entry) {
+        auto& f = functions[entry];
+        if (!f) {
+            f.reset(new Function(entry));
+            computeBody(f.get());
+        }
+        return f.get();
+    }
+
+    // the nodes of the function are the nodes reachable from the entry
+    // without entering the called functions (we continue from the call
+    // to its CALL_RETURN) and without returning
+    void computeBody(Function *f) {
+        std::vector<PSNode *> stack{f->entry};
+        f->members.insert(f->entry);
+
+        auto push = [f, &stack](PSNode *n) {
+            if (f->members.insert(n).second)
+                stack.push_back(n);
+        };
+
+        while (!stack.empty()) {
+            PSNode *n = stack.back();
+            stack.pop_back();
+            f->nodes.push_back(n);
+
+            switch (n->getType()) {
+                case PSNodeType::RETURN:
+                    f->returns.push_back(n);
+                    continue;
+                case PSNodeType::CALL_FUNCPTR:
+                    // the callees are not known yet
+                    f->copyable = false;
+                    // fall-through
+                case PSNodeType::CALL:
+                    if (PSNode *paired = n->getPairedNode())
+                        push(paired);
+                    else
+                        f->copyable = false;
+
+                    for (PSNode *succ : n->getSuccessors()) {
+                        if (succ->getType() == PSNodeType::ENTRY) {
+                            if (f->calls.empty() || f->calls.back() != n)
+                                f->calls.push_back(n);
+                        } else
+                            push(succ);
+                    }
+                    continue;
+                case PSNodeType::FUNCTION:
+                    f->copyable = false;
+                    break;
+                case PSNodeType::ALLOC:
+                case PSNodeType::DYN_ALLOC:
+                    // globals must stay unique
+                    if (PSNodeAlloc::get(n)->isGlobal())
+                        f->copyable = false;
+                    break;
+                default:
+                    break;
+            }
+
+            for (PSNode *succ : n->getSuccessors())
+                push(succ);
+        }
+    }
+
+    void buildContexts() {
+        PointerSubgraph *ps = PTA::getPS();
+        copied_nodes = 0;
+        fallback_calls = 0;
+
+        Function *root = getFunction(ps->getRoot());
+        // we do not copy the root
+        root->copyable = false;
+
+        // build the call graph
+        std::vector<Function *> stack{root};
+        std::unordered_set<Function *> visited{root};
+        while (!stack.empty()) {
+            Function *f = stack.back();
+            stack.pop_back();
+
+            for (PSNode *call : f->calls) {
+                callers[call] = f;
+
+                std::vector<PSNode *> entries;
+                getCallees(call, entries);
+                for (PSNode *entry : entries) {
+                    Function *g = getFunction(entry);
+                    f->callees.push_back(g);
+                    // the nodes of the root are taken by every copy,
+                    // unless they are the operands of the call
+                    if (f != root || call->getOperandsNum() > 0) {
+                        auto addActual = [this, g, call](PSNode *, PSNode *op) {
+                            if (isArgument(call, op))
+                                g->actuals.insert(op);
+                        };
+                        forEachFormalOperand(g, addActual);
+                    }
+
+                    if (visited.insert(g).second)
+                        stack.push_back(g);
+                }
+            }
+        }
+
+        // compute the sizes of copies bottom-up, the components
+        // come in the reverse topological order (callees first)
+        SCC<Function> scc_comp;
+        const auto& components = scc_comp.compute(root);
+        for (unsigned i = 0; i < components.size(); ++i) {
+            for (Function *f : components[i])
+                f->scc = i;
+
+            for (Function *f : components[i])
+                computeSizes(f);
+        }
+
+        // create the copies top-down from the root
+        to_expand.push_back(root);
+        root->expanded = true;
+        while (!to_expand.empty()) {
+            Function *f = to_expand.back();
+            to_expand.pop_back();
+            expand(f);
+        }
+
+        origins.resize(ps->size());
+        for (PSNode *n : ps->getNodes()) {
+            if (n && n->getID() < origins.size() && origins[n->getID()] == n)
+                origins[n->getID()] = nullptr;
+        }
+    }
+
+    // call F(formal argument, operand) for the operands of the formal
+    // arguments of the function (the PHI nodes that take pointers
+    // from the outside of the function)
+    template <typename F>
+    static void forEachFormalOperand(Function *f, F func) {
+        for (PSNode *n : f->nodes) {
+            if (n->getType() != PSNodeType::PHI)
+                continue;
+
+            for (PSNode *op : n->getOperands()) {
+                if (f->members.count(op) == 0)
+                    func(n, op);
+            }
+        }
+    }
+
+    // is the operand of a formal argument of the called function
+    // an actual argument of the (original) call?
+    bool isArgument(PSNode *call, PSNode *op) const {
+        if (call->getOperandsNum() > 0)
+            return call->hasOperand(op);
+
+        // the arguments are only in the formal arguments,
+        // take those that come from the calling function
+        auto it = callers.find(call);
+        assert(it != callers.end() && "Unknown call");
+        return it->second->members.count(op) > 0;
+    }
+
+    static bool canCopy(Function *caller, Function *callee) {
+        return callee->copyable && callee->scc != caller->scc;
+    }
+
+    void computeSizes(Function *f) {
+        const size_t max = std::numeric_limits<size_t>::max() / 2;
+        f->sizes.resize(max_depth + 1, 0);
+        for (unsigned d = 1; d <= max_depth; ++d) {
+            size_t size = f->nodes.size();
+            for (Function *g : f->callees) {
+                if (canCopy(f, g))
+                    size = std::min(size + g->sizes[d - 1], max);
+            }
+            f->sizes[d] = size;
+        }
+    }
+
+    // the largest depth (up to 'depth') of the copy of 'f'
+    // that fits into the budget (0 if none)
+    unsigned chooseDepth(Function *f, unsigned depth) const {
+        for (unsigned d = depth; d > 0; --d) {
+            if (copied_nodes + f->sizes[d] <= budget)
+                return d;
+        }
+        return 0;
+    }
+
+    void schedule(Function *f) {
+        if (!f->expanded) {
+            f->expanded = true;
+            to_expand.push_back(f);
+        }
+    }
+
+    // give copies of callees to the calls of the original function
+    void expand(Function *f) {
+        for (PSNode *call : f->calls) {
+            PSNode *callret = call->getPairedNode();
+            std::vector<PSNode *> entries;
+            getCallees(call, entries);
+            for (PSNode *entry : entries) {
+                Function *g = getFunction(entry);
+                unsigned d = canCopy(f, g) ? chooseDepth(g, max_depth) : 0;
+                if (d == 0) {
+                    if (canCopy(f, g))
+                        ++fallback_calls;
+                    schedule(g);
+                    continue;
+                }
+
+                Instance inst(g, call, nullptr);
+                instantiate(inst, d);
+
+                removed_edges.emplace_back(call, entry);
+                added_edges.emplace_back(call, inst.copies[entry]);
+                for (PSNode *ret : g->returns) {
+                    if (!hasSuccessor(ret, callret))
+                        continue;
+
+                    PSNode *copy = inst.copies[ret];
+                    removed_edges.emplace_back(ret, callret);
+                    added_edges.emplace_back(copy, callret);
+                    replaced_operands.emplace_back(callret, ret, copy);
+                }
+            }
+        }
+    }
+
+    // the node that the copy uses instead of the operand 'op'
+    static PSNode *resolve(Instance& inst, PSNode *op) {
+        auto it = inst.copies.find(op);
+        if (it != inst.copies.end())
+            return it->second;
+
+        if (inst.caller) {
+            auto cit = inst.caller->find(op);
+            if (cit != inst.caller->end())
+                return cit->second;
+        }
+
+        return op;
+    }
+
+    PSNode *copyNode(Instance& inst, PSNode *n) {
+        auto it = inst.copies.find(n);
+        if (it != inst.copies.end())
+            return it->second;
+
+        auto op = [this, &inst, n](int i) {
+            PSNode *o = n->getOperand(i);
+            if (inst.function->members.count(o) > 0)
+                return copyNode(inst, o);
+            return resolve(inst, o);
+        };
+
+        PointerSubgraph *ps = PTA::getPS();
+        PSNode *copy = nullptr;
+        switch (n->getType()) {
+            case PSNodeType::ALLOC:
+            case PSNodeType::DYN_ALLOC: {
+                PSNodeAlloc *orig = PSNodeAlloc::get(n);
+                PSNodeAlloc *alloc = n->getType() == PSNodeType::ALLOC ?
+                                        ps->createAlloc() : ps->createDynAlloc();
+                if (orig->isZeroInitialized())
+                    alloc->setZeroInitialized();
+                if (orig->isHeap())
+                    alloc->setIsHeap();
+                copy = alloc;
+                break;
+            }
+            case PSNodeType::LOAD:
+                copy = ps->createLoad(op(0));
+                break;
+            case PSNodeType::STORE:
+                copy = ps->createStore(op(0), op(1));
+                break;
+            case PSNodeType::GEP:
+                copy = ps->createGep(op(0), PSNodeGep::get(n)->getOffset());
+                break;
+            case PSNodeType::CAST:
+                copy = ps->createCast(op(0));
+                break;
+            case PSNodeType::MEMCPY:
+                copy = ps->createMemcpy(op(0), op(1),
+                                        PSNodeMemcpy::get(n)->getLength());
+                break;
+            case PSNodeType::CONSTANT:
+                assert(n->pointsTo.size() == 1);
+                copy = ps->createConstant(op(0), (*n->pointsTo.begin()).offset);
+                break;
+            case PSNodeType::FREE:
+                copy = ps->createFree(op(0));
+                break;
+            case PSNodeType::INVALIDATE_OBJECT:
+                copy = ps->createInvalidateObject(op(0));
+                break;
+            case PSNodeType::INVALIDATE_LOCALS:
+                copy = ps->createInvalidateLocals(op(0));
+                break;
+            // these nodes get the operands later
+            case PSNodeType::PHI:
+                copy = ps->createPhi();
+                break;
+            case PSNodeType::CALL_RETURN:
+                copy = ps->createCallReturn();
+                break;
+            case PSNodeType::RETURN:
+                copy = ps->createReturn();
+                break;
+            case PSNodeType::CALL:
+                copy = ps->createCall();
+                break;
+            case PSNodeType::ENTRY:
+                copy = ps->createEntry(PSNodeEntry::get(n)->getFunctionName());
+                break;
+            case PSNodeType::NOOP:
+                copy = ps->createNoop();
+                break;
+            default:
+                assert(0 && "Unsupported node in a copied function");
+                abort();
+        }
+
+        copy->setSize(n->getSize());
+        copy->setUserData(n->getUserData<void>());
+
+        if (origins.size() <= copy->getID())
+            origins.resize(copy->getID() + 1);
+        origins[copy->getID()] = n;
+        ++copied_nodes;
+
+        inst.copies.emplace(n, copy);
+        return copy;
+    }
+
+    static bool takesOperandsLater(PSNode *n) {
+        switch (n->getType()) {
+            case PSNodeType::PHI:
+            case PSNodeType::CALL_RETURN:
+            case PSNodeType::RETURN:
+            case PSNodeType::CALL:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // create the copy of the function (with copies of the callees
+    // up to the 'depth')
+    void instantiate(Instance& inst, unsigned depth) {
+        Function *f = inst.function;
+        for (PSNode *n : f->nodes)
+            copyNode(inst, n);
+
+        for (PSNode *n : f->nodes) {
+            PSNode *copy = inst.copies[n];
+
+            if (takesOperandsLater(n)) {
+                for (PSNode *op : n->getOperands()) {
+                    // the formal argument takes only
+                    // the arguments of our call
+                    if (n->getType() == PSNodeType::PHI &&
+                        f->members.count(op) == 0 &&
+                        f->actuals.count(op) > 0 &&
+                        !isArgument(inst.call, op))
+                        continue;
+
+                    copy->addOperand(resolve(inst, op));
+                }
+            }
+
+            for (PSNode *succ : n->getSuccessors()) {
+                auto it = inst.copies.find(succ);
+                if (it != inst.copies.end())
+                    copy->addSuccessor(it->second);
+            }
+
+            if (PSNode *paired = n->getPairedNode())
+                copy->setPairedNode(resolve(inst, paired));
+            if (PSNode *parent = n->getParent())
+                copy->setParent(resolve(inst, parent));
+        }
+
+        for (PSNode *call : f->calls)
+            instantiateCall(inst, call, depth);
+    }
+
+    void instantiateCall(Instance& inst, PSNode *call, unsigned depth) {
+        Function *f = inst.function;
+        PSNode *callret = call->getPairedNode();
+        PSNode *call_copy = inst.copies[call];
+        PSNode *callret_copy = inst.copies[callret];
+
+        std::vector<PSNode *> entries;
+        getCallees(call, entries);
+        for (PSNode *entry : entries) {
+            Function *g = getFunction(entry);
+            bool copy = depth > 1 && canCopy(f, g);
+            unsigned d = copy ? chooseDepth(g, depth - 1) : 0;
+
+            if (d > 0) {
+                Instance callee(g, call, &inst.copies);
+                instantiate(callee, d);
+
+                call_copy->addSuccessor(callee.copies[entry]);
+                for (PSNode *ret : g->returns) {
+                    if (!hasSuccessor(ret, callret))
+                        continue;
+
+                    PSNode *ret_copy = callee.copies[ret];
+                    ret_copy->addSuccessor(callret_copy);
+                    PSNodeRet::get(ret_copy)->addReturnSite(callret_copy);
+                    callret_copy->replaceOperand(ret, ret_copy);
+                }
+                continue;
+            }
+
+            // call the original function
+            if (copy)
+                ++fallback_calls;
+            schedule(g);
+
+            added_edges.emplace_back(call_copy, entry);
+            for (PSNode *ret : g->returns) {
+                if (hasSuccessor(ret, callret))
+                    added_edges.emplace_back(ret, callret_copy);
+            }
+
+            // the formal arguments of the original function
+            // get also the arguments of the copy of the call
+            forEachFormalOperand(g, [this, &inst, call](PSNode *n, PSNode *op) {
+                if (!isArgument(call, op))
+                    return;
+
+                PSNode *arg = resolve(inst, op);
+                if (arg != op)
+                    added_operands.emplace_back(n, arg);
+            });
+        }
+    }
+
+    void connect() {
+        for (auto& e : removed_edges)
+            e.first->removeSuccessor(e.second);
+        for (auto& e : added_edges)
+            e.first->addSuccessor(e.second);
+        for (auto& r : replaced_operands)
+            std::get<0>(r)->replaceOperand(std::get<1>(r), std::get<2>(r));
+        for (auto& o : added_operands)
+            o.first->addOperand(o.second);
+    }
+
+    void disconnect() {
+        for (auto& o : added_operands)
+            o.first->removeOperand(o.second);
+        for (auto& r : replaced_operands)
+            std::get<0>(r)->replaceOperand(std::get<2>(r), std::get<1>(r));
+        for (auto& e : added_edges)
+            e.first->removeSuccessor(e.second);
+        for (auto& e : removed_edges)
+            e.first->addSuccessor(e.second);
+    }
+
+    // remove the (disconnected) copies from the graph
+    // and forget everything about them
+    void removeCopies() {
+        PointerSubgraph *ps = PTA::getPS();
+        std::vector<PSNode *> copies;
+        for (PSNode *n : ps->getNodes()) {
+            if (n && getOrigin(n))
+                copies.push_back(n);
+        }
+
+        // the copies use the original globals and arguments,
+        // so they must leave the users of these nodes
+        for (PSNode *n : copies)
+            n->removeAllOperands();
+
+        for (PSNode *n : copies) {
+            n->isolate();
+            ps->remove(n);
+        }
+
+        functions.clear();
+        callers.clear();
+        origins.clear();
+        removed_edges.clear();
+        added_edges.clear();
+        replaced_operands.clear();
+        added_operands.clear();
+    }
+
+    PSNode *getOrigin(PSNode *n) const {
+        PointerSubgraph *ps = PTA::getPS();
+        unsigned id = n->getID();
+        if (id < origins.size() && origins[id] && ps->getNodes()[id] == n)
+            return origins[id];
+        return nullptr;
+    }
+
+    // merge the points-to sets of copies to the original nodes
+    // and replace the pointers to copies with pointers to originals
+    void mergeCopies() {
+        for (PSNode *n : PTA::getPS()->getNodes()) {
+            if (!n)
+                continue;
+
+            PSNode *orig = getOrigin(n);
+            bool has_copies = false;
+            for (const Pointer& ptr : n->pointsTo) {
+                if (getOrigin(ptr.target)) {
+                    has_copies = true;
+                    break;
+                }
+            }
+
+            if (!has_copies) {
+                if (orig)
+                    orig->addPointsTo(n->pointsTo);
+                continue;
+            }
+
+            PointsToSetT S;
+            for (const Pointer& ptr : n->pointsTo) {
+                PSNode *target = getOrigin(ptr.target);
+                S.add(Pointer(target ? target : ptr.target, ptr.offset));
+            }
+
+            if (orig)
+                orig->addPointsTo(S);
+            else
+                n->pointsTo.swap(S);
+        }
+    }
+};
+
+} // namespace pta
+} // namespace analysis
+} // namespace dg
+
+#endif // _DG_ANALYSIS_POINTS_TO_CONTEXT_SENSITIVE_H_
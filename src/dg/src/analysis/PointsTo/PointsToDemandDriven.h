@@ -0,0 +1,701 @@
+#ifndef _DG_ANALYSIS_POINTS_TO_DEMAND_DRIVEN_H_
+#define _DG_ANALYSIS_POINTS_TO_DEMAND_DRIVEN_H_
+
+#include <cassert>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Pointer.h"
+#include "PointsToSet.h"
+#include "MemoryObject.h"
+#include "PointerSubgraph.h"
+#include "PointerAnalysis.h"
+#include "PointsToFlowInsensitive.h"
+#include "ADT/Queue.h"
+
+namespace dg {
+namespace analysis {
+namespace pta {
+
+// Demand-driven flow-insensitive pointer analysis.
+//
+// The queries compute the points-to sets only for the nodes
+// that the answer depends on (the backward slice of the queried node):
+// the operands of the nodes, and for loads the stores and memcpys
+// that may write the loaded memory. The writers are indexed by the memory
+// their destination is derived from (through GEPs and casts), so reading
+// a memory object adds to the slice only the writers into this object
+// and the writers whose destination is not known syntactically
+// (e.g. stores via loaded pointers). For every store (memcpy) we first
+// compute only the points-to set of the destination and the stored value
+// (the source) is added to the slice only when the store writes memory
+// that some node of the slice reads.
+//
+// The slice is solved to a fixpoint after every query and is kept,
+// so the next queries reuse the points-to sets computed so far
+// and extend the slice only by the nodes that were not needed yet.
+//
+// When the number of processed nodes exceeds the budget, or the graph
+// contains calls via function pointers (the graph is built on the fly
+// during the analysis then), the exhaustive analysis is run over
+// the whole graph and the queries are answered from its results.
+//
+// The results are the same as the results of PointsToFlowInsensitive,
+// with two exceptions: the nodes that are not reachable from the root
+// can contribute to the results, and the GEPs do not get the unknown
+// offset because they are in a loop, but when they create too many
+// offsets into an object of unknown size.
+class PointsToDemandDriven
+{
+public:
+    // @budget   - the maximal number of processed nodes
+    //             (0 means the number of nodes of the graph)
+    // @fallback - the exhaustive analysis over the graph that is used
+    //             when the budget is exceeded. It must not be run yet.
+    //             If it is nullptr, PointsToFlowInsensitive is used.
+    PointsToDemandDriven(PointerSubgraph *ps, size_t budget = 0,
+                         PointerAnalysis *fallback = nullptr)
+    : PS(ps), budget(budget == 0 ? ps->size() : budget), fallback(fallback)
+    {
+        assert(PS && "Need valid PointerSubgraph object");
+    }
+
+    // the points-to set of the node. The set is a copy, the sets
+    // computed on demand are extended by the later queries and they are
+    // dropped when the analysis switches to the exhaustive analysis
+    PointsToSetT pointsTo(PSNode *n)
+    {
+        return query(n);
+    }
+
+    // may the pointers 'a' and 'b' point to the same memory?
+    bool mayAlias(PSNode *a, PSNode *b)
+    {
+        query(a);
+        const PointsToSetT& B = query(b);
+        // query 'a' again, the previous query could switch
+        // the engine to the exhaustive analysis. 'a' is solved already,
+        // so this query does not change 'B'
+        const PointsToSetT& A = query(a);
+
+        if (hasUnknown(A))
+            return hasMemory(B);
+        if (hasUnknown(B))
+            return hasMemory(A);
+
+        for (const Pointer& pa : A) {
+            if (!pa.isValid() || pa.isInvalidated())
+                continue;
+
+            for (const Pointer& pb : B) {
+                if (pa.target == pb.target &&
+                    (pa.offset.isUnknown() || pb.offset.isUnknown() ||
+                     pa.offset == pb.offset))
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    // the queries are answered by the exhaustive analysis
+    bool isExhaustive() const { return exhaustive; }
+
+    // the number of nodes whose points-to sets were computed on demand
+    size_t getSliceSize() const { return nodes.size(); }
+
+    // the number of processings of the nodes
+    size_t getProcessedNum() const { return processed; }
+
+private:
+    struct NodeInfo {
+        PointsToSetT pointsTo;
+        bool queued{false};
+        // the store (memcpy) writes the memory that is read
+        // in the slice, so the stored value (the source) is in the slice
+        bool relevant{false};
+    };
+
+    // compute the points-to set of the node. The returned reference
+    // is valid only until the next query
+    const PointsToSetT& query(PSNode *n)
+    {
+        if (!exhaustive) {
+            if (!initialized)
+                initialize();
+
+            if (!exhaustive) {
+                activate(n);
+                solve();
+            }
+        }
+
+        if (exhaustive || hasConstantPointsTo(n))
+            return n->pointsTo;
+
+        return nodes[n].pointsTo;
+    }
+
+    PointerSubgraph *PS;
+    size_t budget;
+    PointerAnalysis *fallback;
+    // the fallback analysis if the user did not give any
+    std::unique_ptr<PointsToFlowInsensitive> own_fallback;
+
+    bool initialized{false};
+    bool exhaustive{false};
+    size_t processed{0};
+
+    // the nodes in the slice
+    std::unordered_map<PSNode *, NodeInfo> nodes;
+    ADT::QueueLIFO<PSNode *> worklist;
+
+    // the memory -> the stores and memcpys whose destination
+    // is derived only from this memory
+    std::unordered_map<PSNode *, std::vector<PSNode *>> writers;
+    // the stores and memcpys whose destination may point anywhere
+    std::vector<PSNode *> other_writers;
+    // the other writers were added to the slice
+    bool other_writers_active{false};
+
+    // allocation -> the memory object
+    std::unordered_map<PSNode *, std::unique_ptr<MemoryObject>> memory;
+    // memory object -> the nodes in the slice that read it
+    std::unordered_map<const MemoryObject *, std::vector<PSNode *>> readers;
+    // memory object -> the writers that may write it,
+    // but are not relevant (yet)
+    std::unordered_map<const MemoryObject *, std::vector<PSNode *>> waiting;
+
+    // the offsets into an object of unknown size that a GEP can create
+    // before it starts using the unknown offset (in a loop, the GEP
+    // would create new offsets forever)
+    static const unsigned MAX_GEP_OFFSETS = 8;
+
+    static bool hasConstantPointsTo(PSNode *n)
+    {
+        switch (n->getType()) {
+            case PSNodeType::ALLOC:
+            case PSNodeType::DYN_ALLOC:
+            case PSNodeType::FUNCTION:
+            case PSNodeType::CONSTANT:
+            case PSNodeType::NULL_ADDR:
+            case PSNodeType::UNKNOWN_MEM:
+            case PSNodeType::INVALIDATED:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static bool hasUnknown(const PointsToSetT& S)
+    {
+        for (const Pointer& ptr : S) {
+            if (ptr.isUnknown())
+                return true;
+        }
+
+        return false;
+    }
+
+    // does the set contain a pointer to some memory?
+    static bool hasMemory(const PointsToSetT& S)
+    {
+        for (const Pointer& ptr : S) {
+            if (!ptr.isNull() && !ptr.isInvalidated())
+                return true;
+        }
+
+        return false;
+    }
+
+    // the same filter as in PointerAnalysis
+    static bool canBeDereferenced(const Pointer& ptr)
+    {
+        if (!ptr.isValid() || ptr.isInvalidated())
+            return false;
+
+        return ptr.target->getType() != PSNodeType::FUNCTION;
+    }
+
+    const PointsToSetT& getPointsTo(PSNode *n)
+    {
+        if (hasConstantPointsTo(n))
+            return n->pointsTo;
+
+        return nodes[n].pointsTo;
+    }
+
+    // the points-to set of the first operand of the node. The node can be
+    // its own operand (e.g. in unreachable code) and we must not iterate
+    // over the set that we add to, so the set is copied in that case.
+    const PointsToSetT& getOperandPointsTo(PSNode *node, PointsToSetT& copy)
+    {
+        PSNode *op = node->getOperand(0);
+        if (op != node)
+            return getPointsTo(op);
+
+        copy = getPointsTo(op);
+        return copy;
+    }
+
+    void initialize()
+    {
+        initialized = true;
+
+        for (PSNode *n : PS->getNodes()) {
+            if (!n)
+                continue;
+
+            if (n->getType() == PSNodeType::CALL_FUNCPTR) {
+                // the called functions are built during the analysis
+                runExhaustive();
+                return;
+            }
+
+            if (n->getType() == PSNodeType::STORE ||
+                n->getType() == PSNodeType::MEMCPY)
+                indexWriter(n);
+        }
+    }
+
+    // the node that the destination of the writer is derived from
+    // through GEPs and casts
+    static PSNode *getBase(PSNode *n)
+    {
+        std::unordered_set<PSNode *> visited;
+        while ((n->getType() == PSNodeType::GEP ||
+                n->getType() == PSNodeType::CAST) &&
+               visited.insert(n).second)
+            n = n->getOperand(0);
+
+        return n;
+    }
+
+    void indexWriter(PSNode *w)
+    {
+        PSNode *base = getBase(w->getOperand(1));
+        if (!hasConstantPointsTo(base)) {
+            other_writers.push_back(w);
+            return;
+        }
+
+        // GEPs and casts keep the targets of the pointers,
+        // so the writer writes only the memory that the base points to
+        for (const Pointer& ptr : base->pointsTo) {
+            if (!canBeDereferenced(ptr))
+                continue;
+
+            auto& wrts = writers[getMemoryNode(ptr.target)];
+            if (wrts.empty() || wrts.back() != w)
+                wrts.push_back(w);
+        }
+    }
+
+    void runExhaustive()
+    {
+        exhaustive = true;
+
+        nodes.clear();
+        worklist = ADT::QueueLIFO<PSNode *>();
+        memory.clear();
+        readers.clear();
+        waiting.clear();
+
+        if (!fallback) {
+            own_fallback.reset(new PointsToFlowInsensitive(PS));
+            fallback = own_fallback.get();
+        }
+
+        fallback->run();
+    }
+
+    void enqueue(PSNode *n)
+    {
+        NodeInfo& info = nodes[n];
+        if (!info.queued) {
+            info.queued = true;
+            worklist.push(n);
+        }
+    }
+
+    // add the node and the nodes it depends on to the slice
+    void activate(PSNode *n)
+    {
+        ADT::QueueLIFO<PSNode *> queue;
+        queue.push(n);
+
+        while (!queue.empty()) {
+            PSNode *cur = queue.pop();
+            if (hasConstantPointsTo(cur) || nodes.count(cur) > 0)
+                continue;
+
+            enqueue(cur);
+
+            switch (cur->getType()) {
+                case PSNodeType::STORE:
+                case PSNodeType::MEMCPY:
+                    // the value (source) is added when the writer is relevant
+                    queue.push(cur->getOperand(1));
+                    break;
+                default:
+                    for (PSNode *op : cur->getOperands())
+                        queue.push(op);
+            }
+        }
+    }
+
+    // the memory object is read, so the nodes that read it need to know
+    // what may be written to it
+    void activateWriters(const MemoryObject *mo)
+    {
+        auto it = writers.find(mo->node);
+        if (it != writers.end()) {
+            std::vector<PSNode *> wrts;
+            wrts.swap(it->second);
+            writers.erase(it);
+
+            for (PSNode *w : wrts)
+                activate(w);
+        }
+
+        if (!other_writers_active) {
+            other_writers_active = true;
+            for (PSNode *w : other_writers)
+                activate(w);
+        }
+    }
+
+    void makeRelevant(PSNode *writer)
+    {
+        NodeInfo& info = nodes[writer];
+        if (info.relevant)
+            return;
+
+        info.relevant = true;
+        activate(writer->getOperand(0));
+        enqueue(writer);
+    }
+
+    // the node that holds the memory of the target
+    // (the same as in PointsToFlowInsensitive)
+    static PSNode *getMemoryNode(PSNode *n)
+    {
+        if (n->getType() == PSNodeType::CAST || n->getType() == PSNodeType::GEP)
+            n = n->getOperand(0);
+        else if (n->getType() == PSNodeType::CONSTANT) {
+            assert(n->pointsTo.size() == 1);
+            n = (*n->pointsTo.begin()).target;
+        }
+
+        return n;
+    }
+
+    MemoryObject *getMemoryObject(const Pointer& ptr)
+    {
+        PSNode *n = getMemoryNode(ptr.target);
+
+        auto& mo = memory[n];
+        if (!mo)
+            mo.reset(new MemoryObject(n));
+
+        return mo.get();
+    }
+
+    void registerReader(const MemoryObject *mo, PSNode *n)
+    {
+        auto& rdrs = readers[mo];
+        for (PSNode *r : rdrs) {
+            if (r == n)
+                return;
+        }
+
+        rdrs.push_back(n);
+        activateWriters(mo);
+
+        // the memory is read now, so all its writers are relevant
+        auto it = waiting.find(mo);
+        if (it != waiting.end()) {
+            std::vector<PSNode *> wrts;
+            wrts.swap(it->second);
+            waiting.erase(it);
+
+            for (PSNode *w : wrts)
+                makeRelevant(w);
+        }
+    }
+
+    void memoryObjectChanged(const MemoryObject *mo)
+    {
+        auto it = readers.find(mo);
+        if (it == readers.end())
+            return;
+
+        for (PSNode *r : it->second)
+            enqueue(r);
+    }
+
+    bool addPointer(PSNode *n, const Pointer& ptr)
+    {
+        return nodes[n].pointsTo.add(ptr);
+    }
+
+    void solve()
+    {
+        while (!worklist.empty()) {
+            if (processed >= budget) {
+                runExhaustive();
+                return;
+            }
+
+            PSNode *cur = worklist.pop();
+            nodes[cur].queued = false;
+            ++processed;
+
+            if (processNode(cur)) {
+                for (PSNode *user : cur->getUsers()) {
+                    if (nodes.count(user) > 0)
+                        enqueue(user);
+                }
+            }
+        }
+    }
+
+    bool processNode(PSNode *node)
+    {
+        bool changed = false;
+
+        switch (node->getType()) {
+            case PSNodeType::LOAD:
+                changed |= processLoad(node);
+                break;
+            case PSNodeType::STORE:
+            case PSNodeType::MEMCPY:
+                processWriter(node);
+                break;
+            case PSNodeType::GEP:
+                changed |= processGep(node);
+                break;
+            case PSNodeType::CAST:
+            case PSNodeType::PHI:
+            case PSNodeType::RETURN:
+            case PSNodeType::CALL_RETURN:
+                for (PSNode *op : node->getOperands()) {
+                    // a phi in a loop can be its own operand
+                    if (op == node)
+                        continue;
+
+                    for (const Pointer& ptr : getPointsTo(op))
+                        changed |= addPointer(node, ptr);
+                }
+                break;
+            default:
+                // the rest of the nodes do not change points-to sets
+                break;
+        }
+
+        return changed;
+    }
+
+    bool processLoad(PSNode *node)
+    {
+        bool changed = false;
+
+        PointsToSetT copy;
+        for (const Pointer& ptr : getOperandPointsTo(node, copy)) {
+            if (ptr.isUnknown()) {
+                // load from unknown pointer yields unknown pointer
+                changed |= addPointer(node, UNKNOWN_MEMORY);
+                continue;
+            }
+
+            if (!canBeDereferenced(ptr))
+                continue;
+
+            MemoryObject *o = getMemoryObject(ptr);
+            registerReader(o, node);
+
+            PSNodeAlloc *target = PSNodeAlloc::get(ptr.target);
+            assert(target && "Target is not memory allocation");
+
+            if (ptr.offset.isUnknown()) {
+                if (o->pointsTo.empty() && target->isZeroInitialized())
+                    changed |= addPointer(node, NULLPTR);
+
+                for (auto& it : o->pointsTo) {
+                    for (const Pointer& p : it.second)
+                        changed |= addPointer(node, p);
+                }
+
+                continue;
+            }
+
+            auto it = o->find(ptr.offset);
+            if (it == o->end()) {
+                if (target->isZeroInitialized())
+                    changed |= addPointer(node, NULLPTR);
+            } else {
+                for (const Pointer& p : it->second)
+                    changed |= addPointer(node, p);
+            }
+
+            auto unknownIt = o->find(Offset::UNKNOWN);
+            if (unknownIt != o->end()) {
+                for (const Pointer& p : unknownIt->second)
+                    changed |= addPointer(node, p);
+            }
+        }
+
+        return changed;
+    }
+
+    // a store or memcpy, the points-to set of the node does not change
+    void processWriter(PSNode *node)
+    {
+        NodeInfo& info = nodes[node];
+        if (!info.relevant) {
+            // wait until some node reads the memory that is written here
+            for (const Pointer& ptr : getPointsTo(node->getOperand(1))) {
+                if (!canBeDereferenced(ptr))
+                    continue;
+
+                MemoryObject *o = getMemoryObject(ptr);
+                if (readers.count(o) > 0) {
+                    makeRelevant(node);
+                    return;
+                }
+
+                auto& wrts = waiting[o];
+                if (wrts.empty() || wrts.back() != node)
+                    wrts.push_back(node);
+            }
+
+            return;
+        }
+
+        if (node->getType() == PSNodeType::STORE)
+            processStore(node);
+        else
+            processMemcpy(node);
+    }
+
+    void processStore(PSNode *node)
+    {
+        const PointsToSetT& values = getPointsTo(node->getOperand(0));
+
+        for (const Pointer& ptr : getPointsTo(node->getOperand(1))) {
+            if (!canBeDereferenced(ptr))
+                continue;
+
+            MemoryObject *o = getMemoryObject(ptr);
+            bool objChanged = false;
+            for (const Pointer& to : values)
+                objChanged |= o->addPointsTo(ptr.offset, to);
+
+            if (objChanged)
+                memoryObjectChanged(o);
+        }
+    }
+
+    void processMemcpy(PSNode *node)
+    {
+        Offset len = PSNodeMemcpy::get(node)->getLength();
+
+        for (const Pointer& sptr : getPointsTo(node->getOperand(0))) {
+            if (!canBeDereferenced(sptr))
+                continue;
+
+            MemoryObject *so = getMemoryObject(sptr);
+            registerReader(so, node);
+
+            for (const Pointer& dptr : getPointsTo(node->getOperand(1))) {
+                if (!canBeDereferenced(dptr))
+                    continue;
+
+                MemoryObject *destO = getMemoryObject(dptr);
+                if (copyMemory(so, destO, sptr, dptr, len))
+                    memoryObjectChanged(destO);
+            }
+        }
+    }
+
+    // copy the pointers the same way as PointerAnalysis::processMemcpy,
+    // only the null pointers from zero-initialized memory
+    // are always copied to the unknown offset
+    bool copyMemory(MemoryObject *so, MemoryObject *destO,
+                    const Pointer& sptr, const Pointer& dptr, Offset len)
+    {
+        bool changed = false;
+        Offset srcOffset = sptr.offset;
+        Offset destOffset = dptr.offset;
+
+        PSNodeAlloc *sourceAlloc = PSNodeAlloc::get(sptr.target);
+        assert(sourceAlloc && "Pointer's target in memcpy is not an allocation");
+        if (sourceAlloc->isZeroInitialized())
+            changed |= destO->addPointsTo(Offset::UNKNOWN, NULLPTR);
+
+        for (auto& src : so->pointsTo) {
+            if (!src.first.isUnknown() && !srcOffset.isUnknown() &&
+                (srcOffset > src.first ||
+                 (!len.isUnknown() && *src.first - *srcOffset >= *len)))
+                continue;
+
+            if (src.first.isUnknown() || srcOffset.isUnknown() ||
+                destOffset.isUnknown() ||
+                Offset::UNKNOWN - *destOffset <= *src.first - *srcOffset) {
+                changed |= destO->addPointsTo(Offset::UNKNOWN, src.second);
+                continue;
+            }
+
+            Offset newOff = *src.first - *srcOffset + *destOffset;
+            if (newOff >= destO->node->getSize())
+                changed |= destO->addPointsTo(Offset::UNKNOWN, src.second);
+            else
+                changed |= destO->addPointsTo(newOff, src.second);
+        }
+
+        return changed;
+    }
+
+    bool processGep(PSNode *node)
+    {
+        bool changed = false;
+        Offset off = PSNodeGep::get(node)->getOffset();
+
+        PointsToSetT copy;
+        for (const Pointer& ptr : getOperandPointsTo(node, copy)) {
+            uint64_t new_offset;
+            if (ptr.offset.isUnknown() || off.isUnknown())
+                new_offset = Offset::UNKNOWN;
+            else
+                new_offset = *ptr.offset + *off;
+
+            if ((new_offset != 0 && new_offset >= ptr.target->getSize()) ||
+                (ptr.target->getSize() == Offset::UNKNOWN &&
+                 getOffsetsNum(node, ptr.target) >= MAX_GEP_OFFSETS))
+                new_offset = Offset::UNKNOWN;
+
+            changed |= addPointer(node, Pointer(ptr.target, new_offset));
+        }
+
+        return changed;
+    }
+
+    size_t getOffsetsNum(PSNode *node, PSNode *target)
+    {
+        size_t num = 0;
+        for (const Pointer& ptr : nodes[node].pointsTo) {
+            if (ptr.target == target)
+                ++num;
+        }
+
+        return num;
+    }
+};
+
+} // namespace pta
+} // namespace analysis
+} // namespace dg
+
+#endif // _DG_ANALYSIS_POINTS_TO_DEMAND_DRIVEN_H_
@@ -14,16 +14,29 @@ namespace pta {
 class PointsToFlowInsensitive : public PointerAnalysis
 {
     std::vector<std::unique_ptr<MemoryObject>> memory_objects;
+    // the nodes with a smaller ID already have their memory objects
+    // created (used when the nodes are processed in parallel)
+    size_t prepared_nodes{0};
 
 protected:
     PointsToFlowInsensitive() = default;
 
-public:
-    PointsToFlowInsensitive(PointerSubgraph *ps)
-    : PointerAnalysis(ps) {
+    // for the analyses that use this analysis as a pre-analysis
+    // and so must not change the graph (@prepro_geps = false)
+    PointsToFlowInsensitive(PointerSubgraph *ps, bool prepro_geps,
+                            unsigned threads)
+    : PointerAnalysis(ps, Offset::UNKNOWN, prepro_geps,
+                      false /* invalidate nodes */, true /* collapse cycles */) {
         memory_objects.reserve(std::max(ps->size() / 100, static_cast<size_t>(8)));
+        setThreadsNum(threads);
     }
 
+public:
+    // @threads - the number of threads that process the nodes
+    //            (0 = the number of hardware threads)
+    PointsToFlowInsensitive(PointerSubgraph *ps, unsigned threads = 1)
+    : PointsToFlowInsensitive(ps, true /* preprocess GEPs */, threads) {}
+
     void getMemoryObjects(PSNode *where, const Pointer& pointer,
                           std::vector<MemoryObject *>& objects) override
     {
@@ -46,6 +59,27 @@ public:
                || n->getType() == PSNodeType::DYN_ALLOC
                || n->getType() == PSNodeType::UNKNOWN_MEM);
 
+        objects.push_back(getOrCreateObject(n));
+    }
+
+protected:
+    // create the memory objects of all the allocations in advance,
+    // so that the loads processed in parallel do not create them
+    void prepareParallelProcessing(PointerSubgraph *ps) override
+    {
+        const auto& nodes = ps->getNodes();
+        for (; prepared_nodes < nodes.size(); ++prepared_nodes) {
+            PSNode *n = nodes[prepared_nodes];
+            if (n && (n->getType() == PSNodeType::ALLOC
+                      || n->getType() == PSNodeType::DYN_ALLOC
+                      || n->getType() == PSNodeType::UNKNOWN_MEM))
+                getOrCreateObject(n);
+        }
+    }
+
+private:
+    MemoryObject *getOrCreateObject(PSNode *n)
+    {
         MemoryObject *mo = n->getData<MemoryObject>();
         if (!mo) {
             mo = new MemoryObject(n);
@@ -53,7 +87,7 @@ public:
             n->setData<MemoryObject>(mo);
         }
 
-        objects.push_back(mo);
+        return mo;
     }
 };
 
@@ -3,9 +3,12 @@
 
 #include <cassert>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "MemoryObject.h"
 #include "PointerSubgraph.h"
+#include "ADT/PersistentMap.h"
 
 namespace dg {
 namespace analysis {
@@ -14,11 +17,19 @@ namespace pta {
 class PointsToFlowSensitive : public PointerAnalysis
 {
 public:
-    //using MemoryObjectsSetT = std::set<MemoryObject *>;
-    using MemoryMapT = std::map<PSNode *, std::unique_ptr<MemoryObject>>;
+    struct NodeIndex {
+        uint32_t operator()(const PSNode *n) const { return n->getID(); }
+    };
+
+    // The memory maps are persistent and share the memory objects:
+    // a map that merges the maps of predecessors takes their objects
+    // (and whole subtrees of the maps) and a node that writes
+    // to an object that is shared copies the object
+    // (and the path to it in its map) first.
+    using MemoryMapT = ADT::PersistentMap<PSNode *,
+                                          std::shared_ptr<MemoryObject>,
+                                          NodeIndex>;
 
-    // this is an easy but not very efficient implementation,
-    // works for testing
     PointsToFlowSensitive(PointerSubgraph *ps, bool invalidate = false)
     : PointerAnalysis(ps, Offset::UNKNOWN, false, invalidate)
     {
@@ -41,6 +52,14 @@ public:
             PSNode *pred = n->getSinglePredecessor();
             mm = pred->getData<MemoryMapT>();
             assert(mm && "No memory map in the predecessor");
+
+            // the successors that merge the maps may have been
+            // processed already and skipped this node, since it
+            // did not have a map yet
+            for (PSNode *succ : n->getSuccessors()) {
+                if (needsMerge(succ))
+                    enqueue(succ);
+            }
         }
 
         assert(mm && "Did not create the MM");
@@ -62,10 +81,11 @@ public:
         // in the beforeProcessed method
         assert(mm && "Do not have memory map");
 
-        // every store is a strong update
+        // every store is a strong update (unless the pointers
+        // lost precision because of the budget)
         // FIXME: memcpy can be strong update too
         if (n->getType() == PSNodeType::STORE)
-            strong_update = &n->getOperand(1)->pointsTo;
+            strong_update = getStrongUpdate(n);
 
         // merge information from predecessors if there's
         // more of them (if there's just one predecessor
@@ -76,7 +96,8 @@ public:
                 MemoryMapT *pm = p->getData<MemoryMapT>();
                 // merge pm to mm (but only if pm was already created)
                 if (pm) {
-                    changed |= mergeMaps(mm, pm, strong_update);
+                    changed |= mergeMaps(mm, pm, strong_update,
+                                         lastMerged(n, p));
                 }
             }
         }
@@ -90,25 +111,55 @@ public:
         MemoryMapT *mm = where->getData<MemoryMapT>();
         assert(mm && "Node does not have memory map");
 
-        auto I = mm->find(pointer.target);
-        if (I != mm->end()) {
-            objects.push_back(I->second.get());
+        // this psnode may write to the memory, so it gets the object
+        // that is only in its map (a new one if there is no object yet,
+        // so that the write has something to write to)
+        if (canChangeMM(where)) {
+            objects.push_back(getWritableObject(mm, pointer.target));
+            return;
         }
 
-        // if we haven't found any memory object, but this psnode
-        // is a write to memory, create a new one, so that
-        // the write has something to write to
-        if (objects.empty() && canChangeMM(where)) {
-            MemoryObject *mo = new MemoryObject(pointer.target);
-            mm->emplace(pointer.target, std::unique_ptr<MemoryObject>(mo));
-            objects.push_back(mo);
-        }
+        if (const auto *mo = mm->get(pointer.target))
+            objects.push_back(mo->get());
     }
 
 protected:
 
     PointsToFlowSensitive() = default;
 
+    // the memory map of 'n' is shared by the nodes that follow 'n'
+    // in the CFG and that can not change the memory. These nodes
+    // and the nodes that merge the map into their own maps
+    // need to be processed again when the map of 'n' changes
+    void getMemoryDependents(PSNode *n, std::vector<PSNode *>& deps) override
+    {
+        MemoryMapT *mm = n->getData<MemoryMapT>();
+        if (!mm)
+            return;
+
+        // the map of 'n' is not its own, so 'n' could not change it
+        if (n->predecessorsNum() == 1 &&
+            n->getSinglePredecessor()->getData<MemoryMapT>() == mm)
+            return;
+
+        // 'n' itself may have read the map before it was merged
+        // with the maps from predecessors in afterProcessed()
+        deps.push_back(n);
+
+        std::vector<PSNode *> stack(n->getSuccessors());
+        while (!stack.empty()) {
+            PSNode *cur = stack.back();
+            stack.pop_back();
+
+            deps.push_back(cur);
+            if (cur == n || cur->getData<MemoryMapT>() != mm)
+                continue;
+
+            for (PSNode *succ : cur->getSuccessors())
+                stack.push_back(succ);
+        }
+    }
+
     static bool canChangeMM(PSNode *n) {
         if (n->predecessorsNum() == 0) // root node
             return true;
@@ -136,43 +187,130 @@ protected:
             return false;
     }
 
-    static bool mergeObjects(PSNode *node,
-                             MemoryObject *to,
-                             MemoryObject *from,
-                             PointsToSetT *strong_update) {
-        bool changed = false;
+    // get the object for the target that is not shared
+    // with other memory maps, so that it can be changed
+    static MemoryObject *getWritableObject(MemoryMapT *mm, PSNode *target) {
+        std::shared_ptr<MemoryObject>& mo = (*mm)[target];
+        if (!mo)
+            mo = std::make_shared<MemoryObject>(target);
+        else if (mo.use_count() > 1)
+            mo = std::make_shared<MemoryObject>(*mo);
+
+        return mo.get();
+    }
 
+    // merge the object 'from' to the object 'to' (nullptr if the map
+    // has no object for the target yet) and return the result. The result
+    // is 'to' or 'from' if possible, 'to' is changed in place only when
+    // it is not shared.
+    static std::shared_ptr<MemoryObject>
+    mergeObjects(const std::shared_ptr<MemoryObject> *to,
+                 const std::shared_ptr<MemoryObject>& from,
+                 bool exclusive, PointsToSetT *strong_update,
+                 bool& changed) {
+        PSNode *node = from->node;
+        auto overwritten = [node, strong_update](const Offset& off) {
+            return strong_update && strong_update->count(Pointer(node, off));
+        };
+
+        if (to && *to == from)
+            return *to;
+
+        std::shared_ptr<MemoryObject> res;
+        if (!to) {
+            // share the object if the strong update
+            // does not overwrite anything in it
+            bool share = true;
+            for (auto& fromIt : from->pointsTo) {
+                if (overwritten(fromIt.first))
+                    share = false;
+                else if (!fromIt.second.empty())
+                    changed = true;
+            }
+
+            if (share)
+                return from;
+
+            res = std::make_shared<MemoryObject>(node);
+        } else if (exclusive && to->use_count() == 1) {
+            res = *to;
+        }
+
+        bool added = false;
         for (auto& fromIt : from->pointsTo) {
-            if (strong_update &&
-                strong_update->count(Pointer(node, fromIt.first)))
+            if (overwritten(fromIt.first))
                 continue;
 
-            auto& S = to->pointsTo[fromIt.first];
-            for (const auto& ptr : fromIt.second)
-                changed |= S.add(ptr);
+            for (const auto& ptr : fromIt.second) {
+                if (!res) {
+                    // copy the shared object only if it changes
+                    auto it = (*to)->find(fromIt.first);
+                    if (it != (*to)->end() && it->second.count(ptr) > 0)
+                        continue;
+                    res = std::make_shared<MemoryObject>(**to);
+                }
+
+                added |= res->pointsTo[fromIt.first].add(ptr);
+            }
         }
 
-        return changed;
+        changed |= added;
+        if (!to)
+            return res;
+        return added ? res : *to;
     }
 
     // Merge two Memory maps, return true if any new information was created,
-    // otherwise return false
+    // otherwise return false. 'last' is the state of 'from' that was
+    // merged to 'mm' the last time, only the objects that changed since
+    // then are merged (and 'last' is updated).
     static bool mergeMaps(MemoryMapT *mm, MemoryMapT *from,
-                          PointsToSetT *strong_update) {
+                          PointsToSetT *strong_update, MemoryMapT& last) {
         bool changed = false;
-        for (auto& it : *from) {
-            PSNode *fromTarget = it.first;
-            std::unique_ptr<MemoryObject>& toMo = (*mm)[fromTarget];
-            if (toMo == nullptr)
-                toMo.reset(new MemoryObject(fromTarget));
-
-            changed |= mergeObjects(fromTarget, toMo.get(),
-                                    it.second.get(), strong_update);
+        auto mergeObj = [strong_update, &changed]
+                        (const std::shared_ptr<MemoryObject> *to,
+                         const std::shared_ptr<MemoryObject>& fromMo,
+                         bool exclusive) {
+            return mergeObjects(to, fromMo, exclusive, strong_update, changed);
+        };
+
+        if (last.empty()) {
+            // merging for the first time, take whole subtrees
+            mm->merge(*from, mergeObj);
+        } else {
+            from->forEachDifferent(last, [mm, &mergeObj]
+                                         (const MemoryMapT::value_type& it) {
+                mm->update(it.first, [&it, &mergeObj]
+                                     (const std::shared_ptr<MemoryObject> *to,
+                                      bool exclusive) {
+                    return mergeObj(to, it.second, exclusive);
+                });
+            });
         }
 
+        // the map is persistent, so this is only a reference
+        // to the current state of 'from'
+        last = *from;
         return changed;
     }
 
+    // the predecessors' maps were merged without the values overwritten
+    // by the store, so they must be merged whole again
+    void strongUpdateLost(PSNode *store) override {
+        for (PSNode *p : store->getPredecessors())
+            merged.erase(mergedKey(store, p));
+    }
+
+    // the state of the memory map of 'pred' that was merged
+    // to the memory map of 'n' the last time
+    MemoryMapT& lastMerged(PSNode *n, PSNode *pred) {
+        return merged[mergedKey(n, pred)];
+    }
+
+    static uint64_t mergedKey(PSNode *n, PSNode *pred) {
+        return (static_cast<uint64_t>(n->getID()) << 32) | pred->getID();
+    }
+
     MemoryMapT *createMM() {
         MemoryMapT *mm = new MemoryMapT();
         memoryMaps.emplace_back(mm);
@@ -186,6 +324,9 @@ private:
 
     // keep all the maps in order to free the memory
     std::vector<std::unique_ptr<MemoryMapT>> memoryMaps;
+    // (node ID, predecessor ID) -> the memory map of the predecessor
+    // as it was when it was merged to the memory map of the node
+    std::unordered_map<uint64_t, MemoryMapT> merged;
 };
 
 } // namespace pta
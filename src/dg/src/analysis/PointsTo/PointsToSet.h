@@ -1,12 +1,17 @@
 #ifndef _DG_POINTS_TO_SET_H_
 #define _DG_POINTS_TO_SET_H_
 
+#include <algorithm>
 #include <map>
+#include <memory>
 #include <set>
 #include <cassert>
 
 #include "Pointer.h"
 #include "ADT/Bitvector.h"
+#include "SharedPointsToSet.h"
+#include "BDDPointsToSet.h"
+#include "IDPointsToSet.h"
 
 namespace dg {
 namespace analysis {
@@ -77,7 +82,7 @@ public:
 
     bool empty() const { return pointers.empty(); }
 
-    size_t count(const Pointer& ptr) {
+    size_t count(const Pointer& ptr) const {
         auto it = pointers.find(ptr.target);
         if (it != pointers.end()) {
             return it->second.get(*ptr.offset);
@@ -86,13 +91,13 @@ public:
         return 0;
     }
 
-    bool has(const Pointer& ptr) {
+    bool has(const Pointer& ptr) const {
         return count(ptr) > 0;
     }
 
-    size_t size() {
+    size_t size() const {
         size_t num = 0;
-        for (auto& it : pointers) {
+        for (const auto& it : pointers) {
             num += it.second.size();
         }
 
@@ -113,6 +118,8 @@ public:
             }
         }
     public:
+        const_iterator() = default;
+
         const_iterator& operator++() {
             ++innerIt;
             if (innerIt == container_it->second.end()) {
@@ -152,6 +159,277 @@ public:
     friend class const_iterator;
 };
 
+// Points-to set that keeps up to N pointers inline
+// (sorted, without any allocation). Most of the pointers point
+// to one or two targets, so this saves a lot of allocations.
+// If more pointers are added, the set is lifted
+// to the normal PointsToSet (in the same way as SmallNumberSet
+// is lifted from Bits to a bitvector).
+// Adding pointers invalidates the iterators of the set (the inline
+// pointers are shifted or the set is lifted), so the set must not
+// be iterated while adding to it.
+// PSNodes use these sets unless DISABLE_SMALL_POINTS_TO_SETS is defined.
+template <unsigned N = 2>
+class SmallPointsToSet {
+    static_assert(N > 0 && N < 256, "Invalid number of inline pointers");
+
+    PSNode *targets[N];
+    Offset offsets[N];
+    // the number of inline pointers
+    // (only the first num elements of the arrays are initialized)
+    uint8_t num{0};
+    // the set after lifting
+    std::unique_ptr<PointsToSet> big;
+
+    bool isSmall() const { return !big; }
+
+    Pointer getInline(unsigned i) const {
+        assert(i < num);
+        return Pointer(targets[i], offsets[i]);
+    }
+
+    // position of the first inline pointer that is not less
+    // than (target, off). We do not create a Pointer here,
+    // so that a nullptr target can be added like to PointsToSet
+    unsigned lowerBound(PSNode *target, Offset off) const {
+        unsigned i = 0;
+        while (i < num && (targets[i] < target ||
+                           (targets[i] == target && offsets[i] < off)))
+            ++i;
+        return i;
+    }
+
+    bool hasInline(PSNode *target, Offset off) const {
+        unsigned i = lowerBound(target, off);
+        return i < num && targets[i] == target && offsets[i] == off;
+    }
+
+    void insertInline(unsigned pos, PSNode *target, Offset off) {
+        assert(num < N);
+        for (unsigned i = num; i > pos; --i) {
+            targets[i] = targets[i - 1];
+            offsets[i] = offsets[i - 1];
+        }
+
+        targets[pos] = target;
+        offsets[pos] = off;
+        ++num;
+    }
+
+    void lift() {
+        assert(isSmall());
+        std::unique_ptr<PointsToSet> S(new PointsToSet());
+        for (unsigned i = 0; i < num; ++i)
+            S->add(targets[i], offsets[i]);
+
+        big = std::move(S);
+        num = 0;
+    }
+
+    bool addWithUnknownOffset(PSNode *target) {
+        if (hasInline(target, Offset::UNKNOWN))
+            return false;
+
+        // get rid of other offsets and keep
+        // only the unknown offset
+        unsigned n = 0;
+        for (unsigned i = 0; i < num; ++i) {
+            if (targets[i] != target) {
+                targets[n] = targets[i];
+                offsets[n] = offsets[i];
+                ++n;
+            }
+        }
+        num = n;
+
+        if (num == N) {
+            lift();
+            return big->add(target, Offset::UNKNOWN);
+        }
+
+        insertInline(lowerBound(target, Offset::UNKNOWN), target, Offset::UNKNOWN);
+        return true;
+    }
+
+public:
+    SmallPointsToSet() = default;
+
+    SmallPointsToSet(const SmallPointsToSet& rhs)
+    : num(rhs.num), big(rhs.big ? new PointsToSet(*rhs.big) : nullptr) {
+        for (unsigned i = 0; i < num; ++i) {
+            targets[i] = rhs.targets[i];
+            offsets[i] = rhs.offsets[i];
+        }
+    }
+
+    SmallPointsToSet(SmallPointsToSet&& rhs)
+    : num(rhs.num), big(std::move(rhs.big)) {
+        for (unsigned i = 0; i < num; ++i) {
+            targets[i] = rhs.targets[i];
+            offsets[i] = rhs.offsets[i];
+        }
+        rhs.num = 0;
+    }
+
+    SmallPointsToSet& operator=(const SmallPointsToSet& rhs) {
+        SmallPointsToSet tmp(rhs);
+        swap(tmp);
+        return *this;
+    }
+
+    SmallPointsToSet& operator=(SmallPointsToSet&& rhs) {
+        SmallPointsToSet tmp(std::move(rhs));
+        swap(tmp);
+        return *this;
+    }
+
+    bool add(PSNode *target, Offset off) {
+        if (!isSmall())
+            return big->add(target, off);
+
+        if (off.isUnknown())
+            return addWithUnknownOffset(target);
+
+        // if we have the same pointer but with unknown offset,
+        // do nothing
+        if (hasInline(target, Offset::UNKNOWN))
+            return false;
+
+        unsigned pos = lowerBound(target, off);
+        if (pos < num && targets[pos] == target && offsets[pos] == off)
+            return false;
+
+        if (num == N) {
+            lift();
+            return big->add(target, off);
+        }
+
+        insertInline(pos, target, off);
+        return true;
+    }
+
+    bool add(const Pointer& ptr) {
+        return add(ptr.target, ptr.offset);
+    }
+
+    // make union of the two sets and store it
+    // into 'this' set (i.e. merge rhs to this set)
+    bool merge(const SmallPointsToSet& rhs) {
+        if (this == &rhs)
+            return false;
+
+        if (!isSmall() && !rhs.isSmall())
+            return big->merge(*rhs.big);
+
+        if (isSmall() && !rhs.isSmall()) {
+            // do not lift if we already have everything
+            bool changed = false;
+            for (const Pointer& ptr : *rhs.big) {
+                if (!hasInline(ptr.target, ptr.offset) &&
+                    !hasInline(ptr.target, Offset::UNKNOWN)) {
+                    changed = true;
+                    break;
+                }
+            }
+
+            if (!changed)
+                return false;
+
+            std::unique_ptr<PointsToSet> S(new PointsToSet(*rhs.big));
+            for (unsigned i = 0; i < num; ++i)
+                S->add(targets[i], offsets[i]);
+
+            big = std::move(S);
+            num = 0;
+            return true;
+        }
+
+        bool changed = false;
+        for (unsigned i = 0; i < rhs.num; ++i)
+            changed |= add(rhs.targets[i], rhs.offsets[i]);
+
+        return changed;
+    }
+
+    bool empty() const { return isSmall() ? num == 0 : big->empty(); }
+
+    size_t count(const Pointer& ptr) const {
+        return isSmall() ? hasInline(ptr.target, ptr.offset) : big->count(ptr);
+    }
+
+    bool has(const Pointer& ptr) const {
+        return count(ptr) > 0;
+    }
+
+    size_t size() const { return isSmall() ? num : big->size(); }
+
+    void swap(SmallPointsToSet& rhs) {
+        // swap only the initialized inline pointers
+        unsigned common = std::min(num, rhs.num);
+        for (unsigned i = 0; i < common; ++i) {
+            std::swap(targets[i], rhs.targets[i]);
+            std::swap(offsets[i], rhs.offsets[i]);
+        }
+
+        SmallPointsToSet& longer = num > rhs.num ? *this : rhs;
+        SmallPointsToSet& shorter = num > rhs.num ? rhs : *this;
+        for (unsigned i = common; i < longer.num; ++i) {
+            shorter.targets[i] = longer.targets[i];
+            shorter.offsets[i] = longer.offsets[i];
+        }
+
+        std::swap(num, rhs.num);
+        big.swap(rhs.big);
+    }
+
+    class const_iterator {
+        const SmallPointsToSet *set{nullptr};
+        unsigned pos{0};
+        PointsToSet::const_iterator bigIt;
+
+        const_iterator(const SmallPointsToSet& S, bool end = false)
+        : set(&S), pos(end ? S.num : 0) {
+            if (!S.isSmall())
+                bigIt = end ? S.big->end() : S.big->begin();
+        }
+
+    public:
+        const_iterator() = default;
+
+        const_iterator& operator++() {
+            if (set->isSmall())
+                ++pos;
+            else
+                ++bigIt;
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            auto tmp = *this;
+            operator++();
+            return tmp;
+        }
+
+        Pointer operator*() const {
+            return set->isSmall() ? set->getInline(pos) : *bigIt;
+        }
+
+        bool operator==(const const_iterator& rhs) const {
+            if (set->isSmall())
+                return pos == rhs.pos;
+            return bigIt == rhs.bigIt;
+        }
+
+        bool operator!=(const const_iterator& rhs) const {
+            return !operator==(rhs);
+        }
+
+        friend class SmallPointsToSet;
+    };
+
+    const_iterator begin() const { return const_iterator(*this); }
+    const_iterator end() const { return const_iterator(*this, true /* end */); }
+};
 
 ///
 // We keep the implementation of this points-to set because
@@ -163,7 +441,7 @@ class SimplePointsToSet {
     using const_iterator = typename ContainerT::const_iterator;
 
     bool addWithUnknownOffset(PSNode *target) {
-        if (has({target, Offset::UNKNOWN}))
+        if (has(makePointer(target, Offset::UNKNOWN)))
             return false;
 
         ContainerT tmp;
@@ -173,7 +451,7 @@ class SimplePointsToSet {
         }
 
         tmp.swap(pointers);
-        return pointers.insert({target, Offset::UNKNOWN}).second;
+        return pointers.insert(makePointer(target, Offset::UNKNOWN)).second;
     }
 
 public:
@@ -183,10 +461,10 @@ public:
 
         // if we have the same pointer but with unknown offset,
         // do nothing
-        if (has({target, Offset::UNKNOWN}))
+        if (has(makePointer(target, Offset::UNKNOWN)))
             return false;
 
-        return pointers.emplace(target, off).second;
+        return pointers.insert(makePointer(target, off)).second;
     }
 
     bool add(const Pointer& ptr) {
@@ -204,10 +482,10 @@ public:
         return changed;
     }
 
-    size_t count(const Pointer& ptr) { return pointers.count(ptr); }
-    size_t size() { return pointers.size(); }
+    size_t count(const Pointer& ptr) const { return pointers.count(ptr); }
+    size_t size() const { return pointers.size(); }
     bool empty() const { return pointers.empty(); }
-    bool has(const Pointer& ptr) { return count(ptr) > 0; }
+    bool has(const Pointer& ptr) const { return count(ptr) > 0; }
 
     void swap(SimplePointsToSet& rhs) { pointers.swap(rhs.pointers); }
 
@@ -217,7 +495,17 @@ public:
 
 
 
+#if defined(ENABLE_SHARED_POINTS_TO_SETS)
+using PointsToSetT = SharedPointsToSet;
+#elif defined(ENABLE_BDD_POINTS_TO_SETS)
+using PointsToSetT = BDDPointsToSet;
+#elif defined(ENABLE_ID_POINTS_TO_SETS)
+using PointsToSetT = IDPointsToSet;
+#elif defined(DISABLE_SMALL_POINTS_TO_SETS)
 using PointsToSetT = PointsToSet;
+#else
+using PointsToSetT = SmallPointsToSet<>;
+#endif
 using PointsToMapT = std::map<Offset, PointsToSetT>;
 
 } // namespace pta
@@ -0,0 +1,381 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_LLVM
+// ignore unused parameters in LLVM libraries
+#if (__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter"
+#else
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#endif
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Support/raw_ostream.h>
+
+#if (__clang__)
+#pragma clang diagnostic pop // ignore -Wunused-parameter
+#else
+#pragma GCC diagnostic pop
+#endif
+#endif // HAVE_LLVM
+
+#include "PointsToSnapshot.h"
+
+namespace dg {
+namespace analysis {
+namespace pta {
+
+static const char SNAPSHOT_MAGIC[8] = {'D', 'G', 'P', 'T', 'S', 'N', 'P', '\0'};
+
+PointsToSnapshot::~PointsToSnapshot() {
+    release();
+}
+
+void PointsToSnapshot::release() {
+    if (mapped)
+        munmap(const_cast<char *>(data), data_size);
+
+    data = nullptr;
+    data_size = 0;
+    mapped = false;
+    buffer.clear();
+    header = nullptr;
+    nodes = nullptr;
+    pointers = nullptr;
+    names = nullptr;
+}
+
+static PointsToSnapshot::PointerRecord
+createPointerRecord(const Pointer& ptr) {
+    PointsToSnapshot::PointerRecord rec;
+    rec.target = 0;
+    rec.offset = *ptr.offset;
+
+    PointsToSnapshot::Target kind = PointsToSnapshot::Target::NODE;
+    if (ptr.isNull())
+        kind = PointsToSnapshot::Target::NULL_ADDR;
+    else if (ptr.isUnknown())
+        kind = PointsToSnapshot::Target::UNKNOWN_MEM;
+    else if (ptr.isInvalidated())
+        kind = PointsToSnapshot::Target::INVALIDATED;
+    else
+        rec.target = ptr.target->getID();
+
+    rec.kind = static_cast<uint32_t>(kind);
+    return rec;
+}
+
+bool PointsToSnapshot::save(const std::vector<PSNode *>& graph_nodes,
+                            const std::string& path,
+                            const NameFunT& getName) {
+    std::vector<NodeRecord> node_records;
+    std::vector<PointerRecord> pointer_records;
+    std::string all_names;
+    // the names must be unique, the duplicates get a suffix
+    std::unordered_map<std::string, unsigned> names_count;
+
+    // the table of nodes must be sorted by ID (and without duplicates)
+    std::vector<const PSNode *> sorted;
+    for (const PSNode *nd : graph_nodes) {
+        if (nd)
+            sorted.push_back(nd);
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const PSNode *a, const PSNode *b) {
+                  return a->getID() < b->getID();
+              });
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    for (const PSNode *nd : sorted) {
+        NodeRecord rec;
+        rec.id = nd->getID();
+        rec.type = static_cast<uint32_t>(nd->getType());
+        rec.pointers = pointer_records.size();
+        rec.pointers_num = nd->pointsTo.size();
+        for (const Pointer& ptr : nd->pointsTo)
+            pointer_records.push_back(createPointerRecord(ptr));
+
+        std::string name;
+        if (getName)
+            name = getName(nd);
+        if (!name.empty()) {
+            unsigned& count = names_count[name];
+            if (count > 0)
+                name += "#" + std::to_string(count);
+            ++count;
+        }
+
+        rec.name = all_names.size();
+        rec.name_len = name.size();
+        all_names += name;
+
+        node_records.push_back(rec);
+    }
+
+    Header hdr;
+    memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof hdr.magic);
+    hdr.version = VERSION;
+    hdr.nodes_num = node_records.size();
+    hdr.pointers_num = pointer_records.size();
+    hdr.names_size = all_names.size();
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+
+    out.write(reinterpret_cast<const char *>(&hdr), sizeof hdr);
+    out.write(reinterpret_cast<const char *>(node_records.data()),
+              node_records.size() * sizeof(NodeRecord));
+    out.write(reinterpret_cast<const char *>(pointer_records.data()),
+              pointer_records.size() * sizeof(PointerRecord));
+    out.write(all_names.data(), all_names.size());
+
+    return static_cast<bool>(out);
+}
+
+bool PointsToSnapshot::load(const std::string& path) {
+    release();
+    error.clear();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "Cannot open '" + path + "'";
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        error = "Cannot stat '" + path + "'";
+        return false;
+    }
+
+    data_size = st.st_size;
+    if (data_size > 0) {
+        void *addr = mmap(nullptr, data_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            data = static_cast<const char *>(addr);
+            mapped = true;
+        } else {
+            // fall back to reading the file
+            // (the buffer of uint64_t keeps the records aligned)
+            buffer.resize((data_size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+            char *buf = reinterpret_cast<char *>(buffer.data());
+            size_t done = 0;
+            while (done < data_size) {
+                ssize_t r = read(fd, buf + done, data_size - done);
+                if (r <= 0)
+                    break;
+                done += r;
+            }
+
+            if (done != data_size) {
+                close(fd);
+                release();
+                error = "Cannot read '" + path + "'";
+                return false;
+            }
+
+            data = buf;
+        }
+    }
+
+    close(fd);
+
+    if (data_size < sizeof(Header) ||
+        memcmp(data, SNAPSHOT_MAGIC, sizeof SNAPSHOT_MAGIC) != 0) {
+        release();
+        error = "'" + path + "' is not a points-to snapshot";
+        return false;
+    }
+
+    header = reinterpret_cast<const Header *>(data);
+    if (header->version != VERSION) {
+        uint32_t version = header->version;
+        release();
+        error = "Unsupported version of snapshot: " + std::to_string(version);
+        return false;
+    }
+
+    uint64_t expected = sizeof(Header)
+                        + uint64_t(header->nodes_num) * sizeof(NodeRecord)
+                        + uint64_t(header->pointers_num) * sizeof(PointerRecord)
+                        + header->names_size;
+    if (expected != data_size) {
+        release();
+        error = "'" + path + "' has a wrong size";
+        return false;
+    }
+
+    nodes = reinterpret_cast<const NodeRecord *>(data + sizeof(Header));
+    pointers = reinterpret_cast<const PointerRecord *>(nodes + header->nodes_num);
+    names = reinterpret_cast<const char *>(pointers + header->pointers_num);
+
+    for (size_t i = 0; i < header->nodes_num; ++i) {
+        const NodeRecord& nd = nodes[i];
+        if (uint64_t(nd.pointers) + nd.pointers_num > header->pointers_num ||
+            uint64_t(nd.name) + nd.name_len > header->names_size ||
+            (i > 0 && nodes[i - 1].id >= nd.id)) {
+            release();
+            error = "'" + path + "' is corrupted";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const PointsToSnapshot::NodeRecord *
+PointsToSnapshot::getNodeByID(unsigned id) const {
+    const NodeRecord *end = nodes + size();
+    const NodeRecord *it
+        = std::lower_bound(nodes, end, id,
+                           [](const NodeRecord& nd, unsigned id) {
+                                return nd.id < id;
+                           });
+    if (it == end || it->id != id)
+        return nullptr;
+
+    return it;
+}
+
+std::string PointsToSnapshot::getKey(const NodeRecord& nd) const {
+    if (nd.name_len > 0)
+        return getName(nd);
+
+    return "<" + std::to_string(nd.id) + ">";
+}
+
+std::string PointsToSnapshot::getPointerString(const PointerRecord& ptr) const {
+    std::string str;
+    switch (ptr.getKind()) {
+        case Target::NULL_ADDR:
+            str = "null";
+            break;
+        case Target::UNKNOWN_MEM:
+            str = "unknown";
+            break;
+        case Target::INVALIDATED:
+            str = "invalidated";
+            break;
+        default:
+            if (const NodeRecord *target = getNodeByID(ptr.target))
+                str = getKey(*target);
+            else
+                str = "<" + std::to_string(ptr.target) + ">";
+    }
+
+    if (ptr.getOffset().isUnknown())
+        return str + " + UNKNOWN";
+
+    return str + " + " + std::to_string(ptr.offset);
+}
+
+static std::set<std::string>
+getPointerStrings(const PointsToSnapshot& snapshot,
+                  const PointsToSnapshot::NodeRecord& nd) {
+    std::set<std::string> ret;
+    for (auto it = snapshot.pointersBegin(nd), et = snapshot.pointersEnd(nd);
+         it != et; ++it)
+        ret.insert(snapshot.getPointerString(*it));
+    return ret;
+}
+
+std::vector<PointsToSnapshot::Difference>
+PointsToSnapshot::diff(const PointsToSnapshot& first,
+                       const PointsToSnapshot& second) {
+    std::map<std::string, const NodeRecord *> first_nodes;
+    for (size_t i = 0; i < first.size(); ++i)
+        first_nodes.emplace(first.getKey(first.getNode(i)), &first.getNode(i));
+
+    std::vector<Difference> diffs;
+    std::set<std::string> matched;
+    for (size_t i = 0; i < second.size(); ++i) {
+        const NodeRecord& nd = second.getNode(i);
+        std::string key = second.getKey(nd);
+        auto it = first_nodes.find(key);
+        if (it == first_nodes.end()) {
+            Difference d;
+            d.node = key;
+            d.in_first = false;
+            auto ptrs = getPointerStrings(second, nd);
+            d.only_second.assign(ptrs.begin(), ptrs.end());
+            diffs.push_back(std::move(d));
+            continue;
+        }
+
+        matched.insert(key);
+        auto first_ptrs = getPointerStrings(first, *it->second);
+        auto second_ptrs = getPointerStrings(second, nd);
+        if (first_ptrs == second_ptrs)
+            continue;
+
+        Difference d;
+        d.node = key;
+        std::set_difference(first_ptrs.begin(), first_ptrs.end(),
+                            second_ptrs.begin(), second_ptrs.end(),
+                            std::back_inserter(d.only_first));
+        std::set_difference(second_ptrs.begin(), second_ptrs.end(),
+                            first_ptrs.begin(), first_ptrs.end(),
+                            std::back_inserter(d.only_second));
+        diffs.push_back(std::move(d));
+    }
+
+    for (auto& it : first_nodes) {
+        if (matched.count(it.first) > 0)
+            continue;
+
+        Difference d;
+        d.node = it.first;
+        d.in_second = false;
+        auto ptrs = getPointerStrings(first, *it.second);
+        d.only_first.assign(ptrs.begin(), ptrs.end());
+        diffs.push_back(std::move(d));
+    }
+
+    return diffs;
+}
+
+#ifdef HAVE_LLVM
+std::string getSnapshotName(const PSNode *node) {
+    const llvm::Value *val = node->getUserData<llvm::Value>();
+    if (!val)
+        return "";
+
+    if (auto F = llvm::dyn_cast<llvm::Function>(val))
+        return F->getName().str();
+
+    std::string str;
+    llvm::raw_string_ostream ro(str);
+    ro << *val;
+    ro.flush();
+
+    const llvm::Function *F = nullptr;
+    if (auto I = llvm::dyn_cast<llvm::Instruction>(val))
+        F = I->getParent()->getParent();
+    else if (auto A = llvm::dyn_cast<llvm::Argument>(val))
+        F = A->getParent();
+
+    if (F)
+        return F->getName().str() + ": " + str;
+
+    return str;
+}
+#endif // HAVE_LLVM
+
+} // namespace pta
+} // namespace analysis
+} // namespace dg
@@ -0,0 +1,165 @@
+#ifndef _DG_POINTS_TO_SNAPSHOT_H_
+#define _DG_POINTS_TO_SNAPSHOT_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "PSNode.h"
+#include "PointerSubgraph.h"
+
+namespace dg {
+namespace analysis {
+namespace pta {
+
+/**
+ * Compact binary image of the points-to sets of a solved PointerSubgraph.
+ *
+ * The file consists of a header, the table of nodes (sorted by ID),
+ * the table of pointers and the names of the nodes. All records have
+ * a fixed size, so the loaded file is memory-mapped and used as it is,
+ * there is nothing to parse and nothing to solve.
+ * The names identify the nodes across runs (e.g. the LLVM values
+ * the nodes were created for), nodes without a name are identified
+ * by their ID. The numbers are stored in the byte order of the machine.
+ */
+class PointsToSnapshot {
+public:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t nodes_num;
+        uint32_t pointers_num;
+        uint32_t names_size;
+    };
+
+    struct NodeRecord {
+        uint32_t id;
+        uint32_t type;
+        // the first pointer of the node in the table of pointers
+        uint32_t pointers;
+        uint32_t pointers_num;
+        // the position of the name in the names
+        uint32_t name;
+        uint32_t name_len;
+    };
+
+    // the targets that are not nodes of the graph
+    enum class Target : uint32_t {
+        NODE = 0,
+        NULL_ADDR,
+        UNKNOWN_MEM,
+        INVALIDATED
+    };
+
+    struct PointerRecord {
+        // the ID of the target (for Target::NODE)
+        uint32_t target;
+        uint32_t kind;
+        uint64_t offset;
+
+        Target getKind() const { return static_cast<Target>(kind); }
+        Offset getOffset() const { return Offset(offset); }
+    };
+
+    // a node whose points-to set differs in two snapshots
+    struct Difference {
+        std::string node;
+        // the node is missing in one of the snapshots
+        bool in_first{true};
+        bool in_second{true};
+        // "target + offset"
+        std::vector<std::string> only_first;
+        std::vector<std::string> only_second;
+    };
+
+    // returns the name of the node that is stable across runs
+    // (or an empty string if the node has none)
+    using NameFunT = std::function<std::string(const PSNode *)>;
+
+    static const uint32_t VERSION = 1;
+
+    PointsToSnapshot() = default;
+    ~PointsToSnapshot();
+
+    PointsToSnapshot(const PointsToSnapshot&) = delete;
+    PointsToSnapshot& operator=(const PointsToSnapshot&) = delete;
+
+    // store the points-to sets of the nodes to the file
+    // (the nodes can be in any order, they are stored sorted by ID)
+    static bool save(const std::vector<PSNode *>& nodes,
+                     const std::string& path,
+                     const NameFunT& getName = nullptr);
+
+    static bool save(const PointerSubgraph *ps,
+                     const std::string& path,
+                     const NameFunT& getName = nullptr) {
+        return save(ps->getNodes(), path, getName);
+    }
+
+    // map the snapshot from the file, returns false (and sets the error)
+    // if the file can not be read or is not a valid snapshot
+    bool load(const std::string& path);
+
+    const std::string& getError() const { return error; }
+
+    size_t size() const { return header ? header->nodes_num : 0; }
+    const NodeRecord& getNode(size_t idx) const { return nodes[idx]; }
+    // find the node with the ID (nullptr if there is none)
+    const NodeRecord *getNodeByID(unsigned id) const;
+
+    PSNodeType getType(const NodeRecord& nd) const {
+        return static_cast<PSNodeType>(nd.type);
+    }
+
+    const PointerRecord *pointersBegin(const NodeRecord& nd) const {
+        return pointers + nd.pointers;
+    }
+
+    const PointerRecord *pointersEnd(const NodeRecord& nd) const {
+        return pointers + nd.pointers + nd.pointers_num;
+    }
+
+    std::string getName(const NodeRecord& nd) const {
+        return std::string(names + nd.name, nd.name_len);
+    }
+
+    // the name of the node or <ID> if it has no name
+    std::string getKey(const NodeRecord& nd) const;
+    // the key of the target and the offset
+    std::string getPointerString(const PointerRecord& ptr) const;
+
+    // compare the points-to sets of the nodes with the same key
+    static std::vector<Difference> diff(const PointsToSnapshot& first,
+                                        const PointsToSnapshot& second);
+
+private:
+    void release();
+
+    // the content of the file (either mapped or read to the buffer)
+    const char *data{nullptr};
+    size_t data_size{0};
+    bool mapped{false};
+    std::vector<uint64_t> buffer;
+
+    const Header *header{nullptr};
+    const NodeRecord *nodes{nullptr};
+    const PointerRecord *pointers{nullptr};
+    const char *names{nullptr};
+
+    std::string error{};
+};
+
+#ifdef HAVE_LLVM
+// the name of the node that is the same in every run on the LLVM module
+// (the function and the value the node was created for), it can be
+// passed to save(). Returns an empty string for nodes without a value.
+std::string getSnapshotName(const PSNode *node);
+#endif
+
+} // namespace pta
+} // namespace analysis
+} // namespace dg
+
+#endif // _DG_POINTS_TO_SNAPSHOT_H_
@@ -0,0 +1,514 @@
+#ifndef _DG_ANALYSIS_POINTS_TO_SPARSE_FLOW_SENSITIVE_H_
+#define _DG_ANALYSIS_POINTS_TO_SPARSE_FLOW_SENSITIVE_H_
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "MemoryObject.h"
+#include "PointerSubgraph.h"
+#include "PointsToFlowInsensitive.h"
+
+namespace dg {
+namespace analysis {
+namespace pta {
+
+// Flow-sensitive pointer analysis that does not propagate the memory
+// along the whole graph. First, the flow-insensitive analysis finds
+// what memory every load, store and memcpy may access. From that we build
+// def-use chains of the memory (like in memory SSA: stores are
+// definitions, the nodes where different definitions meet get
+// memory phis) and the flow-sensitive analysis then propagates
+// the memory only along these chains.
+// The results are the same as of PointsToFlowSensitive (up to the strong
+// updates -- in both analyses they depend on the order in which
+// the nodes are processed).
+class PointsToSparseFlowSensitive : public PointerAnalysis
+{
+public:
+    PointsToSparseFlowSensitive(PointerSubgraph *ps)
+    : PointerAnalysis(ps, Offset::UNKNOWN, false) {}
+
+    void getMemoryObjects(PSNode *where, const Pointer& pointer,
+                          std::vector<MemoryObject *>& objects) override
+    {
+        MemoryNode *mn = getMemoryNode(where);
+        assert(mn && "Node does not access memory");
+
+        // the memory defined (or merged) by this node
+        auto it = mn->memory.find(pointer.target);
+        if (it != mn->memory.end()) {
+            if (!it->second) {
+                // nothing was merged here yet,
+                // create the object only if we write to it
+                if (!writesMemory(where))
+                    return;
+                it->second.reset(new MemoryObject(pointer.target));
+            }
+
+            objects.push_back(it->second.get());
+            return;
+        }
+
+        // the memory defined by the reaching definition
+        auto rit = mn->reaching.find(pointer.target);
+        assert(rit != mn->reaching.end()
+               && "Target not found by the pre-analysis");
+        if (rit != mn->reaching.end() && rit->second) {
+            if (MemoryObject *mo = getObject(rit->second, pointer.target))
+                objects.push_back(mo);
+        }
+    }
+
+    bool afterProcessed(PSNode *n) override
+    {
+        MemoryNode *mn = getMemoryNode(n);
+        if (!mn)
+            return false;
+
+        // every store is a strong update (as in PointsToFlowSensitive)
+        PointsToSetT *strong_update = nullptr;
+        if (n->getType() == PSNodeType::STORE)
+            strong_update = getStrongUpdate(n);
+
+        bool changed = false;
+        for (auto& it : mn->memory) {
+            PSNode *target = it.first;
+            auto pit = mn->phis.find(target);
+            if (pit != mn->phis.end()) {
+                for (PSNode *def : pit->second)
+                    changed |= mergeObjects(it.second, getObject(def, target),
+                                            strong_update);
+            } else {
+                PSNode *def = mn->reaching[target];
+                if (def)
+                    changed |= mergeObjects(it.second, getObject(def, target),
+                                            strong_update);
+            }
+        }
+
+        return changed;
+    }
+
+protected:
+    // the memory of the node changed, so the nodes that use
+    // this memory must be processed again
+    void getMemoryDependents(PSNode *n, std::vector<PSNode *>& deps) override
+    {
+        MemoryNode *mn = getMemoryNode(n);
+        if (!mn)
+            return;
+
+        deps.insert(deps.end(), mn->users.begin(), mn->users.end());
+
+        // 'n' itself may have read its memory before it was merged
+        // with the reaching definitions in afterProcessed()
+        if (!mn->memory.empty() &&
+            (n->getType() == PSNodeType::LOAD ||
+             n->getType() == PSNodeType::MEMCPY))
+            deps.push_back(n);
+    }
+
+    void preprocess() override
+    {
+        memory_nodes.clear();
+
+        PointerSubgraph *ps = getPS();
+
+        // the points-to sets before the pre-analysis
+        std::vector<PointsToSetT> initial(ps->size());
+        for (PSNode *n : ps->getNodes()) {
+            if (n)
+                initial[n->getID()] = n->pointsTo;
+        }
+
+        PreAnalysis pre(ps, this);
+        pre.run();
+
+        // the pre-analysis could build new parts of the graph
+        std::vector<PSNode *> nodes = ps->getNodes(ps->getRoot());
+        memory_nodes.resize(ps->size());
+        std::unordered_map<PSNode *, std::vector<PSNode *>> definitions;
+        for (PSNode *n : nodes)
+            createMemoryNode(n, definitions);
+
+        // reset the results of the pre-analysis. We keep only
+        // the called functions, the graph is already built for them
+        for (PSNode *n : ps->getNodes()) {
+            if (!n)
+                continue;
+
+            n->setData<MemoryObject>(nullptr);
+            if (n->getType() == PSNodeType::CALL_FUNCPTR)
+                continue;
+
+            if (n->getID() < initial.size())
+                n->pointsTo.swap(initial[n->getID()]);
+            else if (!keepsPointsTo(n))
+                PointsToSetT().swap(n->pointsTo);
+        }
+
+        buildDefUse(nodes, definitions);
+    }
+
+private:
+    // the flow-insensitive pre-analysis. It must not change
+    // the graph except building the calls via function pointers
+    class PreAnalysis : public PointsToFlowInsensitive {
+        PointerAnalysis *owner;
+
+    public:
+        PreAnalysis(PointerSubgraph *ps, PointerAnalysis *o)
+        : PointsToFlowInsensitive(ps, false /* preprocess GEPs */, 1),
+          owner(o) {}
+
+        bool functionPointerCall(PSNode *where, PSNode *what) override
+        {
+            return owner->functionPointerCall(where, what);
+        }
+    };
+
+    // the memory that a node accesses
+    struct MemoryNode {
+        // target -> the definition of the memory of the target that
+        // this node reads (nullptr if there is no definition)
+        std::unordered_map<PSNode *, PSNode *> reaching;
+        // target -> the definitions merged by this node (memory phi)
+        std::unordered_map<PSNode *, std::vector<PSNode *>> phis;
+        // target -> the memory of the target defined by this node
+        // (stores, memcpy and memory phis)
+        std::unordered_map<PSNode *, std::unique_ptr<MemoryObject>> memory;
+        // the nodes that read or merge the memory defined by this node
+        std::vector<PSNode *> users;
+    };
+
+    // node ID -> memory accessed by the node
+    std::vector<std::unique_ptr<MemoryNode>> memory_nodes;
+
+    MemoryNode *getMemoryNode(PSNode *n) const {
+        if (n->getID() >= memory_nodes.size())
+            return nullptr;
+        return memory_nodes[n->getID()].get();
+    }
+
+    MemoryNode *getOrCreateMemoryNode(PSNode *n) {
+        auto& mn = memory_nodes[n->getID()];
+        if (!mn)
+            mn.reset(new MemoryNode());
+        return mn.get();
+    }
+
+    MemoryObject *getObject(PSNode *def, PSNode *target) const {
+        MemoryNode *mn = getMemoryNode(def);
+        assert(mn && "Definition does not access memory");
+        auto it = mn->memory.find(target);
+        if (it == mn->memory.end())
+            return nullptr;
+        return it->second.get();
+    }
+
+    static bool writesMemory(PSNode *n) {
+        return n->getType() == PSNodeType::STORE ||
+               n->getType() == PSNodeType::MEMCPY;
+    }
+
+    // nodes that get their points-to set on creation
+    static bool keepsPointsTo(PSNode *n) {
+        switch (n->getType()) {
+            case PSNodeType::ALLOC:
+            case PSNodeType::DYN_ALLOC:
+            case PSNodeType::FUNCTION:
+            case PSNodeType::CONSTANT:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static void addTargets(MemoryNode *mn, PSNode *ptr) {
+        for (const Pointer& p : ptr->pointsTo) {
+            if (!p.isValid() || p.isInvalidated() ||
+                p.target->getType() == PSNodeType::FUNCTION)
+                continue;
+            mn->reaching.emplace(p.target, nullptr);
+        }
+    }
+
+    // create the memory node from the results of the pre-analysis.
+    // Memcpy defines also the memory that it reads (it gets
+    // the memory of the source from its own memory as in
+    // PointsToFlowSensitive)
+    void createMemoryNode(PSNode *n,
+                          std::unordered_map<PSNode *, std::vector<PSNode *>>& defs) {
+        MemoryNode *mn;
+        switch (n->getType()) {
+            case PSNodeType::LOAD:
+                mn = getOrCreateMemoryNode(n);
+                addTargets(mn, n->getOperand(0));
+                break;
+            case PSNodeType::STORE:
+                mn = getOrCreateMemoryNode(n);
+                addTargets(mn, n->getOperand(1));
+                break;
+            case PSNodeType::MEMCPY:
+                mn = getOrCreateMemoryNode(n);
+                addTargets(mn, n->getOperand(0));
+                addTargets(mn, n->getOperand(1));
+                break;
+            default:
+                return;
+        }
+
+        if (writesMemory(n)) {
+            for (auto& it : mn->reaching) {
+                mn->memory[it.first];
+                defs[it.first].push_back(n);
+            }
+        }
+    }
+
+    // place the memory phis and find the reaching definitions
+    // (the construction of SSA by Cytron et al.)
+    void buildDefUse(const std::vector<PSNode *>& nodes,
+                     std::unordered_map<PSNode *, std::vector<PSNode *>>& defs) {
+        const size_t size = getPS()->size();
+        std::vector<PSNode *> idom(size);
+        std::vector<unsigned> order(size);
+        computeDominators(nodes, idom, order);
+
+        auto reachable = [&idom](PSNode *n) { return idom[n->getID()] != nullptr; };
+
+        // dominance frontiers
+        std::vector<std::vector<PSNode *>> frontiers(size);
+        for (PSNode *n : nodes) {
+            if (n->predecessorsNum() < 2)
+                continue;
+
+            for (PSNode *pred : n->getPredecessors()) {
+                if (!reachable(pred))
+                    continue;
+
+                PSNode *runner = pred;
+                while (runner != idom[n->getID()]) {
+                    auto& df = frontiers[runner->getID()];
+                    if (df.empty() || df.back() != n)
+                        df.push_back(n);
+                    if (runner == idom[runner->getID()])
+                        break; // root
+                    runner = idom[runner->getID()];
+                }
+            }
+        }
+
+        // memory phis at the iterated dominance frontiers of definitions
+        std::vector<PSNode *> has_phi(size);
+        for (auto& it : defs) {
+            PSNode *target = it.first;
+            std::vector<PSNode *> worklist(it.second);
+            while (!worklist.empty()) {
+                PSNode *cur = worklist.back();
+                worklist.pop_back();
+
+                for (PSNode *df : frontiers[cur->getID()]) {
+                    if (has_phi[df->getID()] == target)
+                        continue;
+
+                    has_phi[df->getID()] = target;
+                    MemoryNode *mn = getOrCreateMemoryNode(df);
+                    mn->phis[target];
+                    mn->memory[target];
+                    worklist.push_back(df);
+                }
+            }
+        }
+
+        renameDefinitions(nodes, idom);
+    }
+
+    // the iterative algorithm by Cooper, Harvey and Kennedy.
+    // idom of unreachable nodes is nullptr, idom of the root is the root
+    void computeDominators(const std::vector<PSNode *>& nodes,
+                           std::vector<PSNode *>& idom,
+                           std::vector<unsigned>& order) {
+        PSNode *root = getPS()->getRoot();
+
+        // reverse postorder
+        std::vector<PSNode *> rpo;
+        rpo.reserve(nodes.size());
+        std::vector<char> visited(idom.size(), false);
+        std::vector<std::pair<PSNode *, size_t>> stack;
+        stack.emplace_back(root, 0);
+        visited[root->getID()] = true;
+        while (!stack.empty()) {
+            auto& top = stack.back();
+            const auto& succs = top.first->getSuccessors();
+            if (top.second < succs.size()) {
+                PSNode *succ = succs[top.second++];
+                if (!visited[succ->getID()]) {
+                    visited[succ->getID()] = true;
+                    stack.emplace_back(succ, 0);
+                }
+            } else {
+                order[top.first->getID()] = rpo.size();
+                rpo.push_back(top.first);
+                stack.pop_back();
+            }
+        }
+        std::reverse(rpo.begin(), rpo.end());
+
+        auto intersect = [&idom, &order](PSNode *a, PSNode *b) {
+            while (a != b) {
+                while (order[a->getID()] < order[b->getID()])
+                    a = idom[a->getID()];
+                while (order[b->getID()] < order[a->getID()])
+                    b = idom[b->getID()];
+            }
+            return a;
+        };
+
+        idom[root->getID()] = root;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (PSNode *n : rpo) {
+                if (n == root)
+                    continue;
+
+                PSNode *new_idom = nullptr;
+                for (PSNode *pred : n->getPredecessors()) {
+                    if (!idom[pred->getID()])
+                        continue;
+                    new_idom = new_idom ? intersect(pred, new_idom) : pred;
+                }
+
+                if (idom[n->getID()] != new_idom) {
+                    idom[n->getID()] = new_idom;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // walk the dominator tree and connect the uses of memory
+    // to the definitions that reach them
+    void renameDefinitions(const std::vector<PSNode *>& nodes,
+                           const std::vector<PSNode *>& idom) {
+        std::vector<std::vector<PSNode *>> children(idom.size());
+        for (PSNode *n : nodes) {
+            PSNode *dom = idom[n->getID()];
+            if (dom && dom != n)
+                children[dom->getID()].push_back(n);
+        }
+
+        // target -> the stack of definitions
+        std::unordered_map<PSNode *, std::vector<PSNode *>> current;
+        auto top = [&current](PSNode *target) -> PSNode * {
+            auto it = current.find(target);
+            if (it == current.end() || it->second.empty())
+                return nullptr;
+            return it->second.back();
+        };
+
+        struct Frame {
+            PSNode *node;
+            size_t next_child{0};
+            // the targets that the node defined
+            std::vector<PSNode *> pushed;
+
+            Frame(PSNode *n) : node(n) {}
+        };
+
+        std::vector<Frame> stack;
+        stack.emplace_back(getPS()->getRoot());
+        visitNode(stack.back().node, stack.back().pushed, current, top);
+
+        while (!stack.empty()) {
+            Frame& frame = stack.back();
+            const auto& succs = children[frame.node->getID()];
+            if (frame.next_child < succs.size()) {
+                PSNode *child = succs[frame.next_child++];
+                stack.emplace_back(child);
+                visitNode(child, stack.back().pushed, current, top);
+            } else {
+                for (PSNode *target : frame.pushed)
+                    current[target].pop_back();
+                stack.pop_back();
+            }
+        }
+    }
+
+    template <typename TopF>
+    void visitNode(PSNode *n, std::vector<PSNode *>& pushed,
+                   std::unordered_map<PSNode *, std::vector<PSNode *>>& current,
+                   TopF& top) {
+        if (MemoryNode *mn = getMemoryNode(n)) {
+            // the memory phis are the first definitions in the node
+            for (auto& it : mn->phis) {
+                current[it.first].push_back(n);
+                pushed.push_back(it.first);
+            }
+
+            for (auto& it : mn->reaching) {
+                if (mn->phis.count(it.first) > 0)
+                    continue;
+
+                if (PSNode *def = top(it.first)) {
+                    it.second = def;
+                    getMemoryNode(def)->users.push_back(n);
+                }
+            }
+
+            for (auto& it : mn->memory) {
+                if (mn->phis.count(it.first) > 0)
+                    continue;
+                current[it.first].push_back(n);
+                pushed.push_back(it.first);
+            }
+        }
+
+        // the definitions flowing to memory phis in the successors
+        for (PSNode *succ : n->getSuccessors()) {
+            MemoryNode *mn = getMemoryNode(succ);
+            if (!mn)
+                continue;
+
+            for (auto& it : mn->phis) {
+                if (PSNode *def = top(it.first)) {
+                    it.second.push_back(def);
+                    getMemoryNode(def)->users.push_back(succ);
+                }
+            }
+        }
+    }
+
+    // merge 'from' to 'to' (create 'to' if needed) but skip
+    // the offsets that are overwritten by the strong update
+    static bool mergeObjects(std::unique_ptr<MemoryObject>& to,
+                             MemoryObject *from,
+                             PointsToSetT *strong_update) {
+        if (!from)
+            return false;
+
+        if (!to)
+            to.reset(new MemoryObject(from->node));
+
+        bool changed = false;
+        for (auto& fromIt : from->pointsTo) {
+            if (strong_update &&
+                strong_update->count(Pointer(from->node, fromIt.first)))
+                continue;
+
+            changed |= to->pointsTo[fromIt.first].merge(fromIt.second);
+        }
+
+        return changed;
+    }
+};
+
+} // namespace pta
+} // namespace analysis
+} // namespace dg
+
+#endif // _DG_ANALYSIS_POINTS_TO_SPARSE_FLOW_SENSITIVE_H_
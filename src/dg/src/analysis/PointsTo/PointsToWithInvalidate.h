@@ -2,6 +2,7 @@
 #define _DG_ANALYSIS_POINTS_TO_WITH_INVALIDATE_H_
 
 #include <cassert>
+#include <unordered_map>
 #include "PointsToFlowSensitive.h"
 
 namespace dg {
@@ -47,6 +48,13 @@ public:
             PSNode *pred = n->getSinglePredecessor();
             mm = pred->getData<MemoryMapT>();
             assert(mm && "No memory map in the predecessor");
+
+            // the successors that merge the maps may have been
+            // processed already and skipped this node
+            for (PSNode *succ : n->getSuccessors()) {
+                if (needsMerge(succ))
+                    enqueue(succ);
+            }
         }
 
         assert(mm && "Did not create the MM");
@@ -74,10 +82,11 @@ public:
                n->getType() != PSNodeType::INVALIDATE_LOCALS);
 
         PointsToSetT *strong_update = nullptr;
-        // every store is a strong update
+        // every store is a strong update (unless the pointers
+        // lost precision because of the budget)
         // FIXME: memcpy can be strong update too
         if (n->getType() == PSNodeType::STORE)
-            strong_update = &n->getOperand(1)->pointsTo;
+            strong_update = getStrongUpdate(n);
 
         MemoryMapT *mm = n->getData<MemoryMapT>();
         assert(mm && "Do not have memory map");
@@ -90,7 +99,8 @@ public:
             for (PSNode *p : n->getPredecessors()) {
                 if (MemoryMapT *pm = p->getData<MemoryMapT>()) {
                     // merge pm to mm (but only if pm was already created)
-                    changed |= mergeMaps(mm, pm, strong_update);
+                    changed |= mergeMaps(mm, pm, strong_update,
+                                         lastMerged(n, p));
                 }
             }
         }
@@ -157,16 +167,15 @@ public:
         MemoryMapT *pmm = pred->getData<MemoryMapT>();
         assert(pmm && "Node's predecessor does not have a memory map");
 
-        for (auto& I : *pmm) {
+        // process only the objects that changed since the last time
+        MemoryMapT& last = lastMerged(node, pred);
+        pmm->forEachDifferent(last, [&](const MemoryMapT::value_type& I) {
             if (isInvalidTarget(I.first))
-                continue;
+                return;
 
             // get or create a memory object for this target
-            std::unique_ptr<MemoryObject>& moptr = (*mm)[I.first];
-            if (!moptr)
-                moptr.reset(new MemoryObject(I.first));
-
-            MemoryObject *mo = moptr.get();
+            // (not shared with other maps, we change it)
+            MemoryObject *mo = getWritableObject(mm, I.first);
             MemoryObject *pmo = I.second.get();
 
             for (auto& it : *mo) {
@@ -197,8 +206,9 @@ public:
                     mo->pointsTo.erase(it.first);
                 }
             }
-        }
+        });
 
+        last = *pmm;
         return changed;
     }
 
@@ -225,13 +235,19 @@ public:
 
     bool invalidateMemory(PSNode *node) {
         bool changed = false;
+        // if the invalidated pointers changed, all the memory
+        // must be processed again
+        size_t& size = invalidated_sizes[node];
+        bool all = node->getOperand(0)->pointsTo.size() != size;
+        size = node->getOperand(0)->pointsTo.size();
+
         for (PSNode *pred : node->getPredecessors()) {
-            changed |= invalidateMemory(node, pred);
+            changed |= invalidateMemory(node, pred, all);
         }
         return changed;
     }
 
-    bool invalidateMemory(PSNode *node, PSNode *pred)
+    bool invalidateMemory(PSNode *node, PSNode *pred, bool all)
     {
         bool changed = false;
 
@@ -242,16 +258,18 @@ public:
 
         PSNode *operand = node->getOperand(0);
 
-        for (auto& I : *pmm) {
+        // process only the objects that changed since the last time
+        MemoryMapT& last = lastMerged(node, pred);
+        if (all)
+            last = MemoryMapT();
+
+        pmm->forEachDifferent(last, [&](const MemoryMapT::value_type& I) {
             if (isInvalidTarget(I.first))
-                continue;
+                return;
 
             // get or create a memory object for this target
-            std::unique_ptr<MemoryObject>& moptr = (*mm)[I.first];
-            if (!moptr)
-                moptr.reset(new MemoryObject(I.first));
-
-            MemoryObject *mo = moptr.get();
+            // (not shared with other maps, we change it)
+            MemoryObject *mo = getWritableObject(mm, I.first);
             MemoryObject *pmo = I.second.get();
 
             //remove references to invalidated memory from mo
@@ -288,10 +306,16 @@ public:
                     mo->pointsTo.erase(it.first);
                 }
             }
-        }
+        });
 
+        last = *pmm;
         return changed;
     }
+
+private:
+    // node -> the size of the set of invalidated pointers
+    // when the node was processed the last time
+    std::unordered_map<PSNode *, size_t> invalidated_sizes;
 };
 
 } // namespace pta
@@ -0,0 +1,417 @@
+#ifndef _DG_SHARED_POINTS_TO_SET_H_
+#define _DG_SHARED_POINTS_TO_SET_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "Pointer.h"
+
+namespace dg {
+namespace analysis {
+namespace pta {
+
+// Table of unique (hash-consed) points-to sets.
+// Every set is stored only once as a sorted vector of pointers
+// and is referenced by its ID. The sets are immutable and reference
+// counted: a set is freed when the last reference is released
+// and its ID is reused later. The set with ID 0 is the empty set
+// and it is never freed.
+// Results of unions are memoised, because the analysis
+// computes the same unions over and over again. The memoised unions
+// do not keep the sets alive, a union is forgotten when any
+// of the three sets is freed. The sets of one pointer are kept
+// as long as the table, so that adding a pointer to a set
+// can be a memoised union too.
+// NOTE: the table is not thread-safe.
+class SharedPointsToSetTable {
+public:
+    using IDT = uint32_t;
+    using SetT = std::vector<Pointer>;
+
+private:
+    struct SetHash {
+        size_t operator()(const SetT& S) const {
+            size_t h = S.size();
+            for (const Pointer& ptr : S) {
+                h ^= std::hash<PSNode *>()(ptr.target) + 0x9e3779b9 + (h << 6) + (h >> 2);
+                h ^= std::hash<uint64_t>()(*ptr.offset) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            }
+            return h;
+        }
+    };
+
+    struct Entry {
+        // nullptr if the ID is free
+        const SetT *set{nullptr};
+        size_t refs{0};
+        // the keys of the memoised unions that use this set
+        // (some of them may be forgotten already)
+        std::vector<uint64_t> unions;
+        // prune the forgotten unions when there is this many keys
+        size_t prune_at{16};
+    };
+
+    // the nodes of unordered_map are not moved on rehashing,
+    // so we can keep pointers to the keys
+    std::unordered_map<SetT, IDT, SetHash> ids;
+    std::vector<Entry> sets;
+    std::vector<IDT> free_ids;
+    // (smaller ID, bigger ID) -> ID of the union
+    std::unordered_map<uint64_t, IDT> unions;
+    // pointer -> the set with only this pointer
+    std::map<Pointer, IDT> singletons;
+    // the number of live sets and of the pointers stored in them
+    size_t sets_num{0};
+    size_t pointers_num{0};
+
+    SharedPointsToSetTable() {
+        // reserve ID 0 for the empty set
+        intern(SetT());
+    }
+
+    static uint64_t unionKey(IDT a, IDT b) {
+        return (static_cast<uint64_t>(a) << 32) | b;
+    }
+
+    static bool usesSet(uint64_t key, IDT result, IDT id) {
+        return static_cast<IDT>(key >> 32) == id ||
+               static_cast<IDT>(key) == id || result == id;
+    }
+
+    void addUnionKey(IDT id, uint64_t key) {
+        Entry& E = sets[id];
+        E.unions.push_back(key);
+        if (E.unions.size() < E.prune_at)
+            return;
+
+        // forget the keys of the unions that were forgotten
+        E.unions.erase(std::remove_if(E.unions.begin(), E.unions.end(),
+                                      [this, id](uint64_t k) {
+                                          auto it = unions.find(k);
+                                          return it == unions.end() ||
+                                                 !usesSet(k, it->second, id);
+                                      }),
+                       E.unions.end());
+        E.prune_at = std::max<size_t>(16, 2 * E.unions.size());
+    }
+
+    void freeSet(IDT id) {
+        assert(id != 0 && "Freeing the empty set");
+        Entry& E = sets[id];
+        assert(E.set && E.refs == 0);
+
+        for (uint64_t key : E.unions) {
+            auto it = unions.find(key);
+            if (it != unions.end() && usesSet(key, it->second, id))
+                unions.erase(it);
+        }
+
+        --sets_num;
+        pointers_num -= E.set->size();
+        ids.erase(ids.find(*E.set));
+        E = Entry();
+        free_ids.push_back(id);
+    }
+
+public:
+    SharedPointsToSetTable(const SharedPointsToSetTable&) = delete;
+    SharedPointsToSetTable& operator=(const SharedPointsToSetTable&) = delete;
+
+    static SharedPointsToSetTable& get() {
+        // never destroyed, the sets in static objects
+        // may release their references at exit
+        static SharedPointsToSetTable *table = new SharedPointsToSetTable();
+        return *table;
+    }
+
+    void acquire(IDT id) {
+        if (id != 0)
+            ++sets[id].refs;
+    }
+
+    void release(IDT id) {
+        if (id == 0)
+            return;
+
+        assert(sets[id].refs > 0);
+        if (--sets[id].refs == 0)
+            freeSet(id);
+    }
+
+    // get the ID of the given (sorted) set, store it if it is new.
+    // The returned ID holds a reference to the set.
+    IDT intern(SetT&& S) {
+        assert(std::is_sorted(S.begin(), S.end()));
+        auto it = ids.find(S);
+        if (it != ids.end()) {
+            acquire(it->second);
+            return it->second;
+        }
+
+        IDT id;
+        if (free_ids.empty()) {
+            id = static_cast<IDT>(sets.size());
+            sets.emplace_back();
+        } else {
+            id = free_ids.back();
+            free_ids.pop_back();
+        }
+
+        ++sets_num;
+        pointers_num += S.size();
+        auto ret = ids.emplace(std::move(S), id);
+        sets[id].set = &ret.first->first;
+        acquire(id);
+        return id;
+    }
+
+    // get the ID of the set with only the given pointer
+    // (the table holds the reference to it)
+    IDT singleton(const Pointer& ptr) {
+        auto it = singletons.find(ptr);
+        if (it != singletons.end())
+            return it->second;
+
+        IDT id = intern(SetT{ptr});
+        singletons.emplace(ptr, id);
+        return id;
+    }
+
+    const SetT& getSet(IDT id) const {
+        assert(id < sets.size() && sets[id].set);
+        return *sets[id].set;
+    }
+
+    // get the ID of the union of the two sets.
+    // The returned ID holds a reference to the set.
+    IDT unite(IDT a, IDT b) {
+        if (a == b || b == 0) {
+            acquire(a);
+            return a;
+        }
+        if (a == 0) {
+            acquire(b);
+            return b;
+        }
+
+        if (a > b)
+            std::swap(a, b);
+
+        uint64_t key = unionKey(a, b);
+        auto it = unions.find(key);
+        if (it != unions.end()) {
+            acquire(it->second);
+            return it->second;
+        }
+
+        const SetT& A = getSet(a);
+        const SetT& B = getSet(b);
+        SetT S;
+        S.reserve(A.size() + B.size());
+        std::set_union(A.begin(), A.end(), B.begin(), B.end(),
+                       std::back_inserter(S));
+
+        IDT id = intern(std::move(S));
+        unions.emplace(key, id);
+        addUnionKey(a, key);
+        addUnionKey(b, key);
+        if (id != a && id != b)
+            addUnionKey(id, key);
+        return id;
+    }
+
+    // the number of unique live sets
+    size_t size() const { return sets_num; }
+    // the number of pointers in all the live sets
+    size_t pointersNum() const { return pointers_num; }
+    size_t unionsNum() const { return unions.size(); }
+};
+
+// Points-to set that is only a reference into the SharedPointsToSetTable.
+// Copying the set and comparing two sets is just copying and comparing
+// the IDs (and counting the references). Modifying the set creates
+// a new set in the table (copy-on-write) and the old one is left untouched
+// (and freed if nothing else refers to it).
+class SharedPointsToSet {
+    using TableT = SharedPointsToSetTable;
+    using SetT = TableT::SetT;
+
+    TableT::IDT id{0};
+
+    const SetT& getSet() const { return TableT::get().getSet(id); }
+
+    // replace the set by the set 'newID' that already holds a reference
+    bool reset(TableT::IDT newID) {
+        auto old = id;
+        id = newID;
+        TableT::get().release(old);
+        return old != id;
+    }
+
+    // the first pointer in S that is not less than (target, off).
+    // We do not create a Pointer here, so that a nullptr target
+    // can be added like to PointsToSet
+    static SetT::const_iterator lowerBound(const SetT& S,
+                                           PSNode *target, Offset off) {
+        return std::lower_bound(S.begin(), S.end(), target,
+                                [off](const Pointer& ptr, PSNode *t) {
+                                    return ptr.target == t ? ptr.offset < off
+                                                           : ptr.target < t;
+                                });
+    }
+
+    static bool contains(const SetT& S, PSNode *target, Offset off) {
+        auto it = lowerBound(S, target, off);
+        return it != S.end() && it->target == target && it->offset == off;
+    }
+
+    bool addWithUnknownOffset(PSNode *target) {
+        const SetT& S = getSet();
+        if (contains(S, target, Offset::UNKNOWN))
+            return false;
+
+        // get rid of other offsets and keep
+        // only the unknown offset
+        SetT tmp;
+        tmp.reserve(S.size() + 1);
+        for (const Pointer& ptr : S) {
+            if (ptr.target != target)
+                tmp.push_back(ptr);
+        }
+
+        tmp.insert(lowerBound(tmp, target, Offset::UNKNOWN),
+                   makePointer(target, Offset::UNKNOWN));
+        return reset(TableT::get().intern(std::move(tmp)));
+    }
+
+public:
+    SharedPointsToSet() = default;
+    SharedPointsToSet(const SharedPointsToSet& rhs) : id(rhs.id) {
+        TableT::get().acquire(id);
+    }
+    SharedPointsToSet(SharedPointsToSet&& rhs) : id(rhs.id) { rhs.id = 0; }
+    ~SharedPointsToSet() { TableT::get().release(id); }
+
+    SharedPointsToSet& operator=(const SharedPointsToSet& rhs) {
+        TableT::get().acquire(rhs.id);
+        reset(rhs.id);
+        return *this;
+    }
+
+    SharedPointsToSet& operator=(SharedPointsToSet&& rhs) {
+        swap(rhs);
+        return *this;
+    }
+
+    bool add(PSNode *target, Offset off) {
+        if (off.isUnknown())
+            return addWithUnknownOffset(target);
+
+        const SetT& S = getSet();
+        // if we have the same pointer but with unknown offset,
+        // do nothing
+        if (contains(S, target, Offset::UNKNOWN))
+            return false;
+
+        if (contains(S, target, off))
+            return false;
+
+        // the same pointers are added to the same sets
+        // over and over again, so add it as a memoised union
+        TableT& table = TableT::get();
+        return reset(table.unite(id, table.singleton(makePointer(target, off))));
+    }
+
+    bool add(const Pointer& ptr) {
+        return add(ptr.target, ptr.offset);
+    }
+
+    // make union of the two sets and store it
+    // into 'this' set (i.e. merge rhs to this set)
+    bool merge(const SharedPointsToSet& rhs) {
+        return reset(TableT::get().unite(id, rhs.id));
+    }
+
+    bool empty() const { return id == 0; }
+
+    size_t count(const Pointer& ptr) const {
+        const SetT& S = getSet();
+        return std::binary_search(S.begin(), S.end(), ptr);
+    }
+
+    bool has(const Pointer& ptr) const {
+        return count(ptr) > 0;
+    }
+
+    size_t size() const { return getSet().size(); }
+
+    void swap(SharedPointsToSet& rhs) { std::swap(id, rhs.id); }
+
+    TableT::IDT getID() const { return id; }
+
+    bool operator==(const SharedPointsToSet& rhs) const { return id == rhs.id; }
+    bool operator!=(const SharedPointsToSet& rhs) const { return id != rhs.id; }
+
+    // the iterator holds a reference to the set, so it is safe
+    // to add pointers to this set while iterating over it
+    // (the iteration goes over the old version of the set)
+    class const_iterator {
+        TableT::IDT id{0};
+        SetT::const_iterator it;
+
+        const_iterator(TableT::IDT id, SetT::const_iterator it)
+        : id(id), it(it) { TableT::get().acquire(id); }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Pointer;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Pointer *;
+        using reference = const Pointer&;
+
+        const_iterator(const const_iterator& rhs) : const_iterator(rhs.id, rhs.it) {}
+        ~const_iterator() { TableT::get().release(id); }
+
+        const_iterator& operator=(const const_iterator& rhs) {
+            TableT::get().acquire(rhs.id);
+            TableT::get().release(id);
+            id = rhs.id;
+            it = rhs.it;
+            return *this;
+        }
+
+        const_iterator& operator++() {
+            ++it;
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            auto tmp = *this;
+            ++it;
+            return tmp;
+        }
+
+        reference operator*() const { return *it; }
+        pointer operator->() const { return &*it; }
+
+        bool operator==(const const_iterator& rhs) const { return it == rhs.it; }
+        bool operator!=(const const_iterator& rhs) const { return it != rhs.it; }
+
+        friend class SharedPointsToSet;
+    };
+
+    const_iterator begin() const { return const_iterator(id, getSet().begin()); }
+    const_iterator end() const { return const_iterator(id, getSet().end()); }
+};
+
+} // namespace pta
+} // namespace analysis
+} // namespace dg
+
+#endif // _DG_SHARED_POINTS_TO_SET_H_
@@ -39,7 +39,7 @@ private:
 
     SrgBuilder srg_builder;
     SparseRDGraph srg;
-    std::vector<std::unique_ptr<RDNode>> phi_nodes;
+    srg::SparseRDGraphBuilder::PhiNodes phi_nodes;
 
 public:
     SemisparseRda(RDNode *root) : ReachingDefinitionsAnalysis(root) {}
@@ -107,7 +107,7 @@ public:
     /**
      * see: SparseRDGraphBuilder::build
      */
-    std::pair<SparseRDGraph, std::vector<std::unique_ptr<NodeT>>>
+    std::pair<SparseRDGraph, PhiNodes>
         build(NodeT *root) override
     {
         assert( root && "need root" );
@@ -120,7 +120,7 @@ public:
         PhiPlacement pp;
 
         // place the phi functions into program
-        std::vector<std::unique_ptr<NodeT>> phi_nodes = pp.place(pp.calculate(af.build(root)));
+        PhiNodes phi_nodes = pp.place(pp.calculate(af.build(root)));
 
         // now recursively construct the SparseRDGraph
         constructSrg(root->getBBlock());
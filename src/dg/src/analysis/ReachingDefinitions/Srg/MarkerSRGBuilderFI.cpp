@@ -44,14 +44,13 @@ MarkerSRGBuilderFI::NodeT *MarkerSRGBuilderFI::readVariableRecursive(const DefSi
         if (!val)
             val = readVariable(var, predBB);
     } else {
-        auto phi = std::unique_ptr<NodeT>(new NodeT(RDNodeType::PHI));
+        NodeT *phi = phi_nodes.create(RDNodeType::PHI);
 
         phi->setBasicBlock(block);
-        writeVariable(var, phi.get(), block);
-        addPhiOperands(var, phi.get(), block);
+        writeVariable(var, phi, block);
+        addPhiOperands(var, phi, block);
 
-        val = phi.get();
-        phi_nodes.push_back(std::move(phi));
+        val = phi;
     }
     writeVariable(var, val, block);
     return val;
@@ -22,7 +22,7 @@ class MarkerSRGBuilderFI : public SparseRDGraphBuilder
     /* the resulting graph - stored in class for convenience, moved away on return */
     SparseRDGraph srg;
     /* phi nodes added during the process */
-    std::vector<std::unique_ptr<NodeT>> phi_nodes;
+    PhiNodes phi_nodes;
 
     /* work structures */
     std::unordered_map<NodeT *, std::unordered_map<BlockT *, NodeT *>> current_def;
@@ -69,7 +69,7 @@ class MarkerSRGBuilderFI : public SparseRDGraphBuilder
 
 public:
 
-    std::pair<SparseRDGraph, std::vector<std::unique_ptr<NodeT>>>
+    std::pair<SparseRDGraph, PhiNodes>
         build(NodeT *root) override {
 
         current_def.clear();
@@ -93,7 +93,7 @@ public:
             performGvn(BB);
         }
 
-        return std::make_pair<SparseRDGraph, std::vector<std::unique_ptr<NodeT>>>(std::move(srg), std::move(phi_nodes));
+        return std::make_pair<SparseRDGraph, PhiNodes>(std::move(srg), std::move(phi_nodes));
     }
 
 };
@@ -80,18 +80,16 @@ MarkerSRGBuilderFS::NodeT *MarkerSRGBuilderFS::readVariableRecursive(const DefSi
     std::vector<NodeT *> result;
 
     auto interval = concretize(detail::Interval{var.offset, var.len}, var.target->getSize());
-    auto phi = std::unique_ptr<NodeT>(new NodeT(RDNodeType::PHI));
+    NodeT *phi = phi_nodes.create(RDNodeType::PHI);
 
     phi->setBasicBlock(block);
     // writeVariableStrong kills current weak definitions, which are needed in the phi node, so we need to lookup them first.
     auto weak_defs = current_weak_def[var.target][block].collectAll(interval);
     for (auto& assignment : weak_defs)
-        insertSrgEdge(assignment, phi.get(), var);
+        insertSrgEdge(assignment, phi, var);
 
-    writeVariableStrong(var, phi.get(), block);
-    addPhiOperands(var, phi.get(), block, start, covered);
+    writeVariableStrong(var, phi, block);
+    addPhiOperands(var, phi, block, start, covered);
 
-    NodeT *val = phi.get();
-    phi_nodes.push_back(std::move(phi));
-    return val;
+    return phi;
 }
@@ -31,7 +31,7 @@ class MarkerSRGBuilderFS : public SparseRDGraphBuilder
     SparseRDGraph srg;
 
     /* phi nodes added during the process */
-    std::vector<std::unique_ptr<NodeT>> phi_nodes;
+    PhiNodes phi_nodes;
 
     /* work structures for strong defs */
     DefMapT current_def;
@@ -57,7 +57,7 @@ class MarkerSRGBuilderFS : public SparseRDGraphBuilder
      * Recursively looks up definition of @var in @block starting in @start. @start is supplied to prevent infinite recursion with weak updates.
      * @covered is set of intervals where strong update has already been found.
      * Returns a phi node that joins previous definitions. 
-     * The phi node is owned by the @phi_nodes vector.
+     * The phi node is owned by the @phi_nodes arena.
      */
     NodeT *readVariableRecursive(const DefSite& var, BlockT *block, BlockT *start, const Intervals& covered);
 
@@ -133,7 +133,7 @@ class MarkerSRGBuilderFS : public SparseRDGraphBuilder
 
 public:
 
-    std::pair<SparseRDGraph, std::vector<std::unique_ptr<NodeT>>>
+    std::pair<SparseRDGraph, PhiNodes>
         build(NodeT *root) override {
 
         current_def.clear();
@@ -157,7 +157,7 @@ public:
             performGvn(BB);
         }
 
-        return std::make_pair<SparseRDGraph, std::vector<std::unique_ptr<NodeT>>>(std::move(srg), std::move(phi_nodes));
+        return std::make_pair<SparseRDGraph, PhiNodes>(std::move(srg), std::move(phi_nodes));
     }
 
 };
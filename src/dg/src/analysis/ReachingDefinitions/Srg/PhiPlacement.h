@@ -5,6 +5,7 @@
 #include <set>
 
 #include "BBlock.h"
+#include "ADT/Arena.h"
 #include "analysis/ReachingDefinitions/Srg/AssignmentFinder.h"
 #include "analysis/ReachingDefinitions/ReachingDefinitions.h"
 
@@ -72,20 +73,19 @@ public:
     /**
      * Return ownership of added phi-nodes
      */
-    std::vector<std::unique_ptr<RDNode>> place(const PhiAdditions& pa) const
+    dg::ADT::TypedArena<RDNode> place(const PhiAdditions& pa) const
     {
-        std::vector<std::unique_ptr<RDNode>> result;
+        dg::ADT::TypedArena<RDNode> result;
         for (auto& pair : pa) {
             RDBlock *target = pair.first;
             RDNode *last = target->getFirstNode();
             for (const auto& var : pair.second) {
-                std::unique_ptr<RDNode> node = std::unique_ptr<RDNode>(new RDNode(RDNodeType::PHI));
+                RDNode *node = result.create(RDNodeType::PHI);
                 node->addDef(var, true);
                 node->addUse(var);
                 node->insertBefore(last);
-                target->prepend(node.get());
-                last = node.get();
-                result.push_back(std::move(node));
+                target->prepend(node);
+                last = node;
             }
         }
         return result;
@@ -7,6 +7,7 @@
 #include <stack>
 
 #include "BBlock.h"
+#include "ADT/Arena.h"
 #include "analysis/ReachingDefinitions/ReachingDefinitions.h"
 #include "analysis/ReachingDefinitions/Srg/PhiPlacement.h"
 
@@ -33,6 +34,8 @@ public:
     // neighbour lists representation of Sparse Graph
     //                                       ALLOCA             pair(Variable, Def/Use)
     using SparseRDGraph = std::unordered_map<NodeT *, std::vector<SRGEdge>>;
+    // the phi nodes added by the builder are allocated in an arena
+    using PhiNodes = dg::ADT::TypedArena<NodeT>;
 
     virtual ~SparseRDGraphBuilder() = default;
 
@@ -40,7 +43,7 @@ public:
      * Builds a sparse graph
      * Return value: the graph plus ownership of added phi nodes
      */
-    virtual std::pair<SparseRDGraph, std::vector<std::unique_ptr<NodeT>>>
+    virtual std::pair<SparseRDGraph, PhiNodes>
         build(NodeT *root) = 0;
 
 };
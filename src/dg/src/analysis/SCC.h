@@ -1,10 +1,10 @@
 #ifndef _DG_SCC_H_
 #define  _DG_SCC_H_
 
+#include <algorithm>
+#include <cassert>
+#include <unordered_map>
 #include <vector>
-#include <set>
-
-#include "ADT/Queue.h"
 
 namespace dg {
 namespace analysis {
@@ -12,20 +12,26 @@ namespace analysis {
 // implementation of tarjan's algorithm for
 // computing strongly connected components
 // for a directed graph that has a starting vertex
-// from which are all other vertices reachable
+// from which are all other vertices reachable.
+// The algorithm uses an explicit stack instead of recursion
+// (so that it does not overflow the stack on deep graphs)
+// and it keeps its state in side tables indexed by the DFS order
+// of nodes, so it does not need any fields in the nodes.
 template <typename NodeT>
 class SCC {
 public:
     using SCC_component_t = std::vector<NodeT *>;
     using SCC_t = std::vector<SCC_component_t>;
 
-    SCC<NodeT>() : index(0) {}
+    SCC<NodeT>() = default;
 
     // returns a vector of vectors - every inner vector
-    // contains the nodes that for a SCC
+    // contains the nodes that for a SCC. The components
+    // are in reverse topological order (a component comes
+    // after all components that are reachable from it)
     SCC_t& compute(NodeT *start)
     {
-        assert(start->dfs_id == 0);
+        assert(!visited(start));
 
         _compute(start);
         assert(stack.empty());
@@ -44,51 +50,110 @@ public:
         return scc[idx];
     }
 
+    bool visited(NodeT *n) const
+    {
+        return order.count(n) > 0;
+    }
+
+    // index of the component of the node
+    // (the index into the vector returned by compute())
+    unsigned getSCCId(NodeT *n) const
+    {
+        auto it = order.find(n);
+        assert(it != order.end() && "The node was not visited");
+        return scc_id[it->second];
+    }
 
 private:
-    ADT::QueueLIFO<NodeT *> stack;
-    unsigned index;
+    // DFS order of the visited nodes. All the other
+    // information is in vectors indexed by this order
+    std::unordered_map<NodeT *, unsigned> order;
+    std::vector<NodeT *> nodes;
+    std::vector<unsigned> lowpt;
+    std::vector<unsigned> scc_id;
+    std::vector<bool> on_stack;
+
+    // the stack of tarjan's algorithm
+    std::vector<unsigned> stack;
+
+    // the state of the DFS (replaces the recursion)
+    struct Frame {
+        unsigned idx;
+        size_t succ;
+
+        Frame(unsigned i) : idx(i), succ(0) {}
+    };
+
+    std::vector<Frame> dfs;
 
     // container for the strongly connected components.
     SCC_t scc;
 
-    void _compute(NodeT *n)
+    void _visit(NodeT *n)
     {
-        // here we using the fact that we are a friend class
-        // of SubgraphNode. If we would need to make this
-        // algorithm more generinc, we add setters/getters.
-        n->dfs_id = n->lowpt = ++index;
-        stack.push(n);
-        n->on_stack = true;
-
-        for (NodeT *succ : n->getSuccessors()) {
-            if (succ->dfs_id == 0) {
-                assert(!succ->on_stack);
-                _compute(succ);
-                n->lowpt = std::min(n->lowpt, succ->lowpt);
-            } else if (succ->on_stack) {
-                n->lowpt = std::min(n->lowpt, succ->dfs_id);
-            }
-        }
+        unsigned idx = nodes.size();
+        order.emplace(n, idx);
+        nodes.push_back(n);
+        lowpt.push_back(idx);
+        scc_id.push_back(0);
+        on_stack.push_back(true);
+
+        stack.push_back(idx);
+        dfs.emplace_back(idx);
+    }
 
-        if (n->lowpt == n->dfs_id) {
-            SCC_component_t component;
-            size_t component_num = scc.size();
-
-            NodeT *w;
-            while (stack.top()->dfs_id >= n->dfs_id) {
-                w = stack.pop();
-                w->on_stack = false;
-                component.push_back(w);
-                // the numbers scc_id give
-                // a reverse topological order
-                w->scc_id = component_num;
-
-                if (stack.empty())
-                    break;
+    void _finish(unsigned idx)
+    {
+        if (lowpt[idx] != idx)
+            return;
+
+        SCC_component_t component;
+        unsigned component_num = scc.size();
+
+        unsigned w;
+        do {
+            w = stack.back();
+            stack.pop_back();
+            on_stack[w] = false;
+            component.push_back(nodes[w]);
+            // the numbers scc_id give
+            // a reverse topological order
+            scc_id[w] = component_num;
+        } while (w != idx);
+
+        scc.push_back(std::move(component));
+    }
+
+    void _compute(NodeT *start)
+    {
+        _visit(start);
+
+        while (!dfs.empty()) {
+            Frame& frame = dfs.back();
+            unsigned idx = frame.idx;
+            const auto& succs = nodes[idx]->getSuccessors();
+
+            if (frame.succ < succs.size()) {
+                NodeT *succ = succs[frame.succ++];
+                auto it = order.find(succ);
+                if (it == order.end()) {
+                    // 'frame' is invalidated here
+                    _visit(succ);
+                } else if (on_stack[it->second]) {
+                    lowpt[idx] = std::min(lowpt[idx], it->second);
+                }
+
+                continue;
             }
 
-            scc.push_back(std::move(component));
+            // all successors are done
+            dfs.pop_back();
+            _finish(idx);
+
+            if (!dfs.empty()) {
+                unsigned parent = dfs.back().idx;
+                lowpt[parent] = std::min(lowpt[parent], lowpt[idx]);
+            }
         }
     }
 };
@@ -100,13 +165,14 @@ class SCCCondensation {
 
     struct Node {
         const SCC_component_t& component;
-        std::set<unsigned> successors;
+        // sorted and without duplicates
+        std::vector<unsigned> successors;
 
-        Node(SCC_component_t& comp) : component(comp) {}
+        Node(const SCC_component_t& comp) : component(comp) {}
 
         void addSuccessor(unsigned idx)
         {
-            successors.insert(idx);
+            successors.push_back(idx);
         }
 
         const SCC_component_t& operator*() const
@@ -115,7 +181,7 @@ class SCCCondensation {
         }
 
         // XXX: create iterators instead
-        const std::set<unsigned>& getSuccessors() const
+        const std::vector<unsigned>& getSuccessors() const
         {
             return successors;
         }
@@ -123,14 +189,8 @@ class SCCCondensation {
 
     std::vector<Node> nodes;
 
-public:
-    Node& operator[](unsigned idx)
-    {
-        assert(idx < nodes.size());
-        return nodes[idx];
-    }
-
-    void compute(SCC_t& scc)
+    template <typename GetIdT>
+    void _compute(const SCC_t& scc, GetIdT getSCCId)
     {
         // we know the size before-hand
         nodes.reserve(scc.size());
@@ -141,29 +201,61 @@ public:
 
         assert(nodes.size() == scc.size());
 
-        int idx = 0;
+        unsigned idx = 0;
         for (auto& comp : scc) {
+            auto& succs = nodes[idx].successors;
             for (NodeT *node : comp) {
                 // we can get from this component
                 // to the component of succ
                 for (NodeT *succ : node->getSuccessors()) {
-                    unsigned succ_idx = succ->getSCCId();
-                    if (static_cast<int>(succ_idx) != idx)
+                    unsigned succ_idx = getSCCId(succ);
+                    if (succ_idx != idx)
                         nodes[idx].addSuccessor(succ_idx);
                 }
             }
 
+            std::sort(succs.begin(), succs.end());
+            succs.erase(std::unique(succs.begin(), succs.end()), succs.end());
+
             ++idx;
         }
     }
 
+public:
+    Node& operator[](unsigned idx)
+    {
+        assert(idx < nodes.size());
+        return nodes[idx];
+    }
+
+    size_t size() const { return nodes.size(); }
+
+    void compute(const SCC<NodeT>& S)
+    {
+        _compute(S.getSCC(), [&S](NodeT *n) { return S.getSCCId(n); });
+    }
+
+    void compute(const SCC_t& scc)
+    {
+        std::unordered_map<NodeT *, unsigned> scc_id;
+        for (unsigned idx = 0; idx < scc.size(); ++idx) {
+            for (NodeT *n : scc[idx])
+                scc_id.emplace(n, idx);
+        }
+
+        _compute(scc, [&scc_id](NodeT *n) {
+            assert(scc_id.count(n) > 0 && "Node is not in any component");
+            return scc_id[n];
+        });
+    }
+
     SCCCondensation<NodeT>() = default;
-    SCCCondensation<NodeT>(SCC<NodeT>& S)
+    SCCCondensation<NodeT>(const SCC<NodeT>& S)
     {
-        compute(S.getSCC());
+        compute(S);
     }
 
-    SCCCondensation<NodeT>(SCC_t& s)
+    SCCCondensation<NodeT>(const SCC_t& s)
     {
         compute(s);
     }
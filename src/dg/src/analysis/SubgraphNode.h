@@ -4,6 +4,7 @@
 // This file defines a basis for nodes from
 // PointerSubgraph and reaching definitions subgraph.
 
+#include <algorithm>
 #include <vector>
 
 namespace dg {
@@ -38,21 +39,8 @@ protected:
     // size of the memory
     size_t size;
 public:
-    // FIXME: make this private, this is just for debugging
-    /// for computing SCC
-    //XXX: we could do this more generic
-    // the dfs order
-    unsigned int dfs_id;
-    unsigned int lowpt;
-
-    // id of scc component
-    unsigned int scc_id;
-    // true if the node is on stack
-    bool on_stack;
-
     SubgraphNode<NodeT>(unsigned id)
-    : id(id), data(nullptr), user_data(nullptr), size(0),
-      dfs_id(0), lowpt(0), scc_id(0), on_stack(false)
+    : id(id), data(nullptr), user_data(nullptr), size(0)
     {}
 
     unsigned int getID() const { return id; }
@@ -60,11 +48,6 @@ public:
     void setSize(size_t s) { size = s; }
     size_t getSize() const { return size; }
 
-    unsigned getSCCId() const
-    {
-        return scc_id;
-    }
-
     // getters & setters for analysis's data in the node
     template <typename T>
     T* getData() { return static_cast<T *>(data); }
@@ -186,6 +169,20 @@ public:
         addSuccessor(succ);
     }
 
+    // remove the edge from this node to 'succ'
+    void removeSuccessor(NodeT *succ)
+    {
+        auto it = std::find(successors.begin(), successors.end(), succ);
+        assert(it != successors.end() && "Not a successor");
+        successors.erase(it);
+
+        auto pit = std::find(succ->predecessors.begin(),
+                             succ->predecessors.end(),
+                             static_cast<NodeT *>(this));
+        assert(pit != succ->predecessors.end());
+        succ->predecessors.erase(pit);
+    }
+
     // get successor when we know there's only one of them
     NodeT *getSingleSuccessor() const
     {
@@ -272,6 +269,14 @@ public:
     }
 
     void isolate() {
+        // drop the self-loop, the node must not
+        // be connected to itself below
+        NodeT *self = static_cast<NodeT *>(this);
+        successors.erase(std::remove(successors.begin(), successors.end(), self),
+                         successors.end());
+        predecessors.erase(std::remove(predecessors.begin(), predecessors.end(), self),
+                           predecessors.end());
+
         // Remove this node from successors of the predecessors
         for (NodeT *pred : predecessors) {
             std::vector<NodeT *> new_succs;
@@ -328,6 +333,42 @@ public:
         users.clear();
     }
 
+    // replace every occurrence of the operand 'old' with 'nd'
+    void replaceOperand(NodeT *old, NodeT *nd)
+    {
+        bool replaced = false;
+        for (NodeT *& op : operands) {
+            if (op == old) {
+                op = nd;
+                replaced = true;
+            }
+        }
+
+        if (replaced && old != nd) {
+            nd->addUser(static_cast<NodeT *>(this));
+            old->removeUser(static_cast<NodeT *>(this));
+        }
+    }
+
+    // remove every occurrence of the operand 'op'
+    void removeOperand(NodeT *op)
+    {
+        auto end = std::remove(operands.begin(), operands.end(), op);
+        if (end == operands.end())
+            return;
+
+        operands.erase(end, operands.end());
+        op->removeUser(static_cast<NodeT *>(this));
+    }
+
+    // remove all operands (this node is no longer their user)
+    void removeAllOperands()
+    {
+        for (NodeT *op : operands)
+            op->removeUser(static_cast<NodeT *>(this));
+        operands.clear();
+    }
+
     size_t predecessorsNum() const
     {
         return predecessors.size();
@@ -368,6 +409,10 @@ private:
 
         users.push_back(nd);
     }
+
+    void removeUser(NodeT *nd) {
+        users.erase(std::remove(users.begin(), users.end(), nd), users.end());
+    }
 };
 
 } // analysis
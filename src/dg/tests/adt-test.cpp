@@ -1,11 +1,16 @@
 #include <assert.h>
 #include <cstdarg>
 #include <cstdio>
+#include <algorithm>
+#include <vector>
 
 #include "test-runner.h"
 
 #include "ADT/Queue.h"
 #include "ADT/Bitvector.h"
+#include "ADT/FlatSet.h"
+#include "ADT/Arena.h"
+#include "ADT/PersistentMap.h"
 #include "analysis/ReachingDefinitions/RDMap.h"
 
 using namespace dg::ADT;
@@ -63,6 +68,23 @@ public:
         check(queue.pop() == 4, "Wrong pop order");
         check(queue.pop() == 2, "Wrong pop order");
         check(queue.empty(), "emptied queue not empty");
+
+        // wrap around the ring buffer and make it grow
+        // while it is wrapped
+        int next_push = 0, next_pop = 0;
+        for (int round = 0; round < 100; ++round) {
+            for (int i = 0; i < round; ++i)
+                queue.push(next_push++);
+            for (int i = 0; i < round / 2; ++i)
+                check(queue.pop() == next_pop++, "Wrong pop order");
+        }
+
+        check(queue.size() == static_cast<size_t>(next_push - next_pop),
+              "BUG in size");
+        check(queue.top() == next_pop, "Wrong top");
+        while (!queue.empty())
+            check(queue.pop() == next_pop++, "Wrong pop order");
+        check(next_pop == next_push, "Lost elements");
     }
 };
 
@@ -102,6 +124,262 @@ public:
     }
 };
 
+class TestIndexedHeap : public Test
+{
+    struct Node {
+        unsigned id;
+        Node(unsigned i) : id(i) {}
+        unsigned getID() const { return id; }
+    };
+
+public:
+    TestIndexedHeap() : Test("indexed heap test")
+    {}
+
+    void test()
+    {
+        std::vector<Node> nodes;
+        for (unsigned i = 0; i < 10; ++i)
+            nodes.emplace_back(i);
+
+        IndexedHeap<Node *> heap;
+        check(heap.empty(), "empty heap not empty");
+
+        check(heap.push(&nodes[1], 10), "did not push new element");
+        check(heap.push(&nodes[2], 5), "did not push new element");
+        check(heap.push(&nodes[3], 7), "did not push new element");
+        check(heap.push(&nodes[4], 1), "did not push new element");
+
+        // duplicates are suppressed
+        check(!heap.push(&nodes[3], 8), "pushed an element twice");
+        check(heap.getPriority(&nodes[3]) == 7, "worse priority was set");
+        check(heap.size() == 4, "BUG in size");
+
+        // decrease-key
+        check(!heap.push(&nodes[1], 2), "pushed an element twice");
+        check(heap.getPriority(&nodes[1]) == 2, "priority not decreased");
+        heap.update(&nodes[4], 20);
+
+        check(heap.contains(&nodes[4]), "lost an element");
+        check(!heap.contains(&nodes[5]), "BUG in contains");
+        check(!heap.contains(&nodes[9]), "BUG in contains");
+
+        check(heap.pop() == &nodes[1], "Wrong pop order");
+        check(heap.pop() == &nodes[2], "Wrong pop order");
+        check(!heap.contains(&nodes[2]), "popped element in heap");
+        check(heap.pop() == &nodes[3], "Wrong pop order");
+        check(heap.pop() == &nodes[4], "Wrong pop order");
+        check(heap.empty(), "emptied heap not empty");
+
+        // the element can be pushed again after it was popped
+        check(heap.push(&nodes[2], 3), "did not push popped element");
+
+        // random priorities
+        std::vector<Node> many;
+        for (unsigned i = 0; i < 1000; ++i)
+            many.emplace_back(i);
+
+        IndexedHeap<Node *, unsigned, std::greater<unsigned>> maxheap;
+        for (unsigned i = 0; i < 1000; ++i)
+            maxheap.push(&many[i], (i * 7919) % 1000);
+
+        unsigned prev = ~0u;
+        while (!maxheap.empty()) {
+            unsigned prio = maxheap.topPriority();
+            check(prio <= prev, "Wrong pop order");
+            prev = prio;
+            maxheap.pop();
+        }
+    }
+};
+
+class TestFlatSet : public Test
+{
+public:
+    TestFlatSet() : Test("flat set test")
+    {}
+
+    void test()
+    {
+        FlatSet<int, 2> S;
+        check(S.empty(), "empty set not empty");
+
+        check(S.insert(4).second, "did not insert new element");
+        check(S.insert(1).second, "did not insert new element");
+        check(!S.insert(4).second, "inserted an element twice");
+        check(S.size() == 2, "BUG in size");
+
+        // this one goes over the inline elements
+        check(S.insert(13).second, "did not insert new element");
+        check(S.insert(2).second, "did not insert new element");
+        check(S.size() == 4, "BUG in size");
+
+        int prev = 0;
+        for (int x : S) {
+            check(prev < x, "elements are not sorted");
+            prev = x;
+        }
+
+        check(S.count(13) == 1, "lost an element");
+        check(S.erase(13) == 1, "did not erase an element");
+        check(S.erase(13) == 0, "erased an element twice");
+        check(S.count(13) == 0, "erased element still in the set");
+
+        FlatSet<int, 2> S2;
+        S2.insert(2);
+        S2.insert(1);
+        S2.insert(4);
+        check(S == S2, "sets should be equal");
+
+        S2.clear();
+        check(S2.empty(), "cleared set not empty");
+        S.swap(S2);
+        check(S.empty() && S2.size() == 3, "BUG in swap");
+
+        // copies and moves of a spilled set
+        FlatSet<int, 2> S3(S2);
+        check(S3 == S2, "copy differs from the original");
+        S3.insert(5);
+        check(S3.size() == 4 && S2.size() == 3, "copy shares the elements");
+        S = std::move(S3);
+        check(S.size() == 4 && S.count(5) == 1, "BUG in move");
+        check(S3.empty(), "moved-from set not empty");
+        S3.insert(1);
+        S3 = S;
+        check(S3 == S, "BUG in copy assignment");
+
+        // the spilled elements take the place of the inline ones
+        check(sizeof(FlatSet<int *, 4>) <= 4*sizeof(int *) + 8,
+              "spilled and inline elements do not share the storage");
+    }
+};
+
+class TestArena : public Test
+{
+    struct Counted {
+        static int alive;
+        uint64_t val;
+
+        Counted(uint64_t v) : val(v) { ++alive; }
+        ~Counted() { --alive; }
+    };
+
+public:
+    TestArena() : Test("arena test")
+    {}
+
+    void test()
+    {
+        Arena A(64);
+        char *c = static_cast<char *>(A.allocate(1, 1));
+        uint64_t *x = static_cast<uint64_t *>(A.allocate(sizeof(uint64_t),
+                                                         alignof(uint64_t)));
+        check(reinterpret_cast<uintptr_t>(x) % alignof(uint64_t) == 0,
+              "misaligned allocation");
+        check(static_cast<void *>(c) != static_cast<void *>(x), "overlapping allocations");
+
+        // bigger than the slab
+        A.allocate(1000);
+        check(A.slabsNum() == 2, "BUG in slabs allocation");
+        check(A.allocated() == 1 + sizeof(uint64_t) + 1000, "BUG in allocated()");
+        A.clear();
+        check(A.slabsNum() == 0 && A.allocated() == 0, "BUG in clear()");
+
+        {
+            TypedArena<Counted, 4> T;
+            std::vector<Counted *> objs;
+            for (uint64_t i = 0; i < 10; ++i)
+                objs.push_back(T.create(i));
+
+            check(T.size() == 10, "BUG in size");
+            check(Counted::alive == 10, "objects not constructed");
+            for (uint64_t i = 0; i < 10; ++i) {
+                check(objs[i]->val == i, "object overwritten");
+                check(T[i] == objs[i], "BUG in operator[]");
+            }
+
+            TypedArena<Counted, 4> T2(std::move(T));
+            check(T.empty() && T2.size() == 10, "BUG in move");
+            check(T2[3] == objs[3], "objects moved in memory");
+        }
+
+        check(Counted::alive == 0, "objects not destroyed");
+    }
+};
+
+int TestArena::Counted::alive = 0;
+
+class TestPersistentMap : public Test
+{
+    struct Index {
+        uint32_t operator()(unsigned k) const { return k; }
+    };
+
+    using MapT = PersistentMap<unsigned, int, Index>;
+
+public:
+    TestPersistentMap() : Test("persistent map test")
+    {}
+
+    void test()
+    {
+        MapT M;
+        check(M.empty(), "empty map not empty");
+
+        // the keys collide in the lower bits
+        for (unsigned i = 0; i < 1000; ++i)
+            M[i * 32] = i;
+
+        check(!M.empty(), "map is empty");
+        check(M.get(1) == nullptr, "found a key that is not there");
+
+        unsigned num = 0;
+        bool ok = true;
+        for (const auto& it : M) {
+            ok &= it.second == static_cast<int>(it.first / 32);
+            ++num;
+        }
+        check(ok && num == 1000, "BUG in iteration");
+
+        // the copy is independent
+        MapT M2 = M;
+        check(M2.sameAs(M), "copy does not share the map");
+        M2[64] = -1;
+        M2[7] = 7;
+        check(*M.get(64) == 2 && *M2.get(64) == -1, "change of copy changed the original");
+        check(M.get(7) == nullptr && *M2.get(7) == 7, "BUG in insertion to copy");
+
+        // merging visits only the values that differ
+        std::vector<unsigned> visited;
+        M.merge(M2, [&visited](const int *mine, const int& theirs, bool) {
+            visited.push_back(theirs);
+            return mine ? std::min(*mine, theirs) : theirs;
+        });
+        check(visited.size() == 2, "merge visited shared values");
+        check(*M.get(64) == -1 && *M.get(7) == 7, "BUG in merge");
+        check(*M2.get(64) == -1 && *M2.get(32) == 1, "merge changed the other map");
+
+        // merging to the empty map shares everything
+        MapT M3;
+        M3.merge(M, [](const int *, const int& theirs, bool) { return theirs; });
+        check(M3.sameAs(M), "merge to empty map does not share the map");
+
+        // only the changed values are different
+        MapT M4 = M3;
+        M4.update(32, [](const int *mine, bool) { return *mine; });
+        check(M4.sameAs(M3), "update without a change changed the map");
+        M4.update(32, [](const int *mine, bool) { return *mine + 100; });
+        M4.update(5, [](const int *mine, bool) { return mine ? 0 : 5; });
+        visited.clear();
+        M4.forEachDifferent(M3, [&visited](const MapT::value_type& it) {
+            visited.push_back(it.first);
+        });
+        check(visited.size() == 2, "wrong number of different values");
+        check(*M4.get(32) == 101 && *M3.get(32) == 1, "BUG in update");
+        check(*M4.get(5) == 5 && M3.get(5) == nullptr, "BUG in update");
+    }
+};
+
 class TestIntervalsHandling : public Test
 {
 public:
@@ -161,6 +439,10 @@ int main()
     Runner.add(new TestLIFO());
     Runner.add(new TestFIFO());
     Runner.add(new TestPrioritySet());
+    Runner.add(new TestIndexedHeap());
+    Runner.add(new TestFlatSet());
+    Runner.add(new TestArena());
+    Runner.add(new TestPersistentMap());
     Runner.add(new TestIntervalsHandling());
 
     return Runner();
@@ -0,0 +1,131 @@
+#include <vector>
+#include <string>
+#include <random>
+
+#include "ADT/Bits.h"
+#include "ADT/Bitvector.h"
+#include "../tools/TimeMeasure.h"
+
+using namespace dg::ADT;
+
+std::default_random_engine generator;
+std::uniform_int_distribution<uint64_t> distribution(0, 63);
+
+// the data are accessed through volatile pointers,
+// so that the compiler cannot hoist the computation out of the loop
+static const std::vector<uint64_t> *volatile words_ptr;
+static const SparseBitvector *volatile bitvector_ptr;
+
+// the old way: count and scan the bits one by one
+static size_t naivePopCount(uint64_t bits) {
+    size_t num = 0;
+    while (bits) {
+        if (bits & 0x1)
+            ++num;
+
+        bits = bits >> 1;
+    }
+
+    return num;
+}
+
+static size_t naiveCount() {
+    size_t num = 0;
+    for (auto w : *words_ptr)
+        num += naivePopCount(w);
+
+    return num;
+}
+
+static size_t fastCount() {
+    size_t num = 0;
+    for (auto w : *words_ptr)
+        num += popCount(w);
+
+    return num;
+}
+
+static size_t naiveSum() {
+    const std::vector<uint64_t>& words = *words_ptr;
+    size_t sum = 0;
+    for (size_t w = 0; w < words.size(); ++w) {
+        for (size_t pos = 0; pos < 64; ++pos) {
+            if (words[w] & (static_cast<uint64_t>(1) << pos))
+                sum += w * 64 + pos;
+        }
+    }
+
+    return sum;
+}
+
+static size_t bitvectorSum() {
+    size_t sum = 0;
+    for (auto x : *bitvector_ptr)
+        sum += x;
+
+    return sum;
+}
+
+static size_t scanSum() {
+    const std::vector<uint64_t>& words = *words_ptr;
+    size_t sum = 0;
+    for (size_t w = 0; w < words.size(); ++w) {
+        uint64_t bits = words[w];
+        while (bits) {
+            sum += w * 64 + countTrailingZeros(bits);
+            bits &= bits - 1;
+        }
+    }
+
+    return sum;
+}
+
+#define run(naive, fast, msg) do { \
+    std::cout << "Running " << msg << "\n"; \
+    dg::debug::TimeMeasure tm; \
+    size_t r1 = 0, r2 = 0; \
+    tm.start(); \
+    for (int i = 0; i < times; ++i) \
+        r1 += naive; \
+    tm.stop(); \
+    tm.report(" -- bit by bit took"); \
+    tm.start(); \
+    for (int i = 0; i < times; ++i) \
+        r2 += fast; \
+    tm.stop(); \
+    tm.report(" -- bit-scan/popcount took"); \
+    if (r1 != r2) \
+        std::cout << " -- RESULTS DIFFER!\n"; \
+    } while(0);
+
+int main()
+{
+    // sparse words (few bits per word) are the usual case for offsets
+    std::vector<uint64_t> words;
+    SparseBitvector B;
+    for (int i = 0; i < 1000; ++i) {
+        uint64_t w = (static_cast<uint64_t>(1) << distribution(generator)) |
+                     (static_cast<uint64_t>(1) << distribution(generator));
+        words.push_back(w);
+        for (size_t pos = 0; pos < 64; ++pos)
+            if (w & (static_cast<uint64_t>(1) << pos))
+                B.set(i * 64 + pos);
+    }
+
+    words_ptr = &words;
+    bitvector_ptr = &B;
+
+    int times;
+
+    times = 10000;
+    run(naiveCount(), fastCount(), "Counting bits in 1000 words");
+
+    times = 10000;
+    run(naiveSum(), scanSum(), "Scanning bits in 1000 words");
+
+    times = 10000;
+    run(naiveCount(), bitvector_ptr->size(), "Size of sparse bitvector");
+
+    times = 10000;
+    run(naiveSum(), bitvectorSum(), "Iterating over sparse bitvector");
+}
@@ -202,6 +202,113 @@ TEST_CASE("Merge random bitvectors (union)", "SparseBitvector") {
         REQUIRE(B1.get(x));
     }
 
-//    B2.merge(B1);
-//    REQUIRE(B1 == B2);
+    B2.merge(B1);
+    REQUIRE(B1 == B2);
+}
+
+TEST_CASE("Merge bitvectors (union) changed flag", "SparseBitvector") {
+    SparseBitvector B1;
+    SparseBitvector B2;
+
+    B1.set(1);
+    B1.set(1000);
+    B2.set(1000);
+
+    REQUIRE(B1.merge(B2) == false);
+    REQUIRE(B1.size() == 2);
+
+    B2.set(2);
+    B2.set(100000);
+    REQUIRE(B1.merge(B2) == true);
+    REQUIRE(B1.size() == 4);
+    REQUIRE(B1.get(1));
+    REQUIRE(B1.get(2));
+    REQUIRE(B1.get(1000));
+    REQUIRE(B1.get(100000));
+    REQUIRE(B1.merge(B2) == false);
+    REQUIRE(B1.merge(B1) == false);
+}
+
+TEST_CASE("Intersect and subtract bitvectors", "SparseBitvector") {
+    SparseBitvector B1;
+    SparseBitvector B2;
+
+    for (size_t i : {1, 2, 100, 1000, 100000})
+        B1.set(i);
+    for (size_t i : {2, 1000, 5000})
+        B2.set(i);
+
+    SparseBitvector I = B1;
+    REQUIRE(I.intersect(B2) == true);
+    REQUIRE(I.size() == 2);
+    REQUIRE(I.get(2));
+    REQUIRE(I.get(1000));
+    REQUIRE(I.intersect(B2) == false);
+
+    SparseBitvector D = B1;
+    REQUIRE(D.subtract(B2) == true);
+    REQUIRE(D.size() == 3);
+    REQUIRE(D.get(1));
+    REQUIRE(D.get(100));
+    REQUIRE(D.get(100000));
+    REQUIRE(!D.get(2));
+    REQUIRE(D.subtract(B2) == false);
+
+    // (B1 - B2) | (B1 & B2) == B1
+    D.merge(I);
+    REQUIRE(D == B1);
+
+    REQUIRE(D.subtract(D) == true);
+    REQUIRE(D.empty());
+    REQUIRE(D.begin() == D.end());
+}
+
+TEST_CASE("Multi-word chunks", "SparseBitvector") {
+    dg::ADT::SparseBitvectorImpl<uint64_t, uint64_t, 4> B1;
+    dg::ADT::SparseBitvectorImpl<uint64_t, uint64_t, 4> B2;
+    std::set<size_t> numbers;
+
+    std::default_random_engine generator;
+    std::uniform_int_distribution<uint64_t> distribution(0, 10000);
+
+    for (int i = 0; i < 1000; ++i) {
+        auto x = distribution(generator);
+        auto y = distribution(generator);
+        B1.set(x);
+        B2.set(y);
+        numbers.insert(x);
+        numbers.insert(y);
+    }
+
+    B1.merge(B2);
+    REQUIRE(B1.size() == numbers.size());
+
+    auto it = numbers.begin();
+    for (auto x : B1) {
+        REQUIRE(x == *it);
+        ++it;
+    }
+    REQUIRE(it == numbers.end());
+}
+
+TEST_CASE("Unset bits", "SparseBitvector") {
+    SparseBitvector B;
+
+    REQUIRE(B.unset(10) == false);
+    B.set(10);
+    B.set(11);
+    B.set(1000);
+    REQUIRE(B.size() == 3);
+
+    REQUIRE(B.unset(10) == true);
+    REQUIRE(B.unset(10) == false);
+    REQUIRE(!B.get(10));
+    REQUIRE(B.get(11));
+    REQUIRE(B.size() == 2);
+
+    REQUIRE(B.unset(1000) == true);
+    REQUIRE(B.unset(11) == true);
+    REQUIRE(B.empty());
+    REQUIRE(B.size() == 0);
+    REQUIRE(B.begin() == B.end());
 }
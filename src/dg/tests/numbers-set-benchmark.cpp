@@ -0,0 +1,153 @@
+#include <vector>
+#include <string>
+#include <random>
+
+#include "ADT/NumberSet.h"
+#include "../tools/TimeMeasure.h"
+
+using namespace dg::ADT;
+
+std::default_random_engine generator;
+
+// the numbers are accessed through a volatile pointer,
+// so that the compiler cannot hoist the computation out of the loop
+static const std::vector<uint64_t> *volatile numbers_ptr;
+
+template <typename SetT>
+static size_t fill() {
+    SetT S;
+    for (auto x : *numbers_ptr)
+        S.add(x);
+
+    return S.size();
+}
+
+template <typename SetT>
+static size_t fillAndRemove() {
+    SetT S;
+    for (auto x : *numbers_ptr)
+        S.add(x);
+    for (auto x : *numbers_ptr)
+        S.remove(x);
+
+    return S.size();
+}
+
+template <typename SetT>
+static size_t query(const SetT& S) {
+    size_t num = 0;
+    for (auto x : *numbers_ptr)
+        num += S.has(x + 1);
+
+    return num;
+}
+
+template <typename SetT>
+static size_t sum(const SetT& S) {
+    size_t sum = 0;
+    for (auto x : S)
+        sum += x;
+
+    return sum;
+}
+
+// BitvectorNumberSet has no bulk operations,
+// so the union is done element by element
+static size_t unionBitvector(const BitvectorNumberSet& A,
+                             const BitvectorNumberSet& B) {
+    BitvectorNumberSet S;
+    for (auto x : A)
+        S.add(x);
+    for (auto x : B)
+        S.add(x);
+
+    return S.size();
+}
+
+static size_t unionRoaring(const RoaringNumberSet& A,
+                           const RoaringNumberSet& B) {
+    RoaringNumberSet S(A);
+    S.merge(B);
+    return S.size();
+}
+
+#define run(bitvector, roaring, msg) do { \
+    std::cout << "Running " << msg << "\n"; \
+    dg::debug::TimeMeasure tm; \
+    size_t r1 = 0, r2 = 0; \
+    tm.start(); \
+    for (int i = 0; i < times; ++i) \
+        r1 += bitvector; \
+    tm.stop(); \
+    tm.report(" -- bitvector set took"); \
+    tm.start(); \
+    for (int i = 0; i < times; ++i) \
+        r2 += roaring; \
+    tm.stop(); \
+    tm.report(" -- roaring set took"); \
+    if (r1 != r2) \
+        std::cout << " -- RESULTS DIFFER!\n"; \
+    } while(0);
+
+static void test(const std::vector<uint64_t>& numbers,
+                 const std::vector<uint64_t>& other, int times) {
+    numbers_ptr = &numbers;
+
+    BitvectorNumberSet B1, B2;
+    RoaringNumberSet R1, R2;
+    for (auto x : numbers) {
+        B1.add(x);
+        R1.add(x);
+    }
+    for (auto x : other) {
+        B2.add(x);
+        R2.add(x);
+    }
+
+    run(fill<BitvectorNumberSet>(), fill<RoaringNumberSet>(), "adding elements");
+    run(fillAndRemove<BitvectorNumberSet>(), fillAndRemove<RoaringNumberSet>(),
+        "adding and removing elements");
+    run(query(B1), query(R1), "querying elements");
+    run(sum(B1), sum(R1), "iterating elements");
+    run(B1.size(), R1.size(), "size of the set");
+    run(unionBitvector(B1, B2), unionRoaring(R1, R2), "union of sets");
+
+    R1.optimize();
+    run(query(B1), query(R1), "querying elements (optimized)");
+    run(sum(B1), sum(R1), "iterating elements (optimized)");
+}
+
+int main()
+{
+    std::vector<uint64_t> numbers, other;
+
+    // dense IDs of nodes, like in visited sets
+    std::cout << "-- Dense numbers --\n";
+    for (uint64_t i = 0; i < 100000; ++i)
+        numbers.push_back(i);
+    for (uint64_t i = 50000; i < 150000; ++i)
+        other.push_back(i);
+    test(numbers, other, 10);
+
+    // IDs that are somewhat spread
+    std::cout << "-- Random numbers up to 10^6 --\n";
+    std::uniform_int_distribution<uint64_t> medium(0, 1000000);
+    numbers.clear();
+    other.clear();
+    for (int i = 0; i < 100000; ++i) {
+        numbers.push_back(medium(generator));
+        other.push_back(medium(generator));
+    }
+    test(numbers, other, 10);
+
+    // very sparse numbers
+    std::cout << "-- Random numbers up to 10^12 --\n";
+    std::uniform_int_distribution<uint64_t> sparse(0, 1000000000000);
+    numbers.clear();
+    other.clear();
+    for (int i = 0; i < 10000; ++i) {
+        numbers.push_back(sparse(generator));
+        other.push_back(sparse(generator));
+    }
+    test(numbers, other, 10);
+}
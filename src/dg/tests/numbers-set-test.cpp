@@ -1,6 +1,11 @@
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
 #include "ADT/NumberSet.h"
 
 using namespace dg::ADT;
@@ -128,3 +133,272 @@ TEST_CASE("Iterate mixed elements", "SmallNumberSet") {
         REQUIRE(B.has(x));
 }
 
+
+TEST_CASE("Remove elements", "BitvectorNumberSet") {
+    BitvectorNumberSet B;
+    REQUIRE(B.add(1));
+    REQUIRE(B.add(100000));
+
+    REQUIRE(B.remove(1));
+    REQUIRE(!B.remove(1));
+    REQUIRE(!B.remove(2));
+    REQUIRE(!B.has(1));
+    REQUIRE(B.has(100000));
+    REQUIRE(B.size() == 1);
+
+    REQUIRE(B.remove(100000));
+    REQUIRE(B.empty());
+}
+
+TEST_CASE("Remove elements (small-set)", "SmallNumberSet") {
+    SmallNumberSet B;
+    REQUIRE(B.add(1));
+    REQUIRE(B.add(10));
+    REQUIRE(B.remove(1));
+    REQUIRE(!B.remove(1));
+    REQUIRE(!B.remove(1000));
+    REQUIRE(B.size() == 1);
+
+    // lift the set
+    REQUIRE(B.add(1000));
+    REQUIRE(B.remove(10));
+    REQUIRE(B.remove(1000));
+    REQUIRE(!B.remove(1000));
+    REQUIRE(B.empty());
+}
+
+template <typename SetT>
+static void requireSame(const SetT& B, const std::set<uint64_t>& S) {
+    REQUIRE(B.size() == S.size());
+    REQUIRE(B.empty() == S.empty());
+
+    auto it = S.begin();
+    for (auto x : B) {
+        REQUIRE(it != S.end());
+        REQUIRE(x == *it);
+        ++it;
+    }
+    REQUIRE(it == S.end());
+}
+
+TEST_CASE("Querying empty roaring set", "RoaringNumberSet") {
+    RoaringNumberSet B;
+    REQUIRE(B.empty());
+    REQUIRE(B.size() == 0);
+    REQUIRE(!B.has(0));
+    REQUIRE(!B.remove(0));
+    REQUIRE(B.begin() == B.end());
+}
+
+TEST_CASE("Add and remove elements (roaring)", "RoaringNumberSet") {
+    RoaringNumberSet B;
+    std::set<uint64_t> S{0, 1, 10, 63, 64, 65535, 65536, 100000,
+                         1000000000000000};
+
+    for (auto x : S)
+        REQUIRE(B.add(x));
+    for (auto x : S)
+        REQUIRE(!B.add(x));
+
+    requireSame(B, S);
+    REQUIRE(!B.has(2));
+    REQUIRE(!B.has(65537));
+
+    REQUIRE(B.remove(65536));
+    REQUIRE(!B.remove(65536));
+    S.erase(65536);
+    REQUIRE(B.remove(1000000000000000));
+    S.erase(1000000000000000);
+    requireSame(B, S);
+
+    for (auto x : S)
+        REQUIRE(B.remove(x));
+    REQUIRE(B.empty());
+}
+
+TEST_CASE("Dense chunks (roaring)", "RoaringNumberSet") {
+    RoaringNumberSet B;
+    std::set<uint64_t> S;
+
+    // more than fits into an array container
+    for (uint64_t i = 0; i < 20000; i += 2) {
+        REQUIRE(B.add(i));
+        S.insert(i);
+    }
+    requireSame(B, S);
+
+    for (uint64_t i = 0; i < 20000; i += 4) {
+        REQUIRE(B.remove(i));
+        S.erase(i);
+    }
+    requireSame(B, S);
+    REQUIRE(!B.has(4));
+    REQUIRE(B.has(6));
+}
+
+TEST_CASE("Runs (roaring)", "RoaringNumberSet") {
+    RoaringNumberSet B;
+    std::set<uint64_t> S;
+
+    for (uint64_t i = 100; i < 30000; ++i) {
+        B.add(i);
+        S.insert(i);
+    }
+    for (uint64_t i = 70000; i < 70010; ++i) {
+        B.add(i);
+        S.insert(i);
+    }
+
+    auto C = B;
+    B.optimize();
+    requireSame(B, S);
+    REQUIRE(B == C);
+    REQUIRE(B.has(100));
+    REQUIRE(B.has(29999));
+    REQUIRE(!B.has(30000));
+    REQUIRE(!B.has(99));
+
+    // modify the runs
+    REQUIRE(B.remove(200));
+    REQUIRE(B.add(30000));
+    REQUIRE(!B.add(30000));
+    S.erase(200);
+    S.insert(30000);
+    requireSame(B, S);
+}
+
+TEST_CASE("Sparse chunks (roaring)", "RoaringNumberSet") {
+    std::default_random_engine generator(7);
+    // almost every number is in its own chunk
+    std::uniform_int_distribution<uint64_t> sparse(0, 1000000000000);
+    RoaringNumberSet B;
+    std::set<uint64_t> S;
+    std::vector<uint64_t> numbers;
+
+    for (int i = 0; i < 2000; ++i) {
+        auto x = sparse(generator);
+        REQUIRE(B.add(x) == S.insert(x).second);
+        numbers.push_back(x);
+    }
+    requireSame(B, S);
+
+    // remove chunks in a different order than they were added
+    std::shuffle(numbers.begin(), numbers.end(), generator);
+    for (size_t i = 0; i < numbers.size() / 2; ++i) {
+        REQUIRE(B.remove(numbers[i]) == (S.erase(numbers[i]) > 0));
+    }
+    requireSame(B, S);
+
+    for (size_t i = numbers.size() / 2; i < numbers.size(); ++i)
+        REQUIRE(B.has(numbers[i]));
+
+    RoaringNumberSet C;
+    for (auto x : S)
+        C.add(x);
+    REQUIRE(B == C);
+    REQUIRE(!B.merge(C));
+    REQUIRE(!B.add(numbers.back()));
+}
+
+TEST_CASE("Bitmaps with runs (roaring)", "RoaringNumberSet") {
+    RoaringNumberSet A, B;
+    std::set<uint64_t> SA, SB;
+
+    // the first chunk of A is a bitmap
+    for (uint64_t i = 0; i < 30000; i += 3) {
+        A.add(i);
+        SA.insert(i);
+    }
+    A.add(65535);
+    SA.insert(65535);
+
+    // the first chunk of B is made of runs, including
+    // the runs at the boundaries of the chunk and of the words
+    std::vector<std::pair<uint64_t, uint64_t>> runs = {
+        {0, 5}, {63, 64}, {100, 5000}, {7000, 7003}, {20000, 20127},
+        {65000, 65535}};
+    for (auto& r : runs) {
+        for (uint64_t i = r.first; i <= r.second; ++i) {
+            B.add(i);
+            SB.insert(i);
+        }
+    }
+    B.optimize();
+
+    std::set<uint64_t> I, D;
+    std::set_intersection(SA.begin(), SA.end(), SB.begin(), SB.end(),
+                          std::inserter(I, I.end()));
+    std::set_difference(SA.begin(), SA.end(), SB.begin(), SB.end(),
+                        std::inserter(D, D.end()));
+
+    auto RI = A;
+    REQUIRE(RI.intersect(B));
+    requireSame(RI, I);
+
+    auto RD = A;
+    REQUIRE(RD.subtract(B));
+    requireSame(RD, D);
+}
+
+TEST_CASE("Bulk operations (roaring)", "RoaringNumberSet") {
+    std::default_random_engine generator(42);
+    // sparse and dense parts
+    std::uniform_int_distribution<uint64_t> sparse(0, 1000000);
+    std::uniform_int_distribution<uint64_t> dense(0, 10000);
+
+    for (int round = 0; round < 10; ++round) {
+        RoaringNumberSet A, B;
+        std::set<uint64_t> SA, SB;
+
+        for (int i = 0; i < 5000; ++i) {
+            auto x = sparse(generator);
+            A.add(x);
+            SA.insert(x);
+            x = dense(generator);
+            B.add(x);
+            SB.insert(x);
+            x = dense(generator);
+            A.add(x);
+            SA.insert(x);
+        }
+
+        // intervals, so that some chunks end up as runs
+        for (uint64_t i = 200000; i < 200000 + 1000 * static_cast<uint64_t>(round); ++i) {
+            B.add(i);
+            SB.insert(i);
+        }
+
+        if (round % 2)
+            A.optimize();
+        else
+            B.optimize();
+
+        std::set<uint64_t> U, I, D;
+        std::set_union(SA.begin(), SA.end(), SB.begin(), SB.end(),
+                       std::inserter(U, U.end()));
+        std::set_intersection(SA.begin(), SA.end(), SB.begin(), SB.end(),
+                              std::inserter(I, I.end()));
+        std::set_difference(SA.begin(), SA.end(), SB.begin(), SB.end(),
+                            std::inserter(D, D.end()));
+
+        auto RU = A;
+        REQUIRE(RU.merge(B));
+        requireSame(RU, U);
+        REQUIRE(!RU.merge(B));
+
+        auto RI = A;
+        RI.intersect(B);
+        requireSame(RI, I);
+
+        auto RD = A;
+        RD.subtract(B);
+        requireSame(RD, D);
+        REQUIRE(!RD.subtract(B));
+
+        // the other direction of intersection
+        auto RI2 = B;
+        RI2.intersect(A);
+        requireSame(RI2, I);
+        REQUIRE(RI == RI2);
+    }
+}
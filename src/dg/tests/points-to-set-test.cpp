@@ -1,6 +1,8 @@
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 
+#include <set>
+
 #include "analysis/PointsTo/PSNode.h"
 #include "analysis/PointsTo/PointerSubgraph.h"
 #include "analysis/PointsTo/Pointer.h"
@@ -10,6 +12,13 @@ using dg::analysis::pta::PSNodeType;
 using dg::analysis::pta::Pointer;
 using dg::analysis::pta::PointerSubgraph;
 using dg::analysis::pta::PointsToSet;
+using dg::analysis::pta::SharedPointsToSet;
+using dg::analysis::pta::SharedPointsToSetTable;
+using dg::analysis::pta::BDDPointsToSet;
+using dg::analysis::pta::IDPointsToSet;
+using dg::analysis::pta::SmallPointsToSet;
+using dg::analysis::pta::SimplePointsToSet;
+using dg::analysis::Offset;
 
 TEST_CASE("Querying empty set", "PointsToSet") {
     PointsToSet B;
@@ -82,3 +91,528 @@ TEST_CASE("Merge points-to sets", "PointsToSet") {
     REQUIRE(S1.size() == 2);
 }
 
+
+// the checks that every points-to set must pass
+// (called for every set by CHECK_ALL_SETS)
+
+template <typename PTSetT>
+static void addElements() {
+    PTSetT S;
+    PointerSubgraph PS;
+    PSNode* A = PS.createAlloc();
+    PSNode* B = PS.createAlloc();
+
+    REQUIRE(S.empty());
+    REQUIRE(S.size() == 0);
+    REQUIRE(S.begin() == S.end());
+
+    REQUIRE(S.add({B, 0}));
+    REQUIRE(S.add({B, 8}));
+    REQUIRE(S.add({A, 20}));
+    REQUIRE(S.add({A, 0}));
+    REQUIRE(S.add({A, 120}));
+    REQUIRE(S.add({A, 20}) == false);
+    REQUIRE(S.add({B, 0}) == false);
+    REQUIRE(S.size() == 5);
+    REQUIRE(!S.empty());
+    REQUIRE(S.has({A, 20}));
+    REQUIRE(S.has({B, 0}));
+    REQUIRE(!S.has({B, 20}));
+
+    // every pointer is iterated over exactly once
+    std::set<Pointer> ptrs;
+    for (const auto& ptr : S) {
+        REQUIRE(S.has(ptr));
+        REQUIRE(ptrs.insert(ptr).second);
+    }
+    REQUIRE(ptrs.size() == 5);
+}
+
+template <typename PTSetT>
+static void mergeSets() {
+    PTSetT S1;
+    PTSetT S2;
+    PointerSubgraph PS;
+    PSNode* A = PS.createAlloc();
+    PSNode* B = PS.createAlloc();
+    PSNode* C = PS.createAlloc();
+
+    REQUIRE(S1.add({A, 0}));
+    REQUIRE(S1.add({A, 4}));
+    REQUIRE(S2.add({B, 0}));
+    REQUIRE(S2.add({C, Offset::UNKNOWN}));
+
+    PTSetT S3 = S1;
+    REQUIRE(S1.merge(S2));
+    REQUIRE(S1.merge(S2) == false);
+    REQUIRE(S1.size() == 4);
+    REQUIRE(S1.has({A, 4}));
+    REQUIRE(S1.has({B, 0}));
+    REQUIRE(S1.has({C, Offset::UNKNOWN}));
+
+    // the copy is independent
+    REQUIRE(S3.size() == 2);
+    REQUIRE(!S3.has({B, 0}));
+    // merging a subset changes nothing
+    REQUIRE(S1.merge(S3) == false);
+    REQUIRE(S1.size() == 4);
+}
+
+template <typename PTSetT>
+static void unknownOffset() {
+    PTSetT S;
+    PointerSubgraph PS;
+    PSNode* A = PS.createAlloc();
+    PSNode* B = PS.createAlloc();
+
+    REQUIRE(S.add({A, 0}));
+    REQUIRE(S.add({A, 4}));
+    REQUIRE(S.add({B, 4}));
+    REQUIRE(S.size() == 3);
+
+    // the unknown offset replaces the other offsets
+    REQUIRE(S.add({A, Offset::UNKNOWN}));
+    REQUIRE(S.size() == 2);
+    REQUIRE(S.has({A, Offset::UNKNOWN}));
+    REQUIRE(!S.has({A, 0}));
+    REQUIRE(S.has({B, 4}));
+    REQUIRE(S.add({A, 8}) == false);
+    REQUIRE(S.add({A, Offset::UNKNOWN}) == false);
+}
+
+// like PointsToSet, the sets take a nullptr target
+// (only iterating over such a pointer asserts). The ID set is the
+// exception, a nullptr has no global ID, so it rejects the target
+template <typename PTSetT>
+static void addNullTarget() {
+    PTSetT S;
+    REQUIRE(S.add(nullptr, 0));
+    REQUIRE(S.add(nullptr, 4));
+    REQUIRE(S.add(nullptr, 4) == false);
+    REQUIRE(S.add(reinterpret_cast<PSNode *>(0x1), 0));
+    REQUIRE(S.size() == 3);
+
+    REQUIRE(S.add(nullptr, Offset::UNKNOWN));
+    REQUIRE(S.add(nullptr, 8) == false);
+    REQUIRE(S.size() == 2);
+}
+
+// PSNodes have global IDs only with ID points-to sets
+#ifdef ENABLE_ID_POINTS_TO_SETS
+#define CHECK_ID_SET(check) check<IDPointsToSet>()
+#else
+#define CHECK_ID_SET(check) do {} while (0)
+#endif
+
+#define CHECK_ALL_SETS(check) do { \
+    check<PointsToSet>(); \
+    check<SimplePointsToSet>(); \
+    check<SharedPointsToSet>(); \
+    check<BDDPointsToSet>(); \
+    CHECK_ID_SET(check); \
+    check<SmallPointsToSet<2>>(); \
+    check<SmallPointsToSet<4>>(); \
+    } while (0)
+
+TEST_CASE("Add elements to points-to sets", "PointsToSets") {
+    CHECK_ALL_SETS(addElements);
+}
+
+TEST_CASE("Merge points-to sets of all kinds", "PointsToSets") {
+    CHECK_ALL_SETS(mergeSets);
+}
+
+TEST_CASE("Unknown offset in points-to sets", "PointsToSets") {
+    CHECK_ALL_SETS(unknownOffset);
+}
+
+TEST_CASE("nullptr target in points-to sets", "PointsToSets") {
+    addNullTarget<PointsToSet>();
+    addNullTarget<SimplePointsToSet>();
+    addNullTarget<SharedPointsToSet>();
+    addNullTarget<BDDPointsToSet>();
+    addNullTarget<SmallPointsToSet<2>>();
+    addNullTarget<SmallPointsToSet<4>>();
+}
+
+TEST_CASE("Shared sets are unique", "SharedPointsToSet") {
+    SharedPointsToSet S1;
+    SharedPointsToSet S2;
+    PointerSubgraph PS;
+    PSNode* A = PS.create(PSNodeType::ALLOC);
+    PSNode* B = PS.create(PSNodeType::ALLOC);
+
+    REQUIRE(S1.empty());
+    REQUIRE(S1 == S2);
+
+    REQUIRE(S1.add({A, 0}));
+    REQUIRE(S1.add({B, 8}));
+    REQUIRE(S1 != S2);
+
+    // add in different order, we must get the same set
+    REQUIRE(S2.add({B, 8}));
+    REQUIRE(S2.add({A, 0}));
+    REQUIRE(S1 == S2);
+    REQUIRE(S1.getID() == S2.getID());
+
+    REQUIRE(S1.add({A, 0}) == false);
+    REQUIRE(S1 == S2);
+    REQUIRE(S1.size() == 2);
+}
+
+TEST_CASE("Shared sets are copy-on-write", "SharedPointsToSet") {
+    SharedPointsToSet S1;
+    PointerSubgraph PS;
+    PSNode* A = PS.create(PSNodeType::ALLOC);
+    PSNode* B = PS.create(PSNodeType::ALLOC);
+
+    REQUIRE(S1.add({A, 0}));
+    SharedPointsToSet S2 = S1;
+    REQUIRE(S2.add({B, 0}));
+
+    REQUIRE(S1.size() == 1);
+    REQUIRE(S2.size() == 2);
+    REQUIRE(S1.has({A, 0}));
+    REQUIRE(!S1.has({B, 0}));
+    REQUIRE(S2.has({A, 0}));
+    REQUIRE(S2.has({B, 0}));
+
+    // adding to the set while iterating over it
+    // iterates over the old version of the set
+    size_t num = 0;
+    for (const auto& ptr : S2) {
+        S2.add(ptr.target, 4);
+        ++num;
+    }
+    REQUIRE(num == 2);
+    REQUIRE(S2.size() == 4);
+}
+
+TEST_CASE("Unions of shared sets are memoised", "SharedPointsToSet") {
+    SharedPointsToSet S1;
+    SharedPointsToSet S2;
+    PointerSubgraph PS;
+    PSNode* A = PS.create(PSNodeType::ALLOC);
+    PSNode* B = PS.create(PSNodeType::ALLOC);
+
+    REQUIRE(S1.add({A, 0}));
+    REQUIRE(S2.add({B, 0}));
+
+    SharedPointsToSet S3 = S1;
+    REQUIRE(S1.merge(S2));
+
+    auto unions = SharedPointsToSetTable::get().unionsNum();
+    auto sets = SharedPointsToSetTable::get().size();
+    // the same union again is memoised
+    REQUIRE(S3.merge(S2));
+    REQUIRE(S3 == S1);
+    REQUIRE(SharedPointsToSetTable::get().unionsNum() == unions);
+    REQUIRE(SharedPointsToSetTable::get().size() == sets);
+}
+
+TEST_CASE("Shared sets are freed", "SharedPointsToSet") {
+    auto& table = SharedPointsToSetTable::get();
+    PointerSubgraph PS;
+    PSNode* A = PS.createAlloc();
+    PSNode* B = PS.createAlloc();
+
+    const size_t N = 1000;
+    size_t sets = table.size();
+    size_t pointers = table.pointersNum();
+    {
+        // the offsets that the other tests do not use, so that there are
+        // no sets of one pointer from them (the nodes can get the same address)
+        SharedPointsToSet S;
+        for (size_t i = 0; i < N; ++i)
+            REQUIRE(S.add({A, 1000 + i}));
+
+        REQUIRE(S.size() == N);
+        // only the set and the sets of one pointer are alive,
+        // the previous versions of the set were freed
+        REQUIRE(table.size() == sets + N + 1);
+        REQUIRE(table.pointersNum() == pointers + 2 * N);
+    }
+
+    // the sets of one pointer are kept
+    REQUIRE(table.size() == sets + N);
+    REQUIRE(table.pointersNum() == pointers + N);
+
+    // the unions of the freed sets are forgotten, so a set
+    // that gets a freed ID does not get a stale union
+    SharedPointsToSet S1, S2;
+    S1.add({B, 0});
+    S1.add({B, 1});
+    S2.add({B, 2});
+    S2.add({B, 3});
+    SharedPointsToSet U = S1;
+    size_t unions = table.unionsNum();
+    REQUIRE(U.merge(S2));
+    REQUIRE(U.size() == 4);
+    REQUIRE(table.unionsNum() == unions + 1);
+
+    U = SharedPointsToSet();
+    REQUIRE(table.unionsNum() == unions);
+    S1 = SharedPointsToSet();
+    SharedPointsToSet S3;
+    S3.add({B, 4});
+    S3.add({B, 5});
+    REQUIRE(S3.merge(S2));
+    REQUIRE(S3.size() == 4);
+    REQUIRE(S3.has({B, 4}));
+    REQUIRE(!S3.has({B, 0}));
+}
+
+TEST_CASE("BDD sets are sorted", "BDDPointsToSet") {
+    BDDPointsToSet S;
+    PointerSubgraph PS;
+    PSNode* A = PS.create(PSNodeType::ALLOC);
+    PSNode* B = PS.create(PSNodeType::ALLOC);
+
+    REQUIRE(S.add({A, 0}));
+    REQUIRE(S.add({A, 20}));
+    REQUIRE(S.add({B, 235235}));
+    REQUIRE(S.add({A, 22332435235}));
+
+    // the elements are sorted by the target and the offset
+    std::vector<Pointer> ptrs;
+    for (const auto& ptr : S)
+        ptrs.push_back(ptr);
+    REQUIRE(ptrs.size() == 4);
+    REQUIRE(ptrs[0] == Pointer(A, 0));
+    REQUIRE(ptrs[1] == Pointer(A, 20));
+    REQUIRE(ptrs[2] == Pointer(A, 22332435235));
+    REQUIRE(ptrs[3] == Pointer(B, 235235));
+}
+
+TEST_CASE("Equal BDD sets have the same diagram", "BDDPointsToSet") {
+    BDDPointsToSet S2;
+    PointerSubgraph PS;
+    PSNode* B = PS.create(PSNodeType::ALLOC);
+
+    for (uint64_t i = 0; i < 100; ++i)
+        REQUIRE(S2.add({B, i}));
+
+    BDDPointsToSet S3;
+    for (uint64_t i = 100; i > 0; --i)
+        S3.add({B, i - 1});
+    REQUIRE(S3 == S2);
+}
+
+TEST_CASE("BDD nodes are freed", "BDDPointsToSet") {
+    using dg::analysis::pta::BDDTable;
+    BDDTable& table = BDDTable::get();
+    PointerSubgraph PS;
+    PSNode* A = PS.createAlloc();
+    PSNode* B = PS.createAlloc();
+
+    {
+        BDDPointsToSet S1;
+        BDDPointsToSet S2;
+        // every add creates a new path, the old ones are garbage
+        for (uint64_t i = 0; i < 5000; ++i) {
+            S1.add({A, 3*i});
+            S2.add({B, 3*i});
+            auto it = S2.begin();
+            REQUIRE(*it == Pointer(B, 0));
+        }
+
+        REQUIRE(table.nodesNum() < 200000);
+        REQUIRE(S1.size() == 5000);
+        REQUIRE(S2.size() == 5000);
+
+        size_t num = 0;
+        for (const auto& ptr : S2) {
+            REQUIRE(ptr == Pointer(B, 3*num));
+            ++num;
+        }
+        REQUIRE(num == 5000);
+
+        REQUIRE(S1.merge(S2));
+        REQUIRE(S1.size() == 10000);
+        REQUIRE(S1.has({A, 14997}));
+        REQUIRE(S1.has({B, 14997}));
+        REQUIRE(!S1.has({B, 14998}));
+    }
+
+#ifndef ENABLE_BDD_POINTS_TO_SETS
+    // no set is alive, so everything was freed (with BDD points-to
+    // sets in PSNodes, the static nodes keep their sets alive)
+    REQUIRE(table.nodesNum() == 2);
+#endif
+}
+
+#ifdef ENABLE_ID_POINTS_TO_SETS
+// PSNodes have global IDs only with ID points-to sets
+TEST_CASE("ID sets are sorted by the global IDs", "IDPointsToSet") {
+    IDPointsToSet S;
+    PointerSubgraph PS;
+    PSNode* A = PS.create(PSNodeType::ALLOC);
+    PSNode* B = PS.create(PSNodeType::ALLOC);
+
+    REQUIRE(S.add({B, 0}));
+    REQUIRE(S.add({B, 8}));
+    REQUIRE(S.add({A, 20}));
+    REQUIRE(S.add({A, 0}));
+    REQUIRE(S.add({A, 120}));
+
+    // the elements are sorted by the ID of the target and the offset
+    std::vector<Pointer> ptrs;
+    for (const auto& ptr : S)
+        ptrs.push_back(ptr);
+
+    // (the IDs of destroyed nodes are reused, so B can have smaller ID)
+    std::vector<Pointer> expected = {Pointer(A, 0), Pointer(A, 20),
+                                     Pointer(A, 120)};
+    auto pos = A->getGlobalID() < B->getGlobalID() ? expected.end()
+                                                   : expected.begin();
+    expected.insert(pos, {Pointer(B, 0), Pointer(B, 8)});
+    REQUIRE(ptrs == expected);
+}
+
+TEST_CASE("Big offsets and special nodes in ID sets", "IDPointsToSet") {
+    IDPointsToSet S;
+    PointerSubgraph PS;
+    PSNode* B = PS.create(PSNodeType::ALLOC);
+
+    // too big offsets are unknown
+    REQUIRE(S.add({B, 22332435235}));
+    REQUIRE(S.has({B, Offset::UNKNOWN}));
+    REQUIRE(S.size() == 1);
+
+    // the special nodes have their own IDs too
+    REQUIRE(S.add(dg::analysis::pta::PointerNull));
+    REQUIRE(S.add(dg::analysis::pta::PointerUnknown));
+    REQUIRE(S.has(dg::analysis::pta::PointerNull));
+    REQUIRE(S.size() == 3);
+}
+
+TEST_CASE("Global IDs are reused", "IDPointsToSet") {
+    PSNode *A = new PSNode(PSNodeType::NULL_ADDR);
+    PSNode *B = new PSNode(PSNodeType::NULL_ADDR);
+    unsigned idA = A->getGlobalID();
+    REQUIRE(PSNode::getByGlobalID(idA) == A);
+    REQUIRE(A->getGlobalID() != B->getGlobalID());
+
+    delete A;
+    REQUIRE(PSNode::getByGlobalID(idA) == nullptr);
+
+    PSNode *C = new PSNode(PSNodeType::NULL_ADDR);
+    REQUIRE(C->getGlobalID() == idA);
+    REQUIRE(PSNode::getByGlobalID(idA) == C);
+
+    delete B;
+    delete C;
+}
+#endif // ENABLE_ID_POINTS_TO_SETS
+
+TEST_CASE("Small set stays inline", "SmallPointsToSet") {
+    SmallPointsToSet<2> S;
+    PointerSubgraph PS;
+    PSNode* A = PS.create(PSNodeType::ALLOC);
+    PSNode* B = PS.create(PSNodeType::ALLOC);
+    PSNode* C = PS.create(PSNodeType::ALLOC);
+
+    REQUIRE(S.empty());
+    REQUIRE(S.begin() == S.end());
+    REQUIRE(S.add({B, 0}));
+    REQUIRE(S.add({A, 0}));
+    REQUIRE(S.add({A, 0}) == false);
+    REQUIRE(S.size() == 2);
+    REQUIRE(S.has({A, 0}));
+    REQUIRE(S.has({B, 0}));
+
+    // this one lifts the set
+    REQUIRE(S.add({C, 8}));
+    REQUIRE(S.add({C, 8}) == false);
+    REQUIRE(S.size() == 3);
+    REQUIRE(S.has({A, 0}));
+    REQUIRE(S.has({B, 0}));
+    REQUIRE(S.has({C, 8}));
+
+    size_t num = 0;
+    for (const auto& ptr : S) {
+        REQUIRE(S.has(ptr));
+        ++num;
+    }
+    REQUIRE(num == 3);
+}
+
+TEST_CASE("Merge lifted small sets", "SmallPointsToSet") {
+    SmallPointsToSet<2> S1;
+    SmallPointsToSet<2> S2;
+    SmallPointsToSet<2> S3;
+    PointerSubgraph PS;
+    PSNode* A = PS.create(PSNodeType::ALLOC);
+    PSNode* B = PS.create(PSNodeType::ALLOC);
+    PSNode* C = PS.create(PSNodeType::ALLOC);
+
+    REQUIRE(S1.add({A, 0}));
+    REQUIRE(S1.add({B, 0}));
+    REQUIRE(S2.add({B, 0}));
+
+    // merge big set to small one
+    REQUIRE(S3.add({A, 0}));
+    REQUIRE(S3.add({B, 0}));
+    REQUIRE(S3.add({C, 0}));
+    REQUIRE(S2.merge(S3));
+    REQUIRE(S2.size() == 3);
+    REQUIRE(S2.merge(S3) == false);
+
+    // copies are independent
+    SmallPointsToSet<2> S4 = S2;
+    REQUIRE(S4.add({C, 4}));
+    REQUIRE(S4.size() == 4);
+    REQUIRE(S2.size() == 3);
+
+    // big to big and small to big
+    REQUIRE(S4.merge(S2) == false);
+    REQUIRE(S3.merge(S1) == false);
+}
+
+TEST_CASE("Move and swap small sets", "SmallPointsToSet") {
+    SmallPointsToSet<3> S1;
+    SmallPointsToSet<3> S2;
+    SmallPointsToSet<3> S3;
+    PointerSubgraph PS;
+    PSNode* A = PS.createAlloc();
+    PSNode* B = PS.createAlloc();
+    PSNode* C = PS.createAlloc();
+    PSNode* D = PS.createAlloc();
+
+    REQUIRE(S1.add({A, 0}));
+    REQUIRE(S2.add({B, 0}));
+    REQUIRE(S2.add({C, 4}));
+    REQUIRE(S3.add({A, 0}));
+    REQUIRE(S3.add({B, 0}));
+    REQUIRE(S3.add({C, 0}));
+    REQUIRE(S3.add({D, 0}));
+
+    // sets with different number of inline pointers
+    S1.swap(S2);
+    REQUIRE(S1.size() == 2);
+    REQUIRE(S1.has({B, 0}));
+    REQUIRE(S1.has({C, 4}));
+    REQUIRE(S2.size() == 1);
+    REQUIRE(S2.has({A, 0}));
+
+    // small and lifted set
+    S2.swap(S3);
+    REQUIRE(S2.size() == 4);
+    REQUIRE(S2.has({D, 0}));
+    REQUIRE(S3.size() == 1);
+    REQUIRE(S3.has({A, 0}));
+
+    SmallPointsToSet<3> S4(std::move(S1));
+    REQUIRE(S4.size() == 2);
+    REQUIRE(S4.has({C, 4}));
+    REQUIRE(S1.empty());
+
+    S1 = std::move(S2);
+    REQUIRE(S1.size() == 4);
+    REQUIRE(S1.has({A, 0}));
+    REQUIRE(S2.empty());
+
+    S4 = std::move(S3);
+    REQUIRE(S4.size() == 1);
+    REQUIRE(S4.has({A, 0}));
+}
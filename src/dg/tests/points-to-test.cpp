@@ -2,6 +2,7 @@
 #include <cstdarg>
 #include <cstdio>
 #include <cstring>
+#include <thread>
 
 #include "test-runner.h"
 #include "test-dg.h"
@@ -9,6 +10,13 @@
 #include "analysis/PointsTo/PointerSubgraph.h"
 #include "analysis/PointsTo/PointsToFlowInsensitive.h"
 #include "analysis/PointsTo/PointsToFlowSensitive.h"
+#include "analysis/PointsTo/PointsToSparseFlowSensitive.h"
+#include "analysis/PointsTo/PointsToWithInvalidate.h"
+#include "analysis/PointsTo/PointsToContextSensitive.h"
+#include "analysis/PointsTo/PointsToDemandDriven.h"
+#include "analysis/PointsTo/PointerSubgraphOptimizations.h"
+#include "analysis/PointsTo/PointsToSnapshot.h"
+#include "analysis/SCC.h"
 
 namespace dg {
 namespace tests {
@@ -89,6 +97,49 @@ public:
         check(L3->doesPointsTo(C), "not L3->C");
     }
 
+    void store_load_loop()
+    {
+        using namespace analysis;
+
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        PSNode *B = PS.createAlloc();
+        PSNode *L1 = PS.createLoad(B);
+        PSNode *S = PS.createStore(A, B);
+        PSNode *G = PS.createGep(A, 0);
+        PSNode *L2 = PS.createLoad(B);
+
+        /*
+         *        A
+         *        |
+         *        B
+         *        |
+         *   +--> L1
+         *   |    |
+         *   |    S
+         *   |    |
+         *   +--  G
+         *        |
+         *        L2
+         *
+         * L1 is processed before G gets its memory map,
+         * it must be processed again then
+         */
+        A->addSuccessor(B);
+        B->addSuccessor(L1);
+        L1->addSuccessor(S);
+        S->addSuccessor(G);
+        G->addSuccessor(L1);
+        G->addSuccessor(L2);
+
+        PS.setRoot(A);
+        PTStoT PA(&PS);
+        PA.run();
+
+        check(L1->doesPointsTo(A), "not L1->A");
+        check(L2->doesPointsTo(A), "not L2->A");
+    }
+
     void store_load3()
     {
         using namespace analysis;
@@ -184,6 +235,119 @@ public:
         check(L2->doesPointsTo(C), "L2 do not points to C");
     }
 
+    void gep_loop()
+    {
+        using namespace analysis;
+
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        A->setSize(16);
+        PSNode *B = PS.createAlloc();
+        PSNode *P = PS.createPhi({A});
+        PSNode *G = PS.createGep(P, 4);
+        P->addOperand(G);
+        PSNode *S = PS.createStore(B, G);
+        PSNode *L = PS.createLoad(P);
+
+        /*
+         *  A -> B -> P <-+
+         *            |   |
+         *            G --+
+         *            |
+         *            S
+         *            |
+         *            L
+         *
+         * the offsets grow until they get out of A
+         * and every round adds one new pointer
+         */
+        A->addSuccessor(B);
+        B->addSuccessor(P);
+        P->addSuccessor(G);
+        G->addSuccessor(P);
+        G->addSuccessor(S);
+        S->addSuccessor(L);
+
+        PS.setRoot(A);
+        PTStoT PA(&PS);
+        PA.run();
+
+        check(P->doesPointsTo(A, Offset::UNKNOWN), "not P -> A + UNKNOWN");
+        check(G->doesPointsTo(A, Offset::UNKNOWN), "not G -> A + UNKNOWN");
+        check(L->doesPointsTo(B), "not L -> B");
+    }
+
+    void phi_cycle()
+    {
+        using namespace analysis;
+
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        PSNode *B = PS.createAlloc();
+        PSNode *P1 = PS.createPhi({A});
+        PSNode *C = PS.createCast(P1);
+        PSNode *P2 = PS.createPhi({C, B});
+        P1->addOperand(P2);
+        PSNode *L = PS.createLoad(P2);
+
+        // P1 -> C -> P2 -> P1 is a cycle of nodes
+        // that only copy the pointers
+        A->addSuccessor(B);
+        B->addSuccessor(P1);
+        P1->addSuccessor(C);
+        C->addSuccessor(P2);
+        P2->addSuccessor(L);
+
+        PS.setRoot(A);
+        PTStoT PA(&PS);
+        PA.run();
+
+        for (PSNode *n : {P1, C, P2}) {
+            check(n->doesPointsTo(A), "not P -> A");
+            check(n->doesPointsTo(B), "not P -> B");
+            check(n->pointsTo.size() == 2, "P points to something else");
+
+            // the collapsed nodes are mapped to a node from the cycle
+            if (PSNode *rep = PA.getCollapsedNodes().get(n))
+                check(rep == P1 || rep == C || rep == P2, "wrong representative");
+        }
+
+        check(L->pointsTo.empty(), "L points to something");
+    }
+
+    void self_operands()
+    {
+        using namespace analysis;
+
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        PSNode *B = PS.createAlloc();
+        PSNode *C = PS.createAlloc();
+        PSNode *P = PS.createPhi({A, B});
+        // phi in a loop that is its own operand
+        P->addOperand(P);
+        P->addOperand(C);
+        // the node that is its own operand in unreachable code
+        PSNode *G = PS.createGep(A, 4);
+        G->setOperand(0, G);
+
+        A->addSuccessor(B);
+        B->addSuccessor(C);
+        C->addSuccessor(P);
+        P->addSuccessor(G);
+        G->addSuccessor(P);
+
+        PS.setRoot(A);
+        PTStoT PA(&PS);
+        PA.run();
+
+        check(P->doesPointsTo(A), "not P -> A");
+        check(P->doesPointsTo(B), "not P -> B");
+        check(P->doesPointsTo(C), "not P -> C");
+        check(P->pointsTo.size() == 3, "P points to something else");
+        check(G->pointsTo.empty(), "G points to something");
+    }
+
     void gep1()
     {
         using namespace analysis;
@@ -913,6 +1077,7 @@ public:
     {
         store_load();
         store_load2();
+        store_load_loop();
         store_load3();
         store_load4();
         store_load5();
@@ -921,6 +1086,9 @@ public:
         gep3();
         gep4();
         gep5();
+        gep_loop();
+        phi_cycle();
+        self_operands();
         nulltest();
         constant_store();
         load_from_zeroed();
@@ -956,6 +1124,959 @@ public:
           ("flow-sensitive points-to test") {}
 };
 
+class SparseFlowSensitivePointsToTest
+    : public PointsToTest<analysis::pta::PointsToSparseFlowSensitive>
+{
+public:
+    SparseFlowSensitivePointsToTest()
+        : PointsToTest<analysis::pta::PointsToSparseFlowSensitive>
+          ("sparse flow-sensitive points-to test") {}
+
+    // the definitions from both branches meet
+    // in the memory phi at J
+    void branches()
+    {
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        PSNode *B = PS.createAlloc();
+        PSNode *P = PS.createAlloc();
+        PSNode *S1 = PS.createStore(A, P);
+        PSNode *S2 = PS.createStore(B, P);
+        PSNode *L1 = PS.createLoad(P);
+        PSNode *J = PS.createNoop();
+        PSNode *L2 = PS.createLoad(P);
+        PSNode *S3 = PS.createStore(A, P);
+        PSNode *L3 = PS.createLoad(P);
+
+        A->addSuccessor(B);
+        B->addSuccessor(P);
+        P->addSuccessor(S1);
+        S1->addSuccessor(S2);
+        S1->addSuccessor(J);
+        S2->addSuccessor(L1);
+        L1->addSuccessor(J);
+        J->addSuccessor(L2);
+        L2->addSuccessor(S3);
+        S3->addSuccessor(L3);
+
+        PS.setRoot(A);
+        analysis::pta::PointsToSparseFlowSensitive PA(&PS);
+        PA.run();
+
+        check(L1->doesPointsTo(B) && !L1->doesPointsTo(A), "L1 is not {B}");
+        check(L2->doesPointsTo(A) && L2->doesPointsTo(B), "L2 is not {A, B}");
+        check(L3->doesPointsTo(A) && !L3->doesPointsTo(B), "L3 is not {A}");
+    }
+
+    void test()
+    {
+        PointsToTest<analysis::pta::PointsToSparseFlowSensitive>::test();
+        branches();
+    }
+};
+
+class ContextSensitivePointsToTest
+    : public PointsToTest<analysis::pta::PointsToContextSensitive<
+                            analysis::pta::PointsToFlowInsensitive>>
+{
+    using CSPointsToFlowInsensitive
+        = analysis::pta::PointsToContextSensitive<
+            analysis::pta::PointsToFlowInsensitive>;
+    using CSPointsToFlowSensitive
+        = analysis::pta::PointsToContextSensitive<
+            analysis::pta::PointsToFlowSensitive>;
+
+    // f(p) { return p; } called as f(A) and f(B)
+    struct TwoCallsGraph {
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        PSNode *B = PS.createAlloc();
+        PSNode *C1 = PS.createCall({A});
+        PSNode *CR1 = PS.createCallReturn();
+        PSNode *C2 = PS.createCall({B});
+        PSNode *CR2 = PS.createCallReturn();
+
+        PSNode *E = PS.createEntry("f");
+        PSNode *P = PS.createPhi({A, B});
+        PSNodeRet *R = PS.createReturn({P});
+
+        TwoCallsGraph()
+        {
+            A->addSuccessor(B);
+            B->addSuccessor(C1);
+            C1->addSuccessor(E);
+            C1->setPairedNode(CR1);
+            CR1->setPairedNode(C1);
+            R->addSuccessor(CR1);
+            CR1->addOperand(R);
+            CR1->addSuccessor(C2);
+            C2->addSuccessor(E);
+            C2->setPairedNode(CR2);
+            CR2->setPairedNode(C2);
+            R->addSuccessor(CR2);
+            CR2->addOperand(R);
+            E->addSuccessor(P);
+            P->addSuccessor(R);
+
+            PS.setRoot(A);
+        }
+    };
+
+public:
+    ContextSensitivePointsToTest()
+        : PointsToTest<CSPointsToFlowInsensitive>
+          ("context-sensitive points-to test") {}
+
+    // the two calls of f return different sets
+    template <typename PTA>
+    void two_calls()
+    {
+        TwoCallsGraph G;
+        PTA PA(&G.PS);
+        PA.run();
+
+        check(G.CR1->doesPointsTo(G.A) && !G.CR1->doesPointsTo(G.B),
+              "CR1 is not {A}");
+        check(G.CR2->doesPointsTo(G.B) && !G.CR2->doesPointsTo(G.A),
+              "CR2 is not {B}");
+        check(G.P->doesPointsTo(G.A) && G.P->doesPointsTo(G.B),
+              "P is not {A, B}");
+
+        // the graph is the same as before the analysis
+        check(G.E->predecessorsNum() == 2, "E has wrong predecessors");
+        check(G.C1->successorsNum() == 1 && G.C1->getSingleSuccessor() == G.E,
+              "C1 has wrong successors");
+        check(G.CR1->getOperandsNum() == 1 && G.CR1->getOperand(0) == G.R,
+              "CR1 has wrong operands");
+        check(G.R->successorsNum() == 2, "R has wrong successors");
+
+        // the copies were removed
+        size_t nodes_num = 0;
+        for (PSNode *n : G.PS.getNodes()) {
+            if (n)
+                ++nodes_num;
+        }
+        check(nodes_num == 9, "the copies of f were not removed");
+        check(G.A->getUsers().size() == 2, "A has wrong users");
+    }
+
+    // g1() { return f(A); } and g2() { return f(B); } called from
+    // the root, but the calls of f do not have the arguments as operands
+    // (as from the LLVM front-end), so the copies of f take
+    // the operands of the formal argument that come from their caller
+    void calls_without_arguments()
+    {
+        PointerSubgraph PS;
+        PSNode *N = PS.createNoop();
+        PSNode *CG1 = PS.createCall();
+        PSNode *CRG1 = PS.createCallReturn();
+        PSNode *CG2 = PS.createCall();
+        PSNode *CRG2 = PS.createCallReturn();
+
+        PSNode *E1 = PS.createEntry("g1");
+        PSNode *A = PS.createAlloc();
+        PSNode *C1 = PS.createCall();
+        PSNode *CR1 = PS.createCallReturn();
+        PSNodeRet *R1 = PS.createReturn();
+
+        PSNode *E2 = PS.createEntry("g2");
+        PSNode *B = PS.createAlloc();
+        PSNode *C2 = PS.createCall();
+        PSNode *CR2 = PS.createCallReturn();
+        PSNodeRet *R2 = PS.createReturn();
+
+        PSNode *E = PS.createEntry("f");
+        PSNode *P = PS.createPhi({A, B});
+        PSNodeRet *R = PS.createReturn({P});
+
+        auto call = [](PSNode *C, PSNode *CR, PSNode *entry, PSNode *ret) {
+            C->addSuccessor(entry);
+            C->setPairedNode(CR);
+            CR->setPairedNode(C);
+            ret->addSuccessor(CR);
+            CR->addOperand(ret);
+        };
+
+        N->addSuccessor(CG1);
+        call(CG1, CRG1, E1, R1);
+        CRG1->addSuccessor(CG2);
+        call(CG2, CRG2, E2, R2);
+
+        E1->addSuccessor(A);
+        A->addSuccessor(C1);
+        call(C1, CR1, E, R);
+        CR1->addSuccessor(R1);
+        R1->addOperand(CR1);
+
+        E2->addSuccessor(B);
+        B->addSuccessor(C2);
+        call(C2, CR2, E, R);
+        CR2->addSuccessor(R2);
+        R2->addOperand(CR2);
+
+        E->addSuccessor(P);
+        P->addSuccessor(R);
+
+        PS.setRoot(N);
+        CSPointsToFlowInsensitive PA(&PS);
+        PA.run();
+
+        check(PA.getCopiedNodesNum() > 0, "f was not copied");
+        check(CR1->doesPointsTo(A) && !CR1->doesPointsTo(B), "CR1 is not {A}");
+        check(CR2->doesPointsTo(B) && !CR2->doesPointsTo(A), "CR2 is not {B}");
+        check(CRG1->doesPointsTo(A) && !CRG1->doesPointsTo(B), "CRG1 is not {A}");
+        check(P->doesPointsTo(A) && P->doesPointsTo(B), "P is not {A, B}");
+        check(P->getOperandsNum() == 2, "P has wrong operands");
+    }
+
+    // f() { return malloc(); } called twice, the copies
+    // of the allocation are reported as the original
+    void copied_alloc()
+    {
+        PointerSubgraph PS;
+        PSNode *C1 = PS.createCall();
+        PSNode *CR1 = PS.createCallReturn();
+        PSNode *C2 = PS.createCall();
+        PSNode *CR2 = PS.createCallReturn();
+
+        PSNode *E = PS.createEntry("f");
+        PSNode *X = PS.createDynAlloc();
+        PSNodeRet *R = PS.createReturn({X});
+
+        C1->addSuccessor(E);
+        C1->setPairedNode(CR1);
+        CR1->setPairedNode(C1);
+        R->addSuccessor(CR1);
+        CR1->addOperand(R);
+        CR1->addSuccessor(C2);
+        C2->addSuccessor(E);
+        C2->setPairedNode(CR2);
+        CR2->setPairedNode(C2);
+        R->addSuccessor(CR2);
+        CR2->addOperand(R);
+        E->addSuccessor(X);
+        X->addSuccessor(R);
+
+        PS.setRoot(C1);
+        CSPointsToFlowSensitive PA(&PS);
+        PA.run();
+
+        check(PA.getCopiedNodesNum() == 6, "wrong number of copied nodes");
+        check(CR1->pointsTo.size() == 1 && CR1->doesPointsTo(X),
+              "CR1 is not {X}");
+        check(CR2->pointsTo.size() == 1 && CR2->doesPointsTo(X),
+              "CR2 is not {X}");
+        check(X->doesPointsTo(X), "X does not point to itself");
+    }
+
+    // a budget too small for both copies makes the second call
+    // context-insensitive
+    void budget()
+    {
+        TwoCallsGraph G;
+        // the copy of 'f' has 3 nodes, so only the first call gets it
+        CSPointsToFlowInsensitive PA(&G.PS, 2, 4);
+        PA.run();
+
+        check(PA.getCopiedNodesNum() == 3, "wrong number of copied nodes");
+        check(PA.getFallbackCallsNum() == 1, "wrong number of fallbacks");
+        check(G.CR1->doesPointsTo(G.A) && !G.CR1->doesPointsTo(G.B),
+              "CR1 is not {A}");
+        check(G.CR2->doesPointsTo(G.A) && G.CR2->doesPointsTo(G.B),
+              "CR2 is not {A, B}");
+    }
+
+    void test()
+    {
+        PointsToTest<CSPointsToFlowInsensitive>::test();
+        two_calls<CSPointsToFlowInsensitive>();
+        two_calls<CSPointsToFlowSensitive>();
+        calls_without_arguments();
+        copied_alloc();
+        budget();
+    }
+};
+
+class MemoryMapTest : public Test
+{
+public:
+    MemoryMapTest()
+        : Test("flow-sensitive memory map test") {}
+
+    void test()
+    {
+        using MemoryMapT = PointsToFlowSensitive::MemoryMapT;
+
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        PSNode *B = PS.createAlloc();
+        PSNode *C = PS.createAlloc();
+        PSNode *S1 = PS.createStore(A, B);
+        PSNode *S2 = PS.createStore(A, C);
+        PSNode *L = PS.createLoad(B);
+
+        A->addSuccessor(B);
+        B->addSuccessor(C);
+        C->addSuccessor(S1);
+        S1->addSuccessor(S2);
+        S2->addSuccessor(L);
+
+        PS.setRoot(A);
+        PointsToFlowSensitive PA(&PS);
+        PA.run();
+
+        check(L->doesPointsTo(A), "not L -> A");
+
+        // S2 writes only to C, so it shares the object of B with S1
+        MemoryMapT *mm1 = S1->getData<MemoryMapT>();
+        MemoryMapT *mm2 = S2->getData<MemoryMapT>();
+        check(mm1 != mm2, "stores share the memory map");
+        check(mm1->get(B) && mm2->get(B) &&
+              mm1->get(B)->get() == mm2->get(B)->get(),
+              "the memory object is not shared");
+        check(!mm1->get(C) && mm2->get(C), "S1 has the memory of S2");
+    }
+};
+
+class ParallelPointsToTest : public Test
+{
+    static const int N = 300;
+
+    // every cell M[i] gets pointer to A[i] and the pointers
+    // loaded from the next cell, so at the end all the cells
+    // (and loads) point to all the A's
+    static std::vector<PSNode *> build(PointerSubgraph& PS)
+    {
+        std::vector<PSNode *> nodes;
+        std::vector<PSNode *> A, M;
+        for (int i = 0; i < N; ++i) {
+            A.push_back(PS.createAlloc());
+            M.push_back(PS.createAlloc());
+            nodes.push_back(A.back());
+            nodes.push_back(M.back());
+        }
+
+        PSNode *phi = PS.createPhi({});
+        for (int i = 0; i < N; ++i) {
+            PSNode *L = PS.createLoad(M[(i + 1) % N]);
+            PSNode *G = PS.createGep(L, 0);
+            nodes.push_back(PS.createStore(A[i], M[i]));
+            nodes.push_back(L);
+            nodes.push_back(G);
+            nodes.push_back(PS.createStore(G, M[i]));
+            phi->addOperand(G);
+        }
+        nodes.push_back(phi);
+
+        for (size_t i = 1; i < nodes.size(); ++i)
+            nodes[i - 1]->addSuccessor(nodes[i]);
+        nodes.back()->addSuccessor(nodes[2 * N]);
+
+        PS.setRoot(nodes[0]);
+        return nodes;
+    }
+
+    // records the threads that call the error hook
+    class ErrorsPTA : public PointsToFlowInsensitive {
+    public:
+        std::vector<std::thread::id> threads;
+
+        ErrorsPTA(PointerSubgraph *ps)
+        : PointsToFlowInsensitive(ps, 4) {}
+
+        bool errorEmptyPointsTo(PSNode *, PSNode *) override
+        {
+            threads.push_back(std::this_thread::get_id());
+            return false;
+        }
+    };
+
+    void error_hooks()
+    {
+        // loads from memory that nobody writes to
+        PointerSubgraph PS;
+        PSNode *last = PS.createAlloc();
+        PS.setRoot(last);
+        for (int i = 0; i < N; ++i) {
+            PSNode *A = PS.createAlloc();
+            PSNode *L = PS.createLoad(A);
+            last->addSuccessor(A);
+            A->addSuccessor(L);
+            last = L;
+        }
+
+        ErrorsPTA PA(&PS);
+        PA.run();
+
+        check(PA.threads.size() == N, "wrong number of reported errors");
+        bool main_thread = true;
+        for (const std::thread::id& id : PA.threads)
+            main_thread &= id == std::this_thread::get_id();
+        check(main_thread, "error hook called from a worker thread");
+    }
+
+public:
+    ParallelPointsToTest()
+        : Test("parallel points-to test") {}
+
+    void test()
+    {
+        error_hooks();
+
+        PointerSubgraph PS1, PS2;
+        std::vector<PSNode *> seq = build(PS1);
+        std::vector<PSNode *> par = build(PS2);
+
+        PointsToFlowInsensitive PA1(&PS1);
+        PA1.run();
+        PointsToFlowInsensitive PA2(&PS2, 4);
+        PA2.run();
+
+        bool same = true;
+        for (size_t i = 0; i < seq.size(); ++i) {
+            same &= seq[i]->pointsTo.size() == par[i]->pointsTo.size();
+            for (const Pointer& ptr : seq[i]->pointsTo) {
+                // the graphs differ only in the nodes
+                unsigned id = ptr.target->getID();
+                same &= par[i]->doesPointsTo(PS2.getNodes()[id], ptr.offset);
+            }
+        }
+        check(same, "parallel analysis computed different points-to sets");
+
+        // the phi gets all the pointers
+        check(par.back()->pointsTo.size() == N, "phi does not point to all A's");
+    }
+};
+
+class PSOptimizationsTest : public Test
+{
+public:
+    PSOptimizationsTest()
+          : Test("pointer subgraph optimizations test") {}
+
+    void variable_substitution()
+    {
+        using namespace dg::analysis::pta;
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        PSNode *B = PS.createAlloc();
+        PSNode *P = PS.createAlloc();
+        PSNode *G1 = PS.createGep(P, 4);
+        PSNode *G2 = PS.createGep(P, 4);
+        PSNode *S1 = PS.createStore(A, G1);
+        PSNode *L1 = PS.createLoad(G1);
+        PSNode *L2 = PS.createLoad(G2);
+        PSNode *S2 = PS.createStore(B, G2);
+        PSNode *L3 = PS.createLoad(G1);
+        PSNode *Phi1 = PS.createPhi({A, B});
+        PSNode *Phi2 = PS.createPhi({B, A, A});
+        PSNode *L4 = PS.createLoad(Phi2);
+
+        A->addSuccessor(B);
+        B->addSuccessor(P);
+        P->addSuccessor(G1);
+        G1->addSuccessor(G2);
+        G2->addSuccessor(S1);
+        S1->addSuccessor(L1);
+        L1->addSuccessor(L2);
+        L2->addSuccessor(S2);
+        S2->addSuccessor(L3);
+        L3->addSuccessor(Phi1);
+        Phi1->addSuccessor(Phi2);
+        Phi2->addSuccessor(L4);
+
+        PS.setRoot(A);
+        PSVariableSubstitution substitution(&PS);
+        substitution.run();
+
+        // G2 -> G1, Phi2 -> Phi1 and then L2 -> L1
+        check(substitution.getNumOfMergedNodes() == 3, "wrong number of merged nodes");
+        auto& mapping = substitution.getMapping();
+        check(mapping.get(G2) == G1, "G2 not merged to G1");
+        check(mapping.get(L2) == L1, "L2 not merged to L1");
+        check(mapping.get(Phi2) == Phi1, "Phi2 not merged to Phi1");
+        // there is a store between L1 and L3
+        check(mapping.get(L3) == nullptr, "L3 merged");
+        check(L1->getSingleSuccessor() == S2, "L1 not connected to S2");
+        check(L4->getOperand(0) == Phi1, "L4 does not use Phi1");
+
+        PointsToFlowSensitive PA(&PS);
+        PA.run();
+
+        check(L1->doesPointsTo(A) && !L1->doesPointsTo(B), "L1 is not {A}");
+        check(L3->doesPointsTo(B) && !L3->doesPointsTo(A), "L3 is not {B}");
+    }
+
+    void test()
+    {
+        variable_substitution();
+    }
+};
+
+class DemandDrivenPointsToTest : public Test
+{
+public:
+    DemandDrivenPointsToTest()
+          : Test("demand-driven points-to test") {}
+
+    // A, B, P, Q = alloc; *P = A; X = phi(B); *Q = X; L1 = *P; L2 = *Q
+    void queries()
+    {
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        PSNode *B = PS.createAlloc();
+        PSNode *P = PS.createAlloc();
+        PSNode *Q = PS.createAlloc();
+        PSNode *S1 = PS.createStore(A, P);
+        PSNode *X = PS.createPhi({B});
+        PSNode *S2 = PS.createStore(X, Q);
+        PSNode *L1 = PS.createLoad(P);
+        PSNode *L2 = PS.createLoad(Q);
+
+        A->addSuccessor(B);
+        B->addSuccessor(P);
+        P->addSuccessor(Q);
+        Q->addSuccessor(S1);
+        S1->addSuccessor(X);
+        X->addSuccessor(S2);
+        S2->addSuccessor(L1);
+        L1->addSuccessor(L2);
+        PS.setRoot(A);
+
+        PointsToDemandDriven DD(&PS);
+        PointsToSetT L1pts = DD.pointsTo(L1);
+        check(L1pts.size() == 1 && L1pts.count(Pointer(A, 0)) == 1,
+              "L1 does not point only to A");
+        // *Q = X does not write the memory read by L1
+        check(DD.getSliceSize() == 2, "the slice of L1 is not {L1, S1}");
+
+        size_t processed = DD.getProcessedNum();
+        check(DD.pointsTo(L1).count(Pointer(A, 0)) == 1, "L1 changed");
+        check(DD.getProcessedNum() == processed, "L1 was not memoised");
+
+        check(DD.mayAlias(L1, A), "L1 does not alias with A");
+        check(!DD.mayAlias(L1, L2), "L1 aliases with L2");
+        check(DD.pointsTo(L2).count(Pointer(B, 0)) == 1, "L2 does not point to B");
+        check(DD.getSliceSize() == 5, "the slice of L2 is not extended");
+        check(!DD.isExhaustive(), "used the exhaustive analysis");
+        // the graph was not touched
+        check(L1->pointsTo.empty() && X->pointsTo.empty(),
+              "the demand-driven analysis changed the nodes");
+    }
+
+    // A, B, C, P, Q = alloc; *P = A; L = *P; *L = B; *Q = C; M = *A
+    void unknown_destination()
+    {
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        PSNode *B = PS.createAlloc();
+        PSNode *C = PS.createAlloc();
+        PSNode *P = PS.createAlloc();
+        PSNode *Q = PS.createAlloc();
+        PSNode *S1 = PS.createStore(A, P);
+        PSNode *L = PS.createLoad(P);
+        PSNode *S2 = PS.createStore(B, L);
+        PSNode *S3 = PS.createStore(C, Q);
+        PSNode *M = PS.createLoad(A);
+
+        A->addSuccessor(B);
+        B->addSuccessor(C);
+        C->addSuccessor(P);
+        P->addSuccessor(Q);
+        Q->addSuccessor(S1);
+        S1->addSuccessor(L);
+        L->addSuccessor(S2);
+        S2->addSuccessor(S3);
+        S3->addSuccessor(M);
+        PS.setRoot(A);
+
+        PointsToDemandDriven DD(&PS);
+        PointsToSetT Mpts = DD.pointsTo(M);
+        check(Mpts.size() == 1 && Mpts.count(Pointer(B, 0)) == 1,
+              "M does not point only to B");
+        // the store via the loaded pointer is in the slice,
+        // the store to Q is not
+        check(DD.getSliceSize() == 4, "the slice of M is not {M, S2, L, S1}");
+        check(!DD.isExhaustive(), "used the exhaustive analysis");
+    }
+
+    // *P = A; L = *P; with the budget of one processed node
+    void budget()
+    {
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        PSNode *P = PS.createAlloc();
+        PSNode *S = PS.createStore(A, P);
+        PSNode *L = PS.createLoad(P);
+
+        A->addSuccessor(P);
+        P->addSuccessor(S);
+        S->addSuccessor(L);
+        PS.setRoot(A);
+
+        PointsToDemandDriven DD(&PS, 1);
+        check(DD.mayAlias(L, A), "L does not alias with A");
+        check(DD.isExhaustive(), "did not use the exhaustive analysis");
+        check(L->doesPointsTo(A), "the exhaustive analysis did not run");
+    }
+
+    // C = (cast) A; *P = A; L = *P; with the budget of two processed nodes,
+    // the set of C computed on demand outlives the switch
+    // to the exhaustive analysis
+    void query_after_fallback()
+    {
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        PSNode *C = PS.createCast(A);
+        PSNode *P = PS.createAlloc();
+        PSNode *S = PS.createStore(A, P);
+        PSNode *L = PS.createLoad(P);
+
+        A->addSuccessor(C);
+        C->addSuccessor(P);
+        P->addSuccessor(S);
+        S->addSuccessor(L);
+        PS.setRoot(A);
+
+        PointsToDemandDriven DD(&PS, 2);
+        PointsToSetT Cpts = DD.pointsTo(C);
+        check(!DD.isExhaustive(), "used the exhaustive analysis");
+
+        PointsToSetT Lpts = DD.pointsTo(L);
+        check(DD.isExhaustive(), "did not use the exhaustive analysis");
+        check(Lpts.size() == 1 && Lpts.count(Pointer(A, 0)) == 1,
+              "L does not point only to A");
+        check(Cpts.size() == 1 && Cpts.count(Pointer(A, 0)) == 1,
+              "the set of C changed");
+    }
+
+    void test()
+    {
+        queries();
+        unknown_destination();
+        budget();
+        query_after_fallback();
+    }
+};
+
+class BudgetPointsToTest : public Test
+{
+public:
+    BudgetPointsToTest()
+          : Test("points-to budget test") {}
+
+    static bool hasLoss(const PointerAnalysis& PA, PrecisionLoss::Reason r,
+                        PrecisionLoss::Action a, PSNode *n)
+    {
+        for (const PrecisionLoss& loss : PA.getPrecisionLosses()) {
+            if (loss.reason == r && loss.action == a && loss.node == n)
+                return true;
+        }
+
+        return false;
+    }
+
+    // P = phi(A, B, C); *P = X; L = *A
+    // with at most two pointers in a points-to set
+    void points_to_size()
+    {
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        PSNode *B = PS.createAlloc();
+        PSNode *C = PS.createAlloc();
+        PSNode *X = PS.createAlloc();
+        PSNode *P = PS.createPhi({A, B, C});
+        PSNode *S = PS.createStore(X, P);
+        PSNode *L = PS.createLoad(A);
+
+        A->addSuccessor(B);
+        B->addSuccessor(C);
+        C->addSuccessor(X);
+        X->addSuccessor(P);
+        P->addSuccessor(S);
+        S->addSuccessor(L);
+        PS.setRoot(A);
+
+        PointsToBudget budget;
+        budget.pointsToSize = 2;
+        PointsToFlowInsensitive PA(&PS);
+        PA.setBudget(budget);
+        PA.run();
+
+        check(P->pointsTo.size() == 1 && P->doesPointsTo(UNKNOWN_MEMORY, Offset::UNKNOWN),
+              "P does not point only to unknown memory");
+        // the store via unknown memory can write to A
+        check(L->doesPointsTo(X), "L does not point to X");
+        check(hasLoss(PA, PrecisionLoss::Reason::POINTS_TO_SIZE,
+                      PrecisionLoss::Action::UNKNOWN_TARGETS, P),
+              "the loss in P is not reported");
+    }
+
+    // P = phi(A + 0, A + 8, A + 16) with at most two offsets of an object
+    void offsets()
+    {
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        A->setSize(32);
+        PSNode *G1 = PS.createGep(A, 0);
+        PSNode *G2 = PS.createGep(A, 8);
+        PSNode *G3 = PS.createGep(A, 16);
+        PSNode *P = PS.createPhi({G1, G2, G3});
+        PSNode *G4 = PS.createGep(A, 4);
+
+        A->addSuccessor(G1);
+        G1->addSuccessor(G2);
+        G2->addSuccessor(G3);
+        G3->addSuccessor(P);
+        P->addSuccessor(G4);
+        PS.setRoot(A);
+
+        PointsToBudget budget;
+        budget.offsets = 2;
+        PointsToFlowInsensitive PA(&PS);
+        PA.setBudget(budget);
+        PA.run();
+
+        check(P->pointsTo.size() == 1 && P->doesPointsTo(A, Offset::UNKNOWN),
+              "P does not point to A + UNKNOWN");
+        check(G1->doesPointsTo(A, 0), "G1 lost its pointer");
+        // A is field-insensitive now
+        check(G4->doesPointsTo(A, Offset::UNKNOWN), "G4 does not point to A + UNKNOWN");
+        check(hasLoss(PA, PrecisionLoss::Reason::OFFSETS,
+                      PrecisionLoss::Action::FIELD_INSENSITIVE, A),
+              "A is not reported as field-insensitive");
+    }
+
+    // A, B = alloc; G = A + 4; *B = G; L = *B
+    // with the budget of one processed node
+    template <typename PTA>
+    void iterations()
+    {
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        A->setSize(8);
+        PSNode *B = PS.createAlloc();
+        PSNode *G = PS.createGep(A, 4);
+        PSNode *S = PS.createStore(G, B);
+        PSNode *L = PS.createLoad(B);
+
+        A->addSuccessor(B);
+        B->addSuccessor(G);
+        G->addSuccessor(S);
+        S->addSuccessor(L);
+        PS.setRoot(A);
+
+        PointsToBudget budget;
+        budget.iterations = 1;
+        PTA PA(&PS);
+        PA.setBudget(budget);
+        PA.run();
+
+        check(L->doesPointsTo(A, 4) || L->doesPointsTo(A, Offset::UNKNOWN) ||
+              L->doesPointsTo(UNKNOWN_MEMORY, Offset::UNKNOWN) ||
+              L->doesPointsTo(UNKNOWN_MEMORY, 0), "L lost the pointer to A");
+        check(hasLoss(PA, PrecisionLoss::Reason::ITERATIONS,
+                      PrecisionLoss::Action::UNKNOWN_OFFSETS, nullptr),
+              "the unknown offsets are not reported");
+        check(hasLoss(PA, PrecisionLoss::Reason::ITERATIONS,
+                      PrecisionLoss::Action::UNKNOWN_TARGETS, nullptr),
+              "the unknown targets are not reported");
+    }
+
+    // A = alloc; S1: *A = X; S2: *A = Y; P = phi(A + 0, A + 8, A + 16);
+    // L = *A with at most two offsets of an object. A becomes
+    // field-insensitive after S2 overwrote X, so S2 must not be
+    // a strong update anymore and L must see X again
+    template <typename PTA>
+    void strong_update()
+    {
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        A->setSize(32);
+        PSNode *X = PS.createAlloc();
+        PSNode *Y = PS.createAlloc();
+        PSNode *S1 = PS.createStore(X, A);
+        PSNode *S2 = PS.createStore(Y, A);
+        PSNode *G1 = PS.createGep(A, 0);
+        PSNode *G2 = PS.createGep(A, 8);
+        PSNode *G3 = PS.createGep(A, 16);
+        PSNode *P = PS.createPhi({G1, G2, G3});
+        PSNode *L = PS.createLoad(A);
+
+        A->addSuccessor(X);
+        X->addSuccessor(Y);
+        Y->addSuccessor(S1);
+        S1->addSuccessor(S2);
+        S2->addSuccessor(G1);
+        G1->addSuccessor(G2);
+        G2->addSuccessor(G3);
+        G3->addSuccessor(P);
+        P->addSuccessor(L);
+        PS.setRoot(A);
+
+        PointsToBudget budget;
+        budget.offsets = 2;
+        PTA PA(&PS);
+        PA.setBudget(budget);
+        PA.run();
+
+        check(hasLoss(PA, PrecisionLoss::Reason::OFFSETS,
+                      PrecisionLoss::Action::FIELD_INSENSITIVE, A),
+              "A is not reported as field-insensitive");
+        check(L->doesPointsTo(Y), "L does not point to Y");
+        check(L->doesPointsTo(X), "L lost the pointer overwritten by S2");
+    }
+
+    void unlimited()
+    {
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        PSNode *B = PS.createAlloc();
+        PSNode *P = PS.createPhi({A, B});
+
+        A->addSuccessor(B);
+        B->addSuccessor(P);
+        PS.setRoot(A);
+
+        PointsToFlowInsensitive PA(&PS);
+        PA.run();
+
+        check(PA.getBudget().isUnlimited(), "the default budget is limited");
+        check(PA.getPrecisionLosses().empty(), "reported loss without budget");
+        check(P->pointsTo.size() == 2, "P does not point to A and B");
+    }
+
+    void test()
+    {
+        points_to_size();
+        offsets();
+        iterations<PointsToFlowInsensitive>();
+        iterations<PointsToFlowSensitive>();
+        strong_update<PointsToFlowSensitive>();
+        strong_update<PointsToWithInvalidate>();
+        strong_update<PointsToSparseFlowSensitive>();
+        unlimited();
+    }
+};
+
+class PointsToSnapshotTest : public Test
+{
+public:
+    PointsToSnapshotTest()
+          : Test("points-to snapshot test") {}
+
+    // A, B, P = alloc; *P = A; L1 = *P; *P = B; L2 = *P
+    // (the node names are stored in the user data)
+    template <typename PTA>
+    void runAndSave(const char *path, std::vector<std::string>& names)
+    {
+        using namespace dg::analysis::pta;
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        PSNode *B = PS.createAlloc();
+        PSNode *P = PS.createAlloc();
+        PSNode *S1 = PS.createStore(A, P);
+        PSNode *L1 = PS.createLoad(P);
+        PSNode *S2 = PS.createStore(B, P);
+        PSNode *L2 = PS.createLoad(P);
+
+        A->addSuccessor(B);
+        B->addSuccessor(P);
+        P->addSuccessor(S1);
+        S1->addSuccessor(L1);
+        L1->addSuccessor(S2);
+        S2->addSuccessor(L2);
+
+        A->setUserData(&names[0]);
+        B->setUserData(&names[1]);
+        L1->setUserData(&names[2]);
+        L2->setUserData(&names[3]);
+
+        PS.setRoot(A);
+        PTA PA(&PS);
+        PA.run();
+
+        bool ret = PointsToSnapshot::save(&PS, path, [](const PSNode *nd) {
+            const std::string *name = nd->getUserData<std::string>();
+            return name ? *name : std::string();
+        });
+        check(ret, "failed saving the snapshot");
+    }
+
+    void save_load_diff()
+    {
+        using namespace dg::analysis::pta;
+        std::vector<std::string> names = {"A", "B", "L1", "L2"};
+        runAndSave<PointsToFlowInsensitive>("points-to-snapshot-fi.pts", names);
+        runAndSave<PointsToFlowSensitive>("points-to-snapshot-fs.pts", names);
+
+        PointsToSnapshot fi, fs;
+        check(fi.load("points-to-snapshot-fi.pts"), "failed loading the snapshot");
+        check(fs.load("points-to-snapshot-fs.pts"), "failed loading the snapshot");
+
+        check(fi.size() == 7, "wrong number of nodes");
+        const PointsToSnapshot::NodeRecord *L1 = fi.getNodeByID(5);
+        check(L1 && fi.getName(*L1) == "L1", "L1 not found");
+        check(L1 && L1->pointers_num == 2, "L1 does not have two pointers");
+        check(L1 && fi.getPointerString(*fi.pointersBegin(*L1)) == "A + 0",
+              "L1 does not point to A");
+        const PointsToSnapshot::NodeRecord *S1 = fi.getNodeByID(4);
+        check(S1 && fi.getKey(*S1) == "<4>", "S1 has wrong key");
+
+        auto diffs = PointsToSnapshot::diff(fi, fs);
+        check(diffs.size() == 2, "wrong number of differences");
+        if (diffs.size() == 2) {
+            check(diffs[0].node == "L1" && diffs[0].only_first.size() == 1 &&
+                  diffs[0].only_first[0] == "B + 0" &&
+                  diffs[0].only_second.empty(), "wrong difference in L1");
+            check(diffs[1].node == "L2" && diffs[1].only_first.size() == 1 &&
+                  diffs[1].only_first[0] == "A + 0", "wrong difference in L2");
+        }
+
+        check(PointsToSnapshot::diff(fi, fi).empty(), "snapshot differs from itself");
+
+        PointsToSnapshot bad;
+        check(!bad.load("points-to-test.cpp-does-not-exist"),
+              "loaded nonexistent file");
+
+        std::remove("points-to-snapshot-fi.pts");
+        std::remove("points-to-snapshot-fs.pts");
+    }
+
+    // the nodes given in any order are saved sorted by ID
+    void save_unsorted()
+    {
+        using namespace dg::analysis::pta;
+        PointerSubgraph PS;
+        PSNode *A = PS.createAlloc();
+        PSNode *B = PS.createAlloc();
+        PSNode *P = PS.createPhi({A, B});
+
+        A->addSuccessor(B);
+        B->addSuccessor(P);
+        PS.setRoot(A);
+        PointsToFlowInsensitive PA(&PS);
+        PA.run();
+
+        bool ret = PointsToSnapshot::save({P, A, B, A}, "points-to-snapshot-unsorted.pts");
+        check(ret, "failed saving the snapshot");
+
+        PointsToSnapshot snap;
+        check(snap.load("points-to-snapshot-unsorted.pts"), "failed loading the snapshot");
+        check(snap.size() == 3, "wrong number of nodes");
+        const PointsToSnapshot::NodeRecord *rec = snap.getNodeByID(P->getID());
+        check(rec && rec->pointers_num == 2, "P does not have two pointers");
+
+        std::remove("points-to-snapshot-unsorted.pts");
+    }
+
+    void test()
+    {
+        save_load_diff();
+        save_unsorted();
+    }
+};
+
 class PSNodeTest : public Test
 {
 
@@ -979,9 +2100,179 @@ public:
         check(N2->addPointsTo(N1, 3) == false);
     }
 
+    void builders()
+    {
+        using namespace dg::analysis::pta;
+        PointerSubgraph PS;
+        PSNodeAlloc *A = PS.createAlloc();
+        PSNodeAlloc *B = PS.createDynAlloc();
+        PSNode *S = PS.createStore(A, B);
+        PSNode *L = PS.createLoad(B);
+        PSNodeGep *G = PS.createGep(A, 4);
+        PSNodeMemcpy *M = PS.createMemcpy(A, B, 8);
+        PSNode *C = PS.createConstant(A, 2);
+        PSNode *P = PS.createPhi({A, B, L});
+        PSNodeCall *CL = PS.createCall({A});
+        PSNodeRet *R = PS.createReturn({P});
+        PSNodeEntry *E = PS.createEntry("f");
+
+        check(A->getType() == PSNodeType::ALLOC, "wrong type of A");
+        check(B->getType() == PSNodeType::DYN_ALLOC, "wrong type of B");
+        check(S->getOperandsNum() == 2 && S->getOperand(0) == A &&
+              S->getOperand(1) == B, "wrong operands of S");
+        check(L->getOperandsNum() == 1 && L->getOperand(0) == B,
+              "wrong operands of L");
+        check(G->getSource() == A && G->getOffset() == 4, "wrong GEP");
+        check(M->getSource() == A && M->getDestination() == B &&
+              M->getLength() == 8, "wrong MEMCPY");
+        check(C->pointsTo.size() == 1 && C->doesPointsTo(A, 2),
+              "wrong CONSTANT");
+        check(P->getOperandsNum() == 3 && P->getOperand(2) == L,
+              "wrong operands of P");
+        check(CL->getOperandsNum() == 1 && CL->getOperand(0) == A,
+              "wrong operands of CL");
+        check(R->getOperandsNum() == 1 && R->getOperand(0) == P,
+              "wrong operands of R");
+        check(E->getFunctionName() == "f", "wrong name of E");
+        check(A->getUsers().size() == 6, "wrong users of A");
+    }
+
+    // the type-safe builders create the same graph as create()
+    void builders_and_create()
+    {
+        using namespace dg::analysis::pta;
+        PointerSubgraph PS;
+        PSNode *A = PS.create(PSNodeType::ALLOC);
+        PSNode *B = PS.createAlloc();
+        PSNode *G1 = PS.create(PSNodeType::GEP, A, 4);
+        PSNode *G2 = PS.createGep(A, 4);
+        PSNode *S1 = PS.create(PSNodeType::STORE, G1, B);
+        PSNode *S2 = PS.createStore(G2, B);
+        PSNode *L1 = PS.create(PSNodeType::LOAD, B);
+        PSNode *L2 = PS.createLoad(B);
+        PSNode *P1 = PS.create(PSNodeType::PHI, L1, L2, nullptr);
+        PSNode *P2 = PS.createPhi({L1, L2});
+
+        A->setSize(8);
+        A->addSuccessor(B);
+        B->addSuccessor(G1);
+        G1->addSuccessor(G2);
+        G2->addSuccessor(S1);
+        S1->addSuccessor(S2);
+        S2->addSuccessor(L1);
+        L1->addSuccessor(L2);
+        L2->addSuccessor(P1);
+        P1->addSuccessor(P2);
+
+        PS.setRoot(A);
+        PointsToFlowInsensitive PA(&PS);
+        PA.run();
+
+        auto same = [](PSNode *n1, PSNode *n2) {
+            if (n1->pointsTo.size() != n2->pointsTo.size())
+                return false;
+            for (const Pointer& ptr : n1->pointsTo) {
+                if (!n2->doesPointsTo(ptr))
+                    return false;
+            }
+            return true;
+        };
+
+        check(same(G1, G2), "GEPs differ");
+        check(same(L1, L2), "LOADs differ");
+        check(L1->doesPointsTo(A, 4), "L1 does not point to A + 4");
+        check(same(P1, P2), "PHIs differ");
+        check(P1->getOperandsNum() == P2->getOperandsNum(),
+              "PHIs have different operands");
+    }
+
     void test()
     {
         unknown_offset1();
+        builders();
+        builders_and_create();
+    }
+};
+
+class SCCTest : public Test
+{
+public:
+    SCCTest() : Test("SCC test") {}
+
+    void loops()
+    {
+        using namespace analysis;
+
+        // A -> B -> C -> B, C -> D -> E -> D
+        PointerSubgraph PS;
+        PSNode *A = PS.createNoop();
+        PSNode *B = PS.createNoop();
+        PSNode *C = PS.createNoop();
+        PSNode *D = PS.createNoop();
+        PSNode *E = PS.createNoop();
+        A->addSuccessor(B);
+        B->addSuccessor(C);
+        C->addSuccessor(B);
+        C->addSuccessor(D);
+        D->addSuccessor(E);
+        E->addSuccessor(D);
+        E->addSuccessor(E);
+
+        SCC<PSNode> S;
+        auto& comps = S.compute(A);
+        check(comps.size() == 3, "wrong number of components");
+
+        // reverse topological order
+        check(comps[0].size() == 2, "wrong component");
+        check(S.getSCCId(D) == 0 && S.getSCCId(E) == 0, "wrong component");
+        check(S.getSCCId(B) == 1 && S.getSCCId(C) == 1, "wrong component");
+        check(S.getSCCId(A) == 2 && comps[2].size() == 1, "wrong component");
+
+        SCCCondensation<PSNode> CG(S);
+        check(CG.size() == 3, "wrong condensation");
+        check(CG[2].getSuccessors() == std::vector<unsigned>{1},
+              "wrong successors in condensation");
+        check(CG[1].getSuccessors() == std::vector<unsigned>{0},
+              "wrong successors in condensation");
+        check(CG[0].getSuccessors().empty(),
+              "wrong successors in condensation");
+
+        // the same, but without the SCC object
+        SCCCondensation<PSNode> CG2(comps);
+        check(CG2[2].getSuccessors() == std::vector<unsigned>{1},
+              "wrong successors in condensation");
+    }
+
+    void deep_graph()
+    {
+        using namespace analysis;
+
+        // a long chain closed into a cycle would
+        // overflow the stack with the recursive algorithm
+        PointerSubgraph PS;
+        PSNode *first = PS.createNoop();
+        PSNode *last = first;
+        for (int i = 0; i < 500000; ++i) {
+            PSNode *n = PS.createNoop();
+            last->addSuccessor(n);
+            last = n;
+        }
+
+        PSNode *tail = PS.createNoop();
+        last->addSuccessor(first);
+        last->addSuccessor(tail);
+
+        SCC<PSNode> S;
+        auto& comps = S.compute(first);
+        check(comps.size() == 2, "wrong number of components");
+        check(comps[0].size() == 1 && comps[0][0] == tail, "wrong component");
+        check(comps[1].size() == 500001, "wrong component");
+    }
+
+    void test()
+    {
+        loops();
+        deep_graph();
     }
 };
 
@@ -995,7 +2286,16 @@ int main(void)
 
     Runner.add(new FlowInsensitivePointsToTest());
     Runner.add(new FlowSensitivePointsToTest());
+    Runner.add(new SparseFlowSensitivePointsToTest());
+    Runner.add(new ContextSensitivePointsToTest());
+    Runner.add(new DemandDrivenPointsToTest());
+    Runner.add(new BudgetPointsToTest());
+    Runner.add(new MemoryMapTest());
+    Runner.add(new ParallelPointsToTest());
+    Runner.add(new PSOptimizationsTest());
+    Runner.add(new PointsToSnapshotTest());
     Runner.add(new PSNodeTest());
+    Runner.add(new SCCTest());
 
     return Runner();
 }
@@ -23,6 +23,31 @@ std::uniform_int_distribution<uint64_t> distribution(0, ~static_cast<uint64_t>(0
         func<SimplePointsToSet>(); \
     tm.stop(); \
     tm.report(" -- PointsToSet std::set took"); \
+    tm.start(); \
+    for (int i = 0; i < times; ++i) \
+        func<SmallPointsToSet<>>(); \
+    tm.stop(); \
+    tm.report(" -- PointsToSet small took"); \
+    } while(0);
+
+// the BDD set is not compared on the tests with random offsets,
+// since random offsets share no nodes and every add creates
+// a new path of 64 nodes. The number of nodes that are left
+// in the table after the sets were destroyed is reported too
+#define run_bdd(func, msg) do { \
+    std::cout << "Running " << msg << "\n"; \
+    dg::debug::TimeMeasure tm; \
+    tm.start(); \
+    for (int i = 0; i < times; ++i) \
+        func<PointsToSet>(); \
+    tm.stop(); \
+    tm.report(" -- PointsToSet bitvector took"); \
+    tm.start(); \
+    for (int i = 0; i < times; ++i) \
+        func<BDDPointsToSet>(); \
+    tm.stop(); \
+    tm.report(" -- PointsToSet BDD took"); \
+    std::cout << " -- BDD nodes: " << BDDTable::get().nodesNum() << "\n"; \
     } while(0);
 
 template <typename PTSetT>
@@ -86,6 +111,25 @@ void test5() {
     }
 }
 
+// sets with a lot of aliasing: each set points to the same
+// 100 objects on 100 offsets plus few pointers of its own
+template <typename PTSetT>
+void test6() {
+    PTSetT Common;
+    for (uintptr_t p = 1; p <= 100; ++p)
+        for (uint64_t off = 0; off < 100; ++off)
+            Common.add(reinterpret_cast<PSNode *>(p), off*8);
+
+    std::vector<PTSetT> sets(100);
+    for (uintptr_t i = 0; i < sets.size(); ++i) {
+        sets[i].add(reinterpret_cast<PSNode *>(1000 + i), 0);
+        sets[i].merge(Common);
+    }
+
+    PTSetT S;
+    for (const auto& set : sets)
+        S.merge(set);
+}
 
 int main()
 {
@@ -104,4 +148,13 @@ int main()
 
     times = 10000;
     run(test5, "Adding 1000 different pointers");
+
+    times = 100000;
+    run_bdd(test1, "Adding three elements");
+
+    times = 100;
+    run_bdd(test4, "Adding 1000 offsets to a pointer");
+
+    times = 10;
+    run_bdd(test6, "Merging 100 sets of 10000 aliased pointers");
 }
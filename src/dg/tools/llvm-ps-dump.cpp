@@ -43,6 +43,7 @@
 #include "analysis/PointsTo/PointsToFlowInsensitive.h"
 #include "analysis/PointsTo/PointsToFlowSensitive.h"
 #include "analysis/PointsTo/PointsToWithInvalidate.h"
+#include "analysis/PointsTo/PointsToSnapshot.h"
 #include "analysis/PointsTo/Pointer.h"
 
 #include "TimeMeasure.h"
@@ -365,6 +366,45 @@ dumpPointerSubgraph(LLVMPointerAnalysis *pta, PTType type, bool todot)
     }
 }
 
+static void
+dumpSnapshot(const PointsToSnapshot& snapshot)
+{
+    for (size_t i = 0; i < snapshot.size(); ++i) {
+        const PointsToSnapshot::NodeRecord& nd = snapshot.getNode(i);
+        printf("NODE %3u: Ty: ", nd.id);
+        printPSNodeType(snapshot.getType(nd));
+        printf(" %s\n", snapshot.getName(nd).c_str());
+
+        if (nd.pointers_num == 0) {
+            puts("    -- no points-to");
+            continue;
+        }
+
+        for (auto it = snapshot.pointersBegin(nd), et = snapshot.pointersEnd(nd);
+             it != et; ++it)
+            printf("    -> %s\n", snapshot.getPointerString(*it).c_str());
+    }
+}
+
+static void
+reportPrecisionLosses(const PointerAnalysis *pta)
+{
+    for (const PrecisionLoss& loss : pta->getPrecisionLosses()) {
+        errs() << "INFO: Points-to budget (" << toString(loss.reason)
+               << ") exceeded: " << toString(loss.action) << " in ";
+        if (!loss.node) {
+            errs() << "all nodes\n";
+            continue;
+        }
+
+        std::string name = getSnapshotName(loss.node);
+        if (name.empty())
+            errs() << "<" << loss.node->getID() << ">\n";
+        else
+            errs() << name << "\n";
+    }
+}
+
 int main(int argc, char *argv[])
 {
     llvm::Module *M;
@@ -372,8 +412,11 @@ int main(int argc, char *argv[])
     llvm::SMDiagnostic SMD;
     bool todot = false;
     const char *module = nullptr;
+    const char *snapshot_file = nullptr;
+    const char *save_snapshot = nullptr;
     PTType type = FLOW_INSENSITIVE;
     uint64_t field_senitivity = Offset::UNKNOWN;
+    PointsToBudget budget;
 
     // parse options
     for (int i = 1; i < argc; ++i) {
@@ -385,19 +428,48 @@ int main(int argc, char *argv[])
                 type = WITH_INVALIDATE;
         } else if (strcmp(argv[i], "-pta-field-sensitive") == 0) {
             field_senitivity = static_cast<uint64_t>(atoll(argv[i + 1]));
+        } else if (strcmp(argv[i], "-pta-budget-time") == 0) {
+            budget.time = static_cast<uint64_t>(atoll(argv[++i]));
+        } else if (strcmp(argv[i], "-pta-budget-iterations") == 0) {
+            budget.iterations = static_cast<uint64_t>(atoll(argv[++i]));
+        } else if (strcmp(argv[i], "-pta-budget-size") == 0) {
+            budget.pointsToSize = static_cast<size_t>(atoll(argv[++i]));
+        } else if (strcmp(argv[i], "-pta-budget-offsets") == 0) {
+            budget.offsets = static_cast<size_t>(atoll(argv[++i]));
+        } else if (strcmp(argv[i], "-pta-budget-memory") == 0) {
+            budget.memory = static_cast<uint64_t>(atoll(argv[++i]));
         } else if (strcmp(argv[i], "-dot") == 0) {
             todot = true;
         } else if (strcmp(argv[i], "-ids-only") == 0) {
             ids_only = true;
         } else if (strcmp(argv[i], "-v") == 0) {
             verbose = true;
+        } else if (strcmp(argv[i], "-save-snapshot") == 0) {
+            save_snapshot = argv[++i];
+        } else if (strcmp(argv[i], "-snapshot") == 0) {
+            snapshot_file = argv[++i];
         } else {
             module = argv[i];
         }
     }
 
+    // dump the stored results, there's nothing to compute
+    if (snapshot_file) {
+        PointsToSnapshot snapshot;
+        if (!snapshot.load(snapshot_file)) {
+            errs() << snapshot.getError() << "\n";
+            return 1;
+        }
+
+        dumpSnapshot(snapshot);
+        return 0;
+    }
+
     if (!module) {
-        errs() << "Usage: % IR_module [output_file]\n";
+        errs() << "Usage: % IR_module [-save-snapshot file] [-pta-budget-time ms]\n"
+               << "         [-pta-budget-iterations N] [-pta-budget-size N]\n"
+               << "         [-pta-budget-offsets N] [-pta-budget-memory N] [output_file]\n"
+               << "       % -snapshot file\n";
         return 1;
     }
 
@@ -438,10 +510,19 @@ int main(int argc, char *argv[])
     }
 
     // run the analysis
+    PA->setBudget(budget);
     PA->run();
 
     tm.stop();
     tm.report("INFO: Points-to analysis [new] took");
+    reportPrecisionLosses(PA.get());
+
+    if (save_snapshot &&
+        !PointsToSnapshot::save(PTA.getNodes(), save_snapshot, getSnapshotName)) {
+        errs() << "Failed writing the snapshot to '" << save_snapshot << "'\n";
+        return 1;
+    }
+
     dumpPointerSubgraph(&PTA, type, todot);
 
     return 0;
@@ -40,6 +40,7 @@
 
 #include "analysis/PointsTo/PointsToFlowInsensitive.h"
 #include "analysis/PointsTo/PointsToFlowSensitive.h"
+#include "analysis/PointsTo/PointsToSnapshot.h"
 #include "analysis/PointsTo/Pointer.h"
 
 #include "TimeMeasure.h"
@@ -200,12 +201,61 @@ static bool verify_ptsets(llvm::Module *M,
     return ret;
 }
 
+static bool
+saveSnapshot(LLVMPointerAnalysis *pta, const std::string& path)
+{
+    if (!PointsToSnapshot::save(pta->getNodes(), path, getSnapshotName)) {
+        errs() << "Failed writing the snapshot to '" << path << "'\n";
+        return false;
+    }
+
+    return true;
+}
+
+// compare stored results of two analyses without running them
+static int
+diffSnapshots(const char *first_file, const char *second_file)
+{
+    PointsToSnapshot first, second;
+    if (!first.load(first_file)) {
+        errs() << first.getError() << "\n";
+        return 1;
+    }
+
+    if (!second.load(second_file)) {
+        errs() << second.getError() << "\n";
+        return 1;
+    }
+
+    auto diffs = PointsToSnapshot::diff(first, second);
+    for (const auto& d : diffs) {
+        printf("%s", d.node.c_str());
+        if (!d.in_first)
+            printf(" (only in %s)", second_file);
+        else if (!d.in_second)
+            printf(" (only in %s)", first_file);
+        putchar('\n');
+
+        for (const std::string& ptr : d.only_first)
+            printf("    - %s\n", ptr.c_str());
+        for (const std::string& ptr : d.only_second)
+            printf("    + %s\n", ptr.c_str());
+    }
+
+    if (diffs.empty())
+        llvm::errs() << "The snapshots are the same\n";
+
+    return diffs.empty() ? 0 : 1;
+}
+
 int main(int argc, char *argv[])
 {
     llvm::Module *M;
     llvm::LLVMContext context;
     llvm::SMDiagnostic SMD;
     const char *module = nullptr;
+    const char *save_prefix = nullptr;
+    const char *diff_files[2] = {nullptr, nullptr};
     unsigned type = FLOW_SENSITIVE | FLOW_INSENSITIVE;
 
     // parse options
@@ -220,6 +270,11 @@ int main(int argc, char *argv[])
                 errs() << "Unknown PTA type" << argv[i + 1] << "\n";
                 abort();
             }
+        } else if (strcmp(argv[i], "-save-snapshot") == 0) {
+            save_prefix = argv[++i];
+        } else if (strcmp(argv[i], "-diff") == 0) {
+            diff_files[0] = argv[++i];
+            diff_files[1] = argv[++i];
         /*} else if (strcmp(argv[i], "-v") == 0) {
             verbose = true;*/
         } else {
@@ -227,8 +282,12 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (diff_files[0])
+        return diffSnapshots(diff_files[0], diff_files[1]);
+
     if (!module) {
-        errs() << "Usage: % llvm-pta-compare [-pta fs|fi] IR_module\n";
+        errs() << "Usage: % llvm-pta-compare [-pta fs|fi] [-save-snapshot prefix] IR_module\n"
+               << "       % llvm-pta-compare -diff snapshot1 snapshot2\n";
         return 1;
     }
 
@@ -258,6 +317,10 @@ int main(int argc, char *argv[])
         PTAfi->run<analysis::pta::PointsToFlowInsensitive>();
         tm.stop();
         tm.report("INFO: Points-to flow-insensitive analysis took");
+
+        if (save_prefix &&
+            !saveSnapshot(PTAfi, std::string(save_prefix) + "-fi.pts"))
+            return 1;
     }
 
     if (type & FLOW_SENSITIVE) {
@@ -267,6 +330,10 @@ int main(int argc, char *argv[])
         PTAfs->run<analysis::pta::PointsToFlowSensitive>();
         tm.stop();
         tm.report("INFO: Points-to flow-sensitive analysis took");
+
+        if (save_prefix &&
+            !saveSnapshot(PTAfs, std::string(save_prefix) + "-fs.pts"))
+            return 1;
     }
 
     int ret = 0;
@@ -65,6 +65,8 @@
 
 #include "analysis/PointsTo/PointsToFlowInsensitive.h"
 #include "analysis/PointsTo/PointsToFlowSensitive.h"
+#include "analysis/PointsTo/PointsToSparseFlowSensitive.h"
+#include "analysis/PointsTo/PointsToContextSensitive.h"
 #include "analysis/PointsTo/PointsToWithInvalidate.h"
 #include "analysis/PointsTo/Pointer.h"
 #include "analysis/Offset.h"
@@ -77,7 +79,7 @@ using AnnotationOptsT
         = dg::debug::LLVMDGAssemblyAnnotationWriter::AnnotationOptsT;
 
 enum PtaType {
-    fs, fi, inv
+    fs, fi, inv, sfs, csfi, csfs
 };
 
 enum RdaType {
@@ -130,7 +132,10 @@ llvm::cl::opt<PtaType> pta("pta",
     llvm::cl::values(
         clEnumVal(fi, "Flow-insensitive PTA (default)"),
         clEnumVal(fs, "Flow-sensitive PTA"),
-        clEnumVal(inv, "PTA with invalidate nodes")
+        clEnumVal(inv, "PTA with invalidate nodes"),
+        clEnumVal(sfs, "Sparse flow-sensitive PTA (on top of flow-insensitive PTA)"),
+        clEnumVal(csfi, "Context-sensitive flow-insensitive PTA"),
+        clEnumVal(csfs, "Context-sensitive flow-sensitive PTA")
 #if LLVM_VERSION_MAJOR < 4
         , nullptr
 #endif
@@ -187,6 +192,12 @@ static void annotate(llvm::Module *M, AnnotationOptsT opts,
         module_comment += "flow-sensitive\n";
     else if (pta == PtaType::inv)
         module_comment += "flow-sensitive with invalidate\n";
+    else if (pta == PtaType::sfs)
+        module_comment += "sparse flow-sensitive\n";
+    else if (pta == PtaType::csfi)
+        module_comment += "context-sensitive flow-insensitive\n";
+    else if (pta == PtaType::csfs)
+        module_comment += "context-sensitive flow-sensitive\n";
 
     module_comment+= ";   * PTA field sensitivity: ";
     if (pta_field_sensitivie == Offset::UNKNOWN)
@@ -430,6 +441,14 @@ public:
             PTA->run<analysis::pta::PointsToFlowInsensitive>();
         else if (pta == PtaType::inv)
             PTA->run<analysis::pta::PointsToWithInvalidate>();
+        else if (pta == PtaType::sfs)
+            PTA->run<analysis::pta::PointsToSparseFlowSensitive>();
+        else if (pta == PtaType::csfi)
+            PTA->run<analysis::pta::PointsToContextSensitive<
+                        analysis::pta::PointsToFlowInsensitive>>();
+        else if (pta == PtaType::csfs)
+            PTA->run<analysis::pta::PointsToContextSensitive<
+                        analysis::pta::PointsToFlowSensitive>>();
         else
             assert(0 && "Wrong pointer analysis");
 
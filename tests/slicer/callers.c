@@ -0,0 +1,21 @@
+// The target function is called from more functions and only one
+// of them is on the path from main.
+//
+// APEX-LINE: 10
+// APEX-OUTPUT: 7
+
+int unused(int n);
+
+int target(int n) {
+  int result = n + 2;
+  return result;
+}
+
+int middle(int n) { return target(n); }
+
+int unused(int n) { return target(n) + middle(n); }
+
+int main(void) {
+  int m = middle(5);
+  return m;
+}
@@ -0,0 +1,22 @@
+// The path to the target goes through a call via function pointer
+// that can call more functions.
+//
+// APEX-LINE: 10
+// APEX-OUTPUT: 42
+
+int other(int n) { return n - 1; }
+
+int target(int n) {
+  int result = n * 2;
+  return result;
+}
+
+int via_target(int n) { return target(n + 1); }
+
+int (*pick(int i))(int) { return i > 0 ? via_target : other; }
+
+int main(void) {
+  int (*fp)(int) = pick(1);
+  int r = fp(20);
+  return other(r);
+}
@@ -0,0 +1,41 @@
+#!/bin/bash
+# Published under Apache 2.0 license.
+# See LICENSE for details.
+
+# Runs APEX in the dg slicer mode (via both pass managers) on every
+# program in this directory and checks what the extracted executable
+# prints. The programs specify the target line and the expected output
+# in the comments:
+#   // APEX-LINE: <line>
+#   // APEX-OUTPUT: <value>
+#
+# run (from the repository root): $ make test
+
+cd "$(dirname "$0")/../.." || exit 1
+
+FAILED=0
+for SRC in tests/slicer/*.c; do
+  for NEWPM in false true; do
+    NAME=$(basename "$SRC")
+    LINE=$(sed -n 's/.*APEX-LINE: *\([0-9]*\).*/\1/p' "$SRC")
+    EXPECTED=$(sed -n 's/.*APEX-OUTPUT: *\(.*\)$/\1/p' "$SRC")
+
+    # apex.py removes the build directory, so keep the bitcode elsewhere
+    BC=$(mktemp --suffix=.bc)
+    clang -c -g -emit-llvm "$SRC" -o "$BC" || { FAILED=1; continue; }
+    python apex.py "$BC" "$NAME" "$LINE" --slicer true --newpm $NEWPM
+    rm -f "$BC"
+
+    OUTPUT=$(./extracted)
+    STATUS=$?
+    if [ "$STATUS" -ne 0 ] || [ "$OUTPUT" != "$EXPECTED" ]; then
+      echo "FAIL: $NAME, new pm: $NEWPM (exit $STATUS," \
+           "output '$OUTPUT', expected '$EXPECTED')"
+      FAILED=1
+    else
+      echo "PASS: $NAME, new pm: $NEWPM"
+    fi
+  done
+done
+
+exit $FAILED